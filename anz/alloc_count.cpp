@@ -0,0 +1,96 @@
+#include "alloc_count.h"
+
+#if defined(COUNT_ALLOCATIONS) && defined(__GLIBC__)
+
+#include <cerrno>
+#include <cstddef>
+
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void *ptr);
+}
+
+namespace
+{
+    // initial-exec TLS라 첫 malloc 전에도 쓸 수 있다 (생성자가 없는 POD)
+    __thread uint64_t allocations;
+}
+
+extern "C"
+{
+    void *malloc(size_t size)
+    {
+        allocations++;
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        allocations++;
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        allocations++;
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void *ptr)
+    {
+        __libc_free(ptr);
+    }
+
+    void *memalign(size_t alignment, size_t size)
+    {
+        allocations++;
+        return __libc_memalign(alignment, size);
+    }
+
+    void *aligned_alloc(size_t alignment, size_t size)
+    {
+        allocations++;
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void **ptr, size_t alignment, size_t size)
+    {
+        if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        allocations++;
+        void *p = __libc_memalign(alignment, size);
+        if (!p)
+            return ENOMEM;
+        *ptr = p;
+        return 0;
+    }
+}
+
+bool alloc_count_enabled()
+{
+    return true;
+}
+
+uint64_t alloc_count()
+{
+    return allocations;
+}
+
+#else
+
+bool alloc_count_enabled()
+{
+    return false;
+}
+
+uint64_t alloc_count()
+{
+    return 0;
+}
+
+#endif
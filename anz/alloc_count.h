@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+// malloc 호출 수를 센다 (benchmark의 allocations/glyph 용).
+//
+// COUNT_ALLOCATIONS로 build 하면 malloc / calloc / realloc / memalign 계열을 이 실행 파일에서 정의해서
+// glibc 것으로 넘기기 전에 thread별 counter를 올린다. 공유 library(HarfBuzz, cairo, FreeType ...)의 호출도
+// 실행 파일의 정의로 묶이므로 같이 세어진다. operator new도 malloc을 부르므로 포함된다.
+// 보통 build에서는 아무것도 가로채지 않고 alloc_count_enabled()가 false다.
+
+bool alloc_count_enabled();
+
+// 이 thread에서 지금까지 한 할당 수
+uint64_t alloc_count();
@@ -0,0 +1,1114 @@
+#include "anz.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fontconfig/fontconfig.h>
+// for fontconfig
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+// for freetype
+
+#include <hb.h>
+// for harfbuzz
+
+#include <cairo.h>
+#include <cairo-ft.h>
+// for cairo
+
+#include "bidi_itemizer.h"
+#include "composite.h"
+#include "damage.h"
+#include "font_fallback.h"
+#include "font_map.h"
+#include "font_subset.h"
+#include "glyph_cache.h"
+#include "shape_cache.h"
+
+const int DEFAULT_FONT_SIZE = 36;
+const int SHAPE_CACHE_SIZE = 4096;
+// label damage 영역: cairo가 glyph 위치를 pixel로 반올림하고 (0.5px) antialiasing이 번지는 (1px) 만큼 넓힌다
+const int LABEL_INK_PAD = 2;
+
+struct anz_font
+{
+    std::atomic<int> references{1};
+
+    MappedFont map; // primary font file
+    int faceIndex = 0;
+
+    FontFallback fallback;
+    FontMaps fallbackMaps; // fallback font file, 이 font를 쓰는 모든 renderer가 공유한다 (thread-safe)
+};
+
+namespace
+{
+    // renderer의 FT_Library와 그 face들이 읽는 font.
+    // cairo는 font face를 자기 cache에 renderer보다 오래 잡고 있을 수 있고 다른 thread에서 놓을 수도 있다.
+    // 그래서 cairo font face를 만든 FT_Face는 cairo가 놓을 때 닫고, library와 font (mapping)는
+    // renderer와 모든 FT_Face가 놓은 뒤에 해제한다
+    struct FaceLibrary
+    {
+        FT_Library library = NULL;
+        anz_font_t *font = NULL; // reference 하나
+        std::mutex mutex;        // FT_New_Memory_Face / FT_Done_Face는 library 하나에서 동시에 부를 수 없다
+        std::atomic<int> references{1};
+    };
+
+    void release_library(FaceLibrary *library)
+    {
+        if (library->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        FT_Done_FreeType(library->library);
+        anz_font_destroy(library->font);
+        delete library;
+    }
+
+    void done_face(FT_Face face, FaceLibrary *library)
+    {
+        {
+            std::lock_guard<std::mutex> lock(library->mutex);
+            FT_Done_Face(face);
+        }
+        release_library(library);
+    }
+
+    // cairo font face의 user data: cairo가 font face를 놓을 때 FT_Face를 닫는다
+    const cairo_user_data_key_t FT_FACE_KEY = {};
+
+    struct FaceOwner
+    {
+        FT_Face face;
+        FaceLibrary *library;
+    };
+
+    void done_face_owner(void *data)
+    {
+        FaceOwner *owner = (FaceOwner *)data;
+        done_face(owner->face, owner->library);
+        delete owner;
+    }
+
+    // renderer가 연 font 하나 (primary 또는 fallback)
+    struct RendererFace
+    {
+        bool opened = false;
+        FT_Face face = NULL; // 열지 못했으면 NULL, primary로 대신 그린다
+        uint32_t instance = 0; // GlyphCache::instanceOf(face)
+        hb_font_t *hb_font = NULL;
+        cairo_font_face_t *cairo_face = NULL;
+    };
+
+    struct FontItem
+    {
+        unsigned int start;
+        unsigned int length;
+        unsigned int font;
+        const BidiRun *run;
+    };
+
+    struct GlyphSegment
+    {
+        unsigned int font;
+        unsigned int start;
+        unsigned int count;
+    };
+}
+
+struct anz_renderer
+{
+    anz_font_t *font = NULL;
+
+    int fontSize = DEFAULT_FONT_SIZE;
+    double color[4] = {0., 0., 0., 1.};
+    FriBidiParType base = FRIBIDI_PAR_ON;
+    bool useGlyphCache = false;
+
+    FaceLibrary *library = NULL;     // 열린 FT_Face마다 reference 하나
+    std::vector<RendererFace> faces; // FontFallback 번호로 찾는다, [0]은 primary
+    hb_buffer_t *buffer = NULL;
+
+    BidiItemizer bidi;
+    ShapeCache shapeCache{SHAPE_CACHE_SIZE};
+    GlyphCache glyphCache;
+
+    // 마지막 shape() 결과, 호출 사이에 재사용한다
+    std::string text;
+    std::vector<FontItem> items;
+    std::vector<GlyphSegment> segments;
+    std::vector<hb_glyph_info_t> infos;
+    std::vector<hb_glyph_position_t> positions;
+    std::vector<cairo_glyph_t> glyphs;
+};
+
+struct anz_label
+{
+    anz_renderer_t *renderer = NULL;
+
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    anz_pixel_format_t format = ANZ_FORMAT_ARGB32;
+    cairo_format_t cairoFormat = CAIRO_FORMAT_ARGB32;
+    double x = 0;
+    double y = 0;
+    double background[4] = {0., 0., 0., 0.};
+    std::vector<unsigned char> pixels;
+
+    // 이전 frame을 그린 설정. 바뀌면 전체를 다시 그린다
+    bool full = true;
+    int fontSize = 0;
+    double color[4] = {0., 0., 0., 0.};
+    bool useGlyphCache = false;
+
+    DamageTracker damage;
+    std::vector<anz_rect_t> rects;
+    std::vector<double> penX; // glyph마다 pen 위치 (device 좌표), glyph cache로 일부만 그릴 때 쓴다
+    std::vector<double> penY;
+    std::vector<cairo_glyph_t> glyphs; // scratch
+    cairo_t *measure = NULL;           // cairo로 그릴 glyph의 ink 영역을 재는 곳, 처음 update에서 만든다
+};
+
+namespace
+{
+    anz_status_t open_font(const char *path, int faceIndex, const char *query, anz_font_t **out)
+    {
+        anz_font_t *font = new (std::nothrow) anz_font_t;
+        if (!font)
+            return ANZ_ERROR_NO_MEMORY;
+
+        if (!font->map.open(path))
+        {
+            delete font;
+            return ANZ_ERROR_FONT_NOT_FOUND;
+        }
+        font->faceIndex = faceIndex;
+
+        // primary coverage는 cmap에서 만든다. fallback chain은 처음 필요할 때 fontconfig로 만든다
+        FT_Library library;
+        FT_Face face;
+        if (FT_Init_FreeType(&library))
+        {
+            delete font;
+            return ANZ_ERROR_NO_MEMORY;
+        }
+        if (FT_New_Memory_Face(library, font->map.data(), font->map.size(), faceIndex, &face))
+        {
+            FT_Done_FreeType(library);
+            delete font;
+            return ANZ_ERROR_FONT_LOAD;
+        }
+
+        CoverageBitmap coverage;
+        FT_UInt glyph;
+        FT_ULong first = FT_Get_First_Char(face, &glyph);
+        FT_ULong last = first;
+        while (glyph)
+        {
+            FT_ULong next = FT_Get_Next_Char(face, last, &glyph);
+            if (!glyph || next != last + 1)
+            {
+                coverage.addRange(first, last);
+                first = next;
+            }
+            last = next;
+        }
+
+        std::string family = query ? query : face->family_name ? face->family_name : "sans-serif";
+        FT_Done_Face(face);
+        FT_Done_FreeType(library);
+
+        font->fallback.setPrimary(family, path, faceIndex, std::move(coverage));
+        *out = font;
+        return ANZ_OK;
+    }
+
+    hb_font_t *create_hb_font(MappedFont *map, int faceIndex, FT_Face face)
+    {
+        // main.cpp와 같다: hb_ft_font_create()와 같은 scale, position은 26.6 단위
+        hb_font_t *hb_font = hb_font_create(map->face(faceIndex));
+        hb_font_set_scale(hb_font,
+                          ((uint64_t)face->size->metrics.x_scale * face->units_per_EM + (1u << 15)) >> 16,
+                          ((uint64_t)face->size->metrics.y_scale * face->units_per_EM + (1u << 15)) >> 16);
+        hb_font_set_ppem(hb_font, face->size->metrics.x_ppem, face->size->metrics.y_ppem);
+        return hb_font;
+    }
+
+    RendererFace &face_of(anz_renderer_t *r, unsigned int index)
+    {
+        if (r->faces.size() <= index)
+            r->faces.resize(index + 1);
+
+        RendererFace &face = r->faces[index];
+        if (face.opened)
+            return face;
+        face.opened = true;
+
+        const FallbackFont &font = r->font->fallback.font(index);
+        MappedFont *map = index ? r->font->fallbackMaps.open(font.file) : &r->font->map;
+        if (!map)
+            return face;
+
+        {
+            std::lock_guard<std::mutex> lock(r->library->mutex);
+            if (FT_New_Memory_Face(r->library->library, map->data(), map->size(), font.faceIndex, &face.face))
+            {
+                face.face = NULL;
+                return face;
+            }
+        }
+        r->library->references.fetch_add(1, std::memory_order_relaxed);
+
+        if (FT_Set_Char_Size(face.face, 0, r->fontSize * 64, 0, 0))
+        {
+            done_face(face.face, r->library);
+            face.face = NULL;
+            return face;
+        }
+
+        face.hb_font = create_hb_font(map, font.faceIndex, face.face);
+        face.instance = GlyphCache::instanceOf(face.face);
+        return face;
+    }
+
+    cairo_font_face_t *cairo_face_of(anz_renderer_t *r, RendererFace &face)
+    {
+        if (face.cairo_face)
+            return face.cairo_face;
+
+        // 이제부터 FT_Face는 cairo가 닫는다
+        face.cairo_face = cairo_ft_font_face_create_for_ft_face(face.face, 0);
+        FaceOwner *owner = new (std::nothrow) FaceOwner{face.face, r->library};
+        if (!owner || cairo_font_face_set_user_data(face.cairo_face, &FT_FACE_KEY, owner, done_face_owner) !=
+                          CAIRO_STATUS_SUCCESS)
+        {
+            // user data가 없으면 cairo는 FT_Face를 닫지 않는다. 여기서 닫고 library reference도 놓는다
+            delete owner;
+            cairo_font_face_destroy(face.cairo_face);
+            done_face(face.face, r->library);
+            face.cairo_face = NULL;
+            face.face = NULL;
+            return NULL;
+        }
+        return face.cairo_face;
+    }
+
+    void close_faces(anz_renderer_t *r)
+    {
+        // cache key가 닫힌 hb_font / FT_Face를 가리키지 않도록 먼저 비운다
+        r->shapeCache.clear();
+        r->glyphCache.clear();
+
+        for (RendererFace &face : r->faces)
+        {
+            // cairo font face를 만든 FT_Face는 cairo가 마지막 reference를 놓을 때 닫힌다 (done_face_owner)
+            if (face.cairo_face)
+                cairo_font_face_destroy(face.cairo_face);
+            else if (face.face)
+                done_face(face.face, r->library);
+            if (face.hb_font)
+                hb_font_destroy(face.hb_font);
+        }
+        r->faces.clear();
+    }
+
+    // 그리기 전에 segment가 쓰는 cairo font face를 모두 만들어 둔다. 하나라도 실패하면 cache가 닫힌
+    // FT_Face를 가리키지 않도록 face를 모두 닫는다 (다음 shape()에서 다시 연다)
+    bool open_cairo_faces(anz_renderer_t *r)
+    {
+        for (const GlyphSegment &segment : r->segments)
+        {
+            if (!cairo_face_of(r, r->faces[segment.font]))
+            {
+                close_faces(r);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    anz_status_t shape(anz_renderer_t *r, const char *utf8, int length)
+    {
+        r->text.assign(utf8, length < 0 ? strlen(utf8) : (size_t)length);
+        if (!r->bidi.itemize(r->text, r->base))
+            return ANZ_ERROR_TEXT;
+
+        if (!face_of(r, 0).face)
+            return ANZ_ERROR_FONT_LOAD;
+        if (!r->buffer)
+            r->buffer = hb_buffer_create();
+
+        const uint32_t *text = r->bidi.text();
+        r->items.clear();
+        r->segments.clear();
+        r->infos.clear();
+        r->positions.clear();
+
+        // bidi run을 font 단위로 다시 나눈다 (main.cpp의 my_harfbuzz()와 같음)
+        for (const BidiRun &run : r->bidi.runs())
+        {
+            size_t first = r->items.size();
+            unsigned int end = run.start + run.length;
+            unsigned int start = run.start;
+            unsigned int current = 0;
+            for (unsigned int i = run.start; i < end; i++)
+            {
+                unsigned int font = r->font->fallback.find(text[i], current);
+                if (font && !face_of(r, font).face)
+                    font = 0;
+
+                if (font != current && i > start)
+                {
+                    r->items.push_back({start, i - start, current, &run});
+                    start = i;
+                }
+                current = font;
+            }
+            r->items.push_back({start, end - start, current, &run});
+
+            if (HB_DIRECTION_IS_BACKWARD(run.direction()))
+                std::reverse(r->items.begin() + first, r->items.end());
+        }
+
+        for (const FontItem &item : r->items)
+        {
+            r->shapeCache.shape(r->faces[item.font].hb_font, r->buffer, text, r->bidi.length(), item.start, item.length,
+                                item.run->direction(), item.run->script, NULL, 0);
+
+            unsigned int count = r->shapeCache.length();
+            r->segments.push_back({item.font, (unsigned int)r->infos.size(), count});
+            r->infos.insert(r->infos.end(), r->shapeCache.infos(), r->shapeCache.infos() + count);
+            r->positions.insert(r->positions.end(), r->shapeCache.positions(), r->shapeCache.positions() + count);
+        }
+
+        return ANZ_OK;
+    }
+
+    void fill_metrics(anz_renderer_t *r, anz_metrics_t *metrics)
+    {
+        double x = 0;
+        double y = 0;
+        for (const hb_glyph_position_t &pos : r->positions)
+        {
+            x += pos.x_advance / 64.;
+            y += pos.y_advance / 64.;
+        }
+
+        const FT_Size_Metrics &size = r->faces[0].face->size->metrics;
+        metrics->advance_x = x;
+        metrics->advance_y = y;
+        metrics->ascent = size.ascender / 64.;
+        metrics->descent = -size.descender / 64.;
+        metrics->line_height = size.height / 64.;
+        metrics->glyphs = r->infos.size();
+        metrics->rtl = FRIBIDI_IS_RTL(r->bidi.baseDirection()) ? 1 : 0;
+    }
+
+    void draw_cairo(anz_renderer_t *r, cairo_surface_t *surface, double x, double y)
+    {
+        size_t count = r->infos.size();
+        r->glyphs.resize(count);
+
+        double current_x = x;
+        double current_y = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const hb_glyph_position_t &pos = r->positions[i];
+            r->glyphs[i].index = r->infos[i].codepoint;
+            r->glyphs[i].x = current_x + pos.x_offset / 64.;
+            r->glyphs[i].y = y - (current_y + pos.y_offset / 64.);
+            current_x += pos.x_advance / 64.;
+            current_y += pos.y_advance / 64.;
+        }
+
+        cairo_t *cr = cairo_create(surface);
+        cairo_set_source_rgba(cr, r->color[0], r->color[1], r->color[2], r->color[3]);
+        for (const GlyphSegment &segment : r->segments)
+        {
+            cairo_set_font_face(cr, cairo_face_of(r, r->faces[segment.font]));
+            cairo_set_font_size(cr, r->fontSize);
+            cairo_show_glyphs(cr, r->glyphs.data() + segment.start, segment.count);
+        }
+        cairo_destroy(cr);
+    }
+
+    void draw_glyph_cache(anz_renderer_t *r, cairo_surface_t *surface, double x, double y)
+    {
+        uint32_t color = composite_color(r->color[0], r->color[1], r->color[2], r->color[3]);
+        for (const GlyphSegment &segment : r->segments)
+        {
+            const RendererFace &face = r->faces[segment.font];
+            r->glyphCache.drawGlyphs(surface, face.face, face.instance, x, y,
+                                     r->infos.data() + segment.start, r->positions.data() + segment.start,
+                                     segment.count, color);
+
+            for (unsigned int i = segment.start; i < segment.start + segment.count; i++)
+            {
+                x += r->positions[i].x_advance / 64.;
+                y -= r->positions[i].y_advance / 64.;
+            }
+        }
+    }
+}
+
+namespace
+{
+    // renderer의 shape() 결과를 label에 놓고, glyph마다 위치와 ink 영역을 damage tracker의 새 frame으로 채운다.
+    // ink 영역은 실제로 그리는 것에서 얻는다: glyph cache면 합성할 mask의 pixel 영역, 아니면 cairo가 hinting한
+    // scaled font의 glyph extents. outline만 보면 hinting으로 바뀐 만큼 지우지 못하거나 잘릴 수 있다.
+    // 실패하면 false (measure context를 만들지 못함)
+    bool place_label_glyphs(anz_label_t *label)
+    {
+        anz_renderer_t *r = label->renderer;
+        size_t count = r->infos.size();
+
+        if (!label->useGlyphCache && !label->measure)
+        {
+            cairo_surface_t *surface = cairo_image_surface_create(label->cairoFormat, 1, 1);
+            label->measure = cairo_create(surface);
+            cairo_surface_destroy(surface);
+            if (cairo_status(label->measure) != CAIRO_STATUS_SUCCESS)
+            {
+                cairo_destroy(label->measure);
+                label->measure = NULL;
+                return false;
+            }
+        }
+
+        std::vector<PlacedGlyph> &frame = label->damage.frame();
+        frame.resize(count);
+        label->penX.resize(count);
+        label->penY.resize(count);
+
+        double current_x = label->x;
+        double current_y = label->y;
+        for (const GlyphSegment &segment : r->segments)
+        {
+            RendererFace &face = r->faces[segment.font];
+            if (!label->useGlyphCache)
+            {
+                cairo_set_font_face(label->measure, cairo_face_of(r, face));
+                cairo_set_font_size(label->measure, r->fontSize);
+            }
+
+            for (unsigned int i = segment.start; i < segment.start + segment.count; i++)
+            {
+                const hb_glyph_position_t &pos = r->positions[i];
+                double x = current_x + pos.x_offset / 64.;
+                double y = current_y - pos.y_offset / 64.;
+
+                PlacedGlyph &glyph = frame[i];
+                glyph.font = segment.font;
+                glyph.glyph = r->infos[i].codepoint;
+                glyph.x = (int32_t)lround(x * 64);
+                glyph.y = (int32_t)lround(y * 64);
+                glyph.left = glyph.top = glyph.right = glyph.bottom = 0;
+
+                if (label->useGlyphCache)
+                {
+                    // GlyphCache::drawGlyphs()와 같은 양자화. 그쪽은 구간 첫 glyph부터 pen을 다시 더하므로
+                    // 반올림 경계에서 1px 달라질 수 있다
+                    double floor_x = floor(x);
+                    int ix = (int)floor_x;
+                    int subpixel = (int)lround((x - floor_x) * GLYPH_SUBPIXEL_STEPS);
+                    if (subpixel == GLYPH_SUBPIXEL_STEPS)
+                    {
+                        ix++;
+                        subpixel = 0;
+                    }
+                    int iy = (int)lround(y);
+
+                    GlyphMask mask;
+                    if (r->glyphCache.lookup(face.face, face.instance, glyph.glyph, subpixel, mask) && mask.width &&
+                        mask.height)
+                    {
+                        glyph.left = ix + mask.left - 1;
+                        glyph.top = iy - mask.top - 1;
+                        glyph.right = ix + mask.left + mask.width + 1;
+                        glyph.bottom = iy - mask.top + mask.height + 1;
+                    }
+                }
+                else
+                {
+                    // draw_label_rect()가 cairo_show_glyphs()에 넘기는 위치 그대로 잰다
+                    cairo_glyph_t measured = {glyph.glyph, glyph.x / 64., glyph.y / 64.};
+                    cairo_text_extents_t extents;
+                    cairo_glyph_extents(label->measure, &measured, 1, &extents);
+                    if (extents.width > 0 && extents.height > 0)
+                    {
+                        glyph.left = (int)floor(extents.x_bearing) - LABEL_INK_PAD;
+                        glyph.top = (int)floor(extents.y_bearing) - LABEL_INK_PAD;
+                        glyph.right = (int)ceil(extents.x_bearing + extents.width) + LABEL_INK_PAD;
+                        glyph.bottom = (int)ceil(extents.y_bearing + extents.height) + LABEL_INK_PAD;
+                    }
+                }
+
+                label->penX[i] = current_x;
+                label->penY[i] = current_y;
+                current_x += pos.x_advance / 64.;
+                current_y -= pos.y_advance / 64.;
+            }
+        }
+        return true;
+    }
+
+    // rect 안만 background로 지우고 rect에 걸친 glyph를 다시 그린다.
+    // rect 부분만 가리키는 surface에 그리므로 rect 밖의 pixel은 건드리지 않는다
+    bool draw_label_rect(anz_label_t *label, const DamageRect &rect)
+    {
+        anz_renderer_t *r = label->renderer;
+        int bytes = label->format == ANZ_FORMAT_A8 ? 1 : 4;
+        unsigned char *data = label->pixels.data() + (size_t)rect.y * label->stride + (size_t)rect.x * bytes;
+        cairo_surface_t *surface = cairo_image_surface_create_for_data(data, label->cairoFormat, rect.width,
+                                                                       rect.height, label->stride);
+        if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+        {
+            cairo_surface_destroy(surface);
+            return false;
+        }
+
+        cairo_t *cr = cairo_create(surface);
+        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_rgba(cr, label->background[0], label->background[1], label->background[2],
+                              label->background[3]);
+        cairo_paint(cr);
+        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+        const std::vector<PlacedGlyph> &placed = label->damage.current();
+        if (label->useGlyphCache)
+        {
+            // rect에 걸친 연속 구간마다 그 첫 glyph의 pen 위치에서 그린다
+            uint32_t color = composite_color(r->color[0], r->color[1], r->color[2], r->color[3]);
+            for (const GlyphSegment &segment : r->segments)
+            {
+                unsigned int end = segment.start + segment.count;
+                for (unsigned int i = segment.start; i < end;)
+                {
+                    if (!damage_intersects(rect, placed[i]))
+                    {
+                        i++;
+                        continue;
+                    }
+
+                    unsigned int first = i;
+                    while (i < end && damage_intersects(rect, placed[i]))
+                        i++;
+                    const RendererFace &face = r->faces[segment.font];
+                    r->glyphCache.drawGlyphs(surface, face.face, face.instance, label->penX[first] - rect.x,
+                                             label->penY[first] - rect.y, r->infos.data() + first,
+                                             r->positions.data() + first, i - first, color);
+                }
+            }
+        }
+        else
+        {
+            cairo_translate(cr, -rect.x, -rect.y);
+            cairo_set_source_rgba(cr, r->color[0], r->color[1], r->color[2], r->color[3]);
+            for (const GlyphSegment &segment : r->segments)
+            {
+                label->glyphs.clear();
+                for (unsigned int i = segment.start; i < segment.start + segment.count; i++)
+                {
+                    if (damage_intersects(rect, placed[i]))
+                        label->glyphs.push_back({placed[i].glyph, placed[i].x / 64., placed[i].y / 64.});
+                }
+                if (label->glyphs.empty())
+                    continue;
+
+                cairo_set_font_face(cr, cairo_face_of(r, r->faces[segment.font]));
+                cairo_set_font_size(cr, r->fontSize);
+                cairo_show_glyphs(cr, label->glyphs.data(), label->glyphs.size());
+            }
+        }
+
+        cairo_destroy(cr);
+        cairo_surface_flush(surface);
+        cairo_surface_destroy(surface);
+        return true;
+    }
+}
+
+const char *anz_status_string(anz_status_t status)
+{
+    switch (status)
+    {
+    case ANZ_OK:
+        return "ok";
+    case ANZ_ERROR_INVALID_ARGUMENT:
+        return "invalid argument";
+    case ANZ_ERROR_FONT_NOT_FOUND:
+        return "font not found";
+    case ANZ_ERROR_FONT_LOAD:
+        return "cannot load font";
+    case ANZ_ERROR_NO_MEMORY:
+        return "out of memory";
+    case ANZ_ERROR_TEXT:
+        return "invalid text";
+    case ANZ_ERROR_SURFACE:
+        return "cannot use pixel buffer";
+    case ANZ_ERROR_IO:
+        return "cannot read or write file";
+    case ANZ_ERROR_UNSUPPORTED:
+        return "not supported by this build";
+    case ANZ_ERROR_INTERNAL:
+        return "internal error";
+    }
+    return "unknown error";
+}
+
+anz_status_t anz_font_open_file(const char *path, int face_index, anz_font_t **font)
+{
+    if (!path || !font || face_index < 0)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    try
+    {
+        return open_font(path, face_index, NULL, font);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return ANZ_ERROR_NO_MEMORY;
+    }
+    catch (...)
+    {
+        return ANZ_ERROR_INTERNAL; // 예외가 C 호출자의 frame을 지나가지 않도록
+    }
+}
+
+anz_status_t anz_font_open_name(const char *name, anz_font_t **font)
+{
+    if (!name || !font)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    // 기본 FcConfig를 쓴다 (처음 부를 때 fontconfig가 초기화된다). FcFontMatch는 thread-safe하다
+    FcPattern *pattern = FcNameParse((const FcChar8 *)name);
+    if (!pattern)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+    FcConfigSubstitute(NULL, pattern, FcMatchPattern);
+    FcDefaultSubstitute(pattern);
+
+    FcResult result;
+    FcPattern *match = FcFontMatch(NULL, pattern, &result);
+    FcPatternDestroy(pattern);
+    if (!match)
+        return ANZ_ERROR_FONT_NOT_FOUND;
+
+    anz_status_t status = ANZ_ERROR_FONT_NOT_FOUND;
+    FcChar8 *file = NULL;
+    int faceIndex = 0;
+    if (FcPatternGetString(match, FC_FILE, 0, &file) == FcResultMatch)
+    {
+        if (FcPatternGetInteger(match, FC_INDEX, 0, &faceIndex) != FcResultMatch)
+            faceIndex = 0;
+
+        try
+        {
+            status = open_font((const char *)file, faceIndex, name, font);
+        }
+        catch (const std::bad_alloc &)
+        {
+            status = ANZ_ERROR_NO_MEMORY;
+        }
+        catch (...)
+        {
+            status = ANZ_ERROR_INTERNAL;
+        }
+    }
+
+    FcPatternDestroy(match);
+    return status;
+}
+
+anz_font_t *anz_font_reference(anz_font_t *font)
+{
+    if (font)
+        font->references.fetch_add(1, std::memory_order_relaxed);
+    return font;
+}
+
+void anz_font_destroy(anz_font_t *font)
+{
+    if (font && font->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete font;
+}
+
+anz_status_t anz_font_subset(const char *font_path, int face_index, const char *corpus_path,
+                             const char *output_path, int font_size, anz_subset_report_t *report)
+{
+    if (!font_path || !corpus_path || !output_path || face_index < 0 || font_size <= 0)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    FontSubsetReport subset;
+    try
+    {
+        subset_font(font_path, face_index, corpus_path, output_path, font_size, subset);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return ANZ_ERROR_NO_MEMORY;
+    }
+    catch (const std::exception &)
+    {
+        return ANZ_ERROR_IO; // C caller에게 예외를 넘기지 않는다 (filesystem_error 등)
+    }
+    catch (...)
+    {
+        return ANZ_ERROR_INTERNAL;
+    }
+
+    switch (subset.error)
+    {
+    case FontSubsetError::None:
+        break;
+    case FontSubsetError::Font:
+        return ANZ_ERROR_FONT_LOAD;
+    case FontSubsetError::Subset:
+        return ANZ_ERROR_FONT_LOAD; // hb-subset이 읽지 못하는 font
+    case FontSubsetError::Corpus:
+    case FontSubsetError::Write:
+        return ANZ_ERROR_IO;
+    case FontSubsetError::Unavailable:
+        return ANZ_ERROR_UNSUPPORTED;
+    }
+
+    if (report)
+    {
+        report->paragraphs = subset.paragraphs;
+        report->codepoints = subset.codepoints;
+        report->missing_codepoints = subset.missingCodepoints;
+        report->shaped_glyphs = subset.shapedGlyphs;
+        report->glyphs_before = subset.glyphsBefore;
+        report->glyphs_after = subset.glyphsAfter;
+        report->bytes_before = subset.bytesBefore;
+        report->bytes_after = subset.bytesAfter;
+        report->load_seconds_before = subset.loadSecondsBefore;
+        report->load_seconds_after = subset.loadSecondsAfter;
+        report->checked_items = subset.checkedItems;
+        report->mismatches = subset.mismatches;
+    }
+    return ANZ_OK;
+}
+
+anz_status_t anz_renderer_create(anz_font_t *font, anz_renderer_t **renderer)
+{
+    if (!font || !renderer)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    anz_renderer_t *r = NULL;
+    try
+    {
+        r = new (std::nothrow) anz_renderer_t; // nothrow여도 member 생성자의 예외는 그대로 나온다
+    }
+    catch (...)
+    {
+        return ANZ_ERROR_INTERNAL;
+    }
+    if (!r)
+        return ANZ_ERROR_NO_MEMORY;
+
+    // FT_Library도 renderer마다 따로 둔다 (FT_Face는 thread-safe하지 않다)
+    r->library = new (std::nothrow) FaceLibrary;
+    if (!r->library || FT_Init_FreeType(&r->library->library))
+    {
+        delete r->library;
+        delete r;
+        return ANZ_ERROR_NO_MEMORY;
+    }
+    r->library->font = anz_font_reference(font);
+
+    r->font = anz_font_reference(font);
+    *renderer = r;
+    return ANZ_OK;
+}
+
+void anz_renderer_destroy(anz_renderer_t *renderer)
+{
+    if (!renderer)
+        return;
+
+    close_faces(renderer);
+    hb_buffer_destroy(renderer->buffer);
+    release_library(renderer->library); // cairo가 아직 잡고 있는 FT_Face가 있으면 그것이 닫힐 때 해제된다
+    anz_font_destroy(renderer->font);
+    delete renderer;
+}
+
+anz_status_t anz_renderer_set_font_size(anz_renderer_t *renderer, int pixels)
+{
+    if (!renderer || pixels <= 0)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    // 크기가 바뀌면 face를 다음 shape() 때 다시 연다
+    if (pixels != renderer->fontSize)
+    {
+        close_faces(renderer);
+        renderer->fontSize = pixels;
+    }
+    return ANZ_OK;
+}
+
+anz_status_t anz_renderer_set_color(anz_renderer_t *renderer, double r, double g, double b, double a)
+{
+    if (!renderer)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    double color[4] = {r, g, b, a};
+    for (int i = 0; i < 4; i++)
+        renderer->color[i] = std::min(1., std::max(0., color[i]));
+    return ANZ_OK;
+}
+
+anz_status_t anz_renderer_set_direction(anz_renderer_t *renderer, anz_direction_t direction)
+{
+    if (!renderer)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    switch (direction)
+    {
+    case ANZ_DIRECTION_AUTO:
+        renderer->base = FRIBIDI_PAR_ON;
+        break;
+    case ANZ_DIRECTION_LTR:
+        renderer->base = FRIBIDI_PAR_LTR;
+        break;
+    case ANZ_DIRECTION_RTL:
+        renderer->base = FRIBIDI_PAR_RTL;
+        break;
+    default:
+        return ANZ_ERROR_INVALID_ARGUMENT;
+    }
+    return ANZ_OK;
+}
+
+anz_status_t anz_renderer_set_glyph_cache(anz_renderer_t *renderer, int enabled)
+{
+    if (!renderer)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    renderer->useGlyphCache = enabled != 0;
+    return ANZ_OK;
+}
+
+anz_status_t anz_measure(anz_renderer_t *renderer, const char *utf8, int length, anz_metrics_t *metrics)
+{
+    if (!renderer || !utf8 || !metrics)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    try
+    {
+        anz_status_t status = shape(renderer, utf8, length);
+        if (status == ANZ_OK)
+            fill_metrics(renderer, metrics);
+        return status;
+    }
+    catch (const std::bad_alloc &)
+    {
+        return ANZ_ERROR_NO_MEMORY;
+    }
+    catch (...)
+    {
+        return ANZ_ERROR_INTERNAL; // 예외가 C 호출자의 frame을 지나가지 않도록
+    }
+}
+
+anz_status_t anz_render(anz_renderer_t *renderer, const char *utf8, int length,
+                        unsigned char *pixels, int width, int height, int stride,
+                        anz_pixel_format_t format, double x, double y, anz_metrics_t *metrics)
+{
+    if (!renderer || !utf8 || !pixels || width <= 0 || height <= 0)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+    if (format != ANZ_FORMAT_ARGB32 && format != ANZ_FORMAT_A8)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    cairo_format_t cairoFormat = format == ANZ_FORMAT_A8 ? CAIRO_FORMAT_A8 : CAIRO_FORMAT_ARGB32;
+    if (stride % 4 != 0 || stride < cairo_format_stride_for_width(cairoFormat, width))
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    try
+    {
+        anz_status_t status = shape(renderer, utf8, length);
+        if (status != ANZ_OK)
+            return status;
+        if (metrics)
+            fill_metrics(renderer, metrics);
+
+        cairo_surface_t *surface = cairo_image_surface_create_for_data(pixels, cairoFormat, width, height, stride);
+        if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+        {
+            cairo_surface_destroy(surface);
+            return ANZ_ERROR_SURFACE;
+        }
+
+        // glyph cache 합성은 ARGB32만 된다
+        if (renderer->useGlyphCache && format == ANZ_FORMAT_ARGB32)
+            draw_glyph_cache(renderer, surface, x, y);
+        else if (open_cairo_faces(renderer))
+            draw_cairo(renderer, surface, x, y);
+        else
+        {
+            cairo_surface_destroy(surface);
+            return ANZ_ERROR_FONT_LOAD;
+        }
+
+        // 호출한 쪽이 바로 읽을 수 있게 cairo가 들고 있는 것을 내보낸다. data는 해제하지 않는다
+        cairo_surface_flush(surface);
+        cairo_surface_destroy(surface);
+        return ANZ_OK;
+    }
+    catch (const std::bad_alloc &)
+    {
+        return ANZ_ERROR_NO_MEMORY;
+    }
+    catch (...)
+    {
+        return ANZ_ERROR_INTERNAL; // 예외가 C 호출자의 frame을 지나가지 않도록
+    }
+}
+
+anz_status_t anz_label_create(anz_renderer_t *renderer, int width, int height, anz_pixel_format_t format,
+                              double x, double y, anz_label_t **label)
+{
+    if (!renderer || !label || width <= 0 || height <= 0)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+    if (format != ANZ_FORMAT_ARGB32 && format != ANZ_FORMAT_A8)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    cairo_format_t cairoFormat = format == ANZ_FORMAT_A8 ? CAIRO_FORMAT_A8 : CAIRO_FORMAT_ARGB32;
+    int stride = cairo_format_stride_for_width(cairoFormat, width);
+    if (stride <= 0 || height > 32767)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    anz_label_t *l = new (std::nothrow) anz_label_t;
+    if (!l)
+        return ANZ_ERROR_NO_MEMORY;
+
+    try
+    {
+        l->pixels.assign((size_t)stride * height, 0);
+    }
+    catch (const std::bad_alloc &)
+    {
+        delete l;
+        return ANZ_ERROR_NO_MEMORY;
+    }
+    catch (...)
+    {
+        delete l;
+        return ANZ_ERROR_INTERNAL;
+    }
+
+    l->renderer = renderer;
+    l->width = width;
+    l->height = height;
+    l->stride = stride;
+    l->format = format;
+    l->cairoFormat = cairoFormat;
+    l->x = x;
+    l->y = y;
+    *label = l;
+    return ANZ_OK;
+}
+
+void anz_label_destroy(anz_label_t *label)
+{
+    if (label && label->measure)
+        cairo_destroy(label->measure);
+    delete label;
+}
+
+anz_status_t anz_label_set_background(anz_label_t *label, double r, double g, double b, double a)
+{
+    if (!label)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    double color[4] = {r, g, b, a};
+    for (int i = 0; i < 4; i++)
+        label->background[i] = std::min(1., std::max(0., color[i]));
+    label->full = true;
+    return ANZ_OK;
+}
+
+anz_status_t anz_label_update(anz_label_t *label, const char *utf8, int length,
+                              const anz_rect_t **rects, unsigned int *count, anz_metrics_t *metrics)
+{
+    if (!label || !utf8 || !rects || !count)
+        return ANZ_ERROR_INVALID_ARGUMENT;
+
+    *rects = NULL;
+    *count = 0;
+    anz_renderer_t *r = label->renderer;
+
+    try
+    {
+        anz_status_t status = shape(r, utf8, length);
+        if (status != ANZ_OK)
+            return status;
+        if (metrics)
+            fill_metrics(r, metrics);
+
+        // 이전 frame과 다른 설정으로 그린 pixel은 섞을 수 없다. glyph cache 합성은 ARGB32만 된다
+        bool glyphCache = r->useGlyphCache && label->format == ANZ_FORMAT_ARGB32;
+        bool full = label->full || label->fontSize != r->fontSize || label->useGlyphCache != glyphCache ||
+                    !std::equal(r->color, r->color + 4, label->color);
+        label->fontSize = r->fontSize;
+        label->useGlyphCache = glyphCache;
+        std::copy(r->color, r->color + 4, label->color);
+
+        if (!glyphCache && !open_cairo_faces(r))
+        {
+            label->full = true;
+            return ANZ_ERROR_FONT_LOAD;
+        }
+        if (!place_label_glyphs(label))
+        {
+            label->full = true;
+            return ANZ_ERROR_SURFACE;
+        }
+        const std::vector<DamageRect> &damaged =
+            label->damage.commit(label->width, label->height, full, label->format == ANZ_FORMAT_A8 ? 4 : 1);
+        label->full = false;
+
+        label->rects.clear();
+        for (const DamageRect &rect : damaged)
+        {
+            if (!draw_label_rect(label, rect))
+            {
+                label->full = true;
+                return ANZ_ERROR_SURFACE;
+            }
+            label->rects.push_back({rect.x, rect.y, rect.width, rect.height});
+        }
+
+        *rects = label->rects.data();
+        *count = label->rects.size();
+        return ANZ_OK;
+    }
+    catch (const std::bad_alloc &)
+    {
+        label->full = true;
+        return ANZ_ERROR_NO_MEMORY;
+    }
+    catch (...)
+    {
+        label->full = true;
+        return ANZ_ERROR_INTERNAL;
+    }
+}
+
+const unsigned char *anz_label_pixels(const anz_label_t *label, int *stride)
+{
+    if (!label)
+        return NULL;
+    if (stride)
+        *stride = label->stride;
+    return label->pixels.data();
+}
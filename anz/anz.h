@@ -0,0 +1,172 @@
+#ifndef ANZ_H
+#define ANZ_H
+
+/*
+ * anz text rendering library, C API.
+ *
+ * hello_text와 같은 pipeline (fribidi → font fallback → HarfBuzz → cairo)을 process 안에서 부를 수 있게 한다.
+ * 전역 상태가 없다. 모든 상태는 아래 두 handle 안에 있다.
+ *
+ *   anz_font_t     : mmap한 font file, coverage, fallback chain. immutable이고 thread 사이에 공유할 수 있다.
+ *                    reference count로 관리한다 (renderer도 reference를 하나 잡는다).
+ *   anz_renderer_t : FT_Face, hb_font, hb_buffer, shaping / glyph cache, scratch buffer.
+ *                    한번에 한 thread만 써야 한다. thread마다 하나씩 만든다.
+ *   anz_label_t    : 자기 pixel buffer와 마지막에 그린 glyph를 갖는 label. 바뀐 부분만 다시 그린다.
+ *                    renderer를 빌려 쓰므로 renderer와 같은 thread에서 쓰고, renderer보다 먼저 없앤다.
+ *
+ * 문자열은 UTF-8이고 length가 -1이면 NUL로 끝난다고 본다.
+ * pixel buffer는 호출한 쪽 것이다. anz_render()는 지우지 않고 그 위에 그린다.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define ANZ_API __attribute__((visibility("default")))
+#else
+#define ANZ_API
+#endif
+
+typedef struct anz_font anz_font_t;
+typedef struct anz_renderer anz_renderer_t;
+typedef struct anz_label anz_label_t;
+
+typedef enum
+{
+    ANZ_OK = 0,
+    ANZ_ERROR_INVALID_ARGUMENT,
+    ANZ_ERROR_FONT_NOT_FOUND, /* file이 없거나 fontconfig가 찾지 못함 */
+    ANZ_ERROR_FONT_LOAD,      /* FreeType이 열지 못함 */
+    ANZ_ERROR_NO_MEMORY,
+    ANZ_ERROR_TEXT,           /* bidi 실패 (잘못된 UTF-8 등) */
+    ANZ_ERROR_SURFACE,        /* pixel buffer로 cairo surface를 만들지 못함 */
+    ANZ_ERROR_IO,             /* file을 읽거나 쓰지 못함 */
+    ANZ_ERROR_UNSUPPORTED,    /* 이 빌드에 없는 기능 (SUBSET=1 없이 빌드한 anz_font_subset 등) */
+    ANZ_ERROR_INTERNAL        /* 예상하지 못한 내부 오류 (C++ 예외를 C 쪽으로 넘기지 않고 바꾼 것) */
+} anz_status_t;
+
+typedef enum
+{
+    ANZ_FORMAT_ARGB32 = 0, /* premultiplied, native endian 32bit */
+    ANZ_FORMAT_A8 = 1      /* coverage만 */
+} anz_pixel_format_t;
+
+typedef enum
+{
+    ANZ_DIRECTION_AUTO = 0, /* 첫 strong 글자로 결정 */
+    ANZ_DIRECTION_LTR = 1,
+    ANZ_DIRECTION_RTL = 2
+} anz_direction_t;
+
+typedef struct
+{
+    double advance_x;    /* pen 이동 거리, pixel */
+    double advance_y;
+    double ascent;       /* primary font 기준, baseline 위로 양수 */
+    double descent;      /* baseline 아래로 양수 */
+    double line_height;
+    unsigned int glyphs;
+    int rtl;             /* paragraph 방향이 RTL이면 1 */
+} anz_metrics_t;
+
+typedef struct
+{
+    int x;
+    int y;
+    int width;
+    int height;
+} anz_rect_t;
+
+typedef struct
+{
+    unsigned long long paragraphs;
+    unsigned long long codepoints;         /* corpus의 서로 다른 codepoint */
+    unsigned long long missing_codepoints; /* 그 중 font에 없어 fallback font로 그리는 것 */
+    unsigned long long shaped_glyphs;      /* corpus shaping이 낸 서로 다른 glyph */
+    unsigned int glyphs_before;
+    unsigned int glyphs_after;             /* GSUB closure와 .notdef 포함 */
+    unsigned long long bytes_before;
+    unsigned long long bytes_after;
+    double load_seconds_before;            /* FT_Face + hb_font + 첫 shape, 평균 */
+    double load_seconds_after;
+    unsigned long long checked_items;      /* 원본과 subset으로 같이 shape해서 비교한 item */
+    unsigned long long mismatches;         /* 그 중 결과가 다른 것, 0이어야 한다 */
+} anz_subset_report_t;
+
+ANZ_API const char *anz_status_string(anz_status_t status);
+
+/* font file을 연다. face_index는 ttc 안의 번호 */
+ANZ_API anz_status_t anz_font_open_file(const char *path, int face_index, anz_font_t **font);
+
+/* fontconfig로 family / pattern ("Arial", "Noto Sans:bold")에 가장 맞는 font를 연다 */
+ANZ_API anz_status_t anz_font_open_name(const char *name, anz_font_t **font);
+
+ANZ_API anz_font_t *anz_font_reference(anz_font_t *font);
+ANZ_API void anz_font_destroy(anz_font_t *font);
+
+/*
+ * corpus (UTF-8 text file 하나, 또는 *.txt가 있는 directory)를 font_size pixel로 shape해서 쓰이는 glyph만 남긴
+ * subset font를 output_path에 쓴다 (hb-subset). 모든 GSUB feature의 closure와 variable font table은 남는다.
+ * 쓴 뒤 corpus를 원본과 subset으로 다시 shape해서 비교한다. 다른 item이 있어도 ANZ_OK이고 report->mismatches에 센다.
+ * output은 anz_font_open_file(output_path, 0, ...)로 연다. report는 NULL이어도 된다.
+ * libanz를 make SUBSET=1 없이 빌드했으면 (harfbuzz-subset 없이) ANZ_ERROR_UNSUPPORTED다.
+ */
+ANZ_API anz_status_t anz_font_subset(const char *font_path, int face_index, const char *corpus_path,
+                                     const char *output_path, int font_size, anz_subset_report_t *report);
+
+/* renderer가 font의 reference를 하나 잡는다. 기본 font size는 36 pixel, 색은 불투명 검정 */
+ANZ_API anz_status_t anz_renderer_create(anz_font_t *font, anz_renderer_t **renderer);
+ANZ_API void anz_renderer_destroy(anz_renderer_t *renderer);
+
+ANZ_API anz_status_t anz_renderer_set_font_size(anz_renderer_t *renderer, int pixels);
+ANZ_API anz_status_t anz_renderer_set_color(anz_renderer_t *renderer, double r, double g, double b, double a);
+ANZ_API anz_status_t anz_renderer_set_direction(anz_renderer_t *renderer, anz_direction_t direction);
+
+/* 0이 아니면 cairo_show_glyphs 대신 cache된 glyph mask를 직접 합성한다 (ARGB32 buffer에서만) */
+ANZ_API anz_status_t anz_renderer_set_glyph_cache(anz_renderer_t *renderer, int enabled);
+
+/* 그리지 않고 shaping만 해서 크기를 잰다 */
+ANZ_API anz_status_t anz_measure(anz_renderer_t *renderer, const char *utf8, int length, anz_metrics_t *metrics);
+
+/*
+ * pixels (width × height, 한 줄 stride byte)에 text를 그린다. (x, y)는 첫 glyph의 baseline 시작점.
+ * stride는 4의 배수이고 width만큼의 pixel을 담을 수 있어야 한다.
+ * metrics가 NULL이 아니면 anz_measure()와 같은 값을 채운다.
+ */
+ANZ_API anz_status_t anz_render(anz_renderer_t *renderer, const char *utf8, int length,
+                                unsigned char *pixels, int width, int height, int stride,
+                                anz_pixel_format_t format, double x, double y, anz_metrics_t *metrics);
+
+/*
+ * retained label: width × height pixel buffer를 label이 갖고, (x, y)를 baseline 시작점으로 그린다.
+ * anz_label_update()는 text를 다시 shape해서 이전 frame의 glyph (font, glyph id, 위치)와 비교하고,
+ * 없어지거나 새로 생긴 glyph가 덮는 영역만 background로 지운 뒤 그 영역에 걸친 glyph를 다시 그린다.
+ * 카운터나 시계처럼 조금씩 바뀌는 text에 쓴다.
+ *
+ * 처음 update와 renderer의 font size, color, glyph cache 설정이나 background가 바뀐 뒤의 update는 전체를 그린다.
+ * A8 label의 영역은 x와 폭이 4 pixel 배수로 넓어진다.
+ */
+ANZ_API anz_status_t anz_label_create(anz_renderer_t *renderer, int width, int height, anz_pixel_format_t format,
+                                      double x, double y, anz_label_t **label);
+ANZ_API void anz_label_destroy(anz_label_t *label);
+
+/* background 색, 기본은 투명 (0, 0, 0, 0). A8이면 a만 쓴다 */
+ANZ_API anz_status_t anz_label_set_background(anz_label_t *label, double r, double g, double b, double a);
+
+/*
+ * text를 바꾸고 다시 그린 영역을 rects / count로 돌려준다. 바뀐 것이 없으면 count는 0이다.
+ * rects는 다음 anz_label_update()나 anz_label_destroy()까지 유효하다. 영역끼리 겹칠 수 있다.
+ * 실패하면 pixel은 이전 그대로이거나 (text 오류) 다음 update에서 전체를 다시 그린다.
+ */
+ANZ_API anz_status_t anz_label_update(anz_label_t *label, const char *utf8, int length,
+                                      const anz_rect_t **rects, unsigned int *count, anz_metrics_t *metrics);
+
+/* label의 pixel buffer (height × stride byte). 다음 anz_label_update()까지 읽을 수 있다 */
+ANZ_API const unsigned char *anz_label_pixels(const anz_label_t *label, int *stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ANZ_H */
@@ -0,0 +1,201 @@
+/*
+ * libanz C API를 C에서 불러 본다: font → renderer → render → font size 변경 → render → destroy.
+ *
+ *   make check            또는   ./anz_example [font file]
+ *
+ * font size를 바꾸거나 renderer를 없애면 FT_Face가 닫히는데, cairo는 font face를 자기 cache에 더 잡고 있다.
+ * 그 뒤에 새 renderer로 같은 text를 다시 그려서 처음과 pixel이 같은지 본다 (닫힌 face를 다시 쓰면 달라지거나 죽는다).
+ * label은 text를 여러 번 바꾸면서, 바뀐 pixel이 모두 돌려받은 영역 안에 있는지, 그리고 같은 text를 새 label에
+ * 처음부터 그린 것과 byte 단위로 같은지 본다.
+ * 실패하면 0이 아닌 값으로 끝난다.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "anz.h"
+
+#define WIDTH 320
+#define HEIGHT 64
+#define STRIDE (WIDTH * 4)
+
+static const char *TEXT = "Hello, anz! 0123";
+
+static int check(anz_status_t status, const char *what)
+{
+    if (status != ANZ_OK)
+    {
+        fprintf(stderr, "%s: %s\n", what, anz_status_string(status));
+        return 0;
+    }
+    return 1;
+}
+
+static int render(anz_renderer_t *renderer, unsigned char *pixels)
+{
+    memset(pixels, 0, STRIDE * HEIGHT);
+    return check(anz_render(renderer, TEXT, -1, pixels, WIDTH, HEIGHT, STRIDE, ANZ_FORMAT_ARGB32, 4., 44., NULL),
+                 "anz_render");
+}
+
+static int has_ink(const unsigned char *pixels, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        if (pixels[i])
+            return 1;
+    }
+    return 0;
+}
+
+/* 글자 수, 폭, 자릿수가 바뀌는 경우와 그대로인 경우 */
+static const char *LABEL_TEXTS[] = {"Frame 0123", "Frame 0124", "Frame 0199", "Frame 7", "Frame 0123 (+)",
+                                    "Frame 0123 (+)", "Frame 0120"};
+
+static int inside(const anz_rect_t *rects, unsigned int count, int x, int y)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (x >= rects[i].x && x < rects[i].x + rects[i].width && y >= rects[i].y && y < rects[i].y + rects[i].height)
+            return 1;
+    }
+    return 0;
+}
+
+/* label 하나를 LABEL_TEXTS 순서로 update한다 */
+static int check_label(anz_renderer_t *renderer, anz_pixel_format_t format)
+{
+    static unsigned char before[STRIDE * HEIGHT];
+    const int bpp = format == ANZ_FORMAT_A8 ? 1 : 4;
+    const char *name = format == ANZ_FORMAT_A8 ? "A8" : "ARGB32";
+    int ok = 1;
+
+    anz_label_t *label = NULL;
+    if (!check(anz_label_create(renderer, WIDTH, HEIGHT, format, 4., 44., &label), "anz_label_create"))
+        return 0;
+
+    for (size_t i = 0; ok && i < sizeof(LABEL_TEXTS) / sizeof(LABEL_TEXTS[0]); i++)
+    {
+        const char *text = LABEL_TEXTS[i];
+        int stride = 0;
+        const unsigned char *pixels = anz_label_pixels(label, &stride);
+        if (stride < WIDTH * bpp || stride * HEIGHT > (int)sizeof(before))
+        {
+            fprintf(stderr, "%s label: unexpected stride %d\n", name, stride);
+            ok = 0;
+            break;
+        }
+        memcpy(before, pixels, stride * HEIGHT);
+
+        const anz_rect_t *rects = NULL;
+        unsigned int count = 0;
+        if (!check(anz_label_update(label, text, -1, &rects, &count, NULL), "anz_label_update"))
+        {
+            ok = 0;
+            break;
+        }
+        pixels = anz_label_pixels(label, &stride);
+
+        /* 바뀐 pixel은 모두 다시 그린 영역 안에 있어야 한다 */
+        for (int y = 0; ok && y < HEIGHT; y++)
+        {
+            for (int x = 0; x < WIDTH; x++)
+            {
+                int offset = y * stride + x * bpp;
+                if (memcmp(before + offset, pixels + offset, bpp) != 0 && !inside(rects, count, x, y))
+                {
+                    fprintf(stderr, "%s label \"%s\": pixel (%d, %d) changed outside the %u damage rects\n", name,
+                            text, x, y, count);
+                    ok = 0;
+                    break;
+                }
+            }
+        }
+
+        /* 같은 text를 새 label에 처음부터 그린 것과 같아야 한다 */
+        anz_label_t *fresh = NULL;
+        if (!ok || !check(anz_label_create(renderer, WIDTH, HEIGHT, format, 4., 44., &fresh), "anz_label_create"))
+        {
+            ok = 0;
+            break;
+        }
+        int freshStride = 0;
+        ok = check(anz_label_update(fresh, text, -1, &rects, &count, NULL), "anz_label_update");
+        const unsigned char *expected = anz_label_pixels(fresh, &freshStride);
+        for (int y = 0; ok && y < HEIGHT; y++)
+        {
+            if (memcmp(pixels + y * stride, expected + y * freshStride, WIDTH * bpp) != 0)
+            {
+                fprintf(stderr, "%s label \"%s\": row %d differs from a full render\n", name, text, y);
+                ok = 0;
+            }
+        }
+        ok = ok && has_ink(expected, freshStride * HEIGHT);
+        anz_label_destroy(fresh);
+    }
+
+    anz_label_destroy(label);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : "NotoSans-VariableFont_wdth,wght.ttf";
+    static unsigned char first[STRIDE * HEIGHT];
+    static unsigned char pixels[STRIDE * HEIGHT];
+    int ok = 1;
+
+    anz_font_t *font = NULL;
+    if (!check(anz_font_open_file(path, 0, &font), path))
+        return 1;
+
+    /* 1. 처음 renderer: 36px → 24px → 36px, glyph cache 켜고 한번 더 */
+    anz_renderer_t *renderer = NULL;
+    if (!check(anz_renderer_create(font, &renderer), "anz_renderer_create"))
+    {
+        anz_font_destroy(font);
+        return 1;
+    }
+
+    ok = ok && render(renderer, first) && has_ink(first, sizeof(first));
+    ok = ok && check(anz_renderer_set_font_size(renderer, 24), "anz_renderer_set_font_size");
+    ok = ok && render(renderer, pixels) && has_ink(pixels, sizeof(pixels));
+    ok = ok && check(anz_renderer_set_font_size(renderer, 36), "anz_renderer_set_font_size");
+    ok = ok && render(renderer, pixels);
+    if (ok && memcmp(first, pixels, sizeof(pixels)) != 0)
+    {
+        fprintf(stderr, "36px render differs after reopening the face\n");
+        ok = 0;
+    }
+
+    ok = ok && check(anz_renderer_set_glyph_cache(renderer, 1), "anz_renderer_set_glyph_cache");
+    ok = ok && render(renderer, pixels) && has_ink(pixels, sizeof(pixels));
+    anz_renderer_destroy(renderer);
+
+    /* 2. renderer를 없앤 뒤 새 renderer: font는 아직 이쪽 reference로 살아 있다 */
+    renderer = NULL;
+    if (ok && check(anz_renderer_create(font, &renderer), "anz_renderer_create"))
+    {
+        ok = render(renderer, pixels);
+        if (ok && memcmp(first, pixels, sizeof(pixels)) != 0)
+        {
+            fprintf(stderr, "render with a new renderer differs from the first one\n");
+            ok = 0;
+        }
+
+        /* 3. label: 바뀐 부분만 다시 그린 결과가 전체를 그린 것과 같은지 */
+        ok = ok && check_label(renderer, ANZ_FORMAT_ARGB32) && check_label(renderer, ANZ_FORMAT_A8);
+    }
+
+    /* font를 먼저 놓아도 renderer가 reference를 잡고 있다 */
+    anz_font_destroy(font);
+    if (renderer)
+    {
+        ok = ok && render(renderer, pixels);
+        anz_renderer_destroy(renderer);
+    }
+
+    printf("anz_example: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
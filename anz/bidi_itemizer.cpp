@@ -0,0 +1,98 @@
+#include "bidi_itemizer.h"
+
+static_assert(sizeof(FriBidiChar) == sizeof(uint32_t), "hb_buffer_add_utf32() reads FriBidiChar directly");
+
+bool BidiItemizer::itemize(const std::string &utf8, FriBidiParType base)
+{
+    runs_.clear();
+    base_ = base;
+
+    // UTF-8 byte 수 >= codepoint 수. resize는 capacity를 줄이지 않으므로 paragraph 사이에 재사용된다
+    text_.resize(utf8.size() + 1);
+    FriBidiStrIndex len = fribidi_charset_to_unicode(FRIBIDI_CHAR_SET_UTF8, utf8.data(), utf8.size(), text_.data());
+    text_.resize(len);
+    return resolve(len);
+}
+
+bool BidiItemizer::itemize(const uint32_t *text, unsigned int length, FriBidiParType base)
+{
+    runs_.clear();
+    base_ = base;
+
+    text_.assign(text, text + length);
+    return resolve(length);
+}
+
+bool BidiItemizer::resolve(FriBidiStrIndex len)
+{
+    if (len == 0)
+    {
+        scripts_.clear();
+        levels_.clear();
+        return true;
+    }
+
+    types_.resize(len);
+    brackets_.resize(len);
+    levels_.resize(len);
+
+    fribidi_get_bidi_types(text_.data(), len, types_.data());
+    fribidi_get_bracket_types(text_.data(), len, types_.data(), brackets_.data());
+
+    // 성공하면 최대 level + 1, 실패하면 0
+    if (!fribidi_get_par_embedding_levels_ex(types_.data(), brackets_.data(), len, &base_, levels_.data()))
+        return false;
+
+    splitRuns();
+    bidi_reorder_runs(runs_.data(), runs_.size());
+    return true;
+}
+
+size_t BidiItemizer::capacityBytes() const
+{
+    return text_.capacity() * sizeof(FriBidiChar) +
+           types_.capacity() * sizeof(FriBidiCharType) +
+           brackets_.capacity() * sizeof(FriBidiBracketType) +
+           levels_.capacity() * sizeof(FriBidiLevel) +
+           scripts_.capacity() * sizeof(hb_script_t) +
+           runs_.capacity() * sizeof(BidiRun);
+}
+
+void BidiItemizer::splitRuns()
+{
+    unsigned int len = text_.size();
+    scripts_.resize(len);
+
+    // Common/Inherited (공백, 숫자, 문장부호, 결합 기호)는 앞 글자의 script를 따른다.
+    // 맨 앞에 오는 것은 처음 나오는 실제 script를 따른다.
+    hb_unicode_funcs_t *ufuncs = hb_unicode_funcs_get_default();
+    hb_script_t last = HB_SCRIPT_COMMON;
+    unsigned int firstReal = len;
+    for (unsigned int i = 0; i < len; i++)
+    {
+        hb_script_t script = hb_unicode_script(ufuncs, text_[i]);
+        if (script == HB_SCRIPT_COMMON || script == HB_SCRIPT_INHERITED || script == HB_SCRIPT_UNKNOWN)
+        {
+            script = last;
+        }
+        else if (firstReal == len)
+        {
+            firstReal = i;
+        }
+
+        scripts_[i] = last = script;
+    }
+    for (unsigned int i = 0; i < firstReal && firstReal < len; i++)
+        scripts_[i] = scripts_[firstReal];
+
+    // level이나 script가 바뀌는 곳에서 자른다 (논리 순서)
+    unsigned int start = 0;
+    for (unsigned int i = 1; i <= len; i++)
+    {
+        if (i == len || levels_[i] != levels_[start] || scripts_[i] != scripts_[start])
+        {
+            runs_.push_back({start, i - start, levels_[start], scripts_[start]});
+            start = i;
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <hb.h>
+// for harfbuzz
+
+#include <fribidi/fribidi.h>
+// for fribidi
+
+// UTF-8 paragraph 하나를 UTF-32로 한번만 바꾸고, 논리 순서 그대로 (embedding level, script) run으로 나눈다.
+//
+// 글자 순서는 바꾸지 않는다. 각 run은 원래 UTF-32 배열의 구간이고, HarfBuzz가
+// hb_buffer_add_utf32()로 앞뒤 문맥과 함께 직접 읽는다 (Arabic joining이 논리 순서로 계산됨).
+// 재배치(UAX#9 L2)는 run 단위로만 하므로 run 안의 RTL glyph 순서는 HarfBuzz가 정한다.
+// runs()는 한 줄짜리 paragraph를 가정한다. 줄 끝 공백 처리(L1)는 fribidi가 paragraph 끝 기준으로 해준다.
+// 여러 줄로 나눌 때는 levels()/scripts()로 줄마다 다시 재배치한다 (paragraph_layout.h).
+
+struct BidiRun
+{
+    unsigned int start;  // text() 안에서의 codepoint offset
+    unsigned int length; // codepoint 수
+    FriBidiLevel level;
+    hb_script_t script;
+
+    hb_direction_t direction() const { return FRIBIDI_LEVEL_IS_RTL(level) ? HB_DIRECTION_RTL : HB_DIRECTION_LTR; }
+};
+
+// UAX#9 L2: 가장 높은 level부터 가장 낮은 홀수 level까지, 그 level 이상인 연속된 run들의 순서를 뒤집는다.
+// Run은 level member가 있으면 된다.
+template <class Run>
+void bidi_reorder_runs(Run *runs, size_t count)
+{
+    FriBidiLevel highest = 0;
+    FriBidiLevel lowestOdd = 127;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (runs[i].level > highest)
+            highest = runs[i].level;
+        if (FRIBIDI_LEVEL_IS_RTL(runs[i].level) && runs[i].level < lowestOdd)
+            lowestOdd = runs[i].level;
+    }
+
+    for (int level = highest; level >= lowestOdd; level--)
+    {
+        size_t i = 0;
+        while (i < count)
+        {
+            if (runs[i].level < level)
+            {
+                i++;
+                continue;
+            }
+
+            size_t j = i;
+            while (j < count && runs[j].level >= level)
+                j++;
+            std::reverse(runs + i, runs + j);
+            i = j;
+        }
+    }
+}
+
+class BidiItemizer
+{
+public:
+    // base는 FRIBIDI_PAR_LTR / FRIBIDI_PAR_RTL / FRIBIDI_PAR_ON (첫 strong 글자로 결정)
+    // fribidi가 실패하면 false
+    bool itemize(const std::string &utf8, FriBidiParType base = FRIBIDI_PAR_LTR);
+
+    // 이미 UTF-32인 text (편집된 paragraph 등)
+    bool itemize(const uint32_t *text, unsigned int length, FriBidiParType base = FRIBIDI_PAR_LTR);
+
+    // 논리 순서 UTF-32, 다음 itemize() 전까지 유효
+    const uint32_t *text() const { return text_.data(); }
+    unsigned int length() const { return text_.size(); }
+
+    // 왼쪽에서 오른쪽으로 그릴 순서 (visual order)
+    const std::vector<BidiRun> &runs() const { return runs_; }
+
+    FriBidiParType baseDirection() const { return base_; }
+
+    // codepoint마다의 embedding level과 (Common을 앞 글자로 채운) script, 논리 순서
+    const FriBidiLevel *levels() const { return levels_.data(); }
+    const hb_script_t *scripts() const { return scripts_.data(); }
+
+    // 재사용되는 scratch buffer 크기
+    size_t capacityBytes() const;
+
+private:
+    bool resolve(FriBidiStrIndex len);
+    void splitRuns();
+
+    std::vector<FriBidiChar> text_;
+    std::vector<FriBidiCharType> types_;
+    std::vector<FriBidiBracketType> brackets_;
+    std::vector<FriBidiLevel> levels_;
+    std::vector<hb_script_t> scripts_;
+    std::vector<BidiRun> runs_;
+
+    FriBidiParType base_ = FRIBIDI_PAR_LTR;
+};
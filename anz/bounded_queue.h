@@ -0,0 +1,228 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// pipeline stage 사이를 잇는 크기가 정해진 MPMC queue (Dmitry Vyukov의 bounded queue).
+//
+// lock이 없다. slot마다 sequence 번호가 있어서 producer와 consumer가 CAS 한번으로 자기 slot을 잡는다.
+// 가득 차면 push()가 기다리고 (backpressure: 앞 stage가 뒤 stage보다 앞서가지 못한다), 비면 pop()이 기다린다.
+// 기다릴 때는 몇번 다시 해보고, 그 다음 yield, 그래도 안 되면 잠깐 잔다 (다른 stage에 CPU를 양보).
+// 값은 move로 넣고 꺼낸다. pointer를 넘기면 복사가 없다.
+//
+// close()는 producer가 모두 끝난 뒤에 한번 부른다. 그 뒤 pop()은 남은 것을 다 꺼내면 false를 돌려준다.
+
+struct QueueStats
+{
+    uint64_t pushes = 0;
+    uint64_t depthSum = 0;     // push 직후 깊이의 합, pushes로 나누면 평균 깊이
+    uint64_t maxDepth = 0;
+    double pushWaitSeconds = 0; // 가득 차서 producer가 기다린 시간 (뒤 stage가 느리다)
+    double popWaitSeconds = 0;  // 비어서 consumer가 기다린 시간 (앞 stage가 느리다)
+};
+
+template <class T>
+class BoundedQueue
+{
+public:
+    // capacity는 2의 거듭제곱으로 올린다
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // 대략의 깊이 (다른 thread가 동시에 넣고 빼는 중이면 어긋날 수 있다)
+    size_t size() const
+    {
+        size_t head = dequeuePos_.load(std::memory_order_relaxed);
+        size_t tail = enqueuePos_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    // 가득 차 있으면 false, 성공하면 value에서 move해 간다
+    bool tryPush(T &value)
+    {
+        Cell *cell;
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 비어 있으면 false
+    bool tryPop(T &value)
+    {
+        Cell *cell;
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 자리가 날 때까지 기다린다
+    void push(T value)
+    {
+        if (!tryPush(value))
+        {
+            auto start = std::chrono::steady_clock::now();
+            Backoff backoff;
+            while (!tryPush(value))
+                backoff.wait();
+            pushWaitNs_.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+        }
+
+        uint64_t depth = size();
+        pushes_.fetch_add(1, std::memory_order_relaxed);
+        depthSum_.fetch_add(depth, std::memory_order_relaxed);
+        uint64_t max = maxDepth_.load(std::memory_order_relaxed);
+        while (depth > max && !maxDepth_.compare_exchange_weak(max, depth, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // 하나를 꺼낼 때까지 기다린다. close()된 뒤 비었으면 false
+    bool pop(T &value)
+    {
+        if (tryPop(value))
+            return true;
+
+        auto start = std::chrono::steady_clock::now();
+        Backoff backoff;
+        bool popped = false;
+        for (;;)
+        {
+            if (tryPop(value))
+            {
+                popped = true;
+                break;
+            }
+            if (closed_.load(std::memory_order_acquire))
+            {
+                // close() 전에 들어온 것이 아직 남아 있을 수 있다
+                popped = tryPop(value);
+                break;
+            }
+            backoff.wait();
+        }
+        popWaitNs_.fetch_add(elapsed_ns(start), std::memory_order_relaxed);
+        return popped;
+    }
+
+    void close() { closed_.store(true, std::memory_order_release); }
+
+    QueueStats stats() const
+    {
+        QueueStats stats;
+        stats.pushes = pushes_.load(std::memory_order_relaxed);
+        stats.depthSum = depthSum_.load(std::memory_order_relaxed);
+        stats.maxDepth = maxDepth_.load(std::memory_order_relaxed);
+        stats.pushWaitSeconds = pushWaitNs_.load(std::memory_order_relaxed) * 1e-9;
+        stats.popWaitSeconds = popWaitNs_.load(std::memory_order_relaxed) * 1e-9;
+        return stats;
+    }
+
+private:
+    struct alignas(64) Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    class Backoff
+    {
+    public:
+        void wait()
+        {
+            if (tries_ < 16)
+            {
+                tries_++; // 곧 자리가 날 수 있다, 바로 다시 해본다
+            }
+            else if (tries_ < 64)
+            {
+                tries_++;
+                std::this_thread::yield();
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+    private:
+        int tries_ = 0;
+    };
+
+    static uint64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+
+    // producer와 consumer가 같은 cache line을 두고 다투지 않도록 떼어 놓는다
+    alignas(64) std::atomic<size_t> enqueuePos_{0};
+    alignas(64) std::atomic<size_t> dequeuePos_{0};
+    alignas(64) std::atomic<bool> closed_{false};
+
+    std::atomic<uint64_t> pushes_{0};
+    std::atomic<uint64_t> depthSum_{0};
+    std::atomic<uint64_t> maxDepth_{0};
+    std::atomic<uint64_t> pushWaitNs_{0};
+    std::atomic<uint64_t> popWaitNs_{0};
+};
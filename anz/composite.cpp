@@ -0,0 +1,314 @@
+#include "composite.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COMPOSITE_X86 1
+#endif
+
+namespace
+{
+    typedef void (*SpanFunc)(uint32_t *dst, const uint8_t *mask, int count, uint32_t color);
+
+    // pixman과 같은 반올림: a * b / 255
+    inline uint32_t mul_un8(uint32_t a, uint32_t b)
+    {
+        uint32_t t = a * b + 0x80;
+        return (t + (t >> 8)) >> 8;
+    }
+
+    inline uint32_t over_pixel(uint32_t d, uint32_t m, uint32_t color)
+    {
+        uint32_t s = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+            s |= mul_un8((color >> shift) & 0xff, m) << shift;
+
+        uint32_t ia = 255 - (s >> 24);
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            uint32_t c = mul_un8((d >> shift) & 0xff, ia) + ((s >> shift) & 0xff);
+            out |= (c > 255 ? 255 : c) << shift;
+        }
+        return out;
+    }
+
+    void span_scalar(uint32_t *dst, const uint8_t *mask, int count, uint32_t color)
+    {
+        bool opaque = (color >> 24) == 255;
+        for (int i = 0; i < count; i++)
+        {
+            uint32_t m = mask[i];
+            if (m == 0)
+                continue;
+
+            if (m == 255 && opaque)
+                dst[i] = color;
+            else
+                dst[i] = over_pixel(dst[i], m, color);
+        }
+    }
+
+#ifdef COMPOSITE_X86
+    // 16bit lane 8개에 대해 a * b / 255 (pixman_multiply과 같은 결과)
+    inline __m128i mul_un8_sse2(__m128i a, __m128i b)
+    {
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(0x80));
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    // 2 pixel (16bit × 8) 합성
+    inline __m128i over_sse2(__m128i d, __m128i m, __m128i color)
+    {
+        __m128i s = mul_un8_sse2(color, m);
+        __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i ia = _mm_xor_si128(a, _mm_set1_epi16(0xff));
+        return _mm_add_epi16(mul_un8_sse2(d, ia), s); // 최대 510, packus에서 255로 포화
+    }
+
+    void span_sse2(uint32_t *dst, const uint8_t *mask, int count, uint32_t color)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i color4 = _mm_set1_epi32((int)color);
+        const __m128i color16 = _mm_unpacklo_epi8(color4, zero);
+        const bool opaque = (color >> 24) == 255;
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            uint32_t m4;
+            memcpy(&m4, mask + i, 4);
+            if (m4 == 0)
+                continue;
+            if (m4 == 0xffffffffu && opaque)
+            {
+                _mm_storeu_si128((__m128i *)(dst + i), color4);
+                continue;
+            }
+
+            // mask byte를 pixel의 4 channel로 복제
+            __m128i m = _mm_cvtsi32_si128((int)m4);
+            m = _mm_unpacklo_epi8(m, m);
+            m = _mm_unpacklo_epi16(m, m);
+
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            __m128i lo = over_sse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(m, zero), color16);
+            __m128i hi = over_sse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(m, zero), color16);
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+        }
+
+        span_scalar(dst + i, mask + i, count - i, color);
+    }
+
+    __attribute__((target("avx2"))) inline __m256i mul_un8_avx2(__m256i a, __m256i b)
+    {
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(0x80));
+        return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+    }
+
+    __attribute__((target("avx2"))) inline __m256i over_avx2(__m256i d, __m256i m, __m256i color)
+    {
+        __m256i s = mul_un8_avx2(color, m);
+        __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m256i ia = _mm256_xor_si256(a, _mm256_set1_epi16(0xff));
+        return _mm256_add_epi16(mul_un8_avx2(d, ia), s);
+    }
+
+    __attribute__((target("avx2"))) void span_avx2(uint32_t *dst, const uint8_t *mask, int count, uint32_t color)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i color8 = _mm256_set1_epi32((int)color);
+        const __m256i color16 = _mm256_unpacklo_epi8(color8, zero);
+        const bool opaque = (color >> 24) == 255;
+
+        // 128bit lane 0은 mask 0~3, lane 1은 mask 4~7을 각 pixel의 4 channel로 복제
+        const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                                4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            uint64_t m8;
+            memcpy(&m8, mask + i, 8);
+            if (m8 == 0)
+                continue;
+            if (m8 == ~0ull && opaque)
+            {
+                _mm256_storeu_si256((__m256i *)(dst + i), color8);
+                continue;
+            }
+
+            __m256i m = _mm256_shuffle_epi8(_mm256_set1_epi64x((long long)m8), spread);
+            __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+
+            // unpack/pack 모두 lane 안에서 동작하므로 pixel 순서가 그대로 유지된다
+            __m256i lo = over_avx2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(m, zero), color16);
+            __m256i hi = over_avx2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(m, zero), color16);
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+        }
+
+        span_sse2(dst + i, mask + i, count - i, color);
+    }
+#endif
+
+    SpanFunc span_for(CompositeKernel kernel)
+    {
+        switch (kernel)
+        {
+#ifdef COMPOSITE_X86
+        case COMPOSITE_KERNEL_SSE2:
+            return span_sse2;
+        case COMPOSITE_KERNEL_AVX2:
+            return span_avx2;
+#endif
+        default:
+            return span_scalar;
+        }
+    }
+
+    CompositeKernel best_kernel()
+    {
+        if (composite_kernel_supported(COMPOSITE_KERNEL_AVX2))
+            return COMPOSITE_KERNEL_AVX2;
+        if (composite_kernel_supported(COMPOSITE_KERNEL_SSE2))
+            return COMPOSITE_KERNEL_SSE2;
+        return COMPOSITE_KERNEL_SCALAR;
+    }
+
+    CompositeKernel current_kernel = best_kernel();
+    SpanFunc current_span = span_for(current_kernel);
+}
+
+bool composite_kernel_supported(CompositeKernel kernel)
+{
+    switch (kernel)
+    {
+    case COMPOSITE_KERNEL_AUTO:
+    case COMPOSITE_KERNEL_SCALAR:
+        return true;
+#ifdef COMPOSITE_X86
+    case COMPOSITE_KERNEL_SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case COMPOSITE_KERNEL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+bool composite_set_kernel(CompositeKernel kernel)
+{
+    if (kernel == COMPOSITE_KERNEL_AUTO)
+        kernel = best_kernel();
+    if (!composite_kernel_supported(kernel))
+        return false;
+
+    current_kernel = kernel;
+    current_span = span_for(kernel);
+    return true;
+}
+
+CompositeKernel composite_get_kernel()
+{
+    return current_kernel;
+}
+
+const char *composite_kernel_name(CompositeKernel kernel)
+{
+    switch (kernel)
+    {
+    case COMPOSITE_KERNEL_AUTO:
+        return "auto";
+    case COMPOSITE_KERNEL_SCALAR:
+        return "scalar";
+    case COMPOSITE_KERNEL_SSE2:
+        return "sse2";
+    case COMPOSITE_KERNEL_AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+bool composite_kernel_from_name(const char *name, CompositeKernel &kernel)
+{
+    const CompositeKernel kernels[] = {COMPOSITE_KERNEL_AUTO, COMPOSITE_KERNEL_SCALAR,
+                                       COMPOSITE_KERNEL_SSE2, COMPOSITE_KERNEL_AVX2};
+    for (CompositeKernel k : kernels)
+    {
+        if (strcmp(name, composite_kernel_name(k)) == 0)
+        {
+            kernel = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t composite_color(double red, double green, double blue, double alpha)
+{
+    // cairo: premultiply → 16bit (_cairo_color_double_to_short) → pixman이 상위 8bit를 쓴다
+    auto channel = [](double v) -> uint32_t {
+        if (v < 0.)
+            v = 0.;
+        if (v > 1.)
+            v = 1.;
+        return ((uint32_t)(v * 65535. + .5)) >> 8;
+    };
+
+    return channel(alpha) << 24 | channel(red * alpha) << 16 | channel(green * alpha) << 8 | channel(blue * alpha);
+}
+
+void composite_span(uint32_t *dst, const uint8_t *mask, int count, uint32_t color)
+{
+    current_span(dst, mask, count, color);
+}
+
+void composite_mask(uint8_t *data, int stride, int width, int height,
+                    const uint8_t *mask, int maskStride, int maskWidth, int maskHeight,
+                    int x, int y, uint32_t color)
+{
+    // surface 밖으로 나가는 부분은 잘라낸다
+    int x0 = x < 0 ? -x : 0;
+    int y0 = y < 0 ? -y : 0;
+    int x1 = x + maskWidth > width ? width - x : maskWidth;
+    int y1 = y + maskHeight > height ? height - y : maskHeight;
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    SpanFunc span = current_span;
+    for (int row = y0; row < y1; row++)
+    {
+        uint32_t *dst = (uint32_t *)(data + (size_t)(y + row) * stride) + x + x0;
+        span(dst, mask + (size_t)row * maskStride + x0, x1 - x0, color);
+    }
+}
+
+void composite_mask_a8(uint8_t *data, int stride, int width, int height,
+                       const uint8_t *mask, int maskStride, int maskWidth, int maskHeight, int x, int y)
+{
+    int x0 = x < 0 ? -x : 0;
+    int y0 = y < 0 ? -y : 0;
+    int x1 = x + maskWidth > width ? width - x : maskWidth;
+    int y1 = y + maskHeight > height ? height - y : maskHeight;
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    // pixel당 1 byte라 scalar로도 ARGB32 kernel보다 가볍다
+    for (int row = y0; row < y1; row++)
+    {
+        uint8_t *dst = data + (size_t)(y + row) * stride + x + x0;
+        const uint8_t *src = mask + (size_t)row * maskStride + x0;
+        for (int i = 0; i < x1 - x0; i++)
+        {
+            uint32_t m = src[i];
+            if (m == 255)
+                dst[i] = 255;
+            else if (m)
+                dst[i] = m + mul_un8(dst[i], 255 - m);
+        }
+    }
+}
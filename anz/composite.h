@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+// solid color × A8 coverage mask → premultiplied ARGB32 (OVER) 합성.
+//
+// cairo(pixman)의 over_n_8_8888과 같은 반올림을 쓰므로 같은 mask라면 결과가 bit 단위로 같다.
+// x86에서는 실행 중에 CPU를 보고 AVX2 / SSE2 / scalar 중 하나를 고른다.
+
+enum CompositeKernel
+{
+    COMPOSITE_KERNEL_AUTO,
+    COMPOSITE_KERNEL_SCALAR,
+    COMPOSITE_KERNEL_SSE2,
+    COMPOSITE_KERNEL_AVX2,
+};
+
+bool composite_kernel_supported(CompositeKernel kernel);
+
+// 지원하지 않는 kernel이면 false, 바뀌지 않는다
+bool composite_set_kernel(CompositeKernel kernel);
+CompositeKernel composite_get_kernel();
+
+const char *composite_kernel_name(CompositeKernel kernel);
+bool composite_kernel_from_name(const char *name, CompositeKernel &kernel);
+
+// cairo_set_source_rgba()와 같은 방식으로 8bit premultiplied ARGB32를 만든다
+uint32_t composite_color(double red, double green, double blue, double alpha);
+
+// dst[i] = color * mask[i] OVER dst[i]
+void composite_span(uint32_t *dst, const uint8_t *mask, int count, uint32_t color);
+
+// mask를 (x, y)에 놓고 surface 밖은 잘라서 합성한다
+void composite_mask(uint8_t *data, int stride, int width, int height,
+                    const uint8_t *mask, int maskStride, int maskWidth, int maskHeight,
+                    int x, int y, uint32_t color);
+
+// A8 surface (coverage만, --mask)에 불투명한 색으로 합성한다: dst = mask + dst × (255 - mask) / 255.
+// 색은 encode할 때 입힌다
+void composite_mask_a8(uint8_t *data, int stride, int width, int height,
+                       const uint8_t *mask, int maskStride, int maskWidth, int maskHeight, int x, int y);
@@ -0,0 +1,168 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+#include <cairo.h>
+// for cairo
+
+#include "composite.h"
+
+// composite.cpp의 kernel들을 cairo_mask_surface() 결과와 bit 단위로 비교하고
+// pixel/ns를 잰다.
+//
+// ./composite_bench [iterations]
+
+const int CHECK_ROUNDS = 200;
+const int BENCH_WIDTH = 512;
+const int BENCH_HEIGHT = 512;
+
+namespace
+{
+    std::mt19937 rng(12345);
+
+    uint32_t random_premultiplied()
+    {
+        uint32_t a = rng() & 0xff;
+        uint32_t r = a ? rng() % (a + 1) : 0;
+        uint32_t g = a ? rng() % (a + 1) : 0;
+        uint32_t b = a ? rng() % (a + 1) : 0;
+        return a << 24 | r << 16 | g << 8 | b;
+    }
+
+    // glyph처럼 0, 255 구간과 가장자리 값이 섞인 mask
+    void random_mask(std::vector<uint8_t> &mask)
+    {
+        for (size_t i = 0; i < mask.size();)
+        {
+            size_t run = 1 + rng() % 24;
+            int kind = rng() % 3;
+            for (size_t j = 0; j < run && i < mask.size(); j++, i++)
+                mask[i] = kind == 0 ? 0 : kind == 1 ? 255 : rng() & 0xff;
+        }
+    }
+
+    // cairo(pixman)로 같은 mask를 합성한다
+    void cairo_reference(std::vector<uint32_t> &dst, int width, int height,
+                         std::vector<uint8_t> &mask, int maskStride,
+                         double r, double g, double b, double a)
+    {
+        cairo_surface_t *target = cairo_image_surface_create_for_data(
+            (unsigned char *)dst.data(), CAIRO_FORMAT_ARGB32, width, height, width * 4);
+        cairo_surface_t *maskSurface = cairo_image_surface_create_for_data(
+            mask.data(), CAIRO_FORMAT_A8, width, height, maskStride);
+
+        cairo_t *cr = cairo_create(target);
+        cairo_set_source_rgba(cr, r, g, b, a);
+        cairo_mask_surface(cr, maskSurface, 0, 0);
+        cairo_destroy(cr);
+        cairo_surface_flush(target);
+
+        cairo_surface_destroy(maskSurface);
+        cairo_surface_destroy(target);
+    }
+
+    bool check_kernel(CompositeKernel kernel)
+    {
+        composite_set_kernel(kernel);
+
+        for (int round = 0; round < CHECK_ROUNDS; round++)
+        {
+            // 폭을 바꿔가며 SIMD 꼬리 처리도 확인한다
+            int width = 1 + rng() % 67;
+            int height = 1 + rng() % 5;
+            int maskStride = cairo_format_stride_for_width(CAIRO_FORMAT_A8, width);
+
+            std::vector<uint32_t> expected(width * height);
+            for (uint32_t &p : expected)
+                p = random_premultiplied();
+            std::vector<uint32_t> actual = expected;
+
+            std::vector<uint8_t> mask(maskStride * height);
+            random_mask(mask);
+
+            double r = (rng() % 1001) / 1000.;
+            double g = (rng() % 1001) / 1000.;
+            double b = (rng() % 1001) / 1000.;
+            double a = round % 4 == 0 ? 1. : (rng() % 1001) / 1000.;
+
+            cairo_reference(expected, width, height, mask, maskStride, r, g, b, a);
+            composite_mask((uint8_t *)actual.data(), width * 4, width, height,
+                           mask.data(), maskStride, width, height, 0, 0, composite_color(r, g, b, a));
+
+            for (int i = 0; i < width * height; i++)
+            {
+                if (expected[i] != actual[i])
+                {
+                    printf("%s: mismatch at round %d pixel %d (mask %d): cairo %08x, ours %08x\n",
+                           composite_kernel_name(kernel), round, i, mask[(i / width) * maskStride + i % width],
+                           expected[i], actual[i]);
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    double bench(CompositeKernel kernel, int iterations, const std::vector<uint8_t> &mask,
+                 std::vector<uint32_t> &dst, uint32_t color)
+    {
+        composite_set_kernel(kernel);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int n = 0; n < iterations; n++)
+            composite_mask((uint8_t *)dst.data(), BENCH_WIDTH * 4, BENCH_WIDTH, BENCH_HEIGHT,
+                           mask.data(), BENCH_WIDTH, BENCH_WIDTH, BENCH_HEIGHT, 0, 0, color);
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+        return (double)BENCH_WIDTH * BENCH_HEIGHT * iterations / elapsed.count();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    if (iterations <= 0)
+        iterations = 200;
+
+    const CompositeKernel kernels[] = {COMPOSITE_KERNEL_SCALAR, COMPOSITE_KERNEL_SSE2, COMPOSITE_KERNEL_AVX2};
+
+    bool ok = true;
+    for (CompositeKernel kernel : kernels)
+    {
+        if (!composite_kernel_supported(kernel))
+        {
+            printf("%-8s unsupported on this CPU\n", composite_kernel_name(kernel));
+            continue;
+        }
+
+        bool exact = check_kernel(kernel);
+        printf("%-8s bit-exact vs cairo: %s\n", composite_kernel_name(kernel), exact ? "yes" : "NO");
+        ok = ok && exact;
+    }
+
+    std::vector<uint8_t> mask(BENCH_WIDTH * BENCH_HEIGHT);
+    random_mask(mask);
+    std::vector<uint32_t> dst(BENCH_WIDTH * BENCH_HEIGHT);
+
+    const uint32_t colors[] = {composite_color(0., 0., 0., 1.), composite_color(.2, .4, .8, .5)};
+    for (uint32_t color : colors)
+    {
+        printf("color %08x, %dx%d, %d iterations\n", color, BENCH_WIDTH, BENCH_HEIGHT, iterations);
+        for (CompositeKernel kernel : kernels)
+        {
+            if (!composite_kernel_supported(kernel))
+                continue;
+
+            std::fill(dst.begin(), dst.end(), 0xffffffffu);
+            printf("  %-8s %8.3f pixels/ns\n", composite_kernel_name(kernel),
+                   bench(kernel, iterations, mask, dst, color));
+        }
+    }
+
+    return ok ? 0 : 1;
+}
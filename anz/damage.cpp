@@ -0,0 +1,181 @@
+#include "damage.h"
+
+#include <algorithm>
+
+// 이만큼 떨어진 영역까지는 합친다. 작은 영역 여러개보다 하나가 upload / encode하기 쉽다
+const int MERGE_GAP = 4;
+
+namespace
+{
+    bool glyph_less(const PlacedGlyph &a, const PlacedGlyph &b)
+    {
+        if (a.y != b.y)
+            return a.y < b.y;
+        if (a.x != b.x)
+            return a.x < b.x;
+        if (a.font != b.font)
+            return a.font < b.font;
+        return a.glyph < b.glyph;
+    }
+
+    bool near(const DamageRect &a, const DamageRect &b)
+    {
+        return a.x <= b.x + b.width + MERGE_GAP && b.x <= a.x + a.width + MERGE_GAP &&
+               a.y <= b.y + b.height + MERGE_GAP && b.y <= a.y + a.height + MERGE_GAP;
+    }
+
+    DamageRect unite(const DamageRect &a, const DamageRect &b)
+    {
+        int left = std::min(a.x, b.x);
+        int top = std::min(a.y, b.y);
+        int right = std::max(a.x + a.width, b.x + b.width);
+        int bottom = std::max(a.y + a.height, b.y + b.height);
+        return {left, top, right - left, bottom - top};
+    }
+
+    int64_t area(const DamageRect &rect)
+    {
+        return (int64_t)rect.width * rect.height;
+    }
+}
+
+void DamageTracker::addBox(const PlacedGlyph &glyph, int width, int height, int align)
+{
+    stats_.changedGlyphs++;
+
+    int left = std::max(glyph.left, 0);
+    int top = std::max(glyph.top, 0);
+    int right = std::min(glyph.right, width);
+    int bottom = std::min(glyph.bottom, height);
+    if (left >= right || top >= bottom)
+        return;
+
+    left -= left % align;
+    right = std::min(width, (right + align - 1) / align * align);
+    rects_.push_back({left, top, right - left, bottom - top});
+}
+
+void DamageTracker::merge()
+{
+    // 가까운 것끼리 더 합칠 것이 없을 때까지 합친다
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (size_t i = 0; i < rects_.size(); i++)
+        {
+            for (size_t j = i + 1; j < rects_.size();)
+            {
+                if (near(rects_[i], rects_[j]))
+                {
+                    rects_[i] = unite(rects_[i], rects_[j]);
+                    rects_[j] = rects_.back();
+                    rects_.pop_back();
+                    merged = true;
+                }
+                else
+                {
+                    j++;
+                }
+            }
+        }
+    }
+
+    // 그래도 많으면 합쳤을 때 늘어나는 넓이가 가장 작은 둘씩 합친다.
+    // 합친 영역이 다른 영역과 겹칠 수 있지만, 다시 그리는 것은 멱등이라 상관없다
+    while (rects_.size() > MAX_RECTS)
+    {
+        size_t bestI = 0;
+        size_t bestJ = 1;
+        int64_t best = INT64_MAX;
+        for (size_t i = 0; i < rects_.size(); i++)
+        {
+            for (size_t j = i + 1; j < rects_.size(); j++)
+            {
+                int64_t grow = area(unite(rects_[i], rects_[j])) - area(rects_[i]) - area(rects_[j]);
+                if (grow < best)
+                {
+                    best = grow;
+                    bestI = i;
+                    bestJ = j;
+                }
+            }
+        }
+        rects_[bestI] = unite(rects_[bestI], rects_[bestJ]);
+        rects_[bestJ] = rects_.back();
+        rects_.pop_back();
+    }
+
+    // 위에서 아래, 왼쪽에서 오른쪽 순서로 돌려준다 (upload가 memory 순서로 읽도록)
+    std::sort(rects_.begin(), rects_.end(), [](const DamageRect &a, const DamageRect &b) {
+        return a.y != b.y ? a.y < b.y : a.x < b.x;
+    });
+}
+
+const std::vector<DamageRect> &DamageTracker::commit(int width, int height, bool full, int align)
+{
+    stats_.frames++;
+    rects_.clear();
+    if (align < 1)
+        align = 1;
+
+    if (!full && valid_)
+    {
+        // 위치 순으로 정렬해서 한번에 맞춰본다. 같은 자리의 같은 glyph는 pixel도 같다
+        sortedOld_.assign(current_.begin(), current_.end());
+        sortedNew_.assign(next_.begin(), next_.end());
+        std::sort(sortedOld_.begin(), sortedOld_.end(), glyph_less);
+        std::sort(sortedNew_.begin(), sortedNew_.end(), glyph_less);
+
+        size_t i = 0;
+        size_t j = 0;
+        while (i < sortedOld_.size() || j < sortedNew_.size())
+        {
+            if (j == sortedNew_.size() || (i < sortedOld_.size() && glyph_less(sortedOld_[i], sortedNew_[j])))
+            {
+                addBox(sortedOld_[i++], width, height, align); // 없어진 glyph
+            }
+            else if (i == sortedOld_.size() || glyph_less(sortedNew_[j], sortedOld_[i]))
+            {
+                addBox(sortedNew_[j++], width, height, align); // 새 glyph
+            }
+            else
+            {
+                stats_.keptGlyphs++;
+                i++;
+                j++;
+            }
+        }
+
+        merge();
+
+        // 거의 다 바뀌었으면 한번에 다시 그리는 편이 싸다
+        int64_t damaged = 0;
+        for (const DamageRect &rect : rects_)
+            damaged += area(rect);
+        if (damaged * 2 > (int64_t)width * height)
+            full = true;
+    }
+    else
+    {
+        full = true;
+        stats_.changedGlyphs += next_.size();
+    }
+
+    if (full && width > 0 && height > 0)
+    {
+        rects_.clear();
+        rects_.push_back({0, 0, width, height});
+        stats_.full++;
+    }
+
+    if (rects_.empty())
+        stats_.unchanged++;
+    for (const DamageRect &rect : rects_)
+        stats_.damagedPixels += area(rect);
+
+    current_.swap(next_);
+    next_.clear();
+    valid_ = true;
+    return rects_;
+}
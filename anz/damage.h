@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// 바뀐 glyph만 다시 그리기 위한 damage 계산.
+//
+// frame마다 놓인 glyph 목록 (font, glyph id, 1/64 pixel 위치, pixel ink 영역)을 갖고,
+// 이전 frame과 같은 자리에 같은 glyph가 있으면 그대로 둔다. 없어진 glyph와 새 glyph의 ink 영역이 damage다.
+// 겹치거나 가까운 영역은 하나로 합치고, 개수가 MAX_RECTS를 넘으면 더 합친다. 넓이가 surface 절반을 넘으면 전체를 다시 그린다.
+
+struct DamageRect
+{
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+struct PlacedGlyph
+{
+    unsigned int font;
+    uint32_t glyph;
+    int32_t x; // glyph 원점, 1/64 pixel (offset 포함)
+    int32_t y;
+    int left;  // ink 영역 pixel [left, right) × [top, bottom), antialiasing 1px 포함. 비었으면 left == right
+    int top;
+    int right;
+    int bottom;
+};
+
+struct DamageStats
+{
+    uint64_t frames = 0;
+    uint64_t full = 0;          // 전체를 다시 그린 frame
+    uint64_t unchanged = 0;     // damage가 없던 frame
+    uint64_t keptGlyphs = 0;    // 이전 frame에서 그대로 둔 glyph
+    uint64_t changedGlyphs = 0; // 없어지거나 새로 생긴 glyph
+    uint64_t damagedPixels = 0;
+};
+
+class DamageTracker
+{
+public:
+    static const unsigned int MAX_RECTS = 16;
+
+    // 새 frame의 glyph를 여기 채우고 commit()을 부른다
+    std::vector<PlacedGlyph> &frame() { return next_; }
+
+    // frame()을 이전 frame과 비교해서 다시 그릴 영역을 구하고, frame()을 이전 frame으로 삼는다.
+    // full이거나 이전 frame이 없으면 surface 전체 하나. 반환값은 다음 commit()까지 유효하다.
+    // align이 1보다 크면 영역의 x와 폭을 그 pixel 배수로 넓힌다 (A8 row를 4 byte 경계에서 자르도록)
+    const std::vector<DamageRect> &commit(int width, int height, bool full, int align = 1);
+
+    // 이전 frame을 버린다. 다음 commit()은 surface 전체를 돌려준다
+    void reset() { valid_ = false; }
+
+    const std::vector<PlacedGlyph> &current() const { return current_; }
+    const DamageStats &stats() const { return stats_; }
+
+private:
+    void addBox(const PlacedGlyph &glyph, int width, int height, int align);
+    void merge();
+
+    std::vector<PlacedGlyph> current_;
+    std::vector<PlacedGlyph> next_;
+    bool valid_ = false;
+
+    // scratch
+    std::vector<PlacedGlyph> sortedOld_;
+    std::vector<PlacedGlyph> sortedNew_;
+    std::vector<DamageRect> rects_;
+
+    DamageStats stats_;
+};
+
+inline bool damage_intersects(const DamageRect &rect, const PlacedGlyph &glyph)
+{
+    return glyph.left < rect.x + rect.width && rect.x < glyph.right &&
+           glyph.top < rect.y + rect.height && rect.y < glyph.bottom;
+}
@@ -0,0 +1,152 @@
+#include "font_fallback.h"
+
+#include <hb.h>
+// for harfbuzz
+
+namespace
+{
+    const uint32_t MAX_CODEPOINT = 0x10FFFF;
+
+    // 앞 글자의 font를 따라가도 되는 글자 (공백, 숫자, 문장부호, 결합 기호)
+    bool follows_previous(uint32_t cp)
+    {
+        hb_script_t script = hb_unicode_script(hb_unicode_funcs_get_default(), cp);
+        return script == HB_SCRIPT_COMMON || script == HB_SCRIPT_INHERITED;
+    }
+}
+
+CoverageBitmap::Page &CoverageBitmap::page(uint32_t index)
+{
+    if (index >= top_.size())
+        top_.resize(index + 1, 0);
+    if (top_[index] == 0)
+    {
+        top_[index] = pages_.size();
+        pages_.push_back({});
+    }
+    return pages_[top_[index]];
+}
+
+void CoverageBitmap::addRange(uint32_t first, uint32_t last)
+{
+    if (last > MAX_CODEPOINT)
+        last = MAX_CODEPOINT;
+
+    for (uint32_t cp = first; cp <= last;)
+    {
+        Page &p = page(cp >> 8);
+
+        // 64 bit word 단위로 채운다
+        uint32_t wordEnd = (cp | 63) < last ? (cp | 63) : last;
+        uint32_t lo = cp & 63;
+        uint32_t hi = wordEnd & 63;
+        uint64_t mask = (hi == 63 ? ~0ull : ((1ull << (hi + 1)) - 1)) & ~((1ull << lo) - 1);
+        p.bits[(cp >> 6) & 3] |= mask;
+
+        if (wordEnd == MAX_CODEPOINT)
+            break;
+        cp = wordEnd + 1;
+    }
+}
+
+void CoverageBitmap::addCharSet(const FcCharSet *charset)
+{
+    // FcCharSet의 page도 256 codepoint 단위이므로 그대로 옮긴다
+    FcChar32 map[FC_CHARSET_MAP_SIZE];
+    FcChar32 next;
+
+    for (FcChar32 base = FcCharSetFirstPage(charset, map, &next);
+         base != FC_CHARSET_DONE;
+         base = FcCharSetNextPage(charset, map, &next))
+    {
+        Page &p = page(base >> 8);
+        for (int i = 0; i < 4; i++)
+            p.bits[i] |= map[i * 2] | ((uint64_t)map[i * 2 + 1] << 32);
+    }
+}
+
+void FontFallback::setPrimary(const std::string &query, const std::string &file, int faceIndex, CoverageBitmap coverage,
+                              FcConfig *config)
+{
+    query_ = query;
+    config_ = config;
+    primary_.file = file;
+    primary_.faceIndex = faceIndex;
+    primary_.coverage = std::move(coverage);
+}
+
+size_t FontFallback::bytes() const
+{
+    size_t total = primary_.coverage.bytes();
+    for (const FallbackFont &f : chain_)
+        total += f.coverage.bytes();
+    return total;
+}
+
+unsigned int FontFallback::findSlow(uint32_t cp, unsigned int prev)
+{
+    std::call_once(once_, [this] { buildChain(); });
+
+    if (prev && font(prev).coverage.has(cp) && follows_previous(cp))
+        return prev;
+
+    if (primary_.coverage.has(cp))
+        return 0;
+
+    for (size_t i = 0; i < chain_.size(); i++)
+    {
+        if (chain_[i].coverage.has(cp))
+            return i + 1;
+    }
+
+    return 0;
+}
+
+void FontFallback::buildChain()
+{
+    // my_fontconfig()가 font index로 끝났으면 config가 없다. 여기서 처음 fontconfig가 초기화된다
+    if (!config_)
+        FcInit();
+
+    FcPattern *pattern = FcNameParse((const FcChar8 *)query_.c_str());
+    if (!pattern)
+        return;
+
+    FcConfigSubstitute(config_, pattern, FcMatchPattern);
+    FcDefaultSubstitute(pattern);
+
+    // trim: 앞 font들이 이미 가진 글자만 있는 font는 빠진다
+    FcResult result;
+    FcFontSet *fontSet = FcFontSort(config_, pattern, FcTrue, NULL, &result);
+    FcPatternDestroy(pattern);
+
+    if (fontSet)
+    {
+        for (int i = 0; i < fontSet->nfont; i++)
+        {
+            FcPattern *match = fontSet->fonts[i];
+
+            FcChar8 *file = NULL;
+            FcCharSet *charset = NULL;
+            if (FcPatternGetString(match, FC_FILE, 0, &file) != FcResultMatch ||
+                FcPatternGetCharSet(match, FC_CHARSET, 0, &charset) != FcResultMatch)
+                continue;
+
+            int faceIndex = 0;
+            if (FcPatternGetInteger(match, FC_INDEX, 0, &faceIndex) != FcResultMatch)
+                faceIndex = 0;
+
+            if (primary_.file == (const char *)file && primary_.faceIndex == faceIndex)
+                continue;
+
+            chain_.emplace_back();
+            FallbackFont &fallback = chain_.back();
+            fallback.file = (const char *)file;
+            fallback.faceIndex = faceIndex;
+            fallback.coverage.addCharSet(charset);
+        }
+        FcFontSetDestroy(fontSet);
+    }
+
+    built_.store(true, std::memory_order_release);
+}
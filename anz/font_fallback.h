@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fontconfig/fontconfig.h>
+// for fontconfig
+
+// codepoint → font 선택 (font fallback).
+//
+// font마다 coverage를 2단 bitmap으로 펼쳐 둔다: 256 codepoint page → page bitmap(256 bit).
+// FcCharSet을 매번 묻지 않고 codepoint 하나당 load 두번으로 판정한다.
+//
+// font 0은 my_fontconfig()가 고른 primary font이고 coverage만 미리 만든다.
+// primary에 없는 글자가 처음 나올 때 FcFontSort로 fallback chain(1번부터)을 만든다.
+// 그래서 primary로 다 그려지는 text는 fontconfig를 다시 부르지 않고 bitmap 확인만 한다.
+// chain은 한번 만들어지면 바뀌지 않으므로 여러 thread에서 find()를 불러도 된다.
+
+class CoverageBitmap
+{
+public:
+    // [first, last] 구간을 추가한다
+    void addRange(uint32_t first, uint32_t last);
+    void addCharSet(const FcCharSet *charset);
+
+    bool has(uint32_t cp) const
+    {
+        uint32_t page = cp >> 8;
+        if (page >= top_.size())
+            return false;
+        return (pages_[top_[page]].bits[(cp >> 6) & 3] >> (cp & 63)) & 1;
+    }
+
+    size_t bytes() const { return top_.size() * sizeof(uint16_t) + pages_.size() * sizeof(Page); }
+
+private:
+    struct Page
+    {
+        uint64_t bits[4];
+    };
+
+    Page &page(uint32_t index);
+
+    std::vector<uint16_t> top_;      // codepoint >> 8 → pages_ index, 0은 빈 page
+    std::vector<Page> pages_ = {{}}; // pages_[0]은 항상 비어있다
+};
+
+struct FallbackFont
+{
+    std::string file;
+    int faceIndex = 0;
+    CoverageBitmap coverage;
+};
+
+class FontFallback
+{
+public:
+    // query는 FcFontSort에 넘길 pattern (FONT_NAME).
+    // config는 primary를 찾은 fontconfig 설정, chain도 여기서 찾는다. NULL이면 fontconfig 기본 설정을 쓴다.
+    // chain을 만들 때까지 (find()가 처음 primary에 없는 글자를 볼 때까지) config가 살아 있어야 한다
+    void setPrimary(const std::string &query, const std::string &file, int faceIndex, CoverageBitmap coverage,
+                    FcConfig *config = NULL);
+
+    // cp를 그릴 font 번호. 아무 font에도 없으면 0 (primary의 .notdef)
+    // prev는 바로 앞 글자의 font: 공백, 문장부호, 결합 기호는 prev가 가지고 있으면 prev에 붙인다
+    unsigned int find(uint32_t cp, unsigned int prev = 0)
+    {
+        if (prev == 0 && primary_.coverage.has(cp))
+            return 0;
+        return findSlow(cp, prev);
+    }
+
+    // find()가 돌려준 번호로만 부른다
+    const FallbackFont &font(unsigned int index) const { return index ? chain_[index - 1] : primary_; }
+
+    // fallback chain을 만들었는지, 만들었다면 primary 포함 몇개인지.
+    // worker가 chain을 만드는 중에도 부를 수 있다 (true면 chain_을 읽어도 된다)
+    bool chainBuilt() const { return built_.load(std::memory_order_acquire); }
+    size_t size() const { return chain_.size() + 1; }
+    size_t bytes() const;
+
+private:
+    unsigned int findSlow(uint32_t cp, unsigned int prev);
+    void buildChain();
+
+    std::string query_;
+    FcConfig *config_ = NULL;
+    FallbackFont primary_;
+    std::vector<FallbackFont> chain_;
+    std::once_flag once_;
+    std::atomic<bool> built_{false};
+};
@@ -0,0 +1,462 @@
+#include "font_index.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <strings.h>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const char FONT_INDEX_MAGIC[8] = {'H', 'T', 'F', 'O', 'N', 'T', 'I', 'X'};
+
+    struct StringPool
+    {
+        std::vector<char> data{0}; // offset 0은 빈 문자열
+        std::unordered_map<std::string, uint32_t> offsets;
+
+        uint32_t add(const char *s)
+        {
+            if (!s || !*s)
+                return 0;
+
+            auto it = offsets.find(s);
+            if (it != offsets.end())
+                return it->second;
+
+            uint32_t offset = data.size();
+            data.insert(data.end(), s, s + strlen(s) + 1);
+            offsets.emplace(s, offset);
+            return offset;
+        }
+    };
+
+    struct PendingFont
+    {
+        std::string family;
+        FontIndexFont font;
+    };
+
+    void stat_dir(const char *path, FontIndexDir &dir)
+    {
+        struct stat st;
+        if (stat(path, &st) == 0)
+        {
+            dir.exists = 1;
+            dir.mtimeSec = st.st_mtim.tv_sec;
+            dir.mtimeNsec = st.st_mtim.tv_nsec;
+        }
+        else
+        {
+            dir.exists = 0;
+            dir.mtimeSec = 0;
+            dir.mtimeNsec = 0;
+        }
+    }
+
+    // FcCharSet의 page bitmap을 [first, last] 구간으로 압축한다
+    void charset_to_ranges(FcCharSet *charset, std::vector<FontIndexRange> &ranges)
+    {
+        FcChar32 map[FC_CHARSET_MAP_SIZE];
+        FcChar32 next;
+
+        for (FcChar32 base = FcCharSetFirstPage(charset, map, &next);
+             base != FC_CHARSET_DONE;
+             base = FcCharSetNextPage(charset, map, &next))
+        {
+            for (int i = 0; i < FC_CHARSET_MAP_SIZE; i++)
+            {
+                if (!map[i])
+                    continue;
+
+                for (int bit = 0; bit < 32; bit++)
+                {
+                    if (!(map[i] & (1u << bit)))
+                        continue;
+
+                    FcChar32 cp = base + i * 32 + bit;
+                    if (!ranges.empty() && ranges.back().last + 1 == cp)
+                        ranges.back().last = cp;
+                    else
+                        ranges.push_back({cp, cp});
+                }
+            }
+        }
+    }
+
+    int weight_distance(const FontIndexFont &font)
+    {
+        return std::abs(font.weight - FC_WEIGHT_REGULAR) + (font.slant != FC_SLANT_ROMAN ? 1000 : 0);
+    }
+
+    uint32_t align8(uint32_t n)
+    {
+        return (n + 7) & ~7u;
+    }
+}
+
+FontIndex::~FontIndex()
+{
+    close();
+}
+
+std::string FontIndex::defaultPath()
+{
+    // 빈 문자열로 설정하면 index를 쓰지 않는다
+    if (const char *path = getenv("HELLO_TEXT_FONT_INDEX"))
+        return path;
+
+    std::string dir;
+    if (const char *cache = getenv("XDG_CACHE_HOME"))
+        dir = cache;
+    else if (const char *home = getenv("HOME"))
+        dir = std::string(home) + "/.cache";
+    else
+        return "fonts.idx";
+
+    dir += "/hello_text";
+    return dir + "/fonts.idx";
+}
+
+bool FontIndex::build(const std::string &path, FcConfig *config,
+                      const char *query, FcPattern *resolved)
+{
+    if (path.empty())
+        return false;
+
+    StringPool strings;
+    std::vector<FontIndexDir> dirs;
+    std::vector<PendingFont> pending;
+    std::vector<FontIndexRange> ranges;
+    std::vector<FontIndexAlias> aliases;
+
+    // font directory (하위 directory 포함) mtime 기록
+    FcStrList *dirList = FcConfigGetFontDirs(config);
+    if (dirList)
+    {
+        FcChar8 *dirPath;
+        while ((dirPath = FcStrListNext(dirList)))
+        {
+            FontIndexDir dir;
+            dir.path = strings.add((const char *)dirPath);
+            stat_dir((const char *)dirPath, dir);
+            dirs.push_back(dir);
+        }
+        FcStrListDone(dirList);
+    }
+
+    // 설치된 모든 font
+    FcPattern *all = FcPatternCreate();
+    FcObjectSet *objects = FcObjectSetBuild(FC_FAMILY, FC_STYLE, FC_FILE, FC_INDEX,
+                                            FC_WEIGHT, FC_SLANT, FC_CHARSET, (char *)0);
+    FcFontSet *fontSet = FcFontList(config, all, objects);
+    FcObjectSetDestroy(objects);
+    FcPatternDestroy(all);
+
+    if (!fontSet)
+        return false;
+
+    for (int i = 0; i < fontSet->nfont; i++)
+    {
+        FcPattern *pattern = fontSet->fonts[i];
+
+        FcChar8 *file = NULL;
+        if (FcPatternGetString(pattern, FC_FILE, 0, &file) != FcResultMatch)
+            continue;
+
+        FontIndexFont font = {};
+        font.file = strings.add((const char *)file);
+
+        FcChar8 *style = NULL;
+        if (FcPatternGetString(pattern, FC_STYLE, 0, &style) == FcResultMatch)
+            font.style = strings.add((const char *)style);
+
+        if (FcPatternGetInteger(pattern, FC_INDEX, 0, &font.faceIndex) != FcResultMatch)
+            font.faceIndex = 0;
+        if (FcPatternGetInteger(pattern, FC_WEIGHT, 0, &font.weight) != FcResultMatch)
+            font.weight = FC_WEIGHT_REGULAR;
+        if (FcPatternGetInteger(pattern, FC_SLANT, 0, &font.slant) != FcResultMatch)
+            font.slant = FC_SLANT_ROMAN;
+
+        FcCharSet *charset = NULL;
+        font.rangeStart = ranges.size();
+        if (FcPatternGetCharSet(pattern, FC_CHARSET, 0, &charset) == FcResultMatch)
+            charset_to_ranges(charset, ranges);
+        font.rangeCount = ranges.size() - font.rangeStart;
+
+        // family 이름(지역화된 이름 포함)마다 entry를 만든다. coverage는 공유한다.
+        FcChar8 *family = NULL;
+        for (int n = 0; FcPatternGetString(pattern, FC_FAMILY, n, &family) == FcResultMatch; n++)
+        {
+            font.family = strings.add((const char *)family);
+            pending.push_back({(const char *)family, font});
+        }
+    }
+    FcFontSetDestroy(fontSet);
+
+    // family는 대소문자 무시 정렬, 같은 family 안에서는 Regular에 가까운 것이 앞에 온다
+    std::stable_sort(pending.begin(), pending.end(), [](const PendingFont &a, const PendingFont &b) {
+        int cmp = strcasecmp(a.family.c_str(), b.family.c_str());
+        if (cmp != 0)
+            return cmp < 0;
+        return weight_distance(a.font) < weight_distance(b.font);
+    });
+
+    // fontconfig가 실제로 고른 font를 query 이름으로 기록 (Arial → Liberation Sans 같은 치환 결과)
+    FcChar8 *resolvedFile = NULL;
+    int resolvedIndex = 0;
+    if (query && resolved &&
+        FcPatternGetString(resolved, FC_FILE, 0, &resolvedFile) == FcResultMatch)
+    {
+        FcPatternGetInteger(resolved, FC_INDEX, 0, &resolvedIndex);
+        uint32_t fileOffset = strings.add((const char *)resolvedFile);
+
+        for (size_t i = 0; i < pending.size(); i++)
+        {
+            if (pending[i].font.file == fileOffset && pending[i].font.faceIndex == resolvedIndex)
+            {
+                aliases.push_back({strings.add(query), (uint32_t)i});
+                break;
+            }
+        }
+    }
+
+    // 직렬화
+    FontIndexHeader header = {};
+    memcpy(header.magic, FONT_INDEX_MAGIC, sizeof(header.magic));
+    header.version = FONT_INDEX_VERSION;
+    header.dirCount = dirs.size();
+    header.fontCount = pending.size();
+    header.aliasCount = aliases.size();
+    header.rangeCount = ranges.size();
+    header.stringSize = strings.data.size();
+
+    header.dirOffset = align8(sizeof(FontIndexHeader));
+    header.fontOffset = align8(header.dirOffset + header.dirCount * sizeof(FontIndexDir));
+    header.aliasOffset = align8(header.fontOffset + header.fontCount * sizeof(FontIndexFont));
+    header.rangeOffset = align8(header.aliasOffset + header.aliasCount * sizeof(FontIndexAlias));
+    header.stringOffset = align8(header.rangeOffset + header.rangeCount * sizeof(FontIndexRange));
+    header.fileSize = header.stringOffset + header.stringSize;
+
+    std::vector<char> out(header.fileSize, 0);
+    memcpy(out.data(), &header, sizeof(header));
+    if (!dirs.empty())
+        memcpy(out.data() + header.dirOffset, dirs.data(), dirs.size() * sizeof(FontIndexDir));
+    for (size_t i = 0; i < pending.size(); i++)
+        memcpy(out.data() + header.fontOffset + i * sizeof(FontIndexFont), &pending[i].font, sizeof(FontIndexFont));
+    if (!aliases.empty())
+        memcpy(out.data() + header.aliasOffset, aliases.data(), aliases.size() * sizeof(FontIndexAlias));
+    if (!ranges.empty())
+        memcpy(out.data() + header.rangeOffset, ranges.data(), ranges.size() * sizeof(FontIndexRange));
+    memcpy(out.data() + header.stringOffset, strings.data.data(), strings.data.size());
+
+    // ~/.cache가 아직 없을 수도 있으므로 중간 directory까지 만든다.
+    // 실패하면 (읽기 전용 home 등) 매 실행마다 다시 만들게 되므로 process마다 한번만 알린다
+    size_t slash = path.rfind('/');
+    if (slash != std::string::npos && slash > 0)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(path.substr(0, slash), error);
+        if (error)
+        {
+            static bool reported = false;
+            if (!reported)
+                fprintf(stderr, "font index: cannot create %s: %s\n", path.substr(0, slash).c_str(),
+                        error.message().c_str());
+            reported = true;
+            return false;
+        }
+    }
+
+    std::string tmpPath = path + ".tmp." + std::to_string(getpid());
+    FILE *fp = fopen(tmpPath.c_str(), "wb");
+    if (!fp)
+        return false;
+
+    bool ok = fwrite(out.data(), 1, out.size(), fp) == out.size();
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool FontIndex::open(const std::string &path)
+{
+    close();
+
+    if (path.empty())
+        return false;
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FontIndexHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    map_ = map;
+    mapSize_ = st.st_size;
+
+    const char *base = (const char *)map_;
+    const FontIndexHeader *h = (const FontIndexHeader *)base;
+
+    // 깨진 파일이나 다른 version은 stale과 똑같이 취급한다
+    auto section_ok = [&](uint32_t offset, uint32_t count, size_t size) {
+        return offset % 8 == 0 && offset <= mapSize_ && (uint64_t)count * size <= mapSize_ - offset;
+    };
+
+    if (memcmp(h->magic, FONT_INDEX_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != FONT_INDEX_VERSION ||
+        h->fileSize != mapSize_ ||
+        !section_ok(h->dirOffset, h->dirCount, sizeof(FontIndexDir)) ||
+        !section_ok(h->fontOffset, h->fontCount, sizeof(FontIndexFont)) ||
+        !section_ok(h->aliasOffset, h->aliasCount, sizeof(FontIndexAlias)) ||
+        !section_ok(h->rangeOffset, h->rangeCount, sizeof(FontIndexRange)) ||
+        !section_ok(h->stringOffset, h->stringSize, 1) ||
+        h->stringSize == 0 ||
+        base[h->stringOffset + h->stringSize - 1] != 0)
+    {
+        close();
+        return false;
+    }
+
+    header_ = h;
+    dirs_ = (const FontIndexDir *)(base + h->dirOffset);
+    fonts_ = (const FontIndexFont *)(base + h->fontOffset);
+    aliases_ = (const FontIndexAlias *)(base + h->aliasOffset);
+    ranges_ = (const FontIndexRange *)(base + h->rangeOffset);
+    strings_ = base + h->stringOffset;
+
+    for (uint32_t i = 0; i < h->fontCount; i++)
+    {
+        const FontIndexFont &f = fonts_[i];
+        if (f.family >= h->stringSize || f.style >= h->stringSize || f.file >= h->stringSize ||
+            f.rangeStart > h->rangeCount || f.rangeCount > h->rangeCount - f.rangeStart)
+        {
+            close();
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h->aliasCount; i++)
+    {
+        if (aliases_[i].name >= h->stringSize || aliases_[i].font >= h->fontCount)
+        {
+            close();
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h->dirCount; i++)
+    {
+        if (dirs_[i].path >= h->stringSize)
+        {
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FontIndex::close()
+{
+    if (map_)
+        munmap(map_, mapSize_);
+
+    map_ = nullptr;
+    mapSize_ = 0;
+    header_ = nullptr;
+    dirs_ = nullptr;
+    fonts_ = nullptr;
+    aliases_ = nullptr;
+    ranges_ = nullptr;
+    strings_ = nullptr;
+}
+
+bool FontIndex::fresh() const
+{
+    if (!header_ || header_->dirCount == 0)
+        return false;
+
+    for (uint32_t i = 0; i < header_->dirCount; i++)
+    {
+        FontIndexDir now;
+        stat_dir(string(dirs_[i].path), now);
+
+        if (now.exists != dirs_[i].exists ||
+            now.mtimeSec != dirs_[i].mtimeSec ||
+            now.mtimeNsec != dirs_[i].mtimeNsec)
+            return false;
+    }
+
+    return true;
+}
+
+const FontIndexFont *FontIndex::find(const char *query) const
+{
+    if (!header_ || !query)
+        return NULL;
+
+    // 1. 예전에 fontconfig가 이 query로 골랐던 font
+    for (uint32_t i = 0; i < header_->aliasCount; i++)
+    {
+        if (strcmp(string(aliases_[i].name), query) == 0)
+            return &fonts_[aliases_[i].font];
+    }
+
+    // 2. style 등이 붙은 query("Arial:bold")는 fontconfig 규칙을 흉내내지 않는다
+    if (strchr(query, ':'))
+        return NULL;
+
+    // 3. family 이름 binary search, 같은 family 중 첫번째가 Regular에 가장 가깝다
+    const FontIndexFont *begin = fonts_;
+    const FontIndexFont *end = fonts_ + header_->fontCount;
+    const FontIndexFont *it = std::lower_bound(begin, end, query, [this](const FontIndexFont &f, const char *name) {
+        return strcasecmp(string(f.family), name) < 0;
+    });
+
+    if (it != end && strcasecmp(string(it->family), query) == 0)
+        return it;
+
+    return NULL;
+}
+
+const char *FontIndex::string(uint32_t offset) const
+{
+    if (!header_ || offset >= header_->stringSize)
+        return "";
+    return strings_ + offset;
+}
+
+const FontIndexRange *FontIndex::coverage(const FontIndexFont &font, uint32_t &count) const
+{
+    if (!header_)
+    {
+        count = 0;
+        return NULL;
+    }
+
+    count = font.rangeCount;
+    return ranges_ + font.rangeStart;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <fontconfig/fontconfig.h>
+// for fontconfig
+
+// fontconfig 결과를 저장해두는 on-disk index.
+// 파일 전체를 mmap해서 그대로 읽으므로 모든 구조체는 고정 크기, offset 기반이다.
+// font directory의 mtime이 하나라도 바뀌면 stale로 보고 fontconfig로 다시 만든다.
+
+const uint32_t FONT_INDEX_VERSION = 1;
+
+struct FontIndexHeader
+{
+    char magic[8]; // "HTFONTIX"
+    uint32_t version;
+    uint32_t fileSize;
+
+    uint32_t dirCount;
+    uint32_t fontCount;
+    uint32_t aliasCount;
+    uint32_t rangeCount;
+    uint32_t stringSize;
+
+    uint32_t dirOffset;
+    uint32_t fontOffset;
+    uint32_t aliasOffset;
+    uint32_t rangeOffset;
+    uint32_t stringOffset;
+};
+
+struct FontIndexDir
+{
+    uint32_t path; // string pool offset
+    uint32_t exists;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+};
+
+struct FontIndexFont
+{
+    uint32_t family; // string pool offset, family 이름 하나당 entry 하나
+    uint32_t style;
+    uint32_t file;
+    int32_t faceIndex;
+    int32_t weight; // FC_WEIGHT_*
+    int32_t slant;  // FC_SLANT_*
+    uint32_t rangeStart; // coverage range 배열에서의 위치
+    uint32_t rangeCount;
+};
+
+struct FontIndexAlias
+{
+    uint32_t name; // FcNameParse에 넘겼던 query 그대로
+    uint32_t font; // fontconfig가 골랐던 font entry
+};
+
+struct FontIndexRange
+{
+    // coverage: [first, last] codepoint 구간, 오름차순
+    uint32_t first;
+    uint32_t last;
+};
+
+class FontIndex
+{
+public:
+    FontIndex() = default;
+    ~FontIndex();
+    FontIndex(const FontIndex &) = delete;
+    FontIndex &operator=(const FontIndex &) = delete;
+
+    // 기본 index 파일 경로
+    // $HELLO_TEXT_FONT_INDEX > $XDG_CACHE_HOME/hello_text/fonts.idx > ~/.cache/hello_text/fonts.idx
+    static std::string defaultPath();
+
+    // config의 모든 font와 font directory mtime으로 index를 만든다.
+    // query/resolved가 있으면 fontconfig가 고른 결과를 alias로 같이 저장한다.
+    static bool build(const std::string &path, FcConfig *config,
+                      const char *query, FcPattern *resolved);
+
+    // mmap 후 header 검사. 실패하면 false
+    bool open(const std::string &path);
+    void close();
+
+    // 저장된 font directory mtime이 지금과 같은지
+    bool fresh() const;
+
+    // alias → family 순서로 찾는다. 없으면 NULL
+    const FontIndexFont *find(const char *query) const;
+
+    const char *string(uint32_t offset) const;
+    const FontIndexRange *coverage(const FontIndexFont &font, uint32_t &count) const;
+
+    const FontIndexHeader *header() const { return header_; }
+    const FontIndexFont *fonts() const { return fonts_; }
+
+private:
+    void *map_ = nullptr;
+    size_t mapSize_ = 0;
+
+    const FontIndexHeader *header_ = nullptr;
+    const FontIndexDir *dirs_ = nullptr;
+    const FontIndexFont *fonts_ = nullptr;
+    const FontIndexAlias *aliases_ = nullptr;
+    const FontIndexRange *ranges_ = nullptr;
+    const char *strings_ = nullptr;
+};
@@ -0,0 +1,167 @@
+#include "font_map.h"
+
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFont::~MappedFont()
+{
+    close();
+}
+
+bool MappedFont::open(const std::string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    map_ = map;
+    size_ = st.st_size;
+    path_ = path;
+
+    // mapping은 close()까지 살아있으므로 HarfBuzz에는 복사하지 말라고 알려준다
+    blob_ = hb_blob_create((const char *)map_, size_, HB_MEMORY_MODE_READONLY, NULL, NULL);
+    return true;
+}
+
+void MappedFont::close()
+{
+    for (auto &face : faces_)
+        hb_face_destroy(face.second);
+    faces_.clear();
+
+    if (blob_)
+        hb_blob_destroy(blob_);
+    blob_ = nullptr;
+
+    if (map_)
+        munmap(map_, size_);
+    map_ = nullptr;
+    size_ = 0;
+    path_.clear();
+}
+
+hb_face_t *MappedFont::face(unsigned int index)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = faces_.find(index);
+    if (it != faces_.end())
+        return it->second;
+
+    hb_face_t *face = hb_face_create(blob_, index);
+    hb_face_make_immutable(face);
+    faces_.emplace(index, face);
+    return face;
+}
+
+size_t MappedFont::residentBytes() const
+{
+    if (!map_)
+        return 0;
+
+    long page = sysconf(_SC_PAGESIZE);
+    size_t pages = (size_ + page - 1) / page;
+    std::vector<unsigned char> vec(pages);
+    if (mincore(map_, size_, vec.data()) != 0)
+        return 0;
+
+    size_t resident = 0;
+    for (size_t i = 0; i < pages; i++)
+    {
+        if (vec[i] & 1)
+            resident += (i + 1 == pages) ? size_ - i * page : page;
+    }
+    return resident;
+}
+
+MappedFont *FontMaps::open(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = fonts_.find(path);
+    if (it != fonts_.end())
+        return it->second.get();
+
+    std::unique_ptr<MappedFont> font(new MappedFont);
+    if (!font->open(path))
+        return nullptr;
+
+    MappedFont *result = font.get();
+    fonts_.emplace(path, std::move(font));
+    return result;
+}
+
+void FontMaps::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    fonts_.clear();
+}
+
+FontMapStats FontMaps::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    FontMapStats stats;
+    std::unordered_set<uintptr_t> starts;
+    for (auto &font : fonts_)
+    {
+        stats.files++;
+        stats.mapped += font.second->size();
+        stats.resident += font.second->residentBytes();
+        starts.insert((uintptr_t)font.second->data());
+    }
+
+    // smaps는 mapping마다 "start-end perms ..." 줄 뒤에 "Name: <n> kB" 줄들이 온다
+    FILE *smaps = fopen("/proc/self/smaps", "re");
+    if (!smaps)
+        return stats;
+
+    char line[512];
+    bool font = false;
+    while (fgets(line, sizeof(line), smaps))
+    {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2 && strchr(line, '-') < strchr(line, ' '))
+        {
+            font = starts.count((uintptr_t)start) != 0;
+            continue;
+        }
+        if (!font)
+            continue;
+
+        char name[64];
+        unsigned long kb;
+        if (sscanf(line, "%63[^:]: %lu kB", name, &kb) != 2)
+            continue;
+        if (strcmp(name, "Shared_Clean") == 0 || strcmp(name, "Shared_Dirty") == 0)
+            stats.sharedBytes += kb * 1024;
+        else if (strcmp(name, "Private_Clean") == 0 || strcmp(name, "Private_Dirty") == 0)
+            stats.privateBytes += kb * 1024;
+        else if (strcmp(name, "Anonymous") == 0)
+            stats.anonymousBytes += kb * 1024;
+    }
+    fclose(smaps);
+    stats.measured = true;
+    return stats;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <hb.h>
+// for harfbuzz
+
+// font file을 read-only로 mmap 해서 FreeType, HarfBuzz, cairo가 같은 page를 읽게 한다.
+//
+// FT_Face는 FT_New_Memory_Face로, hb_face_t는 같은 mapping 위의 hb_blob_t로 만든다.
+// cairo는 FT_Face를 통해 읽는다. font data는 page cache에만 있으므로
+// 같은 font를 쓰는 process들이 물리 page를 공유하고, process마다 private copy가 생기지 않는다.
+
+class MappedFont
+{
+public:
+    MappedFont() = default;
+    ~MappedFont();
+    MappedFont(const MappedFont &) = delete;
+    MappedFont &operator=(const MappedFont &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    const uint8_t *data() const { return (const uint8_t *)map_; }
+    size_t size() const { return size_; }
+    const std::string &path() const { return path_; }
+
+    // mapping 위의 hb_face_t, face index마다 하나를 만들어 모든 thread가 공유한다 (immutable)
+    hb_face_t *face(unsigned int index);
+
+    // mapping 중 지금 memory에 올라와 있는 byte 수 (mincore)
+    size_t residentBytes() const;
+
+private:
+    void *map_ = nullptr;
+    size_t size_ = 0;
+    std::string path_;
+
+    hb_blob_t *blob_ = nullptr;
+    std::mutex mutex_;
+    std::unordered_map<unsigned int, hb_face_t *> faces_;
+};
+
+struct FontMapStats
+{
+    size_t files = 0;
+    size_t mapped = 0;   // mmap한 전체 크기 = 예전에 process마다 heap에 복사하던 크기
+    size_t resident = 0; // 그 중 memory에 올라와 있는 것 (mincore, page cache)
+
+    // /proc/self/smaps에서 font mapping만 더한 값. 읽지 못하면 measured가 false
+    bool measured = false;
+    size_t sharedBytes = 0;    // Shared_Clean + Shared_Dirty: 다른 process도 map하고 있는 page
+    size_t privateBytes = 0;   // Private_Clean + Private_Dirty: 지금은 이 process만 map한 page
+    size_t anonymousBytes = 0; // Anonymous: process마다 따로 생긴 copy, read-only mapping이면 0이어야 한다
+};
+
+// path → MappedFont. 같은 file은 process 안에서 한번만 map 한다. thread-safe
+class FontMaps
+{
+public:
+    // 실패하면 NULL. 반환된 pointer는 close() 전까지 유효하다
+    MappedFont *open(const std::string &path);
+    void close();
+
+    FontMapStats stats();
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<MappedFont>> fonts_;
+};
@@ -0,0 +1,420 @@
+#include "font_subset.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+// for freetype
+
+#include <hb.h>
+#ifdef ANZ_HAVE_SUBSET
+#include <hb-subset.h>
+#endif
+// for harfbuzz
+
+#include "bidi_itemizer.h"
+#include "font_map.h"
+#include "paragraph_reader.h"
+
+#ifdef ANZ_HAVE_SUBSET
+
+// face load 시간은 최소 이만큼, 이만큼 반복해서 평균낸다
+const double LOAD_MIN_SECONDS = .1;
+const int LOAD_MIN_REPEAT = 5;
+// 첫 shape에 쓰는 corpus 앞부분 (GSUB / GPOS accelerator가 처음 shape할 때 만들어진다)
+const unsigned int LOAD_SAMPLE_LENGTH = 64;
+
+namespace
+{
+    bool corpus_files(const std::string &corpus, std::vector<std::filesystem::path> &files)
+    {
+        // 읽을 수 없는 directory나 entry에서 filesystem_error를 던지지 않도록 error_code overload만 쓴다
+        std::error_code error;
+        if (std::filesystem::is_directory(corpus, error))
+        {
+            std::filesystem::directory_iterator it(corpus, error), end;
+            for (; !error && it != end; it.increment(error))
+            {
+                std::error_code entryError; // stat하지 못하는 entry는 건너뛴다
+                if (it->is_regular_file(entryError) && it->path().extension() == ".txt")
+                    files.push_back(it->path());
+            }
+            std::sort(files.begin(), files.end());
+        }
+        else
+        {
+            files.push_back(corpus);
+        }
+        return !error && !files.empty();
+    }
+
+    // corpus의 빈 줄이 아닌 paragraph마다 fn을 부른다. file을 열지 못하면 false
+    template <class F>
+    bool for_each_paragraph(const std::vector<std::filesystem::path> &files, F &&fn)
+    {
+        std::string paragraph;
+        for (const std::filesystem::path &file : files)
+        {
+            std::ifstream in(file, std::ios::binary);
+            if (!in)
+                return false;
+
+            ParagraphReader reader(in);
+            while (reader.next(paragraph))
+            {
+                if (!paragraph.empty())
+                    fn(paragraph);
+            }
+        }
+        return true;
+    }
+
+    // memory의 font data 하나로 만든 FT_Face와 hb_font, hello_text의 open_font() / create_hb_font()와 같은 설정
+    struct LoadedFont
+    {
+        FT_Face ft = NULL;
+        hb_face_t *face = NULL;
+        hb_font_t *font = NULL;
+
+        bool open(FT_Library library, const uint8_t *data, size_t size, int faceIndex, int fontSize)
+        {
+            if (FT_New_Memory_Face(library, data, size, faceIndex, &ft))
+            {
+                ft = NULL;
+                return false;
+            }
+            if (FT_Set_Char_Size(ft, 0, fontSize * 64, 0, 0))
+            {
+                close();
+                return false;
+            }
+
+            hb_blob_t *blob = hb_blob_create((const char *)data, size, HB_MEMORY_MODE_READONLY, NULL, NULL);
+            face = hb_face_create(blob, faceIndex);
+            hb_blob_destroy(blob);
+
+            font = hb_font_create(face);
+            hb_font_set_scale(font,
+                              ((uint64_t)ft->size->metrics.x_scale * ft->units_per_EM + (1u << 15)) >> 16,
+                              ((uint64_t)ft->size->metrics.y_scale * ft->units_per_EM + (1u << 15)) >> 16);
+            hb_font_set_ppem(font, ft->size->metrics.x_ppem, ft->size->metrics.y_ppem);
+            return true;
+        }
+
+        void close()
+        {
+            if (font)
+                hb_font_destroy(font);
+            if (face)
+                hb_face_destroy(face);
+            if (ft)
+                FT_Done_Face(ft);
+            font = NULL;
+            face = NULL;
+            ft = NULL;
+        }
+    };
+
+    void shape_item(hb_font_t *font, hb_buffer_t *buffer, const BidiItemizer &bidi, const BidiRun &run,
+                    unsigned int start, unsigned int length)
+    {
+        // ShapeCache::shape()와 같다: direction / script는 itemizer가 정하고 language만 추측한다
+        hb_buffer_clear_contents(buffer);
+        hb_buffer_add_utf32(buffer, bidi.text(), bidi.length(), start, length);
+        hb_buffer_set_direction(buffer, run.direction());
+        hb_buffer_set_script(buffer, run.script);
+        hb_buffer_guess_segment_properties(buffer);
+        hb_shape(font, buffer, NULL, 0);
+    }
+
+    bool has_glyph(hb_font_t *font, uint32_t codepoint)
+    {
+        hb_codepoint_t glyph;
+        return hb_font_get_nominal_glyph(font, codepoint, &glyph);
+    }
+
+    // bidi run을 font에 있는 글자 구간으로 나눠 fn(run, start, length)를 부른다. 없는 글자는 fallback font 몫이다
+    template <class F>
+    void for_each_item(hb_font_t *font, const BidiItemizer &bidi, F &&fn)
+    {
+        const uint32_t *text = bidi.text();
+        for (const BidiRun &run : bidi.runs())
+        {
+            unsigned int end = run.start + run.length;
+            unsigned int start = run.start;
+            for (unsigned int i = run.start; i <= end; i++)
+            {
+                if (i < end && has_glyph(font, text[i]))
+                    continue;
+                if (i > start)
+                    fn(run, start, i - start);
+                start = i + 1;
+            }
+        }
+    }
+
+    class Subsetter
+    {
+    public:
+        ~Subsetter()
+        {
+            original_.close();
+            subset_.close();
+            if (plan_)
+                hb_subset_plan_destroy(plan_);
+            if (subsetBlob_)
+                hb_blob_destroy(subsetBlob_);
+            if (buffer_)
+                hb_buffer_destroy(buffer_);
+            if (checkBuffer_)
+                hb_buffer_destroy(checkBuffer_);
+            hb_set_destroy(unicodes_);
+            hb_set_destroy(missing_);
+            hb_set_destroy(glyphs_);
+            if (library_)
+                FT_Done_FreeType(library_);
+        }
+
+        bool open(const std::string &path, int faceIndex, int fontSize)
+        {
+            faceIndex_ = faceIndex;
+            fontSize_ = fontSize;
+            if (!map_.open(path) || FT_Init_FreeType(&library_))
+                return false;
+            buffer_ = hb_buffer_create();
+            checkBuffer_ = hb_buffer_create();
+            return original_.open(library_, map_.data(), map_.size(), faceIndex, fontSize);
+        }
+
+        // paragraph 하나를 shape해서 쓰는 codepoint와 glyph를 모은다
+        void collect(const std::string &paragraph)
+        {
+            if (!bidi_.itemize(paragraph, FRIBIDI_PAR_LTR))
+                return;
+
+            const uint32_t *text = bidi_.text();
+            for (unsigned int i = 0; i < bidi_.length(); i++)
+                hb_set_add(has_glyph(original_.font, text[i]) ? unicodes_ : missing_, text[i]);
+
+            if (sample_.empty())
+                sample_.assign(text, text + std::min(bidi_.length(), LOAD_SAMPLE_LENGTH));
+
+            for_each_item(original_.font, bidi_, [this](const BidiRun &run, unsigned int start, unsigned int length) {
+                shape_item(original_.font, buffer_, bidi_, run, start, length);
+                unsigned int count;
+                const hb_glyph_info_t *info = hb_buffer_get_glyph_infos(buffer_, &count);
+                for (unsigned int i = 0; i < count; i++)
+                    hb_set_add(glyphs_, info[i].codepoint);
+            });
+        }
+
+        bool subset()
+        {
+            hb_subset_input_t *input = hb_subset_input_create_or_fail();
+            if (!input)
+                return false;
+
+            hb_set_union(hb_subset_input_unicode_set(input), unicodes_);
+            hb_set_union(hb_subset_input_glyph_set(input), glyphs_);
+
+            // 기본은 자주 쓰는 feature만 closure에 넣는다. 빈 set을 뒤집으면 모든 feature를 남긴다
+            hb_set_t *features = hb_subset_input_set(input, HB_SUBSET_SETS_LAYOUT_FEATURE_TAG);
+            hb_set_clear(features);
+            hb_set_invert(features);
+
+            hb_subset_input_set_flags(input, HB_SUBSET_FLAGS_NOTDEF_OUTLINE);
+
+            plan_ = hb_subset_plan_create_or_fail(original_.face, input);
+            hb_subset_input_destroy(input);
+            if (!plan_)
+                return false;
+
+            hb_face_t *result = hb_subset_plan_execute_or_fail(plan_);
+            if (!result)
+                return false;
+            subsetBlob_ = hb_face_reference_blob(result); // builder face는 여기서 font file로 직렬화된다
+            hb_face_destroy(result);
+
+            // 원본 face index는 subset에서 0이다
+            unsigned int size;
+            const char *data = hb_blob_get_data(subsetBlob_, &size);
+            return size && subset_.open(library_, (const uint8_t *)data, size, 0, fontSize_);
+        }
+
+        // paragraph를 원본과 subset으로 같이 shape해서 비교한다
+        void check(const std::string &paragraph, FontSubsetReport &report)
+        {
+            if (!bidi_.itemize(paragraph, FRIBIDI_PAR_LTR))
+                return;
+
+            const hb_map_t *oldToNew = hb_subset_plan_old_to_new_glyph_mapping(plan_);
+            for_each_item(original_.font, bidi_, [&](const BidiRun &run, unsigned int start, unsigned int length) {
+                shape_item(original_.font, buffer_, bidi_, run, start, length);
+                shape_item(subset_.font, checkBuffer_, bidi_, run, start, length);
+
+                unsigned int count;
+                unsigned int subsetCount;
+                const hb_glyph_info_t *info = hb_buffer_get_glyph_infos(buffer_, &count);
+                const hb_glyph_position_t *pos = hb_buffer_get_glyph_positions(buffer_, NULL);
+                const hb_glyph_info_t *subsetInfo = hb_buffer_get_glyph_infos(checkBuffer_, &subsetCount);
+                const hb_glyph_position_t *subsetPos = hb_buffer_get_glyph_positions(checkBuffer_, NULL);
+
+                bool same = count == subsetCount;
+                for (unsigned int i = 0; same && i < count; i++)
+                {
+                    same = hb_map_get(oldToNew, info[i].codepoint) == subsetInfo[i].codepoint &&
+                           info[i].cluster == subsetInfo[i].cluster &&
+                           pos[i].x_advance == subsetPos[i].x_advance && pos[i].y_advance == subsetPos[i].y_advance &&
+                           pos[i].x_offset == subsetPos[i].x_offset && pos[i].y_offset == subsetPos[i].y_offset;
+                }
+
+                report.checkedItems++;
+                if (!same)
+                    report.mismatches++;
+            });
+        }
+
+        bool write(const std::string &path)
+        {
+            unsigned int size;
+            const char *data = hb_blob_get_data(subsetBlob_, &size);
+
+            FILE *file = fopen(path.c_str(), "wb");
+            if (!file)
+                return false;
+            bool ok = fwrite(data, 1, size, file) == size;
+            return fclose(file) == 0 && ok;
+        }
+
+        // font data에서 FT_Face, hb_font를 만들고 sample을 한번 shape하기까지의 평균 시간
+        double loadSeconds(const uint8_t *data, size_t size, int faceIndex)
+        {
+            int repeat = 0;
+            std::chrono::duration<double> elapsed(0);
+            auto start = std::chrono::steady_clock::now();
+            while (repeat < LOAD_MIN_REPEAT || elapsed.count() < LOAD_MIN_SECONDS)
+            {
+                LoadedFont font;
+                if (!font.open(library_, data, size, faceIndex, fontSize_))
+                    return 0;
+
+                hb_buffer_clear_contents(buffer_);
+                hb_buffer_add_utf32(buffer_, sample_.data(), sample_.size(), 0, sample_.size());
+                hb_buffer_guess_segment_properties(buffer_);
+                hb_shape(font.font, buffer_, NULL, 0);
+                font.close();
+
+                repeat++;
+                elapsed = std::chrono::steady_clock::now() - start;
+            }
+            return elapsed.count() / repeat;
+        }
+
+        void fill(FontSubsetReport &report)
+        {
+            report.codepoints = hb_set_get_population(unicodes_) + hb_set_get_population(missing_);
+            report.missingCodepoints = hb_set_get_population(missing_);
+            report.shapedGlyphs = hb_set_get_population(glyphs_);
+            report.glyphsBefore = hb_face_get_glyph_count(original_.face);
+            report.glyphsAfter = hb_face_get_glyph_count(subset_.face);
+            report.bytesBefore = map_.size();
+            report.bytesAfter = hb_blob_get_length(subsetBlob_);
+
+            report.loadSecondsBefore = loadSeconds(map_.data(), map_.size(), faceIndex_);
+            report.loadSecondsAfter =
+                loadSeconds((const uint8_t *)hb_blob_get_data(subsetBlob_, NULL), report.bytesAfter, 0);
+        }
+
+    private:
+        MappedFont map_;
+        int faceIndex_ = 0;
+        int fontSize_ = 0;
+
+        FT_Library library_ = NULL;
+        LoadedFont original_;
+        LoadedFont subset_;
+        hb_buffer_t *buffer_ = NULL;
+        hb_buffer_t *checkBuffer_ = NULL;
+        BidiItemizer bidi_;
+
+        hb_set_t *unicodes_ = hb_set_create();
+        hb_set_t *missing_ = hb_set_create();
+        hb_set_t *glyphs_ = hb_set_create();
+        std::vector<uint32_t> sample_;
+
+        hb_subset_plan_t *plan_ = NULL; // old → new glyph map을 갖고 있다
+        hb_blob_t *subsetBlob_ = NULL;
+    };
+}
+
+bool subset_font(const std::string &fontFile, int faceIndex, const std::string &corpus, const std::string &output,
+                 int fontSize, FontSubsetReport &report)
+{
+    auto start = std::chrono::steady_clock::now();
+    report = FontSubsetReport();
+
+    std::vector<std::filesystem::path> files;
+    if (!corpus_files(corpus, files))
+    {
+        report.error = FontSubsetError::Corpus;
+        return false;
+    }
+
+    Subsetter subsetter;
+    if (!subsetter.open(fontFile, faceIndex, fontSize))
+    {
+        report.error = FontSubsetError::Font;
+        return false;
+    }
+
+    // 한번 읽어 모으고, subset을 만든 뒤 다시 읽어 확인한다 (corpus를 memory에 들고 있지 않는다)
+    bool read = for_each_paragraph(files, [&](const std::string &paragraph) {
+        subsetter.collect(paragraph);
+        report.paragraphs++;
+    });
+    if (!read || !report.paragraphs)
+    {
+        report.error = FontSubsetError::Corpus;
+        return false;
+    }
+
+    if (!subsetter.subset())
+    {
+        report.error = FontSubsetError::Subset;
+        return false;
+    }
+
+    if (!for_each_paragraph(files, [&](const std::string &paragraph) { subsetter.check(paragraph, report); }))
+    {
+        report.error = FontSubsetError::Corpus;
+        return false;
+    }
+
+    if (!subsetter.write(output))
+    {
+        report.error = FontSubsetError::Write;
+        return false;
+    }
+
+    subsetter.fill(report);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    report.seconds = elapsed.count();
+    return true;
+}
+
+#else
+
+bool subset_font(const std::string &, int, const std::string &, const std::string &, int, FontSubsetReport &report)
+{
+    report = FontSubsetReport();
+    report.error = FontSubsetError::Unavailable;
+    return false;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// text corpus로 font를 subset한다 (hb-subset).
+//
+// corpus를 paragraph 단위로 읽어 hello_text와 같은 설정으로 shape한다: BidiItemizer run마다
+// direction / script를 주고, run을 이 font에 있는 글자 구간으로 나눈다 (없는 글자는 fallback font로 가므로 뺀다).
+// 나온 codepoint와 glyph를 hb-subset에 넘긴다. GSUB closure는 HarfBuzz가 계산하는데, 모든 layout feature를
+// 남기므로 기본으로 켜지지 않는 alternate (salt, ssXX 등)도 들어간다. variable font의 fvar / gvar / HVAR 등은
+// instance로 고정하지 않고 그대로 둔다. .notdef outline (tofu)은 원본과 같게 남긴다.
+//
+// 그 다음 corpus를 다시 읽어 원본과 subset으로 같이 shape하고, glyph (subset glyph id를 원본 번호로 바꿔서),
+// cluster, advance, offset이 모두 같은지 확인한다. 크기와 face load 시간도 잰다.
+
+enum class FontSubsetError
+{
+    None,
+    Font,   // font file을 열지 못함
+    Corpus, // corpus를 읽지 못했거나 비었음
+    Subset, // hb-subset 실패
+    Write,      // 출력 file을 쓰지 못함
+    Unavailable // hb-subset 없이 빌드함 (make SUBSET=1이면 ANZ_HAVE_SUBSET)
+};
+
+struct FontSubsetReport
+{
+    FontSubsetError error = FontSubsetError::None;
+
+    size_t paragraphs = 0;
+    size_t codepoints = 0;        // corpus의 서로 다른 codepoint
+    size_t missingCodepoints = 0; // 그 중 font에 없는 것 (fallback font로 그린다)
+    size_t shapedGlyphs = 0;      // corpus shaping이 실제로 낸 서로 다른 glyph
+    unsigned int glyphsBefore = 0;
+    unsigned int glyphsAfter = 0; // GSUB closure와 .notdef 포함
+    size_t bytesBefore = 0;
+    size_t bytesAfter = 0;
+
+    // FT_Face와 hb_font를 만들고 첫 shape까지 (memory에 있는 font data에서), 여러번 평균
+    double loadSecondsBefore = 0;
+    double loadSecondsAfter = 0;
+
+    size_t checkedItems = 0; // 원본과 subset으로 같이 shape해서 비교한 item 수
+    size_t mismatches = 0;   // 그 중 결과가 다른 item, 0이어야 한다
+    double seconds = 0;      // 전체 걸린 시간
+};
+
+// corpus는 text file 하나 또는 *.txt가 있는 directory. fontSize (pixel)는 shaping scale / ppem이다.
+// 실패하면 false이고 report.error가 이유다. 확인에서 다른 결과가 나와도 file은 쓰고 true를 돌려준다 (mismatches를 본다)
+bool subset_font(const std::string &fontFile, int faceIndex, const std::string &corpus, const std::string &output,
+                 int fontSize, FontSubsetReport &report);
@@ -0,0 +1,209 @@
+#include "glyph_cache.h"
+#include "composite.h"
+
+#include <cmath>
+#include <cstring>
+
+#include FT_MULTIPLE_MASTERS_H
+#include FT_OUTLINE_H
+
+GlyphCache::GlyphCache(size_t atlasBytes, size_t maxEntries)
+    : atlasBytes_(atlasBytes), maxEntries_(maxEntries)
+{
+}
+
+size_t GlyphCache::KeyHash::operator()(const Key &k) const
+{
+    uint64_t h = (uint64_t)(uintptr_t)k.face;
+    h = h * 0x9E3779B97F4A7C15ull ^ k.glyph;
+    h = h * 0x9E3779B97F4A7C15ull ^ (uint64_t)k.xScale;
+    h = h * 0x9E3779B97F4A7C15ull ^ (uint64_t)k.yScale;
+    h = h * 0x9E3779B97F4A7C15ull ^ k.instance;
+    h = h * 0x9E3779B97F4A7C15ull ^ k.subpixel;
+    return (size_t)(h ^ (h >> 29));
+}
+
+uint32_t GlyphCache::instanceOf(FT_Face face)
+{
+    if (!FT_HAS_MULTIPLE_MASTERS(face))
+        return 0;
+
+    FT_Fixed coords[16];
+    FT_UInt count = 16;
+    FT_MM_Var *mm_var;
+    if (FT_Get_MM_Var(face, &mm_var) == 0)
+    {
+        if (mm_var->num_axis < count)
+            count = mm_var->num_axis;
+        FT_Done_MM_Var(face->glyph->library, mm_var);
+    }
+
+    if (FT_Get_Var_Blend_Coordinates(face, count, coords))
+        return 0;
+
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (FT_UInt i = 0; i < count; i++)
+    {
+        uint32_t v = (uint32_t)coords[i];
+        for (int b = 0; b < 4; b++)
+        {
+            h ^= (v >> (b * 8)) & 0xff;
+            h *= 16777619u;
+        }
+    }
+    return h ? h : 1;
+}
+
+bool GlyphCache::rasterize(FT_Face face, hb_codepoint_t glyph, int subpixel)
+{
+    if (FT_Load_Glyph(face, glyph, FT_LOAD_DEFAULT | FT_LOAD_NO_BITMAP))
+        return false;
+
+    FT_GlyphSlot slot = face->glyph;
+    if (slot->format == FT_GLYPH_FORMAT_OUTLINE)
+    {
+        // hinting 후에 x 방향으로 subpixel 만큼 옮긴다 (26.6)
+        FT_Outline_Translate(&slot->outline, subpixel * 64 / GLYPH_SUBPIXEL_STEPS, 0);
+    }
+
+    if (FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL))
+        return false;
+
+    const FT_Bitmap &bitmap = slot->bitmap;
+    scratchWidth_ = bitmap.width;
+    scratchHeight_ = bitmap.rows;
+    scratchLeft_ = slot->bitmap_left;
+    scratchTop_ = slot->bitmap_top;
+    scratch_.resize((size_t)scratchWidth_ * scratchHeight_);
+
+    for (int row = 0; row < scratchHeight_; row++)
+    {
+        const unsigned char *src = bitmap.buffer + (ptrdiff_t)row * bitmap.pitch;
+        uint8_t *dst = scratch_.data() + (size_t)row * scratchWidth_;
+
+        if (bitmap.pixel_mode == FT_PIXEL_MODE_GRAY)
+        {
+            memcpy(dst, src, scratchWidth_);
+        }
+        else if (bitmap.pixel_mode == FT_PIXEL_MODE_MONO)
+        {
+            for (int col = 0; col < scratchWidth_; col++)
+                dst[col] = (src[col >> 3] & (0x80 >> (col & 7))) ? 255 : 0;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GlyphCache::flush()
+{
+    stats_.flushes++;
+    stats_.evicted += entries_.size();
+    entries_.clear();
+    used_ = 0;
+}
+
+void GlyphCache::clear()
+{
+    entries_.clear();
+    used_ = 0;
+}
+
+bool GlyphCache::lookup(FT_Face face, uint32_t instance, hb_codepoint_t glyph, int subpixel, GlyphMask &mask)
+{
+    Key key = {face, glyph, face->size->metrics.x_scale, face->size->metrics.y_scale,
+               instance, (uint32_t)subpixel};
+
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+    {
+        stats_.hits++;
+        const Entry &entry = it->second;
+        mask = {atlas_.data() + entry.offset, entry.width, entry.height, entry.left, entry.top};
+        return true;
+    }
+
+    stats_.misses++;
+    if (!rasterize(face, glyph, subpixel))
+    {
+        stats_.failed++;
+        return false;
+    }
+
+    size_t bytes = scratch_.size();
+    if (bytes > atlasBytes_ || scratchWidth_ > 0xffff || scratchHeight_ > 0xffff)
+    {
+        // 너무 큰 glyph는 cache하지 않고 이번에만 쓴다
+        stats_.oversize++;
+        mask = {scratch_.data(), scratchWidth_, scratchHeight_, scratchLeft_, scratchTop_};
+        return true;
+    }
+
+    if (used_ + bytes > atlasBytes_ || entries_.size() >= maxEntries_)
+        flush();
+
+    if (atlas_.size() != atlasBytes_)
+        atlas_.resize(atlasBytes_);
+
+    Entry entry = {(uint32_t)used_, (uint16_t)scratchWidth_, (uint16_t)scratchHeight_,
+                   (int16_t)scratchLeft_, (int16_t)scratchTop_};
+    if (bytes)
+        memcpy(atlas_.data() + used_, scratch_.data(), bytes);
+    used_ += bytes;
+
+    entries_.emplace(key, entry);
+    mask = {atlas_.data() + entry.offset, entry.width, entry.height, entry.left, entry.top};
+    return true;
+}
+
+void GlyphCache::drawGlyphs(cairo_surface_t *surface, FT_Face face, uint32_t instance, double originX, double originY,
+                            const hb_glyph_info_t *info, const hb_glyph_position_t *pos, unsigned int len,
+                            uint32_t color, int surfaceTop)
+{
+    cairo_surface_flush(surface);
+
+    uint8_t *data = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    int width = cairo_image_surface_get_width(surface);
+    int height = cairo_image_surface_get_height(surface);
+    bool coverage = cairo_image_surface_get_format(surface) == CAIRO_FORMAT_A8;
+
+    double current_x = 0;
+    double current_y = 0;
+    for (unsigned int i = 0; i < len; i++)
+    {
+        // my_cairo()의 cairo_glyphs 좌표와 같은 계산, x만 subpixel로 양자화한다
+        double x = originX + current_x + pos[i].x_offset / 64.;
+        double y = originY - (current_y + pos[i].y_offset / 64.);
+        current_x += pos[i].x_advance / 64.;
+        current_y += pos[i].y_advance / 64.;
+
+        double floor_x = floor(x);
+        int ix = (int)floor_x;
+        int subpixel = (int)lround((x - floor_x) * GLYPH_SUBPIXEL_STEPS);
+        if (subpixel == GLYPH_SUBPIXEL_STEPS)
+        {
+            ix++;
+            subpixel = 0;
+        }
+        int iy = (int)lround(y) - surfaceTop;
+
+        GlyphMask mask;
+        if (!lookup(face, instance, info[i].codepoint, subpixel, mask))
+            continue;
+
+        if (coverage)
+            composite_mask_a8(data, stride, width, height, mask.data, mask.width, mask.width, mask.height,
+                              ix + mask.left, iy - mask.top);
+        else
+            composite_mask(data, stride, width, height, mask.data, mask.width, mask.width, mask.height,
+                           ix + mask.left, iy - mask.top, color);
+    }
+
+    cairo_surface_mark_dirty(surface);
+}
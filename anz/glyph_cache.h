@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+// for freetype
+
+#include <hb.h>
+// for harfbuzz
+
+#include <cairo.h>
+// for cairo
+
+// FreeType으로 rasterize한 glyph coverage mask(A8) cache.
+//
+// key: (FT_Face, glyph id, pixel size, variation instance, x subpixel 위치)
+// mask는 하나의 연속된 atlas에 bump allocator로 쌓는다. atlas나 entry 수가 한도를 넘으면
+// 전부 버리고 처음부터 다시 채운다 (bump allocator라서 개별 해제가 없다).
+// cairo_show_glyphs() 대신 drawGlyphs()로 ARGB32 surface에 직접 합성한다 (composite.h).
+
+const int GLYPH_SUBPIXEL_STEPS = 4; // x 위치를 1/4 pixel 단위로 양자화
+
+struct GlyphCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t flushes = 0;  // atlas를 비운 횟수
+    uint64_t evicted = 0;  // flush로 버려진 entry 수
+    uint64_t oversize = 0; // atlas보다 커서 cache하지 못한 glyph
+    uint64_t failed = 0;   // load/render 실패 또는 지원하지 않는 bitmap 형식
+
+    double hitRate() const { return hits + misses ? (double)hits / (hits + misses) : 0.; }
+
+    GlyphCacheStats &operator+=(const GlyphCacheStats &o)
+    {
+        hits += o.hits;
+        misses += o.misses;
+        flushes += o.flushes;
+        evicted += o.evicted;
+        oversize += o.oversize;
+        failed += o.failed;
+        return *this;
+    }
+};
+
+struct GlyphMask
+{
+    const uint8_t *data; // width x height, stride == width
+    int width;
+    int height;
+    int left; // pen 위치 기준 bitmap 왼쪽
+    int top;  // baseline 기준 bitmap 위쪽 (위가 +)
+};
+
+class GlyphCache
+{
+public:
+    explicit GlyphCache(size_t atlasBytes = 4 << 20, size_t maxEntries = 65536);
+
+    // face의 현재 variation 좌표로 instance id를 만든다. variable font가 아니면 0.
+    // FT_Get_MM_Var가 할당을 하므로 face를 열 때 (variation을 바꾸면 그때) 한번 구해 둔다
+    static uint32_t instanceOf(FT_Face face);
+
+    // face의 현재 size로 glyph를 찾고, 없으면 rasterize해서 atlas에 넣는다.
+    // 반환된 mask는 다음 lookup() 전까지만 유효하다 (flush될 수 있으므로).
+    bool lookup(FT_Face face, uint32_t instance, hb_codepoint_t glyph, int subpixel, GlyphMask &mask);
+
+    // shaping 결과를 (originX, originY)를 baseline 시작점으로 surface에 그린다. instance는 instanceOf(face).
+    // color는 premultiplied ARGB32, surface는 CAIRO_FORMAT_ARGB32 이어야 한다. A8 surface면 color 없이 coverage만 합성한다.
+    // surface가 image의 surfaceTop 줄부터 시작하는 slice(band)이면 좌표는 image 기준으로 넘긴다
+    void drawGlyphs(cairo_surface_t *surface, FT_Face face, uint32_t instance, double originX, double originY,
+                    const hb_glyph_info_t *info, const hb_glyph_position_t *pos, unsigned int len,
+                    uint32_t color, int surfaceTop = 0);
+
+    void clear();
+
+    size_t atlasUsed() const { return used_; }
+    size_t atlasCapacity() const { return atlasBytes_; }
+    size_t size() const { return entries_.size(); }
+    const GlyphCacheStats &stats() const { return stats_; }
+
+private:
+    struct Key
+    {
+        FT_Face face;
+        uint32_t glyph;
+        FT_Fixed xScale; // FT_Size_Metrics, 16.16
+        FT_Fixed yScale;
+        uint32_t instance;
+        uint32_t subpixel;
+
+        bool operator==(const Key &o) const
+        {
+            return face == o.face && glyph == o.glyph && xScale == o.xScale && yScale == o.yScale &&
+                   instance == o.instance && subpixel == o.subpixel;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &k) const;
+    };
+
+    struct Entry
+    {
+        uint32_t offset; // atlas 안의 위치
+        uint16_t width;
+        uint16_t height;
+        int16_t left;
+        int16_t top;
+    };
+
+    bool rasterize(FT_Face face, hb_codepoint_t glyph, int subpixel);
+    void flush();
+
+    size_t atlasBytes_;
+    size_t maxEntries_;
+    std::vector<uint8_t> atlas_;
+    size_t used_ = 0;
+    std::unordered_map<Key, Entry, KeyHash> entries_;
+
+    // atlas에 넣지 못한 glyph용
+    std::vector<uint8_t> scratch_;
+    int scratchWidth_ = 0;
+    int scratchHeight_ = 0;
+    int scratchLeft_ = 0;
+    int scratchTop_ = 0;
+
+    GlyphCacheStats stats_;
+};
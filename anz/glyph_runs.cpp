@@ -0,0 +1,529 @@
+#include "glyph_runs.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(GlyphRunHeader) == 136 && sizeof(GlyphRunLine) == 32 && sizeof(GlyphRunRecord) == 24 &&
+                  sizeof(GlyphRunFont) == 8,
+              "glyph run records must not have padding");
+
+namespace
+{
+    const size_t JSON_FLUSH_SIZE = 64 * 1024;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    const bool HOST_LITTLE_ENDIAN = false;
+#else
+    const bool HOST_LITTLE_ENDIAN = true;
+#endif
+
+    // 파일의 field는 little endian으로 쓴다
+    class LittleEndian
+    {
+    public:
+        void u32(uint32_t v)
+        {
+            for (int i = 0; i < 4; i++)
+                bytes_.push_back((v >> (8 * i)) & 0xff);
+        }
+        void u64(uint64_t v)
+        {
+            for (int i = 0; i < 8; i++)
+                bytes_.push_back((v >> (8 * i)) & 0xff);
+        }
+        void raw(const void *data, size_t size) { bytes_.append((const char *)data, size); }
+
+        const std::string &bytes() const { return bytes_; }
+        void clear() { bytes_.clear(); }
+
+    private:
+        std::string bytes_;
+    };
+
+    void encode(LittleEndian &out, const GlyphRunHeader &h)
+    {
+        out.raw(h.magic, sizeof(h.magic));
+        out.u32(h.version);
+        out.u32(h.byteOrder);
+        out.u32(h.headerSize);
+        out.u32(h.lineCount);
+        out.u32(h.runCount);
+        out.u32(h.fontCount);
+        out.u64(h.glyphCount);
+        out.u64(h.stringSize);
+        out.u64(h.fileSize);
+        for (uint64_t offset : h.offsets)
+            out.u64(offset);
+    }
+
+    void encode(LittleEndian &out, const GlyphRunLine &line)
+    {
+        out.u32(line.job);
+        out.u32(line.fontSize);
+        out.u32(line.direction);
+        out.u32(line.firstRun);
+        out.u32(line.runCount);
+        out.u32(line.reserved);
+        out.u64(line.firstGlyph);
+    }
+
+    void encode(LittleEndian &out, const GlyphRunRecord &run)
+    {
+        out.u64(run.firstGlyph);
+        out.u32(run.glyphCount);
+        out.u32(run.font);
+        out.u32(run.direction);
+        out.u32(run.script);
+    }
+
+    void encode(LittleEndian &out, const GlyphRunFont &font)
+    {
+        out.u32(font.file);
+        out.u32(font.faceIndex);
+    }
+
+    void encode(LittleEndian &out, uint32_t v)
+    {
+        out.u32(v);
+    }
+
+    void encode(LittleEndian &out, int32_t v)
+    {
+        out.u32((uint32_t)v);
+    }
+
+    uint64_t align8(uint64_t offset)
+    {
+        return (offset + 7) & ~(uint64_t)7;
+    }
+
+    const char *direction_name(hb_direction_t direction)
+    {
+        switch (direction)
+        {
+        case HB_DIRECTION_LTR:
+            return "ltr";
+        case HB_DIRECTION_RTL:
+            return "rtl";
+        case HB_DIRECTION_TTB:
+            return "ttb";
+        case HB_DIRECTION_BTT:
+            return "btt";
+        default:
+            return "invalid";
+        }
+    }
+
+    bool write_padded(FILE *fp, const void *data, size_t size, uint64_t &offset)
+    {
+        static const char zero[8] = {0};
+        if (size && fwrite(data, 1, size, fp) != size)
+            return false;
+        offset += size;
+
+        size_t pad = align8(offset) - offset;
+        if (pad && fwrite(zero, 1, pad, fp) != pad)
+            return false;
+        offset += pad;
+        return true;
+    }
+
+    // 배열 하나를 little endian으로 쓴다. 조각으로 나눠서 encode하므로 큰 배열도 한번에 복사하지 않는다
+    template <class T>
+    bool write_section(FILE *fp, const std::vector<T> &values, LittleEndian &scratch, uint64_t &offset)
+    {
+        const size_t CHUNK = 4096;
+        for (size_t begin = 0; begin < values.size(); begin += CHUNK)
+        {
+            scratch.clear();
+            for (size_t i = begin; i < std::min(begin + CHUNK, values.size()); i++)
+                encode(scratch, values[i]);
+            if (fwrite(scratch.bytes().data(), 1, scratch.bytes().size(), fp) != scratch.bytes().size())
+                return false;
+            offset += scratch.bytes().size();
+        }
+        return write_padded(fp, NULL, 0, offset);
+    }
+}
+
+// GlyphRunWriter
+
+uint32_t GlyphRunWriter::addFont(const std::string &file, int faceIndex)
+{
+    std::string key = file + '\0' + std::to_string(faceIndex);
+    auto it = fontIds_.find(key);
+    if (it != fontIds_.end())
+        return it->second;
+
+    uint32_t id = fonts_.size();
+    fonts_.push_back({(uint32_t)strings_.size(), (uint32_t)faceIndex});
+    strings_.append(file);
+    strings_.push_back('\0');
+    fontIds_.emplace(key, id);
+    return id;
+}
+
+void GlyphRunWriter::addLine(uint32_t job, int fontSize, hb_direction_t direction,
+                             const GlyphRunInput *runs, size_t count)
+{
+    GlyphRunLine line = {};
+    line.job = job;
+    line.fontSize = fontSize;
+    line.direction = direction;
+    line.firstRun = runs_.size();
+    line.runCount = count;
+    line.firstGlyph = glyphIds_.size();
+    lines_.push_back(line);
+
+    for (size_t r = 0; r < count; r++)
+    {
+        const GlyphRunInput &run = runs[r];
+        runs_.push_back({glyphIds_.size(), run.count, run.font, (uint32_t)run.direction, (uint32_t)run.script});
+
+        for (unsigned int i = 0; i < run.count; i++)
+        {
+            glyphIds_.push_back(run.infos[i].codepoint);
+            clusters_.push_back(run.infos[i].cluster);
+            xAdvances_.push_back(run.positions[i].x_advance);
+            yAdvances_.push_back(run.positions[i].y_advance);
+            xOffsets_.push_back(run.positions[i].x_offset);
+            yOffsets_.push_back(run.positions[i].y_offset);
+        }
+    }
+}
+
+bool GlyphRunWriter::write(const char *path) const
+{
+    const size_t sizes[GLYPH_RUN_SECTION_COUNT] = {
+        lines_.size() * sizeof(GlyphRunLine),
+        runs_.size() * sizeof(GlyphRunRecord),
+        fonts_.size() * sizeof(GlyphRunFont),
+        strings_.size(),
+        glyphIds_.size() * sizeof(uint32_t),
+        clusters_.size() * sizeof(uint32_t),
+        xAdvances_.size() * sizeof(int32_t),
+        yAdvances_.size() * sizeof(int32_t),
+        xOffsets_.size() * sizeof(int32_t),
+        yOffsets_.size() * sizeof(int32_t),
+    };
+
+    GlyphRunHeader header = {};
+    memcpy(header.magic, "ANZGLYPH", 8);
+    header.version = GLYPH_RUN_VERSION;
+    header.byteOrder = GLYPH_RUN_BYTE_ORDER;
+    header.headerSize = sizeof(GlyphRunHeader);
+    header.lineCount = lines_.size();
+    header.runCount = runs_.size();
+    header.fontCount = fonts_.size();
+    header.glyphCount = glyphIds_.size();
+    header.stringSize = strings_.size();
+
+    uint64_t offset = align8(sizeof(GlyphRunHeader));
+    for (int s = 0; s < GLYPH_RUN_SECTION_COUNT; s++)
+    {
+        header.offsets[s] = offset;
+        offset = align8(offset + sizes[s]);
+    }
+    header.fileSize = offset;
+
+    bool toStdout = strcmp(path, "-") == 0;
+    FILE *fp = toStdout ? stdout : fopen(path, "wb");
+    if (!fp)
+        return false;
+
+    // section 순서는 GlyphRunSection 순서
+    LittleEndian scratch;
+    encode(scratch, header);
+    offset = 0;
+    bool ok = write_padded(fp, scratch.bytes().data(), scratch.bytes().size(), offset) &&
+              write_section(fp, lines_, scratch, offset) && write_section(fp, runs_, scratch, offset) &&
+              write_section(fp, fonts_, scratch, offset) &&
+              write_padded(fp, strings_.data(), strings_.size(), offset) &&
+              write_section(fp, glyphIds_, scratch, offset) && write_section(fp, clusters_, scratch, offset) &&
+              write_section(fp, xAdvances_, scratch, offset) && write_section(fp, yAdvances_, scratch, offset) &&
+              write_section(fp, xOffsets_, scratch, offset) && write_section(fp, yOffsets_, scratch, offset);
+
+    if (toStdout)
+        ok = fflush(fp) == 0 && ok;
+    else
+        ok = fclose(fp) == 0 && ok;
+    return ok;
+}
+
+// GlyphRunFile
+
+GlyphRunFile::~GlyphRunFile()
+{
+    close();
+}
+
+bool GlyphRunFile::open(const std::string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GlyphRunHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    map_ = map;
+    size_ = st.st_size;
+    header_ = (const GlyphRunHeader *)map;
+
+    // 파일은 little endian이고 accessor는 mmap을 그대로 돌려주므로 big endian 기계에서는 열지 않는다
+    const GlyphRunHeader &h = *header_;
+    bool valid = HOST_LITTLE_ENDIAN && memcmp(h.magic, "ANZGLYPH", 8) == 0 && h.version == GLYPH_RUN_VERSION &&
+                 h.byteOrder == GLYPH_RUN_BYTE_ORDER && h.headerSize >= sizeof(GlyphRunHeader) &&
+                 h.fileSize <= size_ && h.glyphCount <= h.fileSize;
+
+    // section이 파일 안에 있고 정렬되어 있는지
+    const uint64_t sizes[GLYPH_RUN_SECTION_COUNT] = {
+        (uint64_t)h.lineCount * sizeof(GlyphRunLine),
+        (uint64_t)h.runCount * sizeof(GlyphRunRecord),
+        (uint64_t)h.fontCount * sizeof(GlyphRunFont),
+        h.stringSize,
+        h.glyphCount * sizeof(uint32_t),
+        h.glyphCount * sizeof(uint32_t),
+        h.glyphCount * sizeof(int32_t),
+        h.glyphCount * sizeof(int32_t),
+        h.glyphCount * sizeof(int32_t),
+        h.glyphCount * sizeof(int32_t),
+    };
+    for (int s = 0; s < GLYPH_RUN_SECTION_COUNT && valid; s++)
+        valid = h.offsets[s] % 8 == 0 && h.offsets[s] <= h.fileSize && sizes[s] <= h.fileSize - h.offsets[s];
+
+    // string pool은 NUL로 끝나야 fontFile()이 pool 밖을 읽지 않는다
+    if (valid && h.stringSize)
+        valid = ((const char *)map_)[h.offsets[GLYPH_RUN_STRINGS] + h.stringSize - 1] == '\0';
+    for (uint32_t i = 0; i < h.fontCount && valid; i++)
+        valid = fonts()[i].file < h.stringSize;
+
+    // line → run → glyph / font index가 범위 안인지. 한번 확인해 두면 읽는 쪽은 index를 그대로 쓴다
+    for (uint32_t i = 0; i < h.lineCount && valid; i++)
+    {
+        const GlyphRunLine &line = lines()[i];
+        valid = line.firstRun <= h.runCount && line.runCount <= h.runCount - line.firstRun &&
+                line.firstGlyph <= h.glyphCount;
+    }
+    for (uint32_t i = 0; i < h.runCount && valid; i++)
+    {
+        const GlyphRunRecord &run = runs()[i];
+        valid = run.firstGlyph <= h.glyphCount && run.glyphCount <= h.glyphCount - run.firstGlyph &&
+                run.font < h.fontCount;
+    }
+
+    if (!valid)
+        close();
+    return valid;
+}
+
+void GlyphRunFile::close()
+{
+    if (map_)
+        munmap(map_, size_);
+    map_ = nullptr;
+    size_ = 0;
+    header_ = nullptr;
+}
+
+// GlyphNameCache
+
+const char *GlyphNameCache::name(hb_font_t *font, hb_codepoint_t glyph)
+{
+    Key key = {font, glyph};
+    auto it = names_.find(key);
+    if (it != names_.end())
+        return it->second.c_str();
+
+    char name[64];
+    if (!hb_font_get_glyph_name(font, glyph, name, sizeof(name)))
+        snprintf(name, sizeof(name), "gid%u", glyph);
+    return names_.emplace(key, name).first->second.c_str();
+}
+
+// GlyphRunJsonWriter
+
+bool GlyphRunJsonWriter::open(const char *path, bool names)
+{
+    close();
+
+    toStdout_ = strcmp(path, "-") == 0;
+    fp_ = toStdout_ ? stdout : fopen(path, "w");
+    withNames_ = names;
+    ok_ = fp_ != nullptr;
+    return ok_;
+}
+
+bool GlyphRunJsonWriter::close()
+{
+    if (!fp_)
+        return ok_;
+
+    flush();
+    if (toStdout_)
+        ok_ = fflush(fp_) == 0 && ok_;
+    else
+        ok_ = fclose(fp_) == 0 && ok_;
+    fp_ = nullptr;
+    fontIds_.clear();
+    nameCache_.clear();
+    return ok_;
+}
+
+void GlyphRunJsonWriter::flush()
+{
+    if (!buffer_.empty() && fp_)
+        ok_ = fwrite(buffer_.data(), 1, buffer_.size(), fp_) == buffer_.size() && ok_;
+    buffer_.clear();
+}
+
+void GlyphRunJsonWriter::flushIfFull()
+{
+    if (buffer_.size() >= JSON_FLUSH_SIZE)
+        flush();
+}
+
+void GlyphRunJsonWriter::appendString(const char *s)
+{
+    buffer_.push_back('"');
+    for (; *s; s++)
+    {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+        {
+            buffer_.push_back('\\');
+            buffer_.push_back(c);
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            buffer_.append(escaped);
+        }
+        else
+        {
+            buffer_.push_back(c);
+        }
+    }
+    buffer_.push_back('"');
+}
+
+void GlyphRunJsonWriter::appendInt(int64_t v)
+{
+    // printf 계열보다 훨씬 싸다 (glyph 하나에 숫자 6개)
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *p = end;
+    uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+    do
+    {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    if (v < 0)
+        *--p = '-';
+    buffer_.append(p, end - p);
+}
+
+template <class F>
+void GlyphRunJsonWriter::appendArray(const char *key, const GlyphRunInput &run, F &&value)
+{
+    buffer_.append(",\"");
+    buffer_.append(key);
+    buffer_.append("\":[");
+    for (unsigned int i = 0; i < run.count; i++)
+    {
+        if (i)
+            buffer_.push_back(',');
+        appendInt(value(i));
+    }
+    buffer_.push_back(']');
+}
+
+uint32_t GlyphRunJsonWriter::addFont(const std::string &file, int faceIndex)
+{
+    std::string key = file + '\0' + std::to_string(faceIndex);
+    auto it = fontIds_.find(key);
+    if (it != fontIds_.end())
+        return it->second;
+
+    uint32_t id = fontIds_.size();
+    fontIds_.emplace(key, id);
+
+    buffer_.append("{\"type\":\"font\",\"id\":");
+    appendInt(id);
+    buffer_.append(",\"file\":");
+    appendString(file.c_str());
+    buffer_.append(",\"face\":");
+    appendInt(faceIndex);
+    buffer_.append("}\n");
+    flushIfFull();
+    return id;
+}
+
+void GlyphRunJsonWriter::addLine(uint32_t job, int fontSize, hb_direction_t direction,
+                                 const GlyphRunInput *runs, size_t count)
+{
+    buffer_.append("{\"type\":\"line\",\"job\":");
+    appendInt(job);
+    buffer_.append(",\"size\":");
+    appendInt(fontSize);
+    buffer_.append(",\"direction\":\"");
+    buffer_.append(direction_name(direction));
+    buffer_.append("\",\"runs\":[");
+
+    for (size_t r = 0; r < count; r++)
+    {
+        const GlyphRunInput &run = runs[r];
+        char script[5] = {0};
+        hb_tag_to_string(run.script, script);
+
+        buffer_.append(r ? ",{\"font\":" : "{\"font\":");
+        appendInt(run.font);
+        buffer_.append(",\"script\":");
+        appendString(script);
+        buffer_.append(",\"direction\":\"");
+        buffer_.append(direction_name(run.direction));
+        buffer_.push_back('"');
+
+        appendArray("glyphs", run, [&](unsigned int i) { return (int64_t)run.infos[i].codepoint; });
+        appendArray("clusters", run, [&](unsigned int i) { return (int64_t)run.infos[i].cluster; });
+        appendArray("x_advances", run, [&](unsigned int i) { return (int64_t)run.positions[i].x_advance; });
+        appendArray("y_advances", run, [&](unsigned int i) { return (int64_t)run.positions[i].y_advance; });
+        appendArray("x_offsets", run, [&](unsigned int i) { return (int64_t)run.positions[i].x_offset; });
+        appendArray("y_offsets", run, [&](unsigned int i) { return (int64_t)run.positions[i].y_offset; });
+
+        if (withNames_ && run.hbFont)
+        {
+            buffer_.append(",\"names\":[");
+            for (unsigned int i = 0; i < run.count; i++)
+            {
+                if (i)
+                    buffer_.push_back(',');
+                appendString(nameCache_.name(run.hbFont, run.infos[i].codepoint));
+            }
+            buffer_.push_back(']');
+        }
+
+        buffer_.push_back('}');
+    }
+
+    buffer_.append("]}\n");
+    flushIfFull();
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <hb.h>
+// for harfbuzz
+
+// shaping 결과만 내보내는 layout 출력 (--layout).
+//
+// binary (GlyphRunWriter / GlyphRunFile): mmap해서 그대로 읽는 version이 붙은 format.
+//   glyph 값은 structure-of-arrays로 한 배열씩 이어져 있고 위치는 26.6 fixed point다.
+//   모든 section은 8 byte 정렬, offset은 파일 시작 기준. 모든 field는 little endian이다 (writer가 field마다
+//   바꿔 쓴다). GlyphRunFile은 복사 없이 struct로 읽으므로 little endian 기계에서만 연다.
+//   line (job 하나) → run (font, direction, script가 같은 glyph 구간) → glyph 순으로 가리킨다.
+//   cluster는 line의 UTF-32 text 안에서의 codepoint index다.
+//   --width로 나누면 job 하나가 여러 line이 되고, cluster는 paragraph 전체 text 기준이다.
+//
+// JSON (GlyphRunJsonWriter): 한 줄에 object 하나 (JSON Lines). font는 처음 나올 때 한번 선언한다.
+//   {"type":"font","id":0,"file":"...","face":0}
+//   {"type":"line","job":0,"size":36,"direction":"ltr","runs":[{"font":0,"script":"Latn","direction":"ltr",
+//     "glyphs":[...],"clusters":[...],"x_advances":[...],"y_advances":[...],"x_offsets":[...],"y_offsets":[...]}]}
+//   glyph 이름은 요청할 때만 "names"로 넣고, (font, glyph)마다 한번만 찾는다.
+
+const uint32_t GLYPH_RUN_VERSION = 1;
+const uint32_t GLYPH_RUN_BYTE_ORDER = 0x01020304;
+
+enum GlyphRunSection
+{
+    GLYPH_RUN_LINES,
+    GLYPH_RUN_RUNS,
+    GLYPH_RUN_FONTS,
+    GLYPH_RUN_STRINGS,
+    GLYPH_RUN_GLYPH_IDS,  // uint32
+    GLYPH_RUN_CLUSTERS,   // uint32
+    GLYPH_RUN_X_ADVANCES, // int32, 26.6
+    GLYPH_RUN_Y_ADVANCES,
+    GLYPH_RUN_X_OFFSETS,
+    GLYPH_RUN_Y_OFFSETS,
+    GLYPH_RUN_SECTION_COUNT
+};
+
+struct GlyphRunHeader
+{
+    char magic[8]; // "ANZGLYPH"
+    uint32_t version;
+    uint32_t byteOrder; // GLYPH_RUN_BYTE_ORDER (little endian), 다른 값이면 byte order가 다른 파일이다
+    uint32_t headerSize;
+    uint32_t lineCount;
+    uint32_t runCount;
+    uint32_t fontCount;
+    uint64_t glyphCount;
+    uint64_t stringSize;
+    uint64_t fileSize;
+    uint64_t offsets[GLYPH_RUN_SECTION_COUNT];
+};
+
+struct GlyphRunLine
+{
+    uint32_t job;
+    uint32_t fontSize;
+    uint32_t direction; // hb_direction_t, 줄 전체 방향
+    uint32_t firstRun;
+    uint32_t runCount;
+    uint32_t reserved;
+    uint64_t firstGlyph;
+};
+
+struct GlyphRunRecord
+{
+    uint64_t firstGlyph;
+    uint32_t glyphCount;
+    uint32_t font;      // fonts section index
+    uint32_t direction; // hb_direction_t
+    uint32_t script;    // hb_script_t (ISO 15924 tag)
+};
+
+struct GlyphRunFont
+{
+    uint32_t file; // strings section offset, NUL로 끝난다
+    uint32_t faceIndex;
+};
+
+// writer에 넘기는 run 하나 (visual order)
+struct GlyphRunInput
+{
+    uint32_t font; // addFont()가 돌려준 번호
+    hb_font_t *hbFont; // glyph 이름을 찾을 때만 쓴다
+    hb_direction_t direction;
+    hb_script_t script;
+    const hb_glyph_info_t *infos;
+    const hb_glyph_position_t *positions;
+    unsigned int count;
+};
+
+class GlyphRunWriter
+{
+public:
+    uint32_t addFont(const std::string &file, int faceIndex);
+    void addLine(uint32_t job, int fontSize, hb_direction_t direction, const GlyphRunInput *runs, size_t count);
+
+    // 모은 것을 한번에 쓴다. path가 "-"면 stdout
+    bool write(const char *path) const;
+
+    uint64_t glyphCount() const { return glyphIds_.size(); }
+
+private:
+    std::unordered_map<std::string, uint32_t> fontIds_;
+    std::vector<GlyphRunFont> fonts_;
+    std::string strings_;
+
+    std::vector<GlyphRunLine> lines_;
+    std::vector<GlyphRunRecord> runs_;
+    std::vector<uint32_t> glyphIds_;
+    std::vector<uint32_t> clusters_;
+    std::vector<int32_t> xAdvances_;
+    std::vector<int32_t> yAdvances_;
+    std::vector<int32_t> xOffsets_;
+    std::vector<int32_t> yOffsets_;
+};
+
+// binary layout 파일을 mmap해서 읽는다
+class GlyphRunFile
+{
+public:
+    GlyphRunFile() = default;
+    ~GlyphRunFile();
+    GlyphRunFile(const GlyphRunFile &) = delete;
+    GlyphRunFile &operator=(const GlyphRunFile &) = delete;
+
+    // magic, version, byte order, section 범위, line / run이 가리키는 run / glyph / font 번호를 확인한다.
+    // 통과하면 lines()[i].firstRun + runCount <= runCount 등 모든 index를 그대로 써도 된다
+    bool open(const std::string &path);
+    void close();
+
+    const GlyphRunHeader &header() const { return *header_; }
+    const GlyphRunLine *lines() const { return section<GlyphRunLine>(GLYPH_RUN_LINES); }
+    const GlyphRunRecord *runs() const { return section<GlyphRunRecord>(GLYPH_RUN_RUNS); }
+    const GlyphRunFont *fonts() const { return section<GlyphRunFont>(GLYPH_RUN_FONTS); }
+    const char *fontFile(const GlyphRunFont &font) const { return section<char>(GLYPH_RUN_STRINGS) + font.file; }
+
+    const uint32_t *glyphIds() const { return section<uint32_t>(GLYPH_RUN_GLYPH_IDS); }
+    const uint32_t *clusters() const { return section<uint32_t>(GLYPH_RUN_CLUSTERS); }
+    const int32_t *xAdvances() const { return section<int32_t>(GLYPH_RUN_X_ADVANCES); }
+    const int32_t *yAdvances() const { return section<int32_t>(GLYPH_RUN_Y_ADVANCES); }
+    const int32_t *xOffsets() const { return section<int32_t>(GLYPH_RUN_X_OFFSETS); }
+    const int32_t *yOffsets() const { return section<int32_t>(GLYPH_RUN_Y_OFFSETS); }
+
+private:
+    template <class T>
+    const T *section(GlyphRunSection s) const
+    {
+        return (const T *)((const char *)map_ + header_->offsets[s]);
+    }
+
+    void *map_ = nullptr;
+    size_t size_ = 0;
+    const GlyphRunHeader *header_ = nullptr;
+};
+
+// (hb_font, glyph) → 이름. 한번 찾은 이름은 다시 묻지 않는다
+class GlyphNameCache
+{
+public:
+    const char *name(hb_font_t *font, hb_codepoint_t glyph);
+    void clear() { names_.clear(); }
+
+private:
+    struct Key
+    {
+        hb_font_t *font;
+        hb_codepoint_t glyph;
+        bool operator==(const Key &o) const { return font == o.font && glyph == o.glyph; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key &k) const
+        {
+            return std::hash<const void *>()(k.font) ^ (size_t)k.glyph * 0x9E3779B97F4A7C15ull;
+        }
+    };
+
+    std::unordered_map<Key, std::string, KeyHash> names_;
+};
+
+class GlyphRunJsonWriter
+{
+public:
+    ~GlyphRunJsonWriter() { close(); }
+
+    // path가 "-"면 stdout
+    bool open(const char *path, bool names);
+    bool close();
+
+    uint32_t addFont(const std::string &file, int faceIndex);
+    void addLine(uint32_t job, int fontSize, hb_direction_t direction, const GlyphRunInput *runs, size_t count);
+
+    // hb_font가 destroy되기 전에 불러야 한다 (name cache key)
+    void forgetFonts() { nameCache_.clear(); }
+
+private:
+    void flushIfFull();
+    void flush();
+    void appendString(const char *s);
+    void appendInt(int64_t v);
+    template <class F>
+    void appendArray(const char *key, const GlyphRunInput &run, F &&value);
+
+    FILE *fp_ = nullptr;
+    bool toStdout_ = false;
+    bool withNames_ = false;
+    bool ok_ = true;
+    std::string buffer_;
+
+    std::unordered_map<std::string, uint32_t> fontIds_;
+    GlyphNameCache nameCache_;
+};
@@ -0,0 +1,185 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+#include <cairo.h>
+// for cairo
+
+#include "image_writer.h"
+
+// image_writer.cpp의 encoder들을 cairo_surface_write_to_png_stream()과 비교한다.
+// 흰 바탕 검은 글자 label(회색), 색 글자 label(RGB), 투명 바탕 label(RGBA)을 만들어
+// format / level / filter마다 memory로 encode 하는 시간과 크기를 잰다.
+// PNG는 cairo로 다시 읽어서 원본과 pixel이 같은지도 확인한다.
+//
+// ./image_bench [iterations]
+
+const int LABEL_WIDTH = 640;
+const int LABEL_HEIGHT = 96;
+
+namespace
+{
+    struct Label
+    {
+        const char *name;
+        cairo_format_t format;
+        double background[4]; // alpha 0이면 바탕을 칠하지 않는다
+        double ink[4];
+    };
+
+    cairo_surface_t *render_label(const Label &label)
+    {
+        cairo_surface_t *surface = cairo_image_surface_create(label.format, LABEL_WIDTH, LABEL_HEIGHT);
+        cairo_t *cr = cairo_create(surface);
+
+        if (label.background[3] > 0)
+        {
+            cairo_set_source_rgba(cr, label.background[0], label.background[1], label.background[2], label.background[3]);
+            cairo_paint(cr);
+        }
+
+        cairo_set_source_rgba(cr, label.ink[0], label.ink[1], label.ink[2], label.ink[3]);
+        cairo_select_font_face(cr, "sans-serif", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+        cairo_set_font_size(cr, 28);
+        cairo_move_to(cr, 12, 40);
+        cairo_show_text(cr, "The quick brown fox jumps over the lazy dog");
+        cairo_move_to(cr, 12, 80);
+        cairo_show_text(cr, "0123456789 !\"#$%&'()*+,-./:;<=>?@[]");
+
+        cairo_destroy(cr);
+        cairo_surface_flush(surface);
+        return surface;
+    }
+
+    cairo_status_t append_to_vector(void *closure, const unsigned char *data, unsigned int length)
+    {
+        std::vector<uint8_t> *out = (std::vector<uint8_t> *)closure;
+        out->insert(out->end(), data, data + length);
+        return CAIRO_STATUS_SUCCESS;
+    }
+
+    struct Reader
+    {
+        const std::vector<uint8_t> *data;
+        size_t offset;
+    };
+
+    cairo_status_t read_from_vector(void *closure, unsigned char *data, unsigned int length)
+    {
+        Reader *reader = (Reader *)closure;
+        if (reader->offset + length > reader->data->size())
+            return CAIRO_STATUS_READ_ERROR;
+        memcpy(data, reader->data->data() + reader->offset, length);
+        reader->offset += length;
+        return CAIRO_STATUS_SUCCESS;
+    }
+
+    // cairo가 다시 읽은 ARGB32와 원본을 비교한다. RGB24 원본은 alpha를 255로 본다.
+    // 반투명 pixel은 unpremultiply -> premultiply 왕복 오차가 있으므로 ±1까지 허용한다.
+    bool png_round_trip(cairo_surface_t *source, const std::vector<uint8_t> &png)
+    {
+        Reader reader = {&png, 0};
+        cairo_surface_t *decoded = cairo_image_surface_create_from_png_stream(read_from_vector, &reader);
+        if (cairo_surface_status(decoded) != CAIRO_STATUS_SUCCESS)
+        {
+            cairo_surface_destroy(decoded);
+            return false;
+        }
+
+        ImageView a, b;
+        image_view_from_surface(source, a);
+        image_view_from_surface(decoded, b);
+
+        bool same = a.width == b.width && a.height == b.height;
+        for (int y = 0; y < a.height && same; y++)
+        {
+            const uint32_t *ra = (const uint32_t *)(a.data + (size_t)y * a.stride);
+            const uint32_t *rb = (const uint32_t *)(b.data + (size_t)y * b.stride);
+            for (int x = 0; x < a.width && same; x++)
+            {
+                uint32_t pa = a.format == CAIRO_FORMAT_RGB24 ? ra[x] | 0xff000000 : ra[x];
+                uint32_t pb = rb[x];
+                for (int shift = 0; shift < 32; shift += 8)
+                {
+                    if (abs((int)((pa >> shift) & 0xff) - (int)((pb >> shift) & 0xff)) > 1)
+                        same = false;
+                }
+            }
+        }
+
+        cairo_surface_destroy(decoded);
+        return same;
+    }
+
+    template <class F>
+    double time_us(int iterations, F &&fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int n = 0; n < iterations; n++)
+            fn();
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / iterations;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    if (iterations <= 0)
+        iterations = 50;
+
+    const Label labels[] = {
+        {"gray", CAIRO_FORMAT_RGB24, {1, 1, 1, 1}, {0, 0, 0, 1}},
+        {"rgb", CAIRO_FORMAT_RGB24, {1, 1, .9, 1}, {.1, .3, .7, 1}},
+        {"rgba", CAIRO_FORMAT_ARGB32, {0, 0, 0, 0}, {.8, .1, .1, 1}},
+    };
+
+    bool ok = true;
+    std::vector<uint8_t> out;
+    for (const Label &label : labels)
+    {
+        cairo_surface_t *surface = render_label(label);
+        ImageView view;
+        image_view_from_surface(surface, view);
+
+        printf("%s label %dx%d, %d iterations\n", label.name, LABEL_WIDTH, LABEL_HEIGHT, iterations);
+
+        double us = time_us(iterations, [&] {
+            out.clear();
+            cairo_surface_write_to_png_stream(surface, append_to_vector, &out);
+        });
+        printf("  %-20s %9.1f us %8zu bytes\n", "cairo png", us, out.size());
+
+        for (int level : {1, 6, 9})
+        {
+            for (PngFilter filter : {PngFilter::NONE, PngFilter::SUB, PngFilter::UP, PngFilter::PAETH, PngFilter::ADAPTIVE})
+            {
+                ImageOptions options;
+                options.pngLevel = level;
+                options.pngFilter = filter;
+                us = time_us(iterations, [&] { image_encode(view, options, out); });
+
+                bool exact = png_round_trip(surface, out);
+                ok = ok && exact;
+
+                char name[32];
+                snprintf(name, sizeof(name), "png -%d %s", level, png_filter_name(filter));
+                printf("  %-20s %9.1f us %8zu bytes%s\n", name, us, out.size(), exact ? "" : "  ROUND TRIP FAILED");
+            }
+        }
+
+        for (ImageFormat format : {ImageFormat::QOI, ImageFormat::PAM, ImageFormat::PGM})
+        {
+            ImageOptions options;
+            options.format = format;
+            us = time_us(iterations, [&] { image_encode(view, options, out); });
+            printf("  %-20s %9.1f us %8zu bytes\n", image_format_name(format), us, out.size());
+        }
+
+        cairo_surface_destroy(surface);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,714 @@
+#include "image_writer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <zlib.h>
+// for png
+
+namespace
+{
+    // 출력 pixel 배치, 값은 pixel당 byte 수
+    enum Layout
+    {
+        LAYOUT_GRAY = 1,
+        LAYOUT_RGB = 3,
+        LAYOUT_RGBA = 4,
+    };
+
+    const size_t OUT_CHUNK = 64 * 1024; // IDAT 하나, QOI 출력 buffer 크기
+
+    struct Sink
+    {
+        FILE *fp = nullptr;
+        std::vector<uint8_t> *memory = nullptr;
+        bool ok = true;
+
+        void write(const void *data, size_t size)
+        {
+            if (!ok || size == 0)
+                return;
+            if (memory)
+                memory->insert(memory->end(), (const uint8_t *)data, (const uint8_t *)data + size);
+            else
+                ok = fwrite(data, 1, size, fp) == size;
+        }
+    };
+
+    void put32(uint8_t *p, uint32_t v)
+    {
+        p[0] = v >> 24;
+        p[1] = v >> 16;
+        p[2] = v >> 8;
+        p[3] = v;
+    }
+
+    const uint32_t *pixel_row(const ImageView &image, int y)
+    {
+        return (const uint32_t *)(image.data + (size_t)y * image.stride);
+    }
+
+    bool is_mask(const ImageView &image)
+    {
+        return image.format == CAIRO_FORMAT_A8 || image.format == CAIRO_FORMAT_A1;
+    }
+
+    // coverage mask (A8 / A1)의 값 → 색. A1은 0과 255만 쓴다
+    struct MaskPalette
+    {
+        uint8_t rgb[256][3];
+        uint8_t luma[256];    // PGM
+        bool gray = true;     // 모든 색이 회색이면 grayscale로 쓴다
+        bool identity = true; // 회색 값이 coverage 그대로면 A8 줄을 바꾸지 않고 쓴다
+    };
+
+    MaskPalette mask_palette(const ImageOptions &options)
+    {
+        MaskPalette palette;
+        for (int c = 0; c < 256; c++)
+        {
+            uint8_t *rgb = palette.rgb[c];
+            for (int i = 0; i < 3; i++)
+            {
+                int shift = 16 - 8 * i;
+                int fg = (options.foreground >> shift) & 0xff;
+                int bg = (options.background >> shift) & 0xff;
+                rgb[i] = bg + (int)lround((fg - bg) * c / 255.);
+            }
+            palette.luma[c] = (rgb[0] * 77 + rgb[1] * 150 + rgb[2] * 29 + 128) >> 8;
+            palette.gray = palette.gray && rgb[0] == rgb[1] && rgb[1] == rgb[2];
+            palette.identity = palette.identity && rgb[0] == c;
+        }
+        palette.identity = palette.identity && palette.gray;
+        return palette;
+    }
+
+    // cairo A1은 32bit 단위로 묶이고 bit 순서가 platform endian을 따른다 (little endian이면 첫 pixel이 최하위 bit)
+    inline bool a1_pixel(const uint8_t *row, int x)
+    {
+        uint32_t word = ((const uint32_t *)row)[x >> 5];
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return (word >> (31 - (x & 31))) & 1;
+#else
+        return (word >> (x & 31)) & 1;
+#endif
+    }
+
+    inline uint8_t reverse_bits(uint8_t b)
+    {
+        b = (b & 0xf0) >> 4 | (b & 0x0f) << 4;
+        b = (b & 0xcc) >> 2 | (b & 0x33) << 2;
+        return (b & 0xaa) >> 1 | (b & 0x55) << 1;
+    }
+
+    // 불투명 / 회색 여부를 보고 가장 작은 배치를 고른다. mask는 입힐 색으로 정한다
+    Layout analyze(const ImageView &image, const MaskPalette &palette)
+    {
+        if (is_mask(image))
+            return palette.gray ? LAYOUT_GRAY : LAYOUT_RGB;
+
+        bool gray = true;
+        for (int y = 0; y < image.height; y++)
+        {
+            const uint32_t *row = pixel_row(image, y);
+            for (int x = 0; x < image.width; x++)
+            {
+                uint32_t p = row[x];
+                if (image.format == CAIRO_FORMAT_ARGB32 && (p >> 24) != 0xff)
+                    return LAYOUT_RGBA; // 반투명 pixel이 하나라도 있으면 RGBA
+                uint32_t r = (p >> 16) & 0xff, g = (p >> 8) & 0xff, b = p & 0xff;
+                if (r != g || g != b)
+                    gray = false;
+            }
+        }
+
+        return gray ? LAYOUT_GRAY : LAYOUT_RGB;
+    }
+
+    uint8_t unpremultiply(uint32_t c, uint32_t a)
+    {
+        uint32_t v = (c * 255 + a / 2) / a;
+        return v > 255 ? 255 : v;
+    }
+
+    // y번째 줄을 layout으로 바꾼다. 바꿀 필요가 없으면 (기본 색의 A8) surface 줄을 그대로 돌려준다
+    const uint8_t *convert_row(const ImageView &image, int y, Layout layout, const MaskPalette &palette, uint8_t *out)
+    {
+        if (is_mask(image))
+        {
+            const uint8_t *mask = image.data + (size_t)y * image.stride;
+            if (image.format == CAIRO_FORMAT_A8 && palette.identity)
+                return mask;
+
+            for (int x = 0; x < image.width; x++)
+            {
+                uint8_t c = image.format == CAIRO_FORMAT_A8 ? mask[x] : a1_pixel(mask, x) ? 255 : 0;
+                if (layout == LAYOUT_GRAY)
+                    out[x] = palette.rgb[c][0];
+                else
+                    memcpy(out + x * 3, palette.rgb[c], 3);
+            }
+            return out;
+        }
+
+        const uint32_t *row = pixel_row(image, y);
+        int width = image.width;
+
+        switch (layout)
+        {
+        case LAYOUT_GRAY:
+            for (int x = 0; x < width; x++)
+                out[x] = row[x] & 0xff;
+            break;
+
+        case LAYOUT_RGB:
+            for (int x = 0; x < width; x++)
+            {
+                uint32_t p = row[x];
+                out[x * 3 + 0] = p >> 16;
+                out[x * 3 + 1] = p >> 8;
+                out[x * 3 + 2] = p;
+            }
+            break;
+
+        case LAYOUT_RGBA:
+            for (int x = 0; x < width; x++)
+            {
+                uint32_t p = row[x];
+                uint32_t a = p >> 24;
+                uint8_t *o = out + x * 4;
+                if (a == 0xff)
+                {
+                    o[0] = p >> 16;
+                    o[1] = p >> 8;
+                    o[2] = p;
+                }
+                else if (a == 0)
+                {
+                    o[0] = o[1] = o[2] = 0;
+                }
+                else
+                {
+                    o[0] = unpremultiply((p >> 16) & 0xff, a);
+                    o[1] = unpremultiply((p >> 8) & 0xff, a);
+                    o[2] = unpremultiply(p & 0xff, a);
+                }
+                o[3] = a;
+            }
+            break;
+        }
+
+        return out;
+    }
+
+    // PNG
+
+    void write_chunk(Sink &sink, const char *type, const uint8_t *data, uint32_t size)
+    {
+        uint8_t header[8];
+        put32(header, size);
+        memcpy(header + 4, type, 4);
+
+        uint32_t crc = crc32(0, header + 4, 4);
+        if (size)
+            crc = crc32(crc, data, size);
+        uint8_t footer[4];
+        put32(footer, crc);
+
+        sink.write(header, 8);
+        sink.write(data, size);
+        sink.write(footer, 4);
+    }
+
+    uint8_t paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return a;
+        return pb <= pc ? b : c;
+    }
+
+    // row를 filter 해서 out[0] = filter type, out[1..]에 쓴다. 절대값 합을 돌려준다 (adaptive 선택용)
+    uint32_t filter_row(PngFilter filter, const uint8_t *row, const uint8_t *prev, size_t size, int bpp, uint8_t *out)
+    {
+        out[0] = (uint8_t)filter;
+        uint8_t *o = out + 1;
+        uint32_t sum = 0;
+
+        for (size_t x = 0; x < size; x++)
+        {
+            int left = x >= (size_t)bpp ? row[x - bpp] : 0;
+            int up = prev[x];
+            int upLeft = x >= (size_t)bpp ? prev[x - bpp] : 0;
+
+            uint8_t predict = 0;
+            switch (filter)
+            {
+            case PngFilter::SUB:
+                predict = left;
+                break;
+            case PngFilter::UP:
+                predict = up;
+                break;
+            case PngFilter::AVERAGE:
+                predict = (left + up) >> 1;
+                break;
+            case PngFilter::PAETH:
+                predict = paeth(left, up, upLeft);
+                break;
+            default:
+                break;
+            }
+
+            uint8_t v = row[x] - predict;
+            o[x] = v;
+            sum += v < 128 ? v : 256 - v;
+        }
+
+        return sum;
+    }
+
+    bool deflate_to(z_stream &zs, Sink &sink, std::vector<uint8_t> &idat, int flush)
+    {
+        do
+        {
+            zs.next_out = idat.data();
+            zs.avail_out = idat.size();
+            int ret = deflate(&zs, flush);
+            if (ret == Z_STREAM_ERROR)
+                return false;
+
+            size_t produced = idat.size() - zs.avail_out;
+            if (produced)
+                write_chunk(sink, "IDAT", idat.data(), produced);
+        } while (zs.avail_out == 0);
+
+        return true;
+    }
+
+    bool encode_png(const ImageView &image, Layout layout, const MaskPalette &palette, const ImageOptions &options,
+                    Sink &sink)
+    {
+        static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+        sink.write(signature, sizeof(signature));
+
+        // A1과 회색이 아닌 색의 A8은 coverage를 그대로 palette index로 쓴다 (줄을 바꾸지 않는다)
+        const bool a1 = image.format == CAIRO_FORMAT_A1;
+        const bool indexed = a1 || (image.format == CAIRO_FORMAT_A8 && !palette.gray);
+
+        uint8_t ihdr[13];
+        put32(ihdr, image.width);
+        put32(ihdr + 4, image.height);
+        ihdr[8] = a1 ? 1 : 8; // bit depth
+        ihdr[9] = indexed ? 3 : layout == LAYOUT_GRAY ? 0 : layout == LAYOUT_RGB ? 2 : 6; // color type
+        ihdr[10] = 0;         // deflate
+        ihdr[11] = 0;         // filter method
+        ihdr[12] = 0;         // no interlace
+        write_chunk(sink, "IHDR", ihdr, sizeof(ihdr));
+
+        if (indexed)
+        {
+            uint8_t plte[256 * 3];
+            int entries = a1 ? 2 : 256;
+            for (int i = 0; i < entries; i++)
+                memcpy(plte + i * 3, palette.rgb[a1 ? i * 255 : i], 3);
+            write_chunk(sink, "PLTE", plte, entries * 3);
+        }
+
+        int level = options.pngLevel < 0 ? 0 : options.pngLevel > 9 ? 9 : options.pngLevel;
+        int strategy = options.pngFilter == PngFilter::NONE ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        if (deflateInit2(&zs, level, Z_DEFLATED, 15, 8, strategy) != Z_OK)
+            return false;
+
+        size_t rowBytes = a1 ? ((size_t)image.width + 7) / 8 : (size_t)image.width * (indexed ? 1 : layout);
+        int bpp = indexed ? 1 : layout; // filter가 왼쪽 pixel로 보는 byte 수 (1bit 미만이면 1)
+        std::vector<uint8_t> zero(rowBytes, 0);
+        std::vector<uint8_t> scratch[2] = {std::vector<uint8_t>(rowBytes), std::vector<uint8_t>(rowBytes)};
+        std::vector<uint8_t> filtered(rowBytes + 1);
+        std::vector<uint8_t> candidate(rowBytes + 1);
+        std::vector<uint8_t> idat(OUT_CHUNK);
+
+        const uint8_t *prev = zero.data();
+        bool ok = true;
+        for (int y = 0; y < image.height && ok; y++)
+        {
+            const uint8_t *row;
+            if (a1)
+            {
+                // PNG 1bit는 첫 pixel이 최상위 bit다
+                const uint8_t *mask = image.data + (size_t)y * image.stride;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                row = mask;
+#else
+                uint8_t *out = scratch[y & 1].data();
+                for (size_t i = 0; i < rowBytes; i++)
+                    out[i] = reverse_bits(mask[i]);
+                row = out;
+#endif
+            }
+            else if (indexed)
+            {
+                row = image.data + (size_t)y * image.stride;
+            }
+            else
+            {
+                row = convert_row(image, y, layout, palette, scratch[y & 1].data());
+            }
+
+            if (options.pngFilter != PngFilter::ADAPTIVE)
+            {
+                filter_row(options.pngFilter, row, prev, rowBytes, bpp, filtered.data());
+            }
+            else
+            {
+                uint32_t best = filter_row(PngFilter::NONE, row, prev, rowBytes, bpp, filtered.data());
+                for (PngFilter f : {PngFilter::SUB, PngFilter::UP, PngFilter::AVERAGE, PngFilter::PAETH})
+                {
+                    uint32_t sum = filter_row(f, row, prev, rowBytes, bpp, candidate.data());
+                    if (sum < best)
+                    {
+                        best = sum;
+                        filtered.swap(candidate);
+                    }
+                }
+            }
+
+            zs.next_in = filtered.data();
+            zs.avail_in = rowBytes + 1;
+            ok = deflate_to(zs, sink, idat, Z_NO_FLUSH);
+            prev = row;
+        }
+
+        ok = ok && deflate_to(zs, sink, idat, Z_FINISH);
+        deflateEnd(&zs);
+
+        write_chunk(sink, "IEND", NULL, 0);
+        return ok;
+    }
+
+    // QOI
+
+    bool encode_qoi(const ImageView &image, Layout layout, const MaskPalette &palette, Sink &sink)
+    {
+        uint8_t header[14];
+        memcpy(header, "qoif", 4);
+        put32(header + 4, image.width);
+        put32(header + 8, image.height);
+        header[12] = layout == LAYOUT_RGBA ? 4 : 3;
+        header[13] = 0; // sRGB, linear alpha
+        sink.write(header, sizeof(header));
+
+        struct Rgba
+        {
+            uint8_t r, g, b, a;
+        };
+        Rgba index[64];
+        memset(index, 0, sizeof(index));
+        Rgba prev = {0, 0, 0, 255};
+        int run = 0;
+
+        std::vector<uint8_t> scratch((size_t)image.width * layout);
+        std::vector<uint8_t> out(OUT_CHUNK);
+        size_t n = 0;
+
+        for (int y = 0; y < image.height; y++)
+        {
+            const uint8_t *row = convert_row(image, y, layout, palette, scratch.data());
+
+            for (int x = 0; x < image.width; x++)
+            {
+                Rgba px;
+                if (layout == LAYOUT_GRAY)
+                    px = {row[x], row[x], row[x], 255};
+                else if (layout == LAYOUT_RGB)
+                    px = {row[x * 3], row[x * 3 + 1], row[x * 3 + 2], 255};
+                else
+                    px = {row[x * 4], row[x * 4 + 1], row[x * 4 + 2], row[x * 4 + 3]};
+
+                // 한 pixel은 최대 5 byte, run은 최대 1 byte를 더 쓴다
+                if (n + 6 > out.size())
+                {
+                    sink.write(out.data(), n);
+                    n = 0;
+                }
+
+                if (px.r == prev.r && px.g == prev.g && px.b == prev.b && px.a == prev.a)
+                {
+                    if (++run == 62)
+                    {
+                        out[n++] = 0xc0 | (run - 1); // QOI_OP_RUN
+                        run = 0;
+                    }
+                    continue;
+                }
+
+                if (run)
+                {
+                    out[n++] = 0xc0 | (run - 1);
+                    run = 0;
+                }
+
+                int hash = (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+                if (index[hash].r == px.r && index[hash].g == px.g && index[hash].b == px.b && index[hash].a == px.a)
+                {
+                    out[n++] = hash; // QOI_OP_INDEX
+                }
+                else
+                {
+                    index[hash] = px;
+
+                    if (px.a == prev.a)
+                    {
+                        int8_t dr = px.r - prev.r;
+                        int8_t dg = px.g - prev.g;
+                        int8_t db = px.b - prev.b;
+                        int8_t drg = dr - dg;
+                        int8_t dbg = db - dg;
+
+                        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                        {
+                            out[n++] = 0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2); // QOI_OP_DIFF
+                        }
+                        else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7)
+                        {
+                            out[n++] = 0x80 | (dg + 32); // QOI_OP_LUMA
+                            out[n++] = (drg + 8) << 4 | (dbg + 8);
+                        }
+                        else
+                        {
+                            out[n++] = 0xfe; // QOI_OP_RGB
+                            out[n++] = px.r;
+                            out[n++] = px.g;
+                            out[n++] = px.b;
+                        }
+                    }
+                    else
+                    {
+                        out[n++] = 0xff; // QOI_OP_RGBA
+                        out[n++] = px.r;
+                        out[n++] = px.g;
+                        out[n++] = px.b;
+                        out[n++] = px.a;
+                    }
+                }
+
+                prev = px;
+            }
+        }
+
+        if (run)
+            out[n++] = 0xc0 | (run - 1);
+        sink.write(out.data(), n);
+
+        static const uint8_t end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+        sink.write(end, sizeof(end));
+        return true;
+    }
+
+    // PAM / PGM
+
+    bool encode_pam(const ImageView &image, Layout layout, const MaskPalette &palette, Sink &sink)
+    {
+        const char *tuple = layout == LAYOUT_GRAY ? "GRAYSCALE" : layout == LAYOUT_RGB ? "RGB" : "RGB_ALPHA";
+        char header[128];
+        int len = snprintf(header, sizeof(header), "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n",
+                           image.width, image.height, (int)layout, tuple);
+        sink.write(header, len);
+
+        std::vector<uint8_t> scratch((size_t)image.width * layout);
+        for (int y = 0; y < image.height; y++)
+            sink.write(convert_row(image, y, layout, palette, scratch.data()), scratch.size());
+        return true;
+    }
+
+    bool encode_pgm(const ImageView &image, Layout layout, const MaskPalette &palette, Sink &sink)
+    {
+        char header[64];
+        int len = snprintf(header, sizeof(header), "P5\n%d %d\n255\n", image.width, image.height);
+        sink.write(header, len);
+
+        std::vector<uint8_t> scratch(image.width);
+        for (int y = 0; y < image.height; y++)
+        {
+            if (layout == LAYOUT_GRAY)
+            {
+                sink.write(convert_row(image, y, layout, palette, scratch.data()), image.width);
+                continue;
+            }
+
+            if (is_mask(image))
+            {
+                const uint8_t *mask = image.data + (size_t)y * image.stride;
+                for (int x = 0; x < image.width; x++)
+                    scratch[x] = palette.luma[image.format == CAIRO_FORMAT_A8 ? mask[x] : a1_pixel(mask, x) ? 255 : 0];
+                sink.write(scratch.data(), image.width);
+                continue;
+            }
+
+            // premultiplied 값에 (255 - alpha)를 더하면 흰 바탕에 합성한 색이 된다
+            const uint32_t *row = pixel_row(image, y);
+            for (int x = 0; x < image.width; x++)
+            {
+                uint32_t p = row[x];
+                uint32_t white = image.format == CAIRO_FORMAT_ARGB32 ? 255 - (p >> 24) : 0;
+                uint32_t r = ((p >> 16) & 0xff) + white;
+                uint32_t g = ((p >> 8) & 0xff) + white;
+                uint32_t b = (p & 0xff) + white;
+                scratch[x] = (r * 77 + g * 150 + b * 29 + 128) >> 8;
+            }
+            sink.write(scratch.data(), image.width);
+        }
+        return true;
+    }
+
+    bool encode(const ImageView &image, const ImageOptions &options, Sink &sink)
+    {
+        if (!image.data || image.width <= 0 || image.height <= 0)
+            return false;
+
+        MaskPalette palette = mask_palette(options);
+        Layout layout = analyze(image, palette);
+        bool ok = false;
+        switch (options.format)
+        {
+        case ImageFormat::PNG:
+            ok = encode_png(image, layout, palette, options, sink);
+            break;
+        case ImageFormat::QOI:
+            ok = encode_qoi(image, layout, palette, sink);
+            break;
+        case ImageFormat::PAM:
+            ok = encode_pam(image, layout, palette, sink);
+            break;
+        case ImageFormat::PGM:
+            ok = encode_pgm(image, layout, palette, sink);
+            break;
+        }
+        return ok && sink.ok;
+    }
+}
+
+bool image_view_from_surface(cairo_surface_t *surface, ImageView &view)
+{
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS ||
+        cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE)
+        return false;
+
+    cairo_format_t format = cairo_image_surface_get_format(surface);
+    if (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24 && format != CAIRO_FORMAT_A8 &&
+        format != CAIRO_FORMAT_A1)
+        return false;
+
+    cairo_surface_flush(surface);
+    view.data = cairo_image_surface_get_data(surface);
+    view.width = cairo_image_surface_get_width(surface);
+    view.height = cairo_image_surface_get_height(surface);
+    view.stride = cairo_image_surface_get_stride(surface);
+    view.format = format;
+    return view.data != nullptr;
+}
+
+bool image_encode(const ImageView &image, const ImageOptions &options, std::vector<uint8_t> &out)
+{
+    out.clear();
+    Sink sink;
+    sink.memory = &out;
+    return encode(image, options, sink);
+}
+
+bool image_write(const ImageView &image, const ImageOptions &options, const char *path)
+{
+    bool toStdout = strcmp(path, "-") == 0;
+
+    Sink sink;
+    sink.fp = toStdout ? stdout : fopen(path, "wb");
+    if (!sink.fp)
+        return false;
+
+    bool ok = encode(image, options, sink);
+    if (toStdout)
+        ok = fflush(stdout) == 0 && ok;
+    else
+        ok = fclose(sink.fp) == 0 && ok;
+    return ok;
+}
+
+bool image_write_surface(cairo_surface_t *surface, const ImageOptions &options, const char *path)
+{
+    ImageView view;
+    return image_view_from_surface(surface, view) && image_write(view, options, path);
+}
+
+const char *image_format_name(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::PNG:
+        return "png";
+    case ImageFormat::QOI:
+        return "qoi";
+    case ImageFormat::PAM:
+        return "pam";
+    case ImageFormat::PGM:
+        return "pgm";
+    }
+    return "?";
+}
+
+const char *image_format_extension(ImageFormat format)
+{
+    return image_format_name(format);
+}
+
+bool image_format_from_name(const char *name, ImageFormat &format)
+{
+    for (ImageFormat f : {ImageFormat::PNG, ImageFormat::QOI, ImageFormat::PAM, ImageFormat::PGM})
+    {
+        if (strcmp(name, image_format_name(f)) == 0)
+        {
+            format = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *png_filter_name(PngFilter filter)
+{
+    switch (filter)
+    {
+    case PngFilter::NONE:
+        return "none";
+    case PngFilter::SUB:
+        return "sub";
+    case PngFilter::UP:
+        return "up";
+    case PngFilter::AVERAGE:
+        return "avg";
+    case PngFilter::PAETH:
+        return "paeth";
+    case PngFilter::ADAPTIVE:
+        return "adaptive";
+    }
+    return "?";
+}
+
+bool png_filter_from_name(const char *name, PngFilter &filter)
+{
+    for (PngFilter f : {PngFilter::NONE, PngFilter::SUB, PngFilter::UP, PngFilter::AVERAGE, PngFilter::PAETH,
+                        PngFilter::ADAPTIVE})
+    {
+        if (strcmp(name, png_filter_name(f)) == 0)
+        {
+            filter = f;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <cairo.h>
+// for cairo
+
+// cairo image surface의 data를 바로 읽어서 파일로 쓰는 encoder.
+//
+// cairo_surface_write_to_png()는 zlib 기본 설정과 adaptive filter로 고정이고 경로도 파일만 된다.
+// 여기서는 format(PNG, QOI, PAM, PGM)과 PNG 압축 level / filter를 고를 수 있고,
+// file, stdout("-"), memory buffer 어디로든 쓸 수 있다.
+// 이미지 전체를 복사하지 않고 surface에서 한 줄씩 변환해서 바로 encoder에 넣는다.
+// 모든 pixel이 불투명하면 alpha를 빼고, 회색뿐이면 grayscale로 쓴다
+// (흰 바탕에 검은 글자인 label은 pixel당 1 byte).
+// A8 / A1 surface (coverage mask)는 encode할 때 foreground / background 색을 입힌다. 색이 회색이면 grayscale,
+// 아니면 PNG는 coverage를 그대로 palette index로 쓴다 (A1은 1bit palette PNG).
+
+enum class ImageFormat
+{
+    PNG,
+    QOI, // https://qoiformat.org, 무손실이고 PNG보다 훨씬 빠르다
+    PAM, // netpbm P7, 압축 없음
+    PGM, // netpbm P5, 회색 (alpha는 흰 바탕에 합성)
+};
+
+enum class PngFilter
+{
+    NONE,
+    SUB,
+    UP,
+    AVERAGE,
+    PAETH,
+    ADAPTIVE, // 줄마다 다섯개 중 절대값 합이 가장 작은 것 (libpng 기본과 같은 방식)
+};
+
+struct ImageOptions
+{
+    ImageFormat format = ImageFormat::PNG;
+    int pngLevel = 6; // zlib 압축 level 0..9
+    PngFilter pngFilter = PngFilter::ADAPTIVE;
+
+    // A8 / A1 coverage c에 입힐 색 (0xRRGGBB): background + (foreground - background) × c / 255.
+    // 기본은 coverage 그대로 회색 값이 된다 (SDF atlas 등)
+    uint32_t foreground = 0xffffff;
+    uint32_t background = 0x000000;
+};
+
+// cairo image surface data를 그대로 가리킨다
+struct ImageView
+{
+    const uint8_t *data = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    cairo_format_t format = CAIRO_FORMAT_ARGB32; // ARGB32 (premultiplied), RGB24, A8, A1만 된다
+};
+
+// surface를 flush하고 data를 가리키는 view를 만든다. 지원하지 않는 surface면 false
+bool image_view_from_surface(cairo_surface_t *surface, ImageView &view);
+
+// out을 encode 결과로 바꾼다 (capacity는 재사용)
+bool image_encode(const ImageView &image, const ImageOptions &options, std::vector<uint8_t> &out);
+
+// path가 "-"면 stdout으로 쓴다
+bool image_write(const ImageView &image, const ImageOptions &options, const char *path);
+bool image_write_surface(cairo_surface_t *surface, const ImageOptions &options, const char *path);
+
+const char *image_format_name(ImageFormat format);
+const char *image_format_extension(ImageFormat format);
+bool image_format_from_name(const char *name, ImageFormat &format);
+
+const char *png_filter_name(PngFilter filter);
+bool png_filter_from_name(const char *name, PngFilter &filter);
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+#include <hb.h>
+// for harfbuzz
+
+// 실제로 잉크가 묻는 영역으로 surface 크기를 정하기 위한 도구.
+// 좌표는 cairo와 같이 y가 아래로 커진다. 단위는 pixel.
+
+struct InkBox
+{
+    double left = 0;
+    double top = 0;
+    double right = 0;
+    double bottom = 0;
+    bool empty = true;
+
+    void add(double l, double t, double r, double b)
+    {
+        if (empty)
+        {
+            left = l;
+            top = t;
+            right = r;
+            bottom = b;
+            empty = false;
+            return;
+        }
+        left = std::min(left, l);
+        top = std::min(top, t);
+        right = std::max(right, r);
+        bottom = std::max(bottom, b);
+    }
+
+    void add(const InkBox &o)
+    {
+        if (!o.empty)
+            add(o.left, o.top, o.right, o.bottom);
+    }
+
+    // (x, y)에 놓인 glyph의 extents (HarfBuzz 26.6, y가 위쪽)를 더한다. 빈 glyph(공백 등)는 무시한다
+    void addGlyph(const hb_glyph_extents_t &extents, double x, double y)
+    {
+        if (extents.width == 0 || extents.height == 0)
+            return;
+        double l = x + extents.x_bearing / 64.;
+        double t = y - extents.y_bearing / 64.;
+        double r = l + extents.width / 64.;
+        double b = t - extents.height / 64.; // height는 아래로 내려가므로 음수다
+        add(std::min(l, r), std::min(t, b), std::max(l, r), std::max(t, b));
+    }
+
+    double width() const { return right - left; }
+    double height() const { return bottom - top; }
+};
+
+// hb_font_get_glyph_extents() 결과 cache. 매번 glyf/CFF outline을 읽지 않도록 한다.
+// key는 (font 번호, glyph id)이므로 font가 닫히거나 size가 바뀌면 clear()를 불러야 한다.
+// maxEntries를 넘으면 통째로 비운다 (CJK처럼 glyph가 많은 corpus에서 끝없이 커지지 않도록)
+class GlyphExtentsCache
+{
+public:
+    explicit GlyphExtentsCache(size_t maxEntries = 16384) : maxEntries_(maxEntries) {}
+
+    const hb_glyph_extents_t &extents(unsigned int font, hb_font_t *hbFont, hb_codepoint_t glyph)
+    {
+        uint64_t key = (uint64_t)font << 32 | glyph;
+        auto it = map_.find(key);
+        if (it != map_.end())
+            return it->second;
+
+        hb_glyph_extents_t extents = {0, 0, 0, 0};
+        if (!hbFont || !hb_font_get_glyph_extents(hbFont, glyph, &extents))
+            extents = {0, 0, 0, 0};
+        if (map_.size() >= maxEntries_)
+            map_.clear(); // bucket은 남으므로 다시 채울 때 rehash하지 않는다
+        return map_.emplace(key, extents).first->second;
+    }
+
+    size_t size() const { return map_.size(); }
+    void clear() { map_.clear(); }
+
+private:
+    size_t maxEntries_;
+    std::unordered_map<uint64_t, hb_glyph_extents_t> map_;
+};
@@ -0,0 +1,471 @@
+#include "line_breaker.h"
+
+#include <algorithm>
+
+#include <hb.h>
+// for harfbuzz
+
+namespace
+{
+    // U+0000..U+007F
+    const LineBreakClass ASCII_CLASSES[128] = {
+        // 00-0F: control, TAB=BA, LF, VT/FF=BK, CR
+        LB_CM, LB_CM, LB_CM, LB_CM, LB_CM, LB_CM, LB_CM, LB_CM,
+        LB_CM, LB_BA, LB_LF, LB_BK, LB_BK, LB_CR, LB_CM, LB_CM,
+        // 10-1F
+        LB_CM, LB_CM, LB_CM, LB_CM, LB_CM, LB_CM, LB_CM, LB_CM,
+        LB_CM, LB_CM, LB_CM, LB_CM, LB_CM, LB_CM, LB_CM, LB_CM,
+        // 20-2F: SP ! " # $ % & ' ( ) * + , - . /
+        LB_SP, LB_EX, LB_QU, LB_AL, LB_PR, LB_PO, LB_AL, LB_QU,
+        LB_OP, LB_CP, LB_AL, LB_PR, LB_IS, LB_HY, LB_IS, LB_SY,
+        // 30-3F: 0-9 : ; < = > ?
+        LB_NU, LB_NU, LB_NU, LB_NU, LB_NU, LB_NU, LB_NU, LB_NU,
+        LB_NU, LB_NU, LB_IS, LB_IS, LB_AL, LB_AL, LB_AL, LB_EX,
+        // 40-5F: @ A-Z [ \ ] ^ _
+        LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL,
+        LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL,
+        LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL,
+        LB_AL, LB_AL, LB_AL, LB_OP, LB_PR, LB_CP, LB_AL, LB_AL,
+        // 60-7F: ` a-z { | } ~ DEL
+        LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL,
+        LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL,
+        LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL, LB_AL,
+        LB_AL, LB_AL, LB_AL, LB_OP, LB_BA, LB_CL, LB_AL, LB_CM,
+    };
+
+    struct ClassRange
+    {
+        uint32_t first;
+        uint32_t last;
+        LineBreakClass lb;
+    };
+
+    // ASCII 밖에서 general category만으로는 틀리는 영역. first 순서로 정렬되어 있어야 한다
+    const ClassRange CLASS_RANGES[] = {
+        {0x0085, 0x0085, LB_NL},
+        {0x00A0, 0x00A0, LB_GL},
+        {0x00A1, 0x00A1, LB_OP},
+        {0x00A2, 0x00A2, LB_PO},
+        {0x00A3, 0x00A5, LB_PR},
+        {0x00AB, 0x00AB, LB_QU},
+        {0x00AD, 0x00AD, LB_BA},
+        {0x00B0, 0x00B0, LB_PO},
+        {0x00B1, 0x00B1, LB_PR},
+        {0x00B4, 0x00B4, LB_BB},
+        {0x00BB, 0x00BB, LB_QU},
+        {0x00BF, 0x00BF, LB_OP},
+        {0x02C8, 0x02C8, LB_BB},
+        {0x02CC, 0x02CC, LB_BB},
+        {0x02DF, 0x02DF, LB_BB},
+        {0x034F, 0x034F, LB_GL},
+        {0x035C, 0x0362, LB_GL},
+        {0x0589, 0x0589, LB_IS},
+        {0x058A, 0x058A, LB_BA},
+        {0x05BE, 0x05BE, LB_BA},
+        {0x05D0, 0x05EA, LB_HL},
+        {0x05EF, 0x05F2, LB_HL},
+        {0x060C, 0x060D, LB_IS},
+        {0x061F, 0x061F, LB_EX},
+        {0x066A, 0x066A, LB_PO},
+        {0x06D4, 0x06D4, LB_EX},
+        {0x0964, 0x0965, LB_BA},
+        {0x0E5A, 0x0E5B, LB_BA},
+        {0x0F0B, 0x0F0B, LB_BA},
+        {0x0F0C, 0x0F0C, LB_GL},
+        {0x1100, 0x115F, LB_JL},
+        {0x1160, 0x11A7, LB_JV},
+        {0x11A8, 0x11FF, LB_JT},
+        {0x1361, 0x1361, LB_BA},
+        {0x1680, 0x1680, LB_BA},
+        {0x17D4, 0x17D5, LB_BA},
+        {0x180E, 0x180E, LB_GL},
+        {0x2000, 0x2006, LB_BA},
+        {0x2007, 0x2007, LB_GL},
+        {0x2008, 0x200A, LB_BA},
+        {0x200B, 0x200B, LB_ZW},
+        {0x200C, 0x200C, LB_CM},
+        {0x200D, 0x200D, LB_ZWJ},
+        {0x200E, 0x200F, LB_CM},
+        {0x2010, 0x2010, LB_BA},
+        {0x2011, 0x2011, LB_GL},
+        {0x2012, 0x2013, LB_BA},
+        {0x2014, 0x2014, LB_B2},
+        {0x2015, 0x2017, LB_AL},
+        {0x2018, 0x2019, LB_QU},
+        {0x201A, 0x201A, LB_OP},
+        {0x201B, 0x201D, LB_QU},
+        {0x201E, 0x201E, LB_OP},
+        {0x201F, 0x201F, LB_QU},
+        {0x2020, 0x2023, LB_AL},
+        {0x2024, 0x2026, LB_IN},
+        {0x2027, 0x2027, LB_BA},
+        {0x2028, 0x2029, LB_BK},
+        {0x202A, 0x202E, LB_CM},
+        {0x202F, 0x202F, LB_GL},
+        {0x2030, 0x2037, LB_PO},
+        {0x2039, 0x203A, LB_QU},
+        {0x203C, 0x203D, LB_NS},
+        {0x2044, 0x2044, LB_IS},
+        {0x2047, 0x2049, LB_NS},
+        {0x205F, 0x205F, LB_BA},
+        {0x2060, 0x2060, LB_WJ},
+        {0x2066, 0x206F, LB_CM},
+        {0x20A7, 0x20A7, LB_PO},
+        {0x20B6, 0x20B6, LB_PO},
+        {0x20BB, 0x20BB, LB_PO},
+        {0x20BE, 0x20BE, LB_PO},
+        {0x2103, 0x2103, LB_PO},
+        {0x2109, 0x2109, LB_PO},
+        {0x2116, 0x2116, LB_PR},
+        {0x2212, 0x2213, LB_PR},
+        {0x2E80, 0x2FFF, LB_ID},
+        {0x3000, 0x3000, LB_BA},
+        {0x3001, 0x3002, LB_CL},
+        {0x3003, 0x3004, LB_ID},
+        {0x3005, 0x3005, LB_NS},
+        {0x3006, 0x3007, LB_ID},
+        {0x301C, 0x301C, LB_NS},
+        {0x3020, 0x303A, LB_ID},
+        {0x303B, 0x303C, LB_NS},
+        {0x303D, 0x303F, LB_ID},
+        {0x3041, 0x3041, LB_NS}, // 작은 kana (CJ -> NS)
+        {0x3042, 0x3042, LB_ID},
+        {0x3043, 0x3043, LB_NS},
+        {0x3044, 0x3044, LB_ID},
+        {0x3045, 0x3045, LB_NS},
+        {0x3046, 0x3046, LB_ID},
+        {0x3047, 0x3047, LB_NS},
+        {0x3048, 0x3048, LB_ID},
+        {0x3049, 0x3049, LB_NS},
+        {0x304A, 0x3062, LB_ID},
+        {0x3063, 0x3063, LB_NS},
+        {0x3064, 0x3082, LB_ID},
+        {0x3083, 0x3083, LB_NS},
+        {0x3084, 0x3084, LB_ID},
+        {0x3085, 0x3085, LB_NS},
+        {0x3086, 0x3086, LB_ID},
+        {0x3087, 0x3087, LB_NS},
+        {0x3088, 0x308D, LB_ID},
+        {0x308E, 0x308E, LB_NS},
+        {0x308F, 0x3094, LB_ID},
+        {0x3095, 0x3096, LB_NS},
+        {0x309B, 0x309E, LB_NS},
+        {0x309F, 0x309F, LB_ID},
+        {0x30A0, 0x30A1, LB_NS},
+        {0x30A2, 0x30A2, LB_ID},
+        {0x30A3, 0x30A3, LB_NS},
+        {0x30A4, 0x30A4, LB_ID},
+        {0x30A5, 0x30A5, LB_NS},
+        {0x30A6, 0x30A6, LB_ID},
+        {0x30A7, 0x30A7, LB_NS},
+        {0x30A8, 0x30A8, LB_ID},
+        {0x30A9, 0x30A9, LB_NS},
+        {0x30AA, 0x30C2, LB_ID},
+        {0x30C3, 0x30C3, LB_NS},
+        {0x30C4, 0x30E2, LB_ID},
+        {0x30E3, 0x30E3, LB_NS},
+        {0x30E4, 0x30E4, LB_ID},
+        {0x30E5, 0x30E5, LB_NS},
+        {0x30E6, 0x30E6, LB_ID},
+        {0x30E7, 0x30E7, LB_NS},
+        {0x30E8, 0x30ED, LB_ID},
+        {0x30EE, 0x30EE, LB_NS},
+        {0x30EF, 0x30F4, LB_ID},
+        {0x30F5, 0x30F6, LB_NS},
+        {0x30F7, 0x30FA, LB_ID},
+        {0x30FB, 0x30FE, LB_NS},
+        {0x30FF, 0x30FF, LB_ID},
+        {0x3100, 0x31EF, LB_ID},
+        {0x31F0, 0x31FF, LB_NS},
+        {0x3200, 0x4DBF, LB_ID},
+        {0x4E00, 0x9FFF, LB_ID},
+        {0xA000, 0xA48F, LB_ID},
+        {0xA490, 0xA4CF, LB_ID},
+        {0xA960, 0xA97F, LB_JL},
+        {0xD7B0, 0xD7C6, LB_JV},
+        {0xD7CB, 0xD7FB, LB_JT},
+        {0xF900, 0xFAFF, LB_ID},
+        {0xFB1D, 0xFB4F, LB_HL},
+        {0xFE10, 0xFE10, LB_IS},
+        {0xFE13, 0xFE14, LB_IS},
+        {0xFE30, 0xFE34, LB_ID},
+        {0xFEFF, 0xFEFF, LB_WJ},
+        {0xFF01, 0xFF01, LB_EX},
+        {0xFF02, 0xFF03, LB_ID},
+        {0xFF04, 0xFF04, LB_PR},
+        {0xFF05, 0xFF05, LB_PO},
+        {0xFF06, 0xFF07, LB_ID},
+        {0xFF0A, 0xFF0B, LB_ID},
+        {0xFF0C, 0xFF0C, LB_CL},
+        {0xFF0D, 0xFF0D, LB_ID},
+        {0xFF0E, 0xFF0E, LB_CL},
+        {0xFF0F, 0xFF19, LB_ID},
+        {0xFF1A, 0xFF1B, LB_NS},
+        {0xFF1C, 0xFF1E, LB_ID},
+        {0xFF1F, 0xFF1F, LB_EX},
+        {0xFF20, 0xFF3A, LB_ID},
+        {0xFF3C, 0xFF3C, LB_ID},
+        {0xFF3E, 0xFF5A, LB_ID},
+        {0xFF5C, 0xFF5C, LB_ID},
+        {0xFF5E, 0xFF5E, LB_ID},
+        {0xFF61, 0xFF61, LB_CL},
+        {0xFF64, 0xFF64, LB_CL},
+        {0xFF65, 0xFF65, LB_NS},
+        {0xFF9E, 0xFF9F, LB_NS},
+        {0xFFE0, 0xFFE0, LB_PO},
+        {0xFFE1, 0xFFE1, LB_PR},
+        {0xFFE5, 0xFFE6, LB_PR},
+        {0xFFFC, 0xFFFC, LB_CB},
+        {0x1F000, 0x1F0FF, LB_ID},
+        {0x1F1E6, 0x1F1FF, LB_RI},
+        {0x1F200, 0x1F384, LB_ID},
+        {0x1F385, 0x1F385, LB_EB},
+        {0x1F386, 0x1F3C2, LB_ID},
+        {0x1F3C3, 0x1F3C4, LB_EB},
+        {0x1F3C5, 0x1F3C9, LB_ID},
+        {0x1F3CA, 0x1F3CC, LB_EB},
+        {0x1F3CD, 0x1F3FA, LB_ID},
+        {0x1F3FB, 0x1F3FF, LB_EM},
+        {0x1F400, 0x1F441, LB_ID},
+        {0x1F442, 0x1F443, LB_EB},
+        {0x1F444, 0x1F445, LB_ID},
+        {0x1F446, 0x1F450, LB_EB},
+        {0x1F451, 0x1F465, LB_ID},
+        {0x1F466, 0x1F478, LB_EB},
+        {0x1F479, 0x1F47B, LB_ID},
+        {0x1F47C, 0x1F47C, LB_EB},
+        {0x1F47D, 0x1F480, LB_ID},
+        {0x1F481, 0x1F483, LB_EB},
+        {0x1F484, 0x1F484, LB_ID},
+        {0x1F485, 0x1F487, LB_EB},
+        {0x1F488, 0x1F4A9, LB_ID},
+        {0x1F4AA, 0x1F4AA, LB_EB},
+        {0x1F4AB, 0x1F5FF, LB_ID},
+        {0x1F600, 0x1F644, LB_ID},
+        {0x1F645, 0x1F647, LB_EB},
+        {0x1F648, 0x1F64A, LB_ID},
+        {0x1F64B, 0x1F64F, LB_EB},
+        {0x1F650, 0x1F6FF, LB_ID},
+        {0x1F774, 0x1F77F, LB_ID},
+        {0x1F7D5, 0x1F8FF, LB_ID},
+        {0x1F900, 0x1F90B, LB_ID},
+        {0x1F90C, 0x1F90C, LB_EB},
+        {0x1F90D, 0x1F90E, LB_ID},
+        {0x1F90F, 0x1F90F, LB_EB},
+        {0x1F910, 0x1F917, LB_ID},
+        {0x1F918, 0x1F91F, LB_EB},
+        {0x1F920, 0x1F925, LB_ID},
+        {0x1F926, 0x1F926, LB_EB},
+        {0x1F927, 0x1F92F, LB_ID},
+        {0x1F930, 0x1F939, LB_EB},
+        {0x1F93A, 0x1F93B, LB_ID},
+        {0x1F93C, 0x1F93E, LB_EB},
+        {0x1F93F, 0x1F9FF, LB_ID},
+        {0x1FA00, 0x1FAFF, LB_ID},
+        {0x1FC00, 0x1FFFD, LB_ID},
+        {0x20000, 0x2FFFD, LB_ID},
+        {0x30000, 0x3FFFD, LB_ID},
+        {0xE0001, 0xE01EF, LB_CM},
+    };
+
+    bool is_south_east_asian(uint32_t c)
+    {
+        return (c >= 0x0E00 && c <= 0x0EFF) || (c >= 0x1000 && c <= 0x109F) || (c >= 0x1780 && c <= 0x17FF) ||
+               (c >= 0x1950 && c <= 0x19DF) || (c >= 0x1A20 && c <= 0x1AAF) || (c >= 0xA9E0 && c <= 0xA9FF) ||
+               (c >= 0xAA60 && c <= 0xAADF);
+    }
+
+    // LB30의 East Asian Width F/W/H 괄호는 예외다
+    bool is_wide(uint32_t c)
+    {
+        return (c >= 0x3000 && c <= 0x303F) || (c >= 0xFE30 && c <= 0xFE4F) || (c >= 0xFF00 && c <= 0xFFEF);
+    }
+
+    LineBreakClass class_from_category(uint32_t codepoint)
+    {
+        switch (hb_unicode_general_category(hb_unicode_funcs_get_default(), codepoint))
+        {
+        case HB_UNICODE_GENERAL_CATEGORY_NON_SPACING_MARK:
+        case HB_UNICODE_GENERAL_CATEGORY_SPACING_MARK:
+        case HB_UNICODE_GENERAL_CATEGORY_ENCLOSING_MARK:
+        case HB_UNICODE_GENERAL_CATEGORY_CONTROL:
+        case HB_UNICODE_GENERAL_CATEGORY_FORMAT:
+            return LB_CM;
+        case HB_UNICODE_GENERAL_CATEGORY_DECIMAL_NUMBER:
+            return LB_NU;
+        case HB_UNICODE_GENERAL_CATEGORY_OPEN_PUNCTUATION:
+            return LB_OP;
+        case HB_UNICODE_GENERAL_CATEGORY_CLOSE_PUNCTUATION:
+            return LB_CL;
+        case HB_UNICODE_GENERAL_CATEGORY_INITIAL_PUNCTUATION:
+        case HB_UNICODE_GENERAL_CATEGORY_FINAL_PUNCTUATION:
+            return LB_QU;
+        case HB_UNICODE_GENERAL_CATEGORY_SPACE_SEPARATOR:
+            return LB_BA;
+        case HB_UNICODE_GENERAL_CATEGORY_LINE_SEPARATOR:
+        case HB_UNICODE_GENERAL_CATEGORY_PARAGRAPH_SEPARATOR:
+            return LB_BK;
+        case HB_UNICODE_GENERAL_CATEGORY_CURRENCY_SYMBOL:
+            return LB_PR;
+        case HB_UNICODE_GENERAL_CATEGORY_DASH_PUNCTUATION:
+            return LB_BA;
+        default:
+            return LB_AL;
+        }
+    }
+
+    bool is_alphabetic(LineBreakClass c) { return c == LB_AL || c == LB_HL; }
+    bool is_hangul(LineBreakClass c) { return c == LB_JL || c == LB_JV || c == LB_JT || c == LB_H2 || c == LB_H3; }
+    bool is_ideographic(LineBreakClass c) { return c == LB_ID || c == LB_EB || c == LB_EM; }
+}
+
+LineBreakClass line_break_class(uint32_t codepoint)
+{
+    if (codepoint < 0x80)
+        return ASCII_CLASSES[codepoint];
+
+    // Hangul 음절: 받침이 없으면 LV (H2), 있으면 LVT (H3)
+    if (codepoint >= 0xAC00 && codepoint <= 0xD7A3)
+        return (codepoint - 0xAC00) % 28 == 0 ? LB_H2 : LB_H3;
+
+    const ClassRange *end = CLASS_RANGES + sizeof(CLASS_RANGES) / sizeof(CLASS_RANGES[0]);
+    const ClassRange *range = std::upper_bound(CLASS_RANGES, end, codepoint,
+                                               [](uint32_t c, const ClassRange &r) { return c < r.first; });
+    if (range != CLASS_RANGES && codepoint <= range[-1].last)
+        return range[-1].lb;
+
+    LineBreakClass lb = class_from_category(codepoint);
+
+    // LB1: SA는 결합 기호(Mn, Mc)면 CM, 아니면 AL
+    if (is_south_east_asian(codepoint) && lb != LB_CM)
+        return LB_AL;
+    return lb;
+}
+
+void LineBreaker::find(const uint32_t *text, unsigned int length, std::vector<uint8_t> &breaks)
+{
+    breaks.assign(length + 1, LINE_BREAK_NONE);
+    if (length == 0)
+        return;
+    breaks[length] = LINE_BREAK_MANDATORY; // LB3
+
+    classes_.resize(length);
+    for (unsigned int i = 0; i < length; i++)
+        classes_[i] = line_break_class(text[i]);
+
+    // i - 1 까지 본 상태. class는 LB9/LB10을 적용한 것 (결합 기호는 앞 글자를 따른다)
+    LineBreakClass prev = classes_[0];
+    if (prev == LB_CM || prev == LB_ZWJ)
+        prev = LB_AL;
+    LineBreakClass prevPrev = LB_SP;    // LB21a용, prev 앞의 class
+    LineBreakClass beforeSpaces = prev; // 공백을 건너뛴 마지막 class (LB14-LB17)
+    unsigned int prevIndex = 0;         // prev class를 정한 글자
+    bool zwBeforeSpaces = prev == LB_ZW;
+    unsigned int regionalIndicators = prev == LB_RI ? 1 : 0;
+
+    for (unsigned int i = 1; i < length; i++)
+    {
+        const LineBreakClass a = prev;
+        LineBreakClass b = classes_[i];
+        const bool afterZwj = classes_[i - 1] == LB_ZWJ;
+
+        uint8_t action = LINE_BREAK_ALLOWED;
+        bool attached = false;
+
+        if (a == LB_BK || a == LB_LF || a == LB_NL || (a == LB_CR && b != LB_LF))
+            action = LINE_BREAK_MANDATORY; // LB4, LB5
+        else if (a == LB_CR)
+            action = LINE_BREAK_NONE; // CR × LF
+        else if (b == LB_BK || b == LB_CR || b == LB_LF || b == LB_NL)
+            action = LINE_BREAK_NONE; // LB6
+        else if (b == LB_SP || b == LB_ZW)
+            action = LINE_BREAK_NONE; // LB7
+        else if (zwBeforeSpaces)
+            action = LINE_BREAK_ALLOWED; // LB8
+        else if (afterZwj)
+            action = LINE_BREAK_NONE; // LB8a
+        else if ((b == LB_CM || b == LB_ZWJ) && a != LB_SP)
+        {
+            action = LINE_BREAK_NONE; // LB9
+            attached = true;
+        }
+        else
+        {
+            if (b == LB_CM || b == LB_ZWJ)
+                b = LB_AL; // LB10
+
+            if (a == LB_WJ || b == LB_WJ)
+                action = LINE_BREAK_NONE; // LB11
+            else if (a == LB_GL)
+                action = LINE_BREAK_NONE; // LB12
+            else if (b == LB_GL && a != LB_SP && a != LB_BA && a != LB_HY)
+                action = LINE_BREAK_NONE; // LB12a
+            else if (b == LB_CL || b == LB_CP || b == LB_EX || b == LB_IS || b == LB_SY)
+                action = LINE_BREAK_NONE; // LB13
+            else if (beforeSpaces == LB_OP)
+                action = LINE_BREAK_NONE; // LB14
+            else if (beforeSpaces == LB_QU && b == LB_OP)
+                action = LINE_BREAK_NONE; // LB15
+            else if ((beforeSpaces == LB_CL || beforeSpaces == LB_CP) && b == LB_NS)
+                action = LINE_BREAK_NONE; // LB16
+            else if (beforeSpaces == LB_B2 && b == LB_B2)
+                action = LINE_BREAK_NONE; // LB17
+            else if (a == LB_SP)
+                action = LINE_BREAK_ALLOWED; // LB18
+            else if (a == LB_QU || b == LB_QU)
+                action = LINE_BREAK_NONE; // LB19
+            else if (a == LB_CB || b == LB_CB)
+                action = LINE_BREAK_ALLOWED; // LB20
+            else if (b == LB_BA || b == LB_HY || b == LB_NS || a == LB_BB)
+                action = LINE_BREAK_NONE; // LB21
+            else if (prevPrev == LB_HL && (a == LB_HY || a == LB_BA))
+                action = LINE_BREAK_NONE; // LB21a
+            else if (a == LB_SY && b == LB_HL)
+                action = LINE_BREAK_NONE; // LB21b
+            else if (b == LB_IN)
+                action = LINE_BREAK_NONE; // LB22
+            else if ((is_alphabetic(a) && b == LB_NU) || (a == LB_NU && is_alphabetic(b)))
+                action = LINE_BREAK_NONE; // LB23
+            else if ((a == LB_PR && is_ideographic(b)) || (is_ideographic(a) && b == LB_PO))
+                action = LINE_BREAK_NONE; // LB23a
+            else if (((a == LB_PR || a == LB_PO) && is_alphabetic(b)) || (is_alphabetic(a) && (b == LB_PR || b == LB_PO)))
+                action = LINE_BREAK_NONE; // LB24
+            else if (((a == LB_CL || a == LB_CP || a == LB_NU) && (b == LB_PO || b == LB_PR)) ||
+                     ((a == LB_PO || a == LB_PR) && (b == LB_OP || b == LB_NU)) ||
+                     ((a == LB_HY || a == LB_IS || a == LB_NU || a == LB_SY) && b == LB_NU))
+                action = LINE_BREAK_NONE; // LB25 (숫자 regex 대신 pair 규칙)
+            else if ((a == LB_JL && (b == LB_JL || b == LB_JV || b == LB_H2 || b == LB_H3)) ||
+                     ((a == LB_JV || a == LB_H2) && (b == LB_JV || b == LB_JT)) ||
+                     ((a == LB_JT || a == LB_H3) && b == LB_JT))
+                action = LINE_BREAK_NONE; // LB26
+            else if ((is_hangul(a) && b == LB_PO) || (a == LB_PR && is_hangul(b)))
+                action = LINE_BREAK_NONE; // LB27
+            else if (is_alphabetic(a) && is_alphabetic(b))
+                action = LINE_BREAK_NONE; // LB28
+            else if (a == LB_IS && is_alphabetic(b))
+                action = LINE_BREAK_NONE; // LB29
+            else if (((is_alphabetic(a) || a == LB_NU) && b == LB_OP && !is_wide(text[i])) ||
+                     (a == LB_CP && (is_alphabetic(b) || b == LB_NU) && !is_wide(text[prevIndex])))
+                action = LINE_BREAK_NONE; // LB30
+            else if (a == LB_RI && b == LB_RI && regionalIndicators % 2 == 1)
+                action = LINE_BREAK_NONE; // LB30a
+            else if (a == LB_EB && b == LB_EM)
+                action = LINE_BREAK_NONE; // LB30b
+        }
+
+        breaks[i] = action;
+
+        if (attached)
+            continue;
+
+        prevPrev = prev;
+        prev = b;
+        prevIndex = i;
+        if (b != LB_SP)
+        {
+            beforeSpaces = b;
+            zwBeforeSpaces = b == LB_ZW;
+        }
+        regionalIndicators = b == LB_RI ? regionalIndicators + 1 : 0;
+    }
+}
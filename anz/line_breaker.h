@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// UAX#14 line breaking.
+//
+// 줄 바꿈 class는 자주 쓰는 영역(ASCII, Latin-1, 일반 문장부호, CJK, Hangul, emoji)을 표로 갖고,
+// 나머지는 HarfBuzz general category로 어림한다 (UCD LineBreak.txt 전체가 아니다).
+// 규칙은 LB2-LB31 순서를 따르지만 완전한 구현은 아니다:
+//  - LB25는 숫자 regex (PR? (OP|HY)? NU (NU|SY|IS)* (CL|CP)? (PR|PO)?) 대신 이웃한 두 class의 pair 규칙만 본다.
+//    흔한 숫자는 같게 나오지만, 두 글자보다 먼 문맥을 봐야 하는 경우는 regex와 다를 수 있다
+//  - LB15, LB19는 Unicode 15.0 형태다 (QU의 Pi/Pf 구분 없음). LB28a(Brahmic aksara)는 없다
+//  - SA(Thai, Lao, Khmer, Myanmar)는 사전에 따른 단어 나눔이 없다. AL로 보므로 공백에서만 나뉜다
+
+enum LineBreakClass : uint8_t
+{
+    LB_BK, LB_CR, LB_LF, LB_NL, LB_SP, LB_ZW, LB_ZWJ, LB_CM, LB_WJ, LB_GL,
+    LB_OP, LB_CL, LB_CP, LB_QU, LB_EX, LB_IS, LB_SY, LB_NS,
+    LB_PR, LB_PO, LB_NU, LB_AL, LB_HL, LB_ID, LB_IN, LB_HY, LB_BA, LB_BB, LB_B2, LB_CB,
+    LB_H2, LB_H3, LB_JL, LB_JV, LB_JT, LB_RI, LB_EB, LB_EM,
+};
+
+enum LineBreak : uint8_t
+{
+    LINE_BREAK_NONE,      // 여기서 나누면 안 된다
+    LINE_BREAK_ALLOWED,   // 나눌 수 있다
+    LINE_BREAK_MANDATORY, // 반드시 나눈다 (BK, CR, LF, NL 뒤, 그리고 text 끝)
+};
+
+// LB1까지 적용한 class (AI/SG/XX -> AL, SA -> AL 또는 CM, CJ -> NS)
+LineBreakClass line_break_class(uint32_t codepoint);
+
+class LineBreaker
+{
+public:
+    // breaks[i]는 text[i] 앞에서의 break, i는 [0, length]. breaks[0]은 항상 NONE, breaks[length]는 MANDATORY.
+    // breaks의 capacity는 재사용된다
+    void find(const uint32_t *text, unsigned int length, std::vector<uint8_t> &breaks);
+
+private:
+    std::vector<LineBreakClass> classes_;
+};
@@ -3,6 +3,14 @@
 #include <cmath>
 #include <vector>
 #include <cassert>
+#include <cstring>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <memory>
+#include <atomic>
 
 #include <fontconfig/fontconfig.h>
 // for fontconfig
@@ -12,7 +20,6 @@
 // for freetype
 
 #include <hb.h>
-#include <hb-ft.h>
 // for harfbuzz
 
 #include <cairo.h>
@@ -22,13 +29,171 @@
 #include <fribidi/fribidi.h>
 // for fribidi
 
+#include "bidi_itemizer.h"
+#include "bounded_queue.h"
+#include "composite.h"
+#include "font_fallback.h"
+#include "font_index.h"
+#include "font_map.h"
+#include "font_subset.h"
+#include "glyph_cache.h"
+#include "glyph_runs.h"
+#include "image_writer.h"
+#include "ink_bounds.h"
+#include "paragraph_layout.h"
+#include "paragraph_reader.h"
+#include "sdf_atlas.h"
+#include "shape_cache.h"
+#include "stage_bench.h"
+#include "surface_pool.h"
+#include "trace.h"
+#include "work_steal.h"
+
 const char *FONT_NAME = "Arial";
-const int FONT_SIZE = 36;
-const double MARGIN = FONT_SIZE * .5;
-const int MAX_STR_LEN = 10000;
+const int FONT_SIZE = 36; // 기본 font size, RenderContext마다 바꿀 수 있다
+const int SHAPE_CACHE_SIZE = 4096; // 단어 단위 shaping cache entry 수, 0이면 끔
 
 const std::string str = "Ленивый рыжий кот شَدَّة latin العَرَبِية";
 
+// band로 나눠 그릴 때: worker마다 band 몇개 (work stealing으로 고르게), band 최소 높이, 줄 ink 여유 (pixel)
+const int BANDS_PER_THREAD = 4;
+const int MIN_BAND_HEIGHT = 64;
+const int MAX_SURFACE_SIZE = 32767; // cairo image surface 한 변의 한도. 더 높은 image는 band로만 그린다
+const double BAND_INK_PAD = 2.;
+
+// --pipeline: stage 사이 queue 크기 (job 수)
+const size_t PIPELINE_QUEUE_SIZE = 8;
+
+// --bench mode에서 corpus마다 도는 길이 (codepoint 수)와 font size
+const unsigned int BENCH_LENGTHS[] = {16, 64, 256};
+const int BENCH_FONT_SIZES[] = {12, 36, 72};
+
+// fallback chain의 font 하나. RenderContext마다 처음 쓸 때 연다
+struct FallbackFace
+{
+    bool opened = false;
+    FT_Face face = NULL; // 열지 못했으면 NULL, primary로 대신 그린다
+    uint32_t instance = 0; // GlyphCache::instanceOf(face)
+    hb_font_t *hb_font = NULL;
+    cairo_font_face_t *cairo_face = NULL;
+};
+
+// 한 font로 shape하는 구간 (bidi run을 font fallback으로 다시 나눈 것), visual order
+struct FontItem
+{
+    unsigned int start;
+    unsigned int length;
+    unsigned int font; // FontFallback 번호, 0은 primary
+    const BidiRun *run;
+};
+
+// 그릴 줄 하나. 한 줄이면 my_harfbuzz()의 결과, --width면 ParagraphLayout의 줄이다
+struct LineView
+{
+    const hb_glyph_info_t *info;
+    const hb_glyph_position_t *pos;
+    unsigned int count;
+    const GlyphSegment *segments; // start는 이 줄의 info 기준
+    size_t segmentCount;
+    double x; // 줄이 시작하는 x (RTL paragraph는 오른쪽에 맞춘다)
+};
+
+// my_cairo_draw()에서 band 하나를 그리는 worker의 scratch
+struct RasterScratch
+{
+    SdfRenderer sdf_renderer;          // --sdf, coverage mask
+    std::vector<cairo_glyph_t> glyphs; // device 좌표로 옮긴 glyph
+};
+
+// thread 하나가 쓰는 font instance와 scratch buffer.
+// FT_Face는 thread-safe하지 않으므로 render farm의 worker마다 하나씩 만든다.
+struct RenderContext
+{
+    // my_fribidi()의 결과: 논리 순서 UTF-32와 visual order run 목록. buffer는 job 사이에 재사용된다
+    BidiItemizer bidi;
+
+    int font_size = FONT_SIZE; // open_font() 전에 정한다
+
+    FT_Library library = NULL;
+    FT_Face face = NULL;
+    uint32_t face_instance = 0; // GlyphCache::instanceOf(face), open_font()에서 구한다
+
+    hb_font_t *hb_font = NULL;
+    hb_buffer_t *hb_buffer = NULL;
+
+    ShapeCache shape_cache{SHAPE_CACHE_SIZE};
+
+    std::vector<FallbackFace> fallback_faces; // FontFallback 번호로 찾는다, [0]은 쓰지 않음
+    std::vector<FontItem> font_items;
+    std::vector<GlyphSegment> glyph_segments;
+
+    std::vector<GlyphRunInput> layout_runs; // my_layout()에서 glyph_segments를 옮겨 담는 곳
+
+    // item이 여러개면 item별 glyph를 visual order로 이어 붙이는 곳
+    std::vector<hb_glyph_info_t> line_infos;
+    std::vector<hb_glyph_position_t> line_positions;
+
+    const hb_glyph_info_t *info = NULL;
+    const hb_glyph_position_t *pos = NULL;
+    unsigned int glyph_count = 0; // cache hit이면 hb_buffer에는 glyph가 아니라 unicode가 들어있다
+    hb_direction_t direction = HB_DIRECTION_LTR; // 줄 전체의 진행 방향, glyph는 항상 왼쪽부터 놓인다
+
+    // --width: 여러 줄 layout. 편집하면 바뀐 줄만 다시 만든다
+    ParagraphLayout paragraph;
+    std::vector<LineView> lines; // 그릴 줄들, my_harfbuzz() 또는 my_paragraph()가 채운다
+
+    cairo_font_face_t *cairo_face = NULL;
+
+    GlyphCache glyph_cache;
+
+    // my_cairo_draw()에서 job마다 할당하지 않도록 재사용한다 (band로 나누면 slice surface / cairo_t는 band마다 만든다)
+    GlyphExtentsCache glyph_extents; // (font, glyph) -> ink extents, close_font()에서 비우고 한도를 넘어도 비운다
+    std::vector<cairo_glyph_t> cairo_glyphs;
+    SurfacePool surface_pool;
+    std::vector<InkBox> line_ink;
+    std::vector<RasterScratch> raster_scratch; // [0]은 한 thread로 그릴 때, band로 나누면 worker마다 하나
+    std::unique_ptr<WorkStealingPool> raster_pool; // band worker들, raster_threads가 바뀔 때만 다시 만든다
+};
+
+struct Job
+{
+    std::string outFile;
+    std::string text;
+};
+
+// --pipeline에서 stage 사이를 오가는 job slot. shape stage가 glyph를 채우고 raster stage가 slot의 surface에 그리고,
+// encode stage가 파일로 쓴 뒤 slot을 돌려준다. 한번에 한 stage만 만지므로 lock이 없고, buffer는 다음 job이 다시 쓴다
+struct PipelineJob
+{
+    size_t job = 0;
+
+    // RenderContext의 shaping 결과. 한 줄이면 ctx의 vector와 통째로 바꾸고 (slot이 갖고 있던 vector는 ctx가 받아
+    // 다음 job에 쓴다), 그 밖에는 복사한다. lines는 아래 vector들을 가리킨다
+    std::vector<hb_glyph_info_t> infos;
+    std::vector<hb_glyph_position_t> positions;
+    std::vector<GlyphSegment> segments; // start는 줄의 info 기준
+    std::vector<LineView> lines;
+    unsigned int glyph_count = 0;
+    hb_direction_t direction = HB_DIRECTION_LTR;
+
+    SurfacePool surfaces; // 이 slot의 pixel buffer
+    ImageView image;      // raster stage가 그린 것, 그리지 못했으면 data가 NULL
+};
+
+// --pipeline stage 하나의 thread들이 일한 시간
+struct PipelineStage
+{
+    std::atomic<uint64_t> busy_ns{0}; // queue에서 꺼낸 뒤 다음 queue에 넣기 전까지
+    std::atomic<uint64_t> jobs{0};
+
+    void add(std::chrono::steady_clock::time_point start)
+    {
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        busy_ns.fetch_add(elapsed.count(), std::memory_order_relaxed);
+        jobs.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
 namespace
 { // global variables
 
@@ -36,22 +201,113 @@ namespace
     FcPattern *pat;
     FcPattern *font;
 
-    FT_Library library;
-    FT_Face face;
+    int fontFaceIndex; // font file 안에서의 face index (ttc 등)
 
-    hb_font_t *hb_font;
-    hb_buffer_t *hb_buffer;
+    // font file mmap. 모든 RenderContext의 FT_Face, hb_face_t가 같은 mapping을 읽는다
+    FontMaps font_maps;
+    MappedFont *font_map = NULL; // primary font
 
-    hb_glyph_info_t *info;
-    hb_glyph_position_t *pos;
+    RenderContext main_context;
 
-    cairo_surface_t *cairo_surface;
-    cairo_t *cr;
-    cairo_font_face_t *cairo_face;
+    // primary font에 없는 글자를 그릴 font chain, 모든 RenderContext가 공유한다
+    FontFallback font_fallback;
+
+    bool verbose = true;          // batch mode에서는 glyph dump를 끈다
+    bool use_glyph_cache = false; // cairo_show_glyphs 대신 cache된 glyph mask를 직접 합성
+    bool use_sdf = false;         // font마다 한번 만든 SDF atlas에서 어떤 크기든 그린다
+    bool crop_to_ink = false;     // surface를 줄 높이 대신 실제 ink 영역(+1px)에 맞춘다
+    int wrap_width = 0;           // 0보다 크면 이 폭(pixel)으로 줄을 나눈다
+    bool justify = false;         // 나눈 줄을 양쪽 정렬
+    int threads = 1;              // batch mode render farm의 worker 수
+    int raster_threads = 1;       // 한 image를 가로 band로 나눠 그리는 worker 수
+    int pipeline_threads[3] = {}; // --pipeline: shape, raster, encode stage의 thread 수, 0이면 끔
+    const char *font_file = NULL; // fontconfig 대신 이 file을 primary font로 쓴다
+
+    ImageOptions image_options; // 출력 format, PNG 압축 level / filter, mask에 입힐 색
+
+    // --mask: ARGB32 대신 A8 (또는 1bit A1) coverage만 그리고, 글자색 / 배경색은 encode할 때 입힌다
+    cairo_format_t output_format = CAIRO_FORMAT_ARGB32;
+
+    // --layout: 그리지 않고 shaping 결과만 binary 또는 JSON으로 쓴다. worker들이 같이 쓴다
+    const char *layout_file = NULL;
+    bool layout_json = false;
+    GlyphRunWriter layout_writer;
+    GlyphRunJsonWriter layout_json_writer;
+    std::mutex layout_mutex;
+
+    GlyphNameCache glyph_names; // verbose dump용, main_context의 font만 쓴다
+
+    // FontFallback 번호마다 SDF atlas 하나. 만든 뒤에는 바뀌지 않으므로 모든 worker가 같이 읽는다.
+    // sdf_mutex는 표만 지킨다. atlas는 lock 밖에서 font마다 한번 만들고 (once), 다 만들면 ready를 켠다
+    struct SdfEntry
+    {
+        std::once_flag once;
+        std::atomic<bool> ready{false};
+        SdfAtlas atlas;
+    };
+    std::vector<std::unique_ptr<SdfEntry>> sdf_atlases;
+    std::mutex sdf_mutex;
+
+    bool stdout_data = false; // image나 layout을 stdout으로 쓰면 통계는 stderr로 보낸다
+}
+
+std::ostream &report()
+{
+    return stdout_data ? std::cerr : std::cout;
 }
 
 std::string my_fontconfig()
 {
+    TraceSpan span(TRACE_FONTCONFIG);
+
+    // --font-file: 찾지 않고 그 file을 primary로 쓴다 (subset font 등). coverage는 cmap에서 만든다
+    if (font_file)
+    {
+        fontFaceIndex = 0;
+
+        CoverageBitmap coverage;
+        hb_set_t *unicodes = hb_set_create();
+        hb_face_collect_unicodes(font_maps.open(font_file)->face(fontFaceIndex), unicodes);
+        hb_codepoint_t first = HB_SET_VALUE_INVALID;
+        hb_codepoint_t last = HB_SET_VALUE_INVALID;
+        while (hb_set_next_range(unicodes, &first, &last))
+            coverage.addRange(first, last);
+        hb_set_destroy(unicodes);
+        font_fallback.setPrimary(FONT_NAME, font_file, fontFaceIndex, std::move(coverage));
+
+        if (verbose)
+            std::cout << "fontFile: " << font_file << " (--font-file)\n\n";
+
+        return font_file;
+    }
+
+    // 먼저 on-disk font index를 본다.
+    // index가 최신이고 FONT_NAME이 들어있으면 fontconfig를 초기화하지 않고 바로 끝난다.
+    std::string indexPath = FontIndex::defaultPath();
+    {
+        FontIndex fontIndex;
+        if (fontIndex.open(indexPath) && fontIndex.fresh())
+        {
+            if (const FontIndexFont *indexed = fontIndex.find(FONT_NAME))
+            {
+                std::string fontFile = fontIndex.string(indexed->file);
+                fontFaceIndex = indexed->faceIndex;
+
+                CoverageBitmap coverage;
+                uint32_t rangeCount;
+                const FontIndexRange *ranges = fontIndex.coverage(*indexed, rangeCount);
+                for (uint32_t i = 0; i < rangeCount; i++)
+                    coverage.addRange(ranges[i].first, ranges[i].last);
+                font_fallback.setPrimary(FONT_NAME, fontFile, fontFaceIndex, std::move(coverage));
+
+                if (verbose)
+                    std::cout << "fontFile: " << fontFile << " (font index)\n\n";
+
+                return fontFile;
+            }
+        }
+    }
+
     // FontConfig 사용하기
 
     FcInit(); // initializes Fontconfig
@@ -83,49 +339,194 @@ std::string my_fontconfig()
 
             fontFile = (char *)file;
 
-            std::cout << "fontFile: " << fontFile << '\n';
+            if (FcPatternGetInteger(font, FC_INDEX, 0, &fontFaceIndex) != FcResultMatch)
+                fontFaceIndex = 0;
+
+            CoverageBitmap coverage;
+            FcCharSet *charset = NULL;
+            if (FcPatternGetCharSet(font, FC_CHARSET, 0, &charset) == FcResultMatch)
+                coverage.addCharSet(charset);
+            font_fallback.setPrimary(FONT_NAME, fontFile, fontFaceIndex, std::move(coverage), config);
+
+            if (verbose)
+                std::cout << "fontFile: " << fontFile << '\n';
+
+            // 다음 실행부터는 index에서 바로 찾도록 다시 만든다
+            if (!FontIndex::build(indexPath, config, FONT_NAME, font) && verbose)
+                std::cout << "font index write failed: " << indexPath << '\n';
         }
     }
 
-    std::cout << "\n";
+    if (verbose)
+        std::cout << "\n";
 
     return fontFile;
 }
 
-void my_freetype(std::string &fontFile)
+void open_font(RenderContext &ctx)
 {
     FT_Error error;
 
-    // library 초기화
-    if (error = FT_Init_FreeType(&library))
+    // library 초기화, FT_Library도 thread마다 따로 둔다
+    if (error = FT_Init_FreeType(&ctx.library))
         abort();
 
-    // font file로 부터 font face 로딩
-    if (error = FT_New_Face(library,
-                            fontFile.c_str(),
-                            0,
-                            &face))
+    // mmap해둔 font file로부터 font face 로딩
+    if (error = FT_New_Memory_Face(ctx.library,
+                                   font_map->data(),
+                                   font_map->size(),
+                                   fontFaceIndex,
+                                   &ctx.face))
         abort();
 
-    /*
-    // memory로부터 font file을 이미 로드했을 때
-    error = FT_New_Memory_Face(library, buffer, size, 0, &face);
-    */
-
     // font size 설정
     if (error = FT_Set_Char_Size(
-            face,
+            ctx.face,
             0,              // char_width 0일시 height와 동기화됨
-            FONT_SIZE * 64, // char_height, FONT_SIZE pt
+            ctx.font_size * 64, // char_height, font_size pt
             0,              // horizontal device resolution
             0               // vertical device resolution, 둘다 0일시 자동으로 72 dpi로 설정됨.
             ))
         abort();
 
+    ctx.face_instance = GlyphCache::instanceOf(ctx.face);
+
     /*
     fontsize를 pixel로 설정
     error = FT_Set_Pixel_Sizes(face, 0, 16);
     */
+}
+
+hb_font_t *create_hb_font(MappedFont *map, int faceIndex, FT_Face face)
+{
+    // hb_face_t는 FreeType을 거치지 않고 같은 mapping에서 table을 바로 읽는다.
+    // scale은 hb_ft_font_create()와 같은 계산이라 position은 그대로 26.6 단위다.
+    hb_font_t *hb_font = hb_font_create(map->face(faceIndex));
+    hb_font_set_scale(hb_font,
+                      ((uint64_t)face->size->metrics.x_scale * face->units_per_EM + (1u << 15)) >> 16,
+                      ((uint64_t)face->size->metrics.y_scale * face->units_per_EM + (1u << 15)) >> 16);
+    hb_font_set_ppem(hb_font, face->size->metrics.x_ppem, face->size->metrics.y_ppem);
+    return hb_font;
+}
+
+FallbackFace &open_fallback(RenderContext &ctx, unsigned int index)
+{
+    if (ctx.fallback_faces.size() <= index)
+        ctx.fallback_faces.resize(index + 1);
+
+    FallbackFace &fallback = ctx.fallback_faces[index];
+    if (fallback.opened)
+        return fallback;
+    fallback.opened = true;
+
+    // fallback font도 mmap해서 연다. 실패하면 face는 NULL로 남고 primary로 그린다
+    const FallbackFont &font = font_fallback.font(index);
+    MappedFont *map = font_maps.open(font.file);
+    if (!map || FT_New_Memory_Face(ctx.library, map->data(), map->size(), font.faceIndex, &fallback.face))
+    {
+        fallback.face = NULL;
+        return fallback;
+    }
+
+    if (FT_Set_Char_Size(fallback.face, 0, ctx.font_size * 64, 0, 0))
+    {
+        FT_Done_Face(fallback.face);
+        fallback.face = NULL;
+        return fallback;
+    }
+
+    fallback.hb_font = create_hb_font(map, font.faceIndex, fallback.face);
+    fallback.instance = GlyphCache::instanceOf(fallback.face);
+
+    if (verbose)
+        std::cout << "fallback font " << index << ": " << font.file << '\n';
+
+    return fallback;
+}
+
+FT_Face face_of(RenderContext &ctx, unsigned int font)
+{
+    return font ? ctx.fallback_faces[font].face : ctx.face;
+}
+
+uint32_t instance_of(RenderContext &ctx, unsigned int font)
+{
+    return font ? ctx.fallback_faces[font].instance : ctx.face_instance;
+}
+
+hb_font_t *hb_font_of(RenderContext &ctx, unsigned int font)
+{
+    return font ? ctx.fallback_faces[font].hb_font : ctx.hb_font;
+}
+
+cairo_font_face_t *cairo_face_of(RenderContext &ctx, unsigned int font)
+{
+    if (!font)
+    {
+        if (!ctx.cairo_face)
+            ctx.cairo_face = cairo_ft_font_face_create_for_ft_face(ctx.face, 0);
+        return ctx.cairo_face;
+    }
+
+    FallbackFace &fallback = ctx.fallback_faces[font];
+    if (!fallback.cairo_face)
+        fallback.cairo_face = cairo_ft_font_face_create_for_ft_face(fallback.face, 0);
+    return fallback.cairo_face;
+}
+
+void build_sdf_atlas(RenderContext &ctx, unsigned int font, SdfAtlas &atlas)
+{
+    // size를 바꿔도 되도록 같은 mapping에서 face를 하나 더 열어서 만든다.
+    // 실패하면 빈 atlas로 남고 그 font의 glyph는 그리지 않는다
+    const FallbackFont &fallback = font_fallback.font(font);
+    MappedFont *map = font ? font_maps.open(fallback.file) : font_map;
+    FT_Face face;
+    int faceIndex = font ? fallback.faceIndex : fontFaceIndex;
+    if (!map || FT_New_Memory_Face(ctx.library, map->data(), map->size(), faceIndex, &face))
+    {
+        std::cerr << "sdf: cannot open font " << font << '\n';
+        return;
+    }
+
+    if (!atlas.build(face))
+        std::cerr << "sdf: cannot build atlas for font " << font << '\n';
+    FT_Done_Face(face);
+
+    if (verbose)
+        std::cout << "SDF atlas " << font << ": " << atlas.glyphCount() << " glyphs, " << atlas.width() << "x"
+                  << atlas.height() << ", " << atlas.buildSeconds() << " s\n";
+}
+
+const SdfAtlas &sdf_atlas_of(RenderContext &ctx, unsigned int font)
+{
+    SdfEntry *entry;
+    {
+        std::lock_guard<std::mutex> lock(sdf_mutex);
+        if (sdf_atlases.size() <= font)
+            sdf_atlases.resize(font + 1);
+        if (!sdf_atlases[font])
+            sdf_atlases[font].reset(new SdfEntry);
+        entry = sdf_atlases[font].get();
+    }
+
+    // 같은 font를 기다리는 worker만 막히고, 다른 font의 atlas는 동시에 만들 수 있다
+    std::call_once(entry->once, [&] {
+        build_sdf_atlas(ctx, font, entry->atlas);
+        entry->ready.store(true, std::memory_order_release);
+    });
+    return entry->atlas;
+}
+
+void my_freetype(std::string &fontFile)
+{
+    TraceSpan span(TRACE_FREETYPE);
+
+    // font file은 한번만 mmap하고, face는 RenderContext마다 이 mapping에서 만든다
+    font_map = font_maps.open(fontFile);
+    if (!font_map)
+        abort();
+
+    open_font(main_context);
 
     /*
         // 아래와 같이 직접 shaping 해볼 수 있다.
@@ -157,103 +558,147 @@ void my_freetype(std::string &fontFile)
     */
 }
 
-std::string my_fribidi()
+void my_fribidi(RenderContext &ctx, const std::string &str)
 {
     // Fribidi 사용하기
-    std::vector<FriBidiChar> fribidi_in_char(MAX_STR_LEN);
-
-    // charset을 unicode로 바꿈
-    FriBidiStrIndex fribidi_len = fribidi_charset_to_unicode(
-        FRIBIDI_CHAR_SET_UTF8,
-        str.c_str(),
-        str.size(),
-        fribidi_in_char.data());
-
-    FriBidiCharType fribidi_pbase_dir = FRIBIDI_TYPE_LTR;
-    std::vector<FriBidiChar> fribidi_visual_char(MAX_STR_LEN + 1);
-
-    std::cout << "Before Fribidi: " << str << '\n';
-
-    // RTL은 반대로 뒤집어줌
-    fribidi_boolean stat = fribidi_log2vis(
-        /* input */
-        fribidi_in_char.data(), // unicode input string
-        fribidi_len,            // length
-        &fribidi_pbase_dir,     // input and outpu base direction
-        /* output */
-        fribidi_visual_char.data(), // visual string
-        NULL,                       // logical string to visual string position mapping
-        NULL,                       // visual string to logical string position mapping
-        NULL                        // 각 character의 분류
-    );
-
-    if (!stat)
+    // 글자를 visual order로 뒤집지 않는다. 논리 순서 그대로 embedding level과 script가 같은 run으로 나누고,
+    // 재배치는 my_harfbuzz()에서 run 단위로 glyph를 놓을 때만 한다.
+    TraceSpan span(TRACE_FRIBIDI);
+    if (!ctx.bidi.itemize(str, FRIBIDI_PAR_LTR))
         abort();
+    span.setCount(ctx.bidi.length());
 
-    std::string str_after_fribidi(MAX_STR_LEN, 0);
-
-    // unicode를 charset으로 바꿈
-    const FriBidiStrIndex new_len = fribidi_unicode_to_charset(FRIBIDI_CHAR_SET_UTF8,
-                                                               fribidi_visual_char.data(),
-                                                               fribidi_len,
-                                                               str_after_fribidi.data());
-
-    assert(new_len < MAX_STR_LEN);
-    str_after_fribidi.resize(new_len);
+    if (!verbose)
+        return;
 
-    std::cout << "After Fribidi: " << str_after_fribidi << '\n';
+    std::cout << "Fribidi: " << str << '\n';
+    std::cout << "Bidi runs (visual order):\n";
+    for (const BidiRun &run : ctx.bidi.runs())
+    {
+        char script[5] = {0};
+        hb_tag_to_string(run.script, script);
+        std::cout << "Run: [" << run.start << ", " << run.start + run.length << ")\t\t";
+        std::cout << "Level: " << (int)run.level << "\t\t";
+        std::cout << "Script: " << script << '\n';
+    }
     std::cout << '\n';
-
-    return str_after_fribidi;
 }
 
-void my_harfbuzz(std::string str)
+void my_harfbuzz(RenderContext &ctx)
 {
     // HarfBuzz 사용해보기
+    TraceSpan span(TRACE_HARFBUZZ);
+    ShapeCacheStats before;
+    if (span.active())
+        before = ctx.shape_cache.stats();
 
-    // hb create
-    hb_font = hb_ft_font_create(face, NULL);
-
-    // hb buffer create
-    hb_buffer = hb_buffer_create();
+    // hb create, font는 한번만 만들고 재사용한다
+    if (!ctx.hb_font)
+        ctx.hb_font = create_hb_font(font_map, fontFaceIndex, ctx.face);
 
-    hb_buffer_add_utf8(hb_buffer,
-                       str.c_str(),
-                       -1,  // str의 length, NULL이 terminator면 -1
-                       0,   // buffer의 offset
-                       -1); // 몇 글자 넣을건지, 전부면 -1
-    hb_buffer_guess_segment_properties(hb_buffer);
+    // hb buffer create, 이미 있으면 shape_cache가 내용만 비우고 재사용 (할당된 메모리는 유지됨)
+    if (!ctx.hb_buffer)
+        ctx.hb_buffer = hb_buffer_create();
 
     // 만든다
-    hb_shape(hb_font, hb_buffer, NULL, 0);
+    // run마다 원래 UTF-32 배열에서 direction/script를 지정해 shape한다. 앞뒤 문맥도 같이 넘어간다.
+    // 모든 단어가 cache에 있으면 hb_shape()를 건너뛴다. 없으면 run 전체를 shape하고 단어들을 cache에 넣는다.
+    const BidiItemizer &bidi = ctx.bidi;
+    const uint32_t *text = bidi.text();
+
+    ctx.direction = FRIBIDI_IS_RTL(bidi.baseDirection()) ? HB_DIRECTION_RTL : HB_DIRECTION_LTR;
+    ctx.font_items.clear();
+    ctx.glyph_segments.clear();
+    ctx.line_infos.clear();
+    ctx.line_positions.clear();
+
+    // run을 다시 font 단위로 나눈다. primary에 있는 글자는 bitmap 한번 보고 끝난다
+    for (const BidiRun &run : bidi.runs())
+    {
+        size_t first = ctx.font_items.size();
+        unsigned int end = run.start + run.length;
+        unsigned int start = run.start;
+        unsigned int current = 0;
+        for (unsigned int i = run.start; i < end; i++)
+        {
+            unsigned int font = font_fallback.find(text[i], current);
+            if (font && !open_fallback(ctx, font).face)
+                font = 0;
+
+            if (font != current && i > start)
+            {
+                ctx.font_items.push_back({start, i - start, current, &run});
+                start = i;
+            }
+            current = font;
+        }
+        ctx.font_items.push_back({start, end - start, current, &run});
+
+        // RTL run 안의 item은 오른쪽부터 놓인다
+        if (HB_DIRECTION_IS_BACKWARD(run.direction()))
+            std::reverse(ctx.font_items.begin() + first, ctx.font_items.end());
+    }
+
+    for (const FontItem &item : ctx.font_items)
+    {
+        ctx.shape_cache.shape(hb_font_of(ctx, item.font), ctx.hb_buffer, text, bidi.length(), item.start, item.length,
+                              item.run->direction(), item.run->script, NULL, 0);
+
+        unsigned int count = ctx.shape_cache.length();
+        ctx.glyph_segments.push_back({item.font, (unsigned int)ctx.line_infos.size(), count,
+                                     item.run->direction(), item.run->script});
 
-    // information 획득
-    unsigned int len = hb_buffer_get_length(hb_buffer);
-    info = hb_buffer_get_glyph_infos(hb_buffer, NULL);
-    pos = hb_buffer_get_glyph_positions(hb_buffer, NULL);
+        // RTL도 HarfBuzz가 glyph를 왼쪽부터 내주므로, visual order item을 그대로 이어 붙이면 된다
+        if (ctx.font_items.size() > 1)
+        {
+            const hb_glyph_info_t *infos = ctx.shape_cache.infos();
+            const hb_glyph_position_t *positions = ctx.shape_cache.positions();
+            ctx.line_infos.insert(ctx.line_infos.end(), infos, infos + count);
+            ctx.line_positions.insert(ctx.line_positions.end(), positions, positions + count);
+        }
+    }
 
-    // Raw data 출력
-    std::cout << "Raw buffer: \n";
-    for (unsigned int i = 0; i < len; i++)
+    // information 획득, item이 하나면 복사하지 않는다
+    if (ctx.font_items.size() == 1)
+    {
+        ctx.glyph_count = ctx.shape_cache.length();
+        ctx.info = ctx.shape_cache.infos();
+        ctx.pos = ctx.shape_cache.positions();
+    }
+    else
     {
-        hb_codepoint_t gid = info[i].codepoint;    // Shaping 전 Unicode code point, Shaping 후 Glyph index
-        unsigned int cluster = info[i].cluster;    // 현재 이 글자가 original text의 몇번째 index에 매칭되는지?
-        double x_advance = pos[i].x_advance / 64.; // Advance: 다음 glyph를 놓아햐는 상대 좌표
-        double y_advance = pos[i].y_advance / 64.;
-        double x_offset = pos[i].x_offset / 64.;
-        double y_offset = pos[i].y_offset / 64.;
+        ctx.glyph_count = ctx.line_infos.size();
+        ctx.info = ctx.line_infos.data();
+        ctx.pos = ctx.line_positions.data();
+    }
+
+    unsigned int len = ctx.glyph_count;
+    const hb_glyph_info_t *info = ctx.info;
+    const hb_glyph_position_t *pos = ctx.pos;
 
-        char glyphname[32];
-        hb_font_get_glyph_name(hb_font, gid, glyphname, sizeof(glyphname));
+    ctx.lines.clear();
+    ctx.lines.push_back({info, pos, len, ctx.glyph_segments.data(), ctx.glyph_segments.size(), 0.});
 
-        //        std::cout << "Glyph: " << glyphname << "\t\t";
-        //        std::cout << "Gid: " << gid << "\t\t";
-        //        std::cout << "Cluster: " << cluster << '\n';
-        //        std::cout << "Advance: (" << x_advance << ", " << y_advance << ")\t";
-        //        std::cout << "Offset: (" << x_offset << ", " << y_offset << ")\t";
-        //        std::cout << '\n';
+    if (span.active())
+    {
+        const ShapeCacheStats &after = ctx.shape_cache.stats();
+        span.setCount(len);
+        span.setCache(after.hits - before.hits, after.lookups - before.lookups);
     }
 
+    if (!verbose)
+        return;
+
+    // glyph i를 만든 font (glyph 이름 출력용)
+    auto hb_font_at = [&ctx](unsigned int i) {
+        for (const GlyphSegment &segment : ctx.glyph_segments)
+        {
+            if (i < segment.start + segment.count)
+                return hb_font_of(ctx, segment.font);
+        }
+        return ctx.hb_font;
+    };
+
     // 절대 위치 출력해보기
     std::cout << "Converted to absolute positions:\n";
     {
@@ -266,8 +711,8 @@ void my_harfbuzz(std::string str)
             double x_position = current_x + pos[i].x_offset / 64.;
             double y_position = current_y + pos[i].y_offset / 64.;
 
-            char glyphname[32];
-            hb_font_get_glyph_name(hb_font, gid, glyphname, sizeof(glyphname));
+            // 이름은 (font, glyph)마다 한번만 찾는다
+            const char *glyphname = glyph_names.name(hb_font_at(i), gid);
 
             std::cout << "Glyph: " << glyphname << "\t\t";
             std::cout << "Gid: " << gid << "\t\t";
@@ -283,109 +728,1809 @@ void my_harfbuzz(std::string str)
     }
 }
 
-void my_cairo()
+// ParagraphLayout이 RenderContext의 font fallback chain을 쓰도록 한다
+struct ContextFonts : LayoutFonts
 {
-    // Cairo를 이용해 그리기
-    double width = 2 * MARGIN;
-    double height = 2 * MARGIN;
+    RenderContext &ctx;
 
-    unsigned int len = hb_buffer_get_length(hb_buffer);
-    for (unsigned int i = 0; i < len; i++)
+    explicit ContextFonts(RenderContext &ctx) : ctx(ctx) {}
+
+    unsigned int find(uint32_t codepoint, unsigned int previous) override
     {
-        width += pos[i].x_advance / 64.;
-        height -= pos[i].y_advance / 64.; // HarfBuzz는 y가 커지는 방향이 위쪽을 뜻한다. 세로쓰기를 하면 글자가 아래로 내려가므로, y_advance는 음수가 된다.
+        unsigned int font = font_fallback.find(codepoint, previous);
+        if (font && !open_fallback(ctx, font).face)
+            return 0;
+        return font;
     }
 
-    if (HB_DIRECTION_IS_HORIZONTAL(hb_buffer_get_direction(hb_buffer)))
-        height += FONT_SIZE;
-    else
-        width += FONT_SIZE;
+    hb_font_t *font(unsigned int font) override { return hb_font_of(ctx, font); }
+};
+
+void set_paragraph_lines(RenderContext &ctx, int width)
+{
+    // ctx.paragraph의 줄을 그릴 줄로 삼는다
+    const ParagraphLayout &paragraph = ctx.paragraph;
+    ctx.direction = paragraph.direction();
+    ctx.lines.clear();
+    ctx.glyph_count = 0;
+    for (const LayoutLine &line : paragraph.lines())
+    {
+        // RTL paragraph는 줄을 오른쪽 끝에 맞춘다
+        double x = HB_DIRECTION_IS_BACKWARD(ctx.direction) ? width - line.advance / 64. : 0.;
+        ctx.lines.push_back({line.infos.data(), line.positions.data(), (unsigned int)line.infos.size(),
+                             line.segments.data(), line.segments.size(), x});
+        ctx.glyph_count += line.infos.size();
+    }
+}
+
+void my_paragraph(RenderContext &ctx, const std::string &str)
+{
+    // --width: fribidi, font fallback, shaping, 줄 나누기를 ParagraphLayout이 한번에 한다
+    TraceSpan span(TRACE_HARFBUZZ);
+
+    if (!ctx.hb_font)
+        ctx.hb_font = create_hb_font(font_map, fontFaceIndex, ctx.face);
+
+    ContextFonts fonts(ctx);
+    ParagraphLayout &paragraph = ctx.paragraph;
+    paragraph.setWidth(wrap_width * 64);
+    paragraph.setJustify(justify);
+    paragraph.setBase(FRIBIDI_PAR_LTR);
+    if (!paragraph.setText(str, fonts))
+        abort();
+
+    set_paragraph_lines(ctx, wrap_width);
+    span.setCount(ctx.glyph_count);
+
+    if (!verbose)
+        return;
+
+    std::cout << "Paragraph: " << paragraph.length() << " codepoints, " << ctx.lines.size() << " lines, width "
+              << wrap_width << (justify ? " (justify)" : "") << '\n';
+    for (const LayoutLine &line : paragraph.lines())
+    {
+        std::cout << "Line: [" << line.start << ", " << line.end << ")\t\t";
+        std::cout << "Width: " << line.width / 64. << "\t\t";
+        std::cout << "Glyphs: " << line.infos.size() << (line.hard ? "\t\t(hard break)" : "") << '\n';
+    }
+    std::cout << '\n';
+}
+
+void my_shape(RenderContext &ctx, const std::string &str)
+{
+    if (wrap_width > 0)
+    {
+        my_paragraph(ctx, str);
+        return;
+    }
 
-    // Cairo surface create
-    cairo_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
-                                               ceil(width),
-                                               ceil(height));
+    my_fribidi(ctx, str);
+    my_harfbuzz(ctx);
+}
 
-    // Cairo create
-    cr = cairo_create(cairo_surface);
-    cairo_set_source_rgba(cr, 1., 1., 1., 1.);
-    cairo_paint(cr);
+void draw_band(RenderContext &ctx, RasterScratch &scratch, cairo_t *cr, double origin_x, double origin_y, int band_top)
+{
+    // my_cairo_draw()가 구해둔 cairo_glyphs를 cr의 surface에 그린다. surface는 image의 band_top 줄부터 시작하는 slice다.
+    // (origin_x, origin_y)는 image 기준 첫 줄 baseline 시작점. 위치는 image 기준으로 구하고 band_top만 빼므로
+    // band로 나눠 그려도 pixel 단위로 한 번에 그린 것과 같다.
+    // cr은 재사용될 수 있으므로 바꾼 상태(font face, font options, operator)는 cairo_restore()로 되돌린다
+    cairo_surface_t *surface = cairo_get_target(cr);
+    const int font_size = ctx.font_size;
+    const double line_height = ctx.face->size->metrics.height / 64.;
+    const int band_bottom = band_top + cairo_image_surface_get_height(surface);
+    const uint32_t color = composite_color(0., 0., 0., 1.); // A8 surface면 coverage만 쓴다
+    const cairo_format_t format = cairo_image_surface_get_format(surface);
+
+    cairo_save(cr);
+    if (format == CAIRO_FORMAT_ARGB32)
+    {
+        cairo_set_source_rgba(cr, 1., 1., 1., 1.);
+        cairo_paint(cr); // 재사용한 buffer이므로 전체를 칠한다
+    }
+    else
+    {
+        // mask: 배경은 coverage 0, 글자는 1. 색은 image_options의 foreground / background로 encode할 때 입힌다
+        cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+        cairo_paint(cr);
+        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    }
     cairo_set_source_rgba(cr, 0., 0., 0., 1.);
-    cairo_translate(cr, MARGIN, MARGIN); // 현재 변환 행렬 수정 (Margin, Margin)으로
-
-    // Cairo Font Face 설정
-    cairo_face = cairo_ft_font_face_create_for_ft_face(face, 0);
-    cairo_set_font_face(cr, cairo_face);
-    cairo_set_font_size(cr, FONT_SIZE);
-
-    // baseLine 설정
-    // baseLine은 기준이 되는 아래 줄을 뜻한다. gpqy등의 문자들은 이 아래로 내려가기도 한다.
-    if (HB_DIRECTION_IS_HORIZONTAL(hb_buffer_get_direction(hb_buffer)))
-    {
-        cairo_font_extents_t font_extents;
-        cairo_font_extents(cr, &font_extents);
-        double baseline = (FONT_SIZE - font_extents.height) * .5 + font_extents.ascent;
-        cairo_translate(cr, 0, baseline);
-
-        std::cout << "Font Size: " << FONT_SIZE << '\n';
-        std::cout << "font_extents.height: " << font_extents.height << '\n';
-        std::cout << "font_extents.ascent: " << font_extents.ascent << '\n';
-        std::cout << "font_extents.descent: " << font_extents.descent << '\n';
-        std::cout << "font_extents.max_x_advance: " << font_extents.max_x_advance << '\n';
-        std::cout << "font_extents.max_y_advance: " << font_extents.max_y_advance << '\n';
+
+    if (format == CAIRO_FORMAT_A1)
+    {
+        // 1bit면 FreeType의 monochrome rasterizer로 그린다 (회색 coverage를 잘라내지 않도록)
+        cairo_font_options_t *options = cairo_font_options_create();
+        cairo_font_options_set_antialias(options, CAIRO_ANTIALIAS_NONE);
+        cairo_set_font_options(cr, options);
+        cairo_font_options_destroy(options);
+    }
+
+    unsigned int first = 0;
+    for (size_t l = 0; l < ctx.lines.size(); first += ctx.lines[l].count, l++)
+    {
+        const LineView &line = ctx.lines[l];
+
+        // band에 ink가 닿지 않는 줄은 건너뛴다 (hinting / antialiasing으로 번지는 만큼 넉넉히 본다)
+        const InkBox &ink = ctx.line_ink[l];
+        if (ink.empty || origin_y + ink.bottom + BAND_INK_PAD <= band_top ||
+            origin_y + ink.top - BAND_INK_PAD >= band_bottom)
+            continue;
+
+        double x = origin_x + line.x;
+        double y = origin_y + l * line_height;
+        for (size_t s = 0; s < line.segmentCount; s++)
+        {
+            const GlyphSegment &segment = line.segments[s];
+            if (use_sdf)
+            {
+                // glyph cache와 같지만 mask를 font size마다 rasterize하지 않고 SDF atlas에서 만든다
+                scratch.sdf_renderer.drawGlyphs(surface, sdf_atlas_of(ctx, segment.font), font_size, x, y,
+                                                line.info + segment.start, line.pos + segment.start, segment.count,
+                                                color, band_top);
+            }
+            else if (use_glyph_cache)
+            {
+                // cairo는 배경에만 쓰고, glyph는 cache된 mask를 surface에 직접 합성한다 (band는 한 thread로만)
+                ctx.glyph_cache.drawGlyphs(surface, face_of(ctx, segment.font), instance_of(ctx, segment.font), x,
+                                           y, line.info + segment.start, line.pos + segment.start, segment.count,
+                                           color, band_top);
+            }
+            else
+            {
+                // 위에서 구해둔 cairo_glyphs를 device 좌표로 옮겨서 그린다. font가 바뀌는 곳마다 font face를 바꾼다
+                const cairo_glyph_t *glyphs = ctx.cairo_glyphs.data() + first + segment.start;
+                scratch.glyphs.resize(segment.count);
+                for (unsigned int i = 0; i < segment.count; i++)
+                {
+                    scratch.glyphs[i].index = glyphs[i].index;
+                    scratch.glyphs[i].x = glyphs[i].x + origin_x;
+                    scratch.glyphs[i].y = (glyphs[i].y + origin_y) - band_top;
+                }
+                cairo_set_font_face(cr, cairo_face_of(ctx, segment.font));
+                cairo_set_font_size(cr, font_size);
+                cairo_show_glyphs(cr, scratch.glyphs.data(), segment.count);
+            }
+
+            for (unsigned int i = segment.start; i < segment.start + segment.count; i++)
+            {
+                x += line.pos[i].x_advance / 64.;
+                y -= line.pos[i].y_advance / 64.;
+            }
+        }
+    }
+
+    cairo_restore(cr); // font face reference도 놓는다 (close_font() 뒤에 남지 않도록)
+}
+
+// 그린 image를 image에 담는다. pixel buffer는 pool (surfaces가 없으면 ctx.surface_pool)에서 빌린 것이고,
+// 다 쓰면 pool.release(image.data)로 돌려준다. 그리지 못하면 false
+bool my_cairo_draw(RenderContext &ctx, const char *outFile, ImageView &image, SurfacePool *surfaces = NULL)
+{
+    // Cairo를 이용해 그리기
+    TraceSpan span(TRACE_CAIRO);
+    GlyphCacheStats before;
+    if (span.active())
+        before = ctx.glyph_cache.stats();
+
+    const int font_size = ctx.font_size;
+    const double margin = crop_to_ink ? 1. : font_size * .5; // crop이면 antialiasing 번질 1px만 둔다
+
+    unsigned int len = ctx.glyph_count;
+    hb_direction_t direction = ctx.direction;
+
+    // 줄 간격은 font의 line height, 한 줄이면 쓰지 않는다
+    const FT_Size_Metrics &metrics = ctx.face->size->metrics;
+    const double line_height = metrics.height / 64.;
+
+    // glyph 위치를 첫 줄 baseline 시작점 기준 cairo 좌표(y가 아래로)로 구하고, 그 자리의 ink 영역을 모은다.
+    // HarfBuzz는 y가 커지는 방향이 위쪽을 뜻한다. 세로쓰기를 하면 글자가 아래로 내려가므로, y_advance는 음수가 된다.
+    // cairo_glyphs는 줄을 이어 붙인 것이다. line_ink는 줄마다 ink 영역 (band로 나눌 때 쓴다)
+    ctx.cairo_glyphs.resize(len);
+    cairo_glyph_t *cairo_glyphs = ctx.cairo_glyphs.data();
+    InkBox ink;
+
+    // 글자가 놓이는 줄. 가로쓰기는 font_size 높이 안에 font의 ascent/descent를 가운데 맞추고,
+    // 세로쓰기는 font_size 폭의 가운데에 놓는다. (cairo font extents와 같은 FreeType size metrics)
+    InkBox line_box;
+    double baseline = 0;
+    if (HB_DIRECTION_IS_HORIZONTAL(direction))
+        baseline = (font_size - line_height) * .5 + metrics.ascender / 64.;
+
+    ctx.line_ink.assign(ctx.lines.size(), InkBox());
+    unsigned int first = 0;
+    for (size_t l = 0; l < ctx.lines.size(); l++)
+    {
+        const LineView &line = ctx.lines[l];
+        InkBox &line_ink = ctx.line_ink[l];
+        const double line_y = l * line_height;
+        double current_x = line.x;
+        double current_y = -line_y;
+        for (size_t s = 0; s < line.segmentCount; s++)
+        {
+            const GlyphSegment &segment = line.segments[s];
+            hb_font_t *hb_font = hb_font_of(ctx, segment.font);
+            for (unsigned int i = segment.start; i < segment.start + segment.count; i++)
+            {
+                cairo_glyph_t &glyph = cairo_glyphs[first + i];
+                glyph.index = line.info[i].codepoint;
+                glyph.x = current_x + line.pos[i].x_offset / 64.;
+                glyph.y = -(current_y + line.pos[i].y_offset / 64.);
+                line_ink.addGlyph(ctx.glyph_extents.extents(segment.font, hb_font, glyph.index), glyph.x, glyph.y);
+                current_x += line.pos[i].x_advance / 64.;
+                current_y += line.pos[i].y_advance / 64.;
+            }
+        }
+
+        ink.add(line_ink);
+        if (HB_DIRECTION_IS_HORIZONTAL(direction))
+            line_box.add(line.x, line_y - baseline, current_x, font_size - baseline - current_y);
+        else
+            line_box.add(-font_size * .5, 0, font_size * .5 + current_x, -current_y);
+        first += line.count;
+    }
+
+    // --width면 줄 폭만큼은 항상 담는다 (짧은 줄, RTL 오른쪽 정렬)
+    if (wrap_width > 0 && !line_box.empty)
+        line_box.add(0, line_box.top, wrap_width, line_box.top);
+
+    // 기본은 줄과 ink를 모두 담는다 (위아래로 튀어나온 diacritic이 잘리지 않도록).
+    // crop이면 ink만 담는다. ink가 없으면 (공백만 있으면) 줄 크기를 쓴다.
+    InkBox box = line_box;
+    if (crop_to_ink && !ink.empty)
+        box = ink;
+    else
+        box.add(ink);
+
+    double width = box.width() + 2 * margin;
+    double height = box.height() + 2 * margin;
+
+    const int surface_width = ceil(width);
+    const int surface_height = ceil(height);
+    if (verbose)
+    {
+        std::cout << "Font Size: " << font_size << '\n';
         std::cout << "baseline: " << baseline << '\n';
+        std::cout << "ink: (" << ink.left << ", " << ink.top << ") - (" << ink.right << ", " << ink.bottom << ")\n";
+        std::cout << "surface: " << surface_width << "x" << surface_height << '\n';
+    }
+
+    // 첫 줄 baseline 시작점의 device 좌표
+    const double origin_x = margin - box.left;
+    const double origin_y = margin - box.top;
+
+    // 줄이 많으면 가로 band로 나눠 worker마다 자기 slice에 그린다.
+    // glyph cache는 thread-safe하지 않으므로 한 thread로 그린다.
+    // paragraph가 길어 cairo image 크기 제한을 넘으면 한 thread로라도 band로 나눈다 (slice만 cairo surface다)
+    int bands = 1;
+    int workers = 1;
+    if (raster_threads > 1 && !use_glyph_cache && ctx.lines.size() > 1)
+    {
+        bands = std::min(raster_threads * BANDS_PER_THREAD, surface_height / MIN_BAND_HEIGHT);
+        workers = raster_threads;
+    }
+    bands = std::max(bands, (surface_height + MAX_SURFACE_SIZE - 1) / MAX_SURFACE_SIZE);
+    if (bands <= 1)
+        workers = 1;
+
+    if (ctx.raster_scratch.size() < (size_t)workers)
+        ctx.raster_scratch.resize(workers);
+
+    // job 사이에 pixel buffer를 재사용한다. surfaces가 있으면 (--pipeline의 job slot) 거기서 받는다
+    SurfacePool &pool = surfaces ? *surfaces : ctx.surface_pool;
+    if (surface_width > MAX_SURFACE_SIZE)
+    {
+        std::cerr << "cairo: cannot create " << surface_width << "x" << surface_height << " surface for " << outFile
+                  << '\n';
+        return false;
+    }
+
+    if (bands <= 1)
+    {
+        // surface와 cairo_t 모두 pool이 재사용한다
+        cairo_surface_t *cairo_surface = pool.acquire(surface_width, surface_height, output_format);
+        cairo_t *cr = cairo_surface ? pool.context(cairo_surface) : NULL;
+        if (!cr)
+        {
+            if (cairo_surface)
+                pool.release(cairo_surface);
+            std::cerr << "cairo: cannot create " << surface_width << "x" << surface_height << " surface for "
+                      << outFile << '\n';
+            return false;
+        }
+        draw_band(ctx, ctx.raster_scratch[0], cr, origin_x, origin_y, 0);
+        image_view_from_surface(cairo_surface, image);
     }
     else
     {
-        cairo_translate(cr, FONT_SIZE * .5, 0);
+        // worker가 lazy하게 만들지 않도록 쓰는 font의 cairo face와 atlas를 먼저 만든다
+        for (const LineView &line : ctx.lines)
+        {
+            for (size_t s = 0; s < line.segmentCount; s++)
+            {
+                if (use_sdf)
+                    sdf_atlas_of(ctx, line.segments[s].font);
+                else
+                    cairo_face_of(ctx, line.segments[s].font);
+            }
+        }
+
+        // image 전체는 cairo surface로 만들지 않는다
+        int stride;
+        unsigned char *data = pool.acquireBuffer(surface_width, surface_height, output_format, stride);
+        if (!data)
+        {
+            std::cerr << "cannot allocate " << surface_width << "x" << surface_height << " image for " << outFile
+                      << '\n';
+            return false;
+        }
+        int band_height = (surface_height + bands - 1) / bands;
+
+        if (verbose)
+            std::cout << "bands: " << bands << " x " << band_height << " px, " << workers << " threads\n";
+
+        auto drawSlice = [&](int worker, size_t band) {
+            int top = band * band_height;
+            int rows = std::min(band_height, surface_height - top);
+            if (rows <= 0)
+                return;
+
+            // 같은 buffer의 band 줄들만 가리키는 surface. 경계에 걸친 glyph는 여기서 잘린다.
+            // slice마다 surface와 cairo_t를 새로 만든다 (band 수만큼의 작은 할당, pixel buffer는 pool 것이다)
+            cairo_surface_t *slice = cairo_image_surface_create_for_data(data + (size_t)top * stride, output_format,
+                                                                         surface_width, rows, stride);
+            cairo_t *cr = cairo_create(slice);
+            draw_band(ctx, ctx.raster_scratch[worker], cr, origin_x, origin_y, top);
+            cairo_destroy(cr);
+            cairo_surface_destroy(slice);
+        };
+
+        if (workers == 1)
+        {
+            for (int band = 0; band < bands; band++)
+                drawSlice(0, band);
+        }
+        else
+        {
+            if (!ctx.raster_pool || ctx.raster_pool->threads() != workers)
+                ctx.raster_pool.reset(new WorkStealingPool(workers));
+            ctx.raster_pool->run(bands, drawSlice);
+        }
+
+        image.data = data;
+        image.width = surface_width;
+        image.height = surface_height;
+        image.stride = stride;
+        image.format = output_format;
     }
 
-    // 절대 위치로 변경했던것과 같이 그림
-    cairo_glyph_t *cairo_glyphs = cairo_glyph_allocate(len);
-    double current_x = 0;
-    double current_y = 0;
-    for (unsigned int i = 0; i < len; i++)
+    if (span.active())
     {
-        cairo_glyphs[i].index = info[i].codepoint;
-        cairo_glyphs[i].x = current_x + pos[i].x_offset / 64.;
-        cairo_glyphs[i].y = -(current_y + pos[i].y_offset / 64.);
-        // cairo_glyphs[i].x = current_x;
-        // cairo_glyphs[i].y = current_y;
-        current_x += pos[i].x_advance / 64.;
-        current_y += pos[i].y_advance / 64.;
+        const GlyphCacheStats &after = ctx.glyph_cache.stats();
+        span.setCount(len);
+        span.setCache(after.hits - before.hits, after.hits + after.misses - before.hits - before.misses);
     }
 
-    cairo_show_glyphs(cr, cairo_glyphs, len);
-    cairo_glyph_free(cairo_glyphs);
+    return true;
+}
+
+void my_cairo(RenderContext &ctx, const char *outFile)
+{
+    ImageView image;
+    if (!my_cairo_draw(ctx, outFile, image))
+        return;
+
+    {
+        TraceSpan span(TRACE_ENCODE);
+        if (!image_write(image, image_options, outFile))
+            std::cerr << "cannot write " << image_format_name(image_options.format) << " to " << outFile << '\n';
+    }
 
-    cairo_surface_write_to_png(cairo_surface, "out.png");
+    // buffer는 다음 job이 다시 쓴다
+    ctx.surface_pool.release(image.data);
 }
 
-void destroy()
+void my_layout(RenderContext &ctx, unsigned int job)
+{
+    // 그리지 않고 glyph id, cluster, 26.6 위치만 내보낸다. 줄마다 line 하나, segment 하나가 run 하나다
+    std::lock_guard<std::mutex> lock(layout_mutex);
+
+    for (const LineView &line : ctx.lines)
+    {
+        ctx.layout_runs.clear();
+        for (size_t i = 0; i < line.segmentCount; i++)
+        {
+            const GlyphSegment &segment = line.segments[i];
+            const FallbackFont &font = font_fallback.font(segment.font);
+
+            uint32_t id = layout_json ? layout_json_writer.addFont(font.file, font.faceIndex)
+                                      : layout_writer.addFont(font.file, font.faceIndex);
+            ctx.layout_runs.push_back({id, hb_font_of(ctx, segment.font), segment.direction, segment.script,
+                                       line.info + segment.start, line.pos + segment.start, segment.count});
+        }
+
+        if (layout_json)
+            layout_json_writer.addLine(job, ctx.font_size, ctx.direction, ctx.layout_runs.data(), ctx.layout_runs.size());
+        else
+            layout_writer.addLine(job, ctx.font_size, ctx.direction, ctx.layout_runs.data(), ctx.layout_runs.size());
+    }
+}
+
+void render(RenderContext &ctx, const std::string &text, const char *outFile, unsigned int job)
 {
-    cairo_font_face_destroy(cairo_face);
-    cairo_destroy(cr);
-    cairo_surface_destroy(cairo_surface);
+    TraceSpan span(TRACE_JOB);
+    my_shape(ctx, text);
+    if (layout_file)
+        my_layout(ctx, job);
+    else
+        my_cairo(ctx, outFile);
+    span.setCount(ctx.glyph_count);
+}
+
+void close_font(RenderContext &ctx)
+{
+    ctx.shape_cache.clear(); // hb_font를 가리키는 key가 남지 않도록
+    ctx.paragraph.clear();
+    ctx.glyph_cache.clear();
+    ctx.glyph_extents.clear(); // size가 바뀔 수 있다
+    if (&ctx == &main_context)
+        glyph_names.clear();
+    if (layout_json)
+    {
+        std::lock_guard<std::mutex> lock(layout_mutex);
+        layout_json_writer.forgetFonts();
+    }
 
-    hb_buffer_destroy(hb_buffer);
-    hb_font_destroy(hb_font);
+    if (ctx.cairo_face)
+        cairo_font_face_destroy(ctx.cairo_face);
 
-    FT_Done_Face(face);
-    FT_Done_FreeType(library);
+    for (FallbackFace &fallback : ctx.fallback_faces)
+    {
+        if (fallback.cairo_face)
+            cairo_font_face_destroy(fallback.cairo_face);
+        if (fallback.hb_font)
+            hb_font_destroy(fallback.hb_font);
+        if (fallback.face)
+            FT_Done_Face(fallback.face);
+    }
+    ctx.fallback_faces.clear();
+
+    hb_buffer_destroy(ctx.hb_buffer);
+    hb_font_destroy(ctx.hb_font);
 
-    FcPatternDestroy(font);  // needs to be called for every pattern created; in this case, 'fontFile' / 'file' is also freed
-    FcPatternDestroy(pat);   // needs to be called for every pattern created
-    FcConfigDestroy(config); // needs to be called for every config created
-    FcFini();                // uninitializes Fontconfig
+    FT_Done_Face(ctx.face);
+    FT_Done_FreeType(ctx.library);
+
+    ctx.cairo_face = NULL;
+    ctx.hb_buffer = NULL;
+    ctx.hb_font = NULL;
+    ctx.face = NULL;
+    ctx.library = NULL;
 }
 
-int main()
+bool read_text(const char *path, std::string &text)
 {
-    std::string fontFile = my_fontconfig();
-    my_freetype(fontFile);
-    std::string newString = my_fribidi();
-    my_harfbuzz(newString);
-    my_cairo();
+    // 파일 전체를 한 paragraph로 읽는다. 끝의 줄바꿈은 뺀다
+    std::ifstream file;
+    if (strcmp(path, "-") != 0)
+        file.open(path, std::ios::binary);
+    std::istream &in = strcmp(path, "-") == 0 ? std::cin : file;
+    if (!in)
+        return false;
+
+    text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r'))
+        text.pop_back();
+    return !in.bad();
+}
+
+int read_jobs(std::istream &in, std::vector<Job> &jobs)
+{
+    // 한 줄에 job 하나: "<output path>\t<text>"
+    // 빈 줄과 '#'으로 시작하는 줄은 무시한다.
+    int failed = 0;
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos || tab == 0)
+        {
+            std::cerr << "batch: malformed job (expected <output>\\t<text>): " << line << '\n';
+            failed++;
+            continue;
+        }
+
+        jobs.push_back({line.substr(0, tab), line.substr(tab + 1)});
+    }
+
+    return failed;
+}
+
+void print_font_map_stats()
+{
+    // mmap 전에는 process마다 font file 전체를 heap에 복사했다 (anonymous RSS).
+    // 지금은 page cache에 한번만 올라간다. smaps의 shared는 같은 font를 map한 다른 process가 있을 때만 0보다 크다
+    FontMapStats stats = font_maps.stats();
+    report() << "Font map: " << stats.files << " files, " << stats.mapped << " bytes mapped, "
+              << stats.resident << " resident";
+    if (stats.measured)
+        report() << " (smaps: " << stats.sharedBytes << " shared, " << stats.privateBytes << " private, "
+                  << stats.anonymousBytes << " anonymous)";
+    report() << '\n';
+}
+
+void print_cache_stats(const std::vector<RenderContext *> &contexts)
+{
+    ShapeCacheStats shapeStats;
+    GlyphCacheStats glyphStats;
+    size_t shapeEntries = 0;
+    size_t glyphEntries = 0;
+    size_t atlasUsed = 0;
+    size_t atlasCapacity = 0;
+    SurfacePoolStats poolStats;
+    size_t pooledBytes = 0;
+
+    for (const RenderContext *ctx : contexts)
+    {
+        poolStats += ctx->surface_pool.stats();
+        pooledBytes += ctx->surface_pool.pooledBytes();
+        shapeStats += ctx->shape_cache.stats();
+        glyphStats += ctx->glyph_cache.stats();
+        shapeEntries += ctx->shape_cache.size();
+        glyphEntries += ctx->glyph_cache.size();
+        atlasUsed += ctx->glyph_cache.atlasUsed();
+        atlasCapacity += ctx->glyph_cache.atlasCapacity();
+    }
+
+    report() << "Shape cache: " << shapeStats.hits << "/" << shapeStats.lookups << " word hits ("
+              << shapeStats.hitRate() * 100 << "%), " << shapeStats.shapes << "/" << shapeStats.texts
+              << " texts shaped, " << shapeEntries << " entries, "
+              << shapeStats.evictions << " evictions, " << shapeStats.unsafe << " unsafe words\n";
+
+    if (poolStats.acquires)
+        report() << "Surface pool: " << poolStats.reused << "/" << poolStats.acquires << " reused, "
+                  << poolStats.rewrapped << " rewrapped, " << poolStats.allocated << " buffers allocated, "
+                  << poolStats.dropped << " dropped, " << pooledBytes << " bytes pooled\n";
+
+    if (wrap_width > 0)
+    {
+        ParagraphLayoutStats paragraphStats;
+        for (const RenderContext *ctx : contexts)
+            paragraphStats += ctx->paragraph.stats();
+        report() << "Paragraph layout: " << paragraphStats.layouts << " layouts, " << paragraphStats.edits
+                  << " edits, " << paragraphStats.shapedCodepoints << " codepoints shaped, "
+                  << paragraphStats.reusedCodepoints << " reused, " << paragraphStats.linesBuilt << " lines built, "
+                  << paragraphStats.linesReused << " reused\n";
+    }
+
+    if (use_sdf)
+    {
+        std::lock_guard<std::mutex> lock(sdf_mutex);
+        size_t faces = 0;
+        size_t glyphs = 0;
+        size_t bytes = 0;
+        double seconds = 0;
+        for (const std::unique_ptr<SdfEntry> &entry : sdf_atlases)
+        {
+            if (!entry || !entry->ready.load(std::memory_order_acquire))
+                continue;
+            const SdfAtlas *atlas = &entry->atlas;
+            faces++;
+            glyphs += atlas->glyphCount();
+            bytes += (size_t)atlas->width() * atlas->height();
+            seconds += atlas->buildSeconds();
+        }
+        report() << "SDF atlas: " << faces << " faces, " << glyphs << " glyphs, " << bytes << " atlas bytes, built in "
+                 << seconds << " s\n";
+    }
+
+    if (use_glyph_cache)
+    {
+        report() << "Compositor: " << composite_kernel_name(composite_get_kernel()) << '\n';
+        report() << "Glyph cache: " << glyphStats.hits << " hits, " << glyphStats.misses << " misses ("
+                  << glyphStats.hitRate() * 100 << "%), " << glyphEntries << " entries, "
+                  << atlasUsed << "/" << atlasCapacity << " atlas bytes, "
+                  << glyphStats.flushes << " flushes (" << glyphStats.evicted << " evicted), "
+                  << glyphStats.oversize << " oversize, " << glyphStats.failed << " failed\n";
+    }
+
+    print_font_map_stats();
+}
+
+int run_batch(std::istream &in)
+{
+    // font pipeline(FT_Library, FT_Face, hb_font, cairo_face, hb_buffer)은 모든 job이 공유한다.
+    // threads > 1이면 worker마다 mmap된 font에서 만든 RenderContext를 하나씩 쓴다.
+    std::vector<Job> jobs;
+    int failed = read_jobs(in, jobs);
+
+    unsigned long glyphs = 0;
+    std::vector<RenderContext> workers(threads > 1 ? threads : 0);
+    std::vector<RenderContext *> contexts;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (workers.empty())
+    {
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            const Job &job = jobs[i];
+            trace_set_job(i);
+            render(main_context, job.text, job.outFile.c_str(), i);
+            glyphs += main_context.glyph_count;
+        }
+        contexts.push_back(&main_context);
+    }
+    else
+    {
+        std::vector<unsigned long> workerGlyphs(threads);
+
+        WorkStealingPool pool(threads);
+        pool.run(jobs.size(), [&](int w, size_t i) {
+            RenderContext &ctx = workers[w];
+            if (!ctx.face)
+                open_font(ctx);
+
+            trace_set_job(i);
+            render(ctx, jobs[i].text, jobs[i].outFile.c_str(), i);
+            workerGlyphs[w] += ctx.glyph_count;
+        });
+
+        for (int w = 0; w < threads; w++)
+        {
+            glyphs += workerGlyphs[w];
+            contexts.push_back(&workers[w]);
+        }
+
+        report() << "Farm: " << threads << " workers, jobs (stolen):";
+        for (const WorkStealingStats &stats : pool.stats())
+            report() << ' ' << stats.jobs << " (" << stats.stolen << ")";
+        report() << '\n';
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = elapsed.count();
+
+    report() << "Batch: " << jobs.size() << " jobs, " << glyphs << " glyphs in " << seconds << " s\n";
+    if (seconds > 0)
+        report() << "Batch: " << jobs.size() / seconds << " jobs/sec, " << glyphs / seconds << " glyphs/sec\n";
+    if (failed)
+        report() << "Batch: " << failed << " jobs skipped\n";
+
+    print_cache_stats(contexts);
+
+    for (RenderContext &ctx : workers)
+    {
+        if (ctx.face)
+            close_font(ctx);
+    }
+
+    return failed ? 1 : 0;
+}
+
+void capture_shaped(RenderContext &ctx, PipelineJob &job)
+{
+    // ctx의 buffer (shape cache, paragraph의 줄)는 다음 job이 덮어쓰므로 slot으로 넘긴다.
+    // my_harfbuzz()의 한 줄이면 glyph_segments와, item을 이어 붙였으면 line_infos / line_positions까지 slot의
+    // vector와 바꾼다. slot이 돌아와 다음 job을 받으면 그 vector가 다시 ctx로 간다 (my_harfbuzz()가 비운다).
+    // item 하나 (shape cache의 glyph)와 --width의 줄은 ctx가 계속 갖고 있어야 하므로 복사한다.
+    // 어느 쪽이든 vector는 capacity를 유지하므로 steady state에서는 할당이 없다
+    job.lines.clear();
+    const bool swapped = ctx.lines.size() == 1 && ctx.lines[0].segments == ctx.glyph_segments.data();
+    if (swapped)
+    {
+        const LineView &line = ctx.lines[0];
+        job.segments.swap(ctx.glyph_segments);
+        if (line.info == ctx.line_infos.data())
+        {
+            job.infos.swap(ctx.line_infos);
+            job.positions.swap(ctx.line_positions);
+        }
+        else
+        {
+            job.infos.assign(line.info, line.info + line.count);
+            job.positions.assign(line.pos, line.pos + line.count);
+        }
+    }
+    else
+    {
+        job.infos.clear();
+        job.positions.clear();
+        job.segments.clear();
+        for (const LineView &line : ctx.lines)
+        {
+            job.infos.insert(job.infos.end(), line.info, line.info + line.count);
+            job.positions.insert(job.positions.end(), line.pos, line.pos + line.count);
+            job.segments.insert(job.segments.end(), line.segments, line.segments + line.segmentCount);
+        }
+    }
+
+    // vector를 다 채운 뒤에 pointer를 잡는다
+    size_t glyph = 0;
+    size_t segment = 0;
+    for (const LineView &line : ctx.lines)
+    {
+        job.lines.push_back({job.infos.data() + glyph, job.positions.data() + glyph, line.count,
+                             job.segments.data() + segment, line.segmentCount, line.x});
+        glyph += line.count;
+        segment += line.segmentCount;
+    }
+    job.glyph_count = ctx.glyph_count;
+    job.direction = ctx.direction;
+
+    // 바꾼 vector는 이제 slot의 것이므로 ctx에서 가리키지 않는다
+    if (swapped)
+    {
+        ctx.lines.clear();
+        ctx.info = NULL;
+        ctx.pos = NULL;
+    }
+}
+
+void adopt_shaped(RenderContext &ctx, const PipelineJob &job)
+{
+    // 다른 thread가 shape한 결과를 ctx로 그리도록 한다. glyph는 slot의 것을 그대로 읽는다.
+    // fallback font는 ctx마다 따로 열므로 이 ctx에서도 연다
+    ctx.lines.assign(job.lines.begin(), job.lines.end());
+    ctx.glyph_count = job.glyph_count;
+    ctx.direction = job.direction;
+    for (const GlyphSegment &segment : job.segments)
+    {
+        if (segment.font)
+            open_fallback(ctx, segment.font);
+    }
+}
+
+int run_pipeline(std::istream &in)
+{
+    // batch job을 shape → raster → encode stage로 나눠 stage마다 자기 thread에서 돌린다.
+    // stage 사이는 bounded queue로 잇는다: 뒤 stage가 밀리면 queue가 차서 앞 stage가 기다린다.
+    // job slot은 free → shaped → drawn → free로 돈다. queue에는 slot pointer만 오가므로 glyph와 pixel은 복사되지 않는다.
+    // slot 수가 동시에 진행 중인 job 수의 상한이다.
+    std::vector<Job> jobs;
+    int failed = read_jobs(in, jobs);
+
+    const int shapeThreads = pipeline_threads[0];
+    const int rasterThreads = pipeline_threads[1];
+    const int encodeThreads = pipeline_threads[2];
+
+    std::vector<RenderContext> shapers(shapeThreads);
+    std::vector<RenderContext> rasterizers(rasterThreads);
+
+    const size_t slotCount = shapeThreads + rasterThreads + encodeThreads + 2 * PIPELINE_QUEUE_SIZE;
+    std::vector<PipelineJob> slots(slotCount);
+    BoundedQueue<PipelineJob *> freeSlots(slotCount);
+    BoundedQueue<PipelineJob *> shaped(PIPELINE_QUEUE_SIZE);
+    BoundedQueue<PipelineJob *> drawn(PIPELINE_QUEUE_SIZE);
+    for (PipelineJob &slot : slots)
+        freeSlots.push(&slot);
+
+    std::atomic<size_t> nextJob{0};
+    std::atomic<unsigned long> glyphs{0};
+    std::atomic<int> writeFailed{0};
+    PipelineStage stages[3];
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> shapeWorkers;
+    for (int w = 0; w < shapeThreads; w++)
+    {
+        shapeWorkers.emplace_back([&, w] {
+            RenderContext &ctx = shapers[w];
+            open_font(ctx);
+
+            for (;;)
+            {
+                size_t i = nextJob.fetch_add(1);
+                if (i >= jobs.size())
+                    break;
+
+                PipelineJob *slot;
+                freeSlots.pop(slot); // 닫지 않는다, encode stage가 돌려줄 때까지 기다린다
+                auto begin = std::chrono::steady_clock::now();
+
+                trace_set_job(i);
+                my_shape(ctx, jobs[i].text);
+                capture_shaped(ctx, *slot);
+                slot->job = i;
+
+                stages[0].add(begin);
+                shaped.push(slot);
+            }
+        });
+    }
+
+    std::vector<std::thread> rasterWorkers;
+    for (int w = 0; w < rasterThreads; w++)
+    {
+        rasterWorkers.emplace_back([&, w] {
+            RenderContext &ctx = rasterizers[w];
+            open_font(ctx);
+            ctx.hb_font = create_hb_font(font_map, fontFaceIndex, ctx.face); // ink 영역을 구할 때 쓴다
+
+            PipelineJob *slot;
+            while (shaped.pop(slot))
+            {
+                auto begin = std::chrono::steady_clock::now();
+
+                trace_set_job(slot->job);
+                adopt_shaped(ctx, *slot);
+                if (!my_cairo_draw(ctx, jobs[slot->job].outFile.c_str(), slot->image, &slot->surfaces))
+                    slot->image = ImageView();
+
+                stages[1].add(begin);
+                drawn.push(slot);
+            }
+        });
+    }
+
+    std::vector<std::thread> encodeWorkers;
+    for (int w = 0; w < encodeThreads; w++)
+    {
+        encodeWorkers.emplace_back([&] {
+            PipelineJob *slot;
+            while (drawn.pop(slot))
+            {
+                auto begin = std::chrono::steady_clock::now();
+
+                trace_set_job(slot->job);
+                if (slot->image.data)
+                {
+                    TraceSpan span(TRACE_ENCODE);
+                    const char *outFile = jobs[slot->job].outFile.c_str();
+                    if (!image_write(slot->image, image_options, outFile))
+                    {
+                        std::cerr << "cannot write " << image_format_name(image_options.format) << " to " << outFile
+                                  << '\n';
+                        writeFailed++;
+                    }
+                    slot->surfaces.release(slot->image.data);
+                    slot->image = ImageView();
+                }
+                glyphs += slot->glyph_count;
+
+                stages[2].add(begin);
+                freeSlots.push(slot);
+            }
+        });
+    }
+
+    // 앞 stage가 모두 끝나야 다음 queue를 닫는다
+    for (std::thread &t : shapeWorkers)
+        t.join();
+    shaped.close();
+    for (std::thread &t : rasterWorkers)
+        t.join();
+    drawn.close();
+    for (std::thread &t : encodeWorkers)
+        t.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = elapsed.count();
+
+    // occupancy: stage thread들이 job을 처리한 시간 / (전체 시간 × thread 수). 가장 높은 stage가 병목이다
+    const char *names[3] = {"shape", "raster", "encode"};
+    int bottleneck = 0;
+    double occupancy[3];
+    report() << "Pipeline: " << shapeThreads << " shape, " << rasterThreads << " raster, " << encodeThreads
+             << " encode threads, " << slotCount << " job slots, queues of " << shaped.capacity() << '\n';
+    for (int s = 0; s < 3; s++)
+    {
+        occupancy[s] = seconds > 0 ? stages[s].busy_ns.load() * 1e-9 / (seconds * pipeline_threads[s]) : 0;
+        if (occupancy[s] > occupancy[bottleneck])
+            bottleneck = s;
+        report() << "Pipeline: " << names[s] << " " << stages[s].jobs.load() << " jobs, " << occupancy[s] * 100
+                 << "% busy\n";
+    }
+
+    const BoundedQueue<PipelineJob *> *queues[3] = {&shaped, &drawn, &freeSlots};
+    const char *queueNames[3] = {"shape -> raster", "raster -> encode", "encode -> shape (free slots)"};
+    for (int q = 0; q < 3; q++)
+    {
+        QueueStats stats = queues[q]->stats();
+        report() << "Pipeline: queue " << queueNames[q];
+        if (q < 2)
+            report() << ": depth avg " << (stats.pushes ? (double)stats.depthSum / stats.pushes : 0.) << " max "
+                     << stats.maxDepth << " of " << queues[q]->capacity() << ", producer blocked "
+                     << stats.pushWaitSeconds << " s, consumer idle " << stats.popWaitSeconds << " s\n";
+        else
+            report() << ": shape waited " << stats.popWaitSeconds << " s for a slot\n";
+    }
+    report() << "Pipeline: bottleneck " << names[bottleneck] << '\n';
+
+    report() << "Batch: " << jobs.size() << " jobs, " << glyphs.load() << " glyphs in " << seconds << " s\n";
+    if (seconds > 0)
+        report() << "Batch: " << jobs.size() / seconds << " jobs/sec, " << glyphs.load() / seconds << " glyphs/sec\n";
+    if (failed)
+        report() << "Batch: " << failed << " jobs skipped\n";
+
+    std::vector<RenderContext *> contexts;
+    for (RenderContext &ctx : shapers)
+        contexts.push_back(&ctx);
+    for (RenderContext &ctx : rasterizers)
+        contexts.push_back(&ctx);
+    print_cache_stats(contexts);
+
+    for (RenderContext &ctx : shapers)
+        close_font(ctx);
+    for (RenderContext &ctx : rasterizers)
+        close_font(ctx);
+
+    return failed || writeFailed ? 1 : 0;
+}
+
+bool parse_rgb(const char *text, uint32_t &color)
+{
+    // "rrggbb" (앞의 #는 있어도 된다)
+    if (*text == '#')
+        text++;
+    if (strlen(text) != 6 || strspn(text, "0123456789abcdefABCDEF") != 6)
+        return false;
+    color = strtoul(text, NULL, 16);
+    return true;
+}
+
+bool valid_output_pattern(const char *pattern)
+{
+    // printf 형식: %d 하나 (flag, width 허용)와 %% 만 허용한다
+    int numbers = 0;
+    for (const char *p = pattern; *p; p++)
+    {
+        if (*p != '%')
+            continue;
+        if (p[1] == '%')
+        {
+            p++;
+            continue;
+        }
+
+        p++;
+        while (*p == '0' || *p == '-' || *p == ' ' || *p == '+')
+            p++;
+        while (*p >= '0' && *p <= '9')
+            p++;
+        if (*p != 'd')
+            return false;
+        numbers++;
+    }
+    return numbers == 1;
+}
+
+int run_stream(std::istream &in, const char *outPattern)
+{
+    // 입력을 UAX#9 paragraph 단위로 읽어서 bidi → shaping (→ outPattern이 있으면 paragraph마다 그림)
+    // 모든 buffer는 main_context의 것을 재사용하므로 메모리는 가장 긴 paragraph에만 비례한다.
+    ParagraphReader reader(in);
+    std::string paragraph;
+
+    unsigned long paragraphs = 0;
+    unsigned long glyphs = 0;
+    size_t longest = 0;
+    std::vector<char> outFile;
+
+    auto start = std::chrono::steady_clock::now();
+
+    while (reader.next(paragraph))
+    {
+        if (paragraph.empty())
+            continue;
+
+        if (paragraph.size() > longest)
+            longest = paragraph.size();
+
+        trace_set_job(paragraphs);
+        TraceSpan span(TRACE_JOB);
+        my_shape(main_context, paragraph);
+
+        if (outPattern)
+        {
+            int n = snprintf(NULL, 0, outPattern, (int)paragraphs);
+            outFile.resize(n + 1);
+            snprintf(outFile.data(), outFile.size(), outPattern, (int)paragraphs);
+            my_cairo(main_context, outFile.data());
+        }
+        if (layout_file)
+            my_layout(main_context, paragraphs);
+
+        span.setCount(main_context.glyph_count);
+        glyphs += main_context.glyph_count;
+        paragraphs++;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = elapsed.count();
+
+    report() << "Stream: " << paragraphs << " paragraphs, " << glyphs << " glyphs, "
+              << reader.bytesRead() << " bytes in " << seconds << " s\n";
+    if (seconds > 0)
+        report() << "Stream: " << paragraphs / seconds << " paragraphs/sec, " << glyphs / seconds << " glyphs/sec\n";
+    report() << "Stream: longest paragraph " << longest << " bytes, bidi scratch "
+              << main_context.bidi.capacityBytes() << " bytes\n";
+
+    print_cache_stats({&main_context});
+
+    return 0;
+}
+
+// 두 layout의 줄, glyph, position, segment가 같은지. glyph flag는 shape한 범위에 따라 달라질 수 있어 보지 않는다
+bool same_layout(const ParagraphLayout &a, const ParagraphLayout &b)
+{
+    if (a.length() != b.length() || !std::equal(a.text(), a.text() + a.length(), b.text()) ||
+        a.lines().size() != b.lines().size())
+        return false;
+
+    for (size_t l = 0; l < a.lines().size(); l++)
+    {
+        const LayoutLine &x = a.lines()[l];
+        const LayoutLine &y = b.lines()[l];
+        if (x.start != y.start || x.end != y.end || x.width != y.width || x.advance != y.advance ||
+            x.hard != y.hard || x.infos.size() != y.infos.size() || x.segments.size() != y.segments.size())
+            return false;
+
+        for (size_t g = 0; g < x.infos.size(); g++)
+        {
+            const hb_glyph_position_t &p = x.positions[g];
+            const hb_glyph_position_t &q = y.positions[g];
+            if (x.infos[g].codepoint != y.infos[g].codepoint || x.infos[g].cluster != y.infos[g].cluster ||
+                p.x_advance != q.x_advance || p.y_advance != q.y_advance || p.x_offset != q.x_offset ||
+                p.y_offset != q.y_offset)
+                return false;
+        }
+        for (size_t s = 0; s < x.segments.size(); s++)
+        {
+            const GlyphSegment &p = x.segments[s];
+            const GlyphSegment &q = y.segments[s];
+            if (p.font != q.font || p.start != q.start || p.count != q.count || p.direction != q.direction ||
+                p.script != q.script)
+                return false;
+        }
+    }
+    return true;
+}
+
+int run_bench(const char *corpusDir, const char *tsvPath, double minSeconds)
+{
+    // pipeline을 stage별로 따로 잰다: font lookup, face load, bidi, shaping, rasterization, encoding.
+    // corpus × 길이 × font size마다 한번씩 돌고, glyph 수로 나눈 값도 낸다.
+    std::vector<BenchCorpus> corpora;
+    if (!load_bench_corpora(corpusDir, corpora))
+    {
+        std::cerr << "bench: no *.txt corpus in " << corpusDir << '\n';
+        return 1;
+    }
+
+    StageTimer timer(minSeconds);
+    std::vector<StageResult> results;
+    std::vector<uint8_t> encoded;
+    volatile unsigned int sink = 0; // 결과를 안 쓰는 loop가 지워지지 않도록
+    const bool glyphCache = use_glyph_cache;
+    const bool sdfMode = use_sdf;
+    const std::string encodeStage = std::string("encode-") + image_format_name(image_options.format);
+
+    // font lookup: on-disk index에서 FONT_NAME 찾기 (my_fontconfig()의 빠른 경로)
+    std::string indexPath = FontIndex::defaultPath();
+    FontIndex fontIndex;
+    if (fontIndex.open(indexPath) && fontIndex.fresh())
+    {
+        StageSample sample = timer.measure([&] {
+            FontIndex index;
+            if (!index.open(indexPath) || !index.find(FONT_NAME))
+                abort();
+        });
+        results.push_back(stage_result("-", 0, 0, "font-index", sample, 0));
+    }
+
+    for (int fontSize : BENCH_FONT_SIZES)
+    {
+        // face load: mmap된 font에서 FT_Face, hb_font, cairo font face를 만들고 닫는다
+        RenderContext loader;
+        loader.font_size = fontSize;
+        StageSample sample = timer.measure([&] {
+            open_font(loader);
+            loader.hb_font = create_hb_font(font_map, fontFaceIndex, loader.face);
+            cairo_face_of(loader, 0);
+            close_font(loader);
+        });
+        results.push_back(stage_result("-", 0, fontSize, "face-load", sample, 0));
+
+        RenderContext &ctx = main_context;
+        close_font(ctx);
+        ctx.font_size = fontSize;
+        open_font(ctx);
+
+        for (const BenchCorpus &corpus : corpora)
+        {
+            for (unsigned int length : BENCH_LENGTHS)
+            {
+                std::string text = bench_sample(corpus.text, length);
+
+                // glyph 수를 알기 위해 한번 돌린다 (fallback font도 여기서 열린다)
+                my_fribidi(ctx, text);
+                my_harfbuzz(ctx);
+                uint64_t glyphs = ctx.glyph_count;
+
+                sample = timer.measure([&] { my_fribidi(ctx, text); });
+                results.push_back(stage_result(corpus.name, length, fontSize, "bidi", sample, glyphs));
+
+                // 글자마다 fallback chain에서 font 고르기 (my_harfbuzz()의 itemize 부분)
+                const uint32_t *codepoints = ctx.bidi.text();
+                unsigned int count = ctx.bidi.length();
+                sample = timer.measure([&] {
+                    unsigned int font = 0;
+                    for (unsigned int i = 0; i < count; i++)
+                        font = font_fallback.find(codepoints[i], font);
+                    sink = font;
+                });
+                results.push_back(stage_result(corpus.name, length, fontSize, "font-fallback", sample, glyphs));
+
+                // shaping: cache 없이 매번 hb_shape(), 그리고 모든 단어가 cache에 있을 때
+                ctx.shape_cache.setCapacity(0);
+                sample = timer.measure([&] { my_harfbuzz(ctx); });
+                results.push_back(stage_result(corpus.name, length, fontSize, "shape", sample, glyphs));
+
+                ctx.shape_cache.setCapacity(SHAPE_CACHE_SIZE);
+                sample = timer.measure([&] { my_harfbuzz(ctx); });
+                results.push_back(stage_result(corpus.name, length, fontSize, "shape-cached", sample, glyphs));
+
+                // rasterization + compositing: cairo_show_glyphs, glyph cache 합성
+                for (bool cached : {false, true})
+                {
+                    use_glyph_cache = cached;
+                    bool drawn = true;
+                    sample = timer.measure([&] {
+                        ImageView image;
+                        if (my_cairo_draw(ctx, "bench", image))
+                            ctx.surface_pool.release(image.data);
+                        else
+                            drawn = false;
+                    });
+                    if (drawn)
+                        results.push_back(stage_result(corpus.name, length, fontSize,
+                                                       cached ? "raster-glyph-cache" : "raster-cairo", sample, glyphs));
+                }
+                use_glyph_cache = glyphCache;
+
+                // SDF atlas에서 그리기. atlas는 font마다 한번 만들고, 잴 때는 이미 있다
+                use_sdf = true;
+                sdf_atlas_of(ctx, 0);
+                bool drawn = true;
+                sample = timer.measure([&] {
+                    ImageView image;
+                    if (my_cairo_draw(ctx, "bench", image))
+                        ctx.surface_pool.release(image.data);
+                    else
+                        drawn = false;
+                });
+                if (drawn)
+                    results.push_back(stage_result(corpus.name, length, fontSize, "raster-sdf", sample, glyphs));
+                use_sdf = sdfMode;
+
+                // encoding: --format 설정으로 memory에 쓴다
+                ImageView view;
+                if (my_cairo_draw(ctx, "bench", view))
+                {
+                    sample = timer.measure([&] { image_encode(view, image_options, encoded); });
+                    results.push_back(stage_result(corpus.name, length, fontSize, encodeStage.c_str(), sample,
+                                                   glyphs, encoded.size()));
+                    ctx.surface_pool.release(view.data);
+                }
+            }
+
+            // paragraph layout: 긴 text를 40em 폭으로 나누기 (shape cache는 찬 상태),
+            // 그리고 가운데에 글자 하나를 넣고 다시 지우는 편집 두번
+            std::string text = bench_sample(corpus.text, 4096);
+            ContextFonts fonts(ctx);
+            ParagraphLayout &paragraph = ctx.paragraph;
+            paragraph.setWidth(40 * fontSize * 64);
+            paragraph.setJustify(false);
+            paragraph.setBase(FRIBIDI_PAR_LTR);
+            if (!paragraph.setText(text, fonts))
+                abort();
+            uint64_t glyphs = paragraph.glyphCount();
+            unsigned int length = paragraph.length();
+
+            sample = timer.measure([&] { paragraph.setText(text, fonts); });
+            results.push_back(stage_result(corpus.name, length, fontSize, "paragraph-layout", sample, glyphs));
+
+            unsigned int middle = length / 2;
+            sample = timer.measure([&] {
+                if (!paragraph.edit(middle, middle, "x", fonts) || !paragraph.edit(middle, middle + 1, "", fonts))
+                    abort();
+            });
+            results.push_back(stage_result(corpus.name, length, fontSize, "paragraph-edit", sample, glyphs));
+
+            // 편집으로 만든 layout이 같은 text를 setText()로 처음부터 만든 것과 같아야 한다
+            std::vector<uint32_t> original(paragraph.text(), paragraph.text() + length);
+            std::vector<uint32_t> inserted = original;
+            inserted.insert(inserted.begin() + middle, 'x');
+            ParagraphLayout reference;
+            reference.setWidth(40 * fontSize * 64);
+            reference.setBase(FRIBIDI_PAR_LTR);
+
+            bool same = paragraph.edit(middle, middle, "x", fonts) &&
+                        reference.setText(inserted.data(), inserted.size(), fonts) && same_layout(paragraph, reference);
+            same = same && paragraph.edit(middle, middle + 1, "", fonts) &&
+                   reference.setText(original.data(), original.size(), fonts) && same_layout(paragraph, reference);
+            if (!same)
+            {
+                std::cerr << "bench: " << corpus.name << ": paragraph edit at " << middle
+                          << " differs from setText() of the same text\n";
+                return 1;
+            }
+
+            // 여러 줄 image 하나를 한 thread로, 그리고 core 수만큼의 band worker로 그리기
+            set_paragraph_lines(ctx, 40 * fontSize);
+            const int rasterThreads = raster_threads;
+            const int wrapWidth = wrap_width;
+            wrap_width = 40 * fontSize; // surface 폭
+            std::vector<uint8_t> serial; // 한 thread로 그린 pixel
+            ImageView serialView;
+            std::vector<int> workerCounts = {1};
+            if (std::thread::hardware_concurrency() > 1)
+                workerCounts.push_back(std::thread::hardware_concurrency());
+            for (int workers : workerCounts)
+            {
+                raster_threads = workers;
+                bool drawn = true;
+                sample = timer.measure([&] {
+                    ImageView image;
+                    if (my_cairo_draw(ctx, "bench", image))
+                        ctx.surface_pool.release(image.data);
+                    else
+                        drawn = false;
+                });
+                if (drawn)
+                    results.push_back(stage_result(corpus.name, length, fontSize,
+                                                   workers == 1 ? "raster-paragraph" : "raster-bands", sample, glyphs));
+
+                // band로 나눠 그린 pixel이 한 thread로 그린 것과 byte 단위로 같아야 한다
+                ImageView image;
+                if (!drawn || !my_cairo_draw(ctx, "bench", image))
+                    continue;
+                bool same = true;
+                if (workers == 1)
+                {
+                    serial.assign(image.data, image.data + (size_t)image.stride * image.height);
+                    serialView = image;
+                }
+                else
+                {
+                    // stride 끝의 padding과 A1의 마지막 byte 남는 bit는 그리지 않으므로 보지 않는다
+                    size_t rowBytes = image.format == CAIRO_FORMAT_A1   ? image.width / 8
+                                      : image.format == CAIRO_FORMAT_A8 ? image.width
+                                                                        : (size_t)image.width * 4;
+                    same = image.width == serialView.width && image.height == serialView.height &&
+                           image.stride == serialView.stride && image.format == serialView.format;
+                    for (int y = 0; same && y < image.height; y++)
+                        same = memcmp(image.data + (size_t)y * image.stride, serial.data() + (size_t)y * image.stride,
+                                      rowBytes) == 0;
+                }
+                ctx.surface_pool.release(image.data);
+                if (!same)
+                {
+                    std::cerr << "bench: " << corpus.name << ": " << workers
+                              << " band workers draw different pixels than one thread\n";
+                    return 1;
+                }
+            }
+            raster_threads = rasterThreads;
+            wrap_width = wrapWidth;
+        }
+    }
+
+    // TSV를 stdout으로 쓰면 표는 stderr로 보낸다
+    bool tsvToStdout = tsvPath && strcmp(tsvPath, "-") == 0;
+    std::ostream &table = tsvToStdout ? std::cerr : std::cout;
+    print_stage_table(table, results);
+    if (!alloc_count_enabled())
+        table << "(allocations are counted only in the stage_bench build)\n";
+
+    if (tsvPath && !write_stage_tsv(tsvPath, results))
+    {
+        std::cerr << "bench: cannot write " << tsvPath << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+int export_sdf_atlas(const char *prefix)
+{
+    // primary font의 atlas를 <prefix>.<format>과 <prefix>.jsonl (glyph 표)로 쓴다. GPU 쪽에서 그대로 쓴다
+    const SdfAtlas &atlas = sdf_atlas_of(main_context, 0);
+    if (!atlas.glyphCount())
+        return 1;
+
+    ImageView view;
+    view.data = atlas.data();
+    view.width = atlas.width();
+    view.height = atlas.height();
+    view.stride = atlas.width();
+    view.format = CAIRO_FORMAT_A8;
+
+    // atlas는 거리 값 그대로 쓴다 (--fg / --bg를 입히지 않는다)
+    ImageOptions options = image_options;
+    options.foreground = ImageOptions().foreground;
+    options.background = ImageOptions().background;
+
+    std::string image = std::string(prefix) + "." + image_format_extension(image_options.format);
+    std::string metrics = std::string(prefix) + ".jsonl";
+    const FallbackFont &font = font_fallback.font(0);
+    if (!image_write(view, options, image.c_str()))
+    {
+        std::cerr << "sdf: cannot write " << image << '\n';
+        return 1;
+    }
+    if (!atlas.writeMetrics(metrics.c_str(), font.file, font.faceIndex))
+    {
+        std::cerr << "sdf: cannot write " << metrics << '\n';
+        return 1;
+    }
+
+    report() << "SDF atlas: " << atlas.glyphCount() << " glyphs, " << atlas.width() << "x" << atlas.height()
+             << " (em " << atlas.emSize() << " px, spread " << atlas.spread() << " px) in " << atlas.buildSeconds()
+             << " s -> " << image << ", " << metrics << '\n';
+    return 0;
+}
+
+int run_subset(const char *corpus, const char *output)
+{
+    // primary font를 corpus에 필요한 glyph만 남겨 output에 쓴다. 다음부터 --font-file <output>으로 그린다
+    const FallbackFont &primary = font_fallback.font(0);
+    FontSubsetReport subset;
+    if (!subset_font(primary.file, primary.faceIndex, corpus, output, main_context.font_size, subset))
+    {
+        switch (subset.error)
+        {
+        case FontSubsetError::Corpus:
+            std::cerr << "subset: cannot read corpus " << corpus << '\n';
+            break;
+        case FontSubsetError::Write:
+            std::cerr << "subset: cannot write " << output << '\n';
+            break;
+        case FontSubsetError::Unavailable:
+            std::cerr << "subset: built without hb-subset (rebuild with make SUBSET=1)\n";
+            break;
+        default:
+            std::cerr << "subset: hb-subset failed for " << primary.file << '\n';
+            break;
+        }
+        return 1;
+    }
+
+    report() << "Subset: " << primary.file << " -> " << output << '\n';
+    report() << "  corpus: " << subset.paragraphs << " paragraphs, " << subset.codepoints << " codepoints ("
+             << subset.missingCodepoints << " not in font, drawn by fallback), " << subset.shapedGlyphs
+             << " glyphs shaped\n";
+    report() << "  glyphs: " << subset.glyphsBefore << " -> " << subset.glyphsAfter << " (with GSUB closure)\n";
+    report() << "  size:   " << subset.bytesBefore << " -> " << subset.bytesAfter << " bytes ("
+             << (subset.bytesBefore ? 100. * subset.bytesAfter / subset.bytesBefore : 0.) << "%)\n";
+    report() << "  load:   " << subset.loadSecondsBefore * 1e6 << " -> " << subset.loadSecondsAfter * 1e6
+             << " us (FT_Face + hb_font + first shape)\n";
+    report() << "  check:  " << subset.checkedItems << " items shaped with both, " << subset.mismatches
+             << " different\n";
+    report() << "  took " << subset.seconds << " s\n";
+
+    if (subset.mismatches)
+    {
+        std::cerr << "subset: shaping differs from the original font in " << subset.mismatches << " items\n";
+        return 1;
+    }
+    return 0;
+}
+
+void destroy()
+{
+    close_font(main_context);
+    font_maps.close(); // 모든 FT_Face, hb_face_t가 정리된 뒤에 unmap
+
+    // font index로 찾았으면 fontconfig는 초기화되지 않았다 (fallback chain을 만들었으면 초기화됨)
+    if (config)
+    {
+        if (font)
+            FcPatternDestroy(font); // needs to be called for every pattern created; in this case, 'fontFile' / 'file' is also freed
+        FcPatternDestroy(pat);      // needs to be called for every pattern created
+        FcConfigDestroy(config);    // needs to be called for every config created
+    }
+    if (config || font_fallback.chainBuilt())
+        FcFini(); // uninitializes Fontconfig
+}
+
+int main(int argc, char *argv[])
+{
+    // ./hello_text                  : str 하나를 out.png (--format에 따라 out.qoi 등)로 그린다
+    // ./hello_text --batch <file|-> : job 파일(또는 stdin)의 모든 job을 그린다
+    // --glyph-cache                 : cairo_show_glyphs 대신 glyph cache로 그린다
+    // --text <file|->               : str 대신 파일 내용 전체를 그린다 (--width와 같이 쓰면 긴 문서 하나가 image 하나)
+    // --raster-threads <n>          : 여러 줄 image를 가로 band로 나눠 n개 worker로 그린다, 0이면 core 수
+    // --sdf                         : glyph를 font마다 한번 만든 SDF atlas에서 그린다 (--glyph-cache 대신)
+    // --sdf-atlas <prefix>          : primary font의 SDF atlas를 <prefix>.png와 <prefix>.jsonl로 쓰고 끝낸다
+    // --font-file <path>            : fontconfig로 찾지 않고 이 font file을 primary로 쓴다
+    // --subset <corpus file|dir>    : primary font를 corpus(*.txt)에 필요한 glyph만 남겨 쓰고 끝낸다
+    // --subset-out <file>           : subset font를 쓸 곳 (기본 subset.ttf)
+    // --compositor <name>           : glyph cache 합성 kernel (auto, scalar, sse2, avx2), --glyph-cache 포함
+    // --threads <n>                 : batch mode를 n개의 worker로 그린다, 0이면 core 수
+    // --pipeline <s,r,e>            : batch mode를 shape, raster, encode stage로 나눠 stage마다 s, r, e개 thread로 돌린다
+    // --stream <file|->             : 입력을 paragraph 단위로 읽어 bidi + shaping만 한다
+    // --output <pattern>            : stream mode에서 paragraph마다 그릴 파일 이름 (예: para_%05d.png)
+    // --out <file|->                : str 하나를 그릴 파일, -면 stdout (이때 dump와 통계는 찍지 않는다)
+    // --format <png|qoi|pam|pgm>    : 출력 image format
+    // --png-level <0..9>            : PNG zlib 압축 level
+    // --png-filter <name>           : PNG filter (none, sub, up, avg, paeth, adaptive)
+    // --mask <a8|a1>                : ARGB32 대신 coverage mask로 그리고 grayscale / indexed PNG로 쓴다 (a1은 antialias 없음)
+    // --fg <rrggbb>, --bg <rrggbb>  : --mask 출력의 글자색과 배경색 (기본 000000, ffffff)
+    // --bench <corpus dir>          : corpus(*.txt)로 stage별 시간과 할당 수를 잰다
+    // --bench-tsv <file|->          : bench 결과를 TSV로도 쓴다 (version 사이 비교용)
+    // --bench-time <ms>             : stage 하나를 최소 몇 ms 동안 반복할지 (기본 100)
+    // --trace <file|->              : stage별 span을 Chrome trace JSON으로 쓴다
+    // --trace-summary               : stage별 latency p50/p90/p99를 stderr에 찍는다
+    // --width <px>                  : paragraph를 이 폭으로 여러 줄에 나눈다 (UAX#14)
+    // --justify                     : --width로 나눈 줄을 양쪽 정렬한다
+    // --crop                        : surface를 실제 ink 영역에 맞춰 자른다
+    // --layout <file|->             : 그리지 않고 shaping 결과(glyph run)만 쓴다
+    // --layout-format <bin|json>    : layout 출력 형식 (기본 bin, json은 한 줄에 한 record)
+    // --layout-names                : json에 glyph 이름도 넣는다 (느리다)
+    const char *batchFile = NULL;
+    const char *streamFile = NULL;
+    const char *outPattern = NULL;
+    const char *outFile = NULL;
+    const char *benchDir = NULL;
+    const char *benchTsv = NULL;
+    double benchSeconds = .1;
+    const char *traceFile = NULL;
+    bool traceSummary = false;
+    bool layoutNames = false;
+    const char *sdfAtlasPrefix = NULL;
+    const char *textFile = NULL;
+    const char *subsetCorpus = NULL;
+    const char *subsetOut = "subset.ttf";
+    uint32_t maskForeground = 0x000000;
+    uint32_t maskBackground = 0xffffff;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+        {
+            batchFile = argv[++i];
+            verbose = false;
+        }
+        else if (strcmp(argv[i], "--glyph-cache") == 0)
+        {
+            use_glyph_cache = true;
+        }
+        else if (strcmp(argv[i], "--raster-threads") == 0 && i + 1 < argc)
+        {
+            raster_threads = atoi(argv[++i]);
+            if (raster_threads <= 0)
+                raster_threads = std::thread::hardware_concurrency();
+        }
+        else if (strcmp(argv[i], "--text") == 0 && i + 1 < argc)
+        {
+            textFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--sdf") == 0)
+        {
+            use_sdf = true;
+        }
+        else if (strcmp(argv[i], "--sdf-atlas") == 0 && i + 1 < argc)
+        {
+            sdfAtlasPrefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "--font-file") == 0 && i + 1 < argc)
+        {
+            font_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--subset") == 0 && i + 1 < argc)
+        {
+            subsetCorpus = argv[++i];
+        }
+        else if (strcmp(argv[i], "--subset-out") == 0 && i + 1 < argc)
+        {
+            subsetOut = argv[++i];
+        }
+        else if (strcmp(argv[i], "--compositor") == 0 && i + 1 < argc)
+        {
+            CompositeKernel kernel;
+            if (!composite_kernel_from_name(argv[++i], kernel) || !composite_set_kernel(kernel))
+            {
+                std::cerr << "compositor not available: " << argv[i] << '\n';
+                return 1;
+            }
+            use_glyph_cache = true;
+        }
+        else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc)
+        {
+            streamFile = argv[++i];
+            verbose = false;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            outPattern = argv[++i];
+            if (!valid_output_pattern(outPattern))
+            {
+                std::cerr << "output pattern needs exactly one %d: " << outPattern << '\n';
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+        {
+            outFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            if (!image_format_from_name(argv[++i], image_options.format))
+            {
+                std::cerr << "unknown image format: " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--png-level") == 0 && i + 1 < argc)
+        {
+            image_options.pngLevel = atoi(argv[++i]);
+            if (image_options.pngLevel < 0 || image_options.pngLevel > 9)
+            {
+                std::cerr << "png level must be 0..9: " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--png-filter") == 0 && i + 1 < argc)
+        {
+            if (!png_filter_from_name(argv[++i], image_options.pngFilter))
+            {
+                std::cerr << "unknown png filter: " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--mask") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "a8") == 0)
+                output_format = CAIRO_FORMAT_A8;
+            else if (strcmp(argv[i], "a1") == 0)
+                output_format = CAIRO_FORMAT_A1;
+            else
+            {
+                std::cerr << "unknown mask format: " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if ((strcmp(argv[i], "--fg") == 0 || strcmp(argv[i], "--bg") == 0) && i + 1 < argc)
+        {
+            uint32_t &color = argv[i][2] == 'f' ? maskForeground : maskBackground;
+            if (!parse_rgb(argv[++i], color))
+            {
+                std::cerr << "colour must be rrggbb: " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+        {
+            benchDir = argv[++i];
+            verbose = false;
+        }
+        else if (strcmp(argv[i], "--bench-tsv") == 0 && i + 1 < argc)
+        {
+            benchTsv = argv[++i];
+        }
+        else if (strcmp(argv[i], "--bench-time") == 0 && i + 1 < argc)
+        {
+            benchSeconds = atof(argv[++i]) / 1000.;
+            if (benchSeconds <= 0)
+            {
+                std::cerr << "bench time must be positive: " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            traceFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace-summary") == 0)
+        {
+            traceSummary = true;
+        }
+        else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+        {
+            wrap_width = atoi(argv[++i]);
+            if (wrap_width <= 0)
+            {
+                std::cerr << "--width must be a positive number of pixels\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--justify") == 0)
+        {
+            justify = true;
+        }
+        else if (strcmp(argv[i], "--crop") == 0)
+        {
+            crop_to_ink = true;
+        }
+        else if (strcmp(argv[i], "--layout") == 0 && i + 1 < argc)
+        {
+            layout_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--layout-format") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "bin") == 0)
+                layout_json = false;
+            else if (strcmp(argv[i], "json") == 0)
+                layout_json = true;
+            else
+            {
+                std::cerr << "unknown layout format: " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--layout-names") == 0)
+        {
+            layoutNames = true;
+        }
+        else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc)
+        {
+            int *n = pipeline_threads;
+            if (sscanf(argv[++i], "%d,%d,%d", &n[0], &n[1], &n[2]) != 3 || n[0] <= 0 || n[1] <= 0 || n[2] <= 0)
+            {
+                std::cerr << "--pipeline needs three thread counts, e.g. 1,2,2\n";
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+            if (threads <= 0)
+                threads = std::thread::hardware_concurrency();
+        }
+        else
+        {
+            std::cerr << "How to use: " << argv[0]
+                      << " [--batch <jobs file | ->] [--threads <n>] [--pipeline <shape,raster,encode>]"
+                      << " [--stream <text file | ->] [--output <pattern>] [--glyph-cache] [--sdf]"
+                      << " [--text <file | ->] [--raster-threads <n>]"
+                      << " [--compositor <auto|scalar|sse2|avx2>] [--out <file | ->]"
+                      << " [--format <png|qoi|pam|pgm>] [--png-level <0..9>]"
+                      << " [--png-filter <none|sub|up|avg|paeth|adaptive>]"
+                      << " [--mask <a8|a1>] [--fg <rrggbb>] [--bg <rrggbb>]"
+                      << " [--bench <corpus dir>] [--bench-tsv <file | ->] [--bench-time <ms>]"
+                      << " [--trace <file | ->] [--trace-summary] [--sdf-atlas <prefix>]"
+                      << " [--font-file <path>] [--subset <corpus> [--subset-out <file>]]"
+                      << " [--width <px>] [--justify] [--crop] [--layout <file | ->] [--layout-format <bin|json>] [--layout-names]\n";
+            return 1;
+        }
+    }
+
+    if ((batchFile != NULL) + (streamFile != NULL) + (benchDir != NULL) + (sdfAtlasPrefix != NULL) +
+            (subsetCorpus != NULL) > 1)
+    {
+        std::cerr << "--batch, --stream, --bench, --sdf-atlas and --subset cannot be used together\n";
+        return 1;
+    }
+
+    if (output_format == CAIRO_FORMAT_A1 && (use_glyph_cache || use_sdf))
+    {
+        std::cerr << "--mask a1 cannot be used with --glyph-cache or --sdf (they draw antialiased coverage)\n";
+        return 1;
+    }
+
+    // mask에 입힐 색. ARGB32로 그릴 때는 쓰지 않는다
+    image_options.foreground = maskForeground;
+    image_options.background = maskBackground;
+
+    if (pipeline_threads[0] && (!batchFile || layout_file || threads > 1))
+    {
+        std::cerr << "--pipeline needs --batch and cannot be used with --layout or --threads\n";
+        return 1;
+    }
+
+    if (benchDir && layout_file)
+    {
+        std::cerr << "--layout cannot be used with --bench\n";
+        return 1;
+    }
+
+    if (benchDir && wrap_width)
+    {
+        std::cerr << "--width cannot be used with --bench (paragraph stages use their own width)\n";
+        return 1;
+    }
+
+    // stdout에는 image (또는 layout)만 나가야 한다. 통계는 stderr로 보낸다
+    bool toStdout = outFile && strcmp(outFile, "-") == 0;
+    stdout_data = toStdout || (layout_file && strcmp(layout_file, "-") == 0);
+    if (stdout_data)
+        verbose = false;
+
+    if (layout_file && layout_json && !layout_json_writer.open(layout_file, layoutNames))
+    {
+        std::cerr << "cannot write layout " << layout_file << '\n';
+        return 1;
+    }
+
+    if (traceFile || traceSummary)
+        trace_enable();
+
+    if (font_file && !font_maps.open(font_file))
+    {
+        std::cerr << "cannot open font " << font_file << '\n';
+        return 1;
+    }
+
+    std::string fontFile = my_fontconfig();
+    my_freetype(fontFile);
+
+    int ret = 0;
+    const char *inputFile = batchFile ? batchFile : streamFile;
+    if (benchDir)
+    {
+        ret = run_bench(benchDir, benchTsv, benchSeconds);
+    }
+    else if (sdfAtlasPrefix)
+    {
+        ret = export_sdf_atlas(sdfAtlasPrefix);
+    }
+    else if (subsetCorpus)
+    {
+        ret = run_subset(subsetCorpus, subsetOut);
+    }
+    else if (!inputFile)
+    {
+        std::string text = str;
+        if (textFile && !read_text(textFile, text))
+        {
+            std::cerr << "cannot read " << textFile << '\n';
+            destroy();
+            return 1;
+        }
+
+        std::string defaultOut = std::string("out.") + image_format_extension(image_options.format);
+        render(main_context, text, outFile ? outFile : defaultOut.c_str(), 0);
+        if (!stdout_data)
+            print_font_map_stats();
+    }
+    else
+    {
+        std::ifstream file;
+        if (strcmp(inputFile, "-") != 0)
+            file.open(inputFile, std::ios::binary);
+
+        std::istream &in = strcmp(inputFile, "-") == 0 ? std::cin : file;
+        if (!in)
+        {
+            std::cerr << "cannot open " << inputFile << '\n';
+            ret = 1;
+        }
+        else if (batchFile)
+        {
+            ret = pipeline_threads[0] ? run_pipeline(in) : run_batch(in);
+        }
+        else
+        {
+            ret = run_stream(in, outPattern);
+        }
+    }
+
+    if (layout_file)
+    {
+        bool written = layout_json ? layout_json_writer.close() : layout_writer.write(layout_file);
+        if (!written)
+        {
+            std::cerr << "cannot write layout " << layout_file << '\n';
+            ret = 1;
+        }
+    }
+
+    if (traceFile && !trace_write_chrome(traceFile))
+    {
+        std::cerr << "cannot write trace " << traceFile << '\n';
+        ret = 1;
+    }
+    if (traceSummary)
+        trace_print_summary(std::cerr);
 
     destroy();
+    return ret;
 }
@@ -0,0 +1,500 @@
+#include "paragraph_layout.h"
+
+#include <algorithm>
+
+namespace
+{
+    // 줄 끝에 매달아 폭에 넣지 않는 공백
+    bool is_space(uint32_t c)
+    {
+        return c == ' ' || c == '\t' || c == 0x3000 || (c >= 0x2000 && c <= 0x200A && c != 0x2007) || c == 0x205F;
+    }
+
+    bool is_newline(uint32_t c)
+    {
+        LineBreakClass lb = line_break_class(c);
+        return lb == LB_BK || lb == LB_CR || lb == LB_LF || lb == LB_NL;
+    }
+
+    bool unsafe_to_break(const hb_glyph_info_t &info)
+    {
+        return hb_glyph_info_get_glyph_flags(&info) & HB_GLYPH_FLAG_UNSAFE_TO_BREAK;
+    }
+
+    void shift_line(LayoutLine &line, int delta)
+    {
+        line.start += delta;
+        line.end += delta;
+        for (hb_glyph_info_t &info : line.infos)
+            info.cluster += delta;
+    }
+}
+
+ParagraphLayout::~ParagraphLayout()
+{
+    if (buffer_)
+        hb_buffer_destroy(buffer_);
+}
+
+void ParagraphLayout::clear()
+{
+    shapeCache_.clear();
+    text_.clear();
+    attrs_.clear();
+    infos_.clear();
+    positions_.clear();
+    advances_.clear();
+    breaks_.clear();
+    lines_.clear();
+}
+
+bool ParagraphLayout::setText(const std::string &utf8, LayoutFonts &fonts)
+{
+    // UTF-8 byte 수 >= codepoint 수
+    utf32_.resize(utf8.size() + 1);
+    FriBidiStrIndex len = fribidi_charset_to_unicode(FRIBIDI_CHAR_SET_UTF8, utf8.data(), utf8.size(),
+                                                     (FriBidiChar *)utf32_.data());
+    return setText(utf32_.data(), len, fonts);
+}
+
+bool ParagraphLayout::setText(const uint32_t *text, unsigned int length, LayoutFonts &fonts)
+{
+    stats_.layouts++;
+
+    text_.assign(text, text + length);
+    if (!itemize(fonts))
+    {
+        // 예전 glyph와 줄은 새 text와 맞지 않는다
+        clear();
+        return false;
+    }
+
+    infos_.clear();
+    positions_.clear();
+    shapeRange(0, length, fonts, infos_, positions_);
+    computeAdvances();
+
+    breaker_.find(text_.data(), length, breaks_);
+    wrapAll(fonts);
+    return true;
+}
+
+bool ParagraphLayout::edit(unsigned int start, unsigned int end, const std::string &utf8, LayoutFonts &fonts)
+{
+    utf32_.resize(utf8.size() + 1);
+    FriBidiStrIndex len = fribidi_charset_to_unicode(FRIBIDI_CHAR_SET_UTF8, utf8.data(), utf8.size(),
+                                                     (FriBidiChar *)utf32_.data());
+    return edit(start, end, utf32_.data(), len, fonts);
+}
+
+bool ParagraphLayout::edit(unsigned int start, unsigned int end, const uint32_t *replacement, unsigned int length,
+                           LayoutFonts &fonts)
+{
+    if (start > end || end > text_.size())
+        return false;
+    stats_.edits++;
+
+    const unsigned int removed = end - start;
+    const int delta = (int)length - (int)removed;
+
+    removed_.assign(text_.begin() + start, text_.begin() + end);
+    oldAttrs_.swap(attrs_);
+    text_.erase(text_.begin() + start, text_.begin() + end);
+    text_.insert(text_.begin() + start, replacement, replacement + length);
+    if (!itemize(fonts))
+    {
+        // 편집 전으로 되돌린다. itemize()는 attrs_를 건드리기 전에 실패하지만 bidi_는 새 text를 받았으므로
+        // 예전 text로 다시 맞추고, 그것도 안 되면 비운다
+        text_.erase(text_.begin() + start, text_.begin() + start + length);
+        text_.insert(text_.begin() + start, removed_.begin(), removed_.end());
+        attrs_.swap(oldAttrs_);
+        if (!bidi_.itemize(text_.data(), text_.size(), base_))
+            clear();
+        return false;
+    }
+
+    const unsigned int total = text_.size();
+
+    // 다시 shape할 구간 (새 좌표). bidi level, script, font가 바뀐 글자까지 넓힌다
+    // (RTL 글자를 넣으면 주변 중립 글자의 level이 바뀔 수 있다)
+    unsigned int dirtyStart = start;
+    unsigned int dirtyEnd = start + length;
+    for (unsigned int i = 0; i < start; i++)
+    {
+        if (attrs_[i] != oldAttrs_[i])
+        {
+            dirtyStart = i;
+            break;
+        }
+    }
+    for (unsigned int i = total; i > start + length; i--)
+    {
+        if (attrs_[i - 1] != oldAttrs_[i - 1 - length + removed])
+        {
+            dirtyEnd = i;
+            break;
+        }
+    }
+
+    // 예전 glyph를 잘라도 되는 경계까지 넓힌다. 앞쪽은 새 좌표와 예전 좌표가 같다
+    unsigned int shapeStart = dirtyStart;
+    while (shapeStart > 0 && !safeBoundary(oldAttrs_, shapeStart))
+        shapeStart--;
+    unsigned int shapeEnd = dirtyEnd;
+    while (shapeEnd < total && !safeBoundary(oldAttrs_, shapeEnd - length + removed))
+        shapeEnd++;
+
+    // 예전 glyph의 flag만으로는 새 text에서도 그 경계를 자를 수 있는지 알 수 없다 (앞 글자에 따라 kerning,
+    // ligature가 달라질 수 있다). 그래서 양쪽으로 안전한 구간을 하나씩 더 shape해서 새 결과의 flag로 확인하고,
+    // 안전하지 않으면 그 구간까지 넓혀서 다시 한다.
+    auto cutOk = [this](unsigned int position) {
+        size_t g = std::lower_bound(shapedInfos_.begin(), shapedInfos_.end(), position,
+                                    [](const hb_glyph_info_t &info, unsigned int p) { return info.cluster < p; }) -
+                   shapedInfos_.begin();
+        return g < shapedInfos_.size() && shapedInfos_[g].cluster == position && !unsafe_to_break(shapedInfos_[g]);
+    };
+
+    for (;;)
+    {
+        unsigned int outerStart = shapeStart;
+        if (outerStart > 0 && !itemBoundary(attrs_, outerStart))
+        {
+            do
+                outerStart--;
+            while (outerStart > 0 && !safeBoundary(oldAttrs_, outerStart));
+        }
+        unsigned int outerEnd = shapeEnd;
+        if (outerEnd < total && !itemBoundary(attrs_, outerEnd))
+        {
+            do
+                outerEnd++;
+            while (outerEnd < total && !safeBoundary(oldAttrs_, outerEnd - length + removed));
+        }
+
+        shapedInfos_.clear();
+        shapedPositions_.clear();
+        shapeRange(outerStart, outerEnd, fonts, shapedInfos_, shapedPositions_);
+
+        bool startOk = outerStart == shapeStart || cutOk(shapeStart);
+        bool endOk = outerEnd == shapeEnd || cutOk(shapeEnd);
+        if (startOk && endOk)
+            break;
+        if (!startOk)
+            shapeStart = outerStart;
+        if (!endOk)
+            shapeEnd = outerEnd;
+    }
+
+    // 더 shape한 양쪽 구간은 버린다 (예전 glyph와 같다)
+    auto shapedAt = [this](unsigned int position) {
+        return std::lower_bound(shapedInfos_.begin(), shapedInfos_.end(), position,
+                                [](const hb_glyph_info_t &info, unsigned int p) { return info.cluster < p; }) -
+               shapedInfos_.begin();
+    };
+    size_t shaped0 = shapedAt(shapeStart);
+    size_t shaped1 = shapedAt(shapeEnd);
+
+    // 앞뒤 glyph는 그대로 두고 가운데만 바꾼다. 뒤쪽은 cluster만 옮긴다
+    size_t prefix = glyphAt(shapeStart);
+    size_t suffix = glyphAt(shapeEnd - length + removed);
+    for (size_t g = suffix; g < infos_.size(); g++)
+        infos_[g].cluster += delta;
+
+    infos_.erase(infos_.begin() + prefix, infos_.begin() + suffix);
+    infos_.insert(infos_.begin() + prefix, shapedInfos_.begin() + shaped0, shapedInfos_.begin() + shaped1);
+    positions_.erase(positions_.begin() + prefix, positions_.begin() + suffix);
+    positions_.insert(positions_.begin() + prefix, shapedPositions_.begin() + shaped0,
+                      shapedPositions_.begin() + shaped1);
+    stats_.reusedCodepoints += shapeStart + (total - shapeEnd);
+
+    computeAdvances();
+    breaker_.find(text_.data(), total, breaks_);
+
+    if (rewrap_ || lines_.empty())
+    {
+        wrapAll(fonts);
+        return true;
+    }
+
+    // shapeStart가 있던 줄의 앞 줄부터 다시 나눈다 (첫 단어가 앞 줄로 올라갈 수 있다)
+    std::vector<LayoutLine> old;
+    old.swap(lines_);
+
+    size_t first = 0;
+    while (first + 1 < old.size() && old[first].end <= shapeStart)
+        first++;
+    if (first > 0)
+        first--;
+
+    for (size_t i = 0; i < first; i++)
+        lines_.push_back(std::move(old[i]));
+    stats_.linesReused += first;
+
+    unsigned int pos = old[first].start;
+    size_t k = first;
+    for (;;)
+    {
+        // 바뀐 구간을 지나서 예전 줄 시작과 다시 맞으면, 거기부터는 줄 나누기와 glyph가 예전과 같다
+        if (pos >= shapeEnd)
+        {
+            unsigned int oldPos = pos - length + removed;
+            while (k < old.size() && old[k].start < oldPos)
+                k++;
+            if (k < old.size() && old[k].start == oldPos)
+            {
+                stats_.linesReused += old.size() - k;
+                for (; k < old.size(); k++)
+                {
+                    shift_line(old[k], delta);
+                    lines_.push_back(std::move(old[k]));
+                }
+                break;
+            }
+        }
+
+        bool hard;
+        unsigned int lineEnd = wrapLine(pos, hard);
+        lines_.push_back(LayoutLine{pos, lineEnd, 0, 0, hard, {}, {}, {}});
+        buildLine(lines_.back(), lineEnd >= total, fonts);
+
+        pos = lineEnd;
+        if (pos >= total)
+            break;
+    }
+
+    return true;
+}
+
+void ParagraphLayout::relayout(LayoutFonts &fonts)
+{
+    wrapAll(fonts);
+}
+
+bool ParagraphLayout::itemize(LayoutFonts &fonts)
+{
+    unsigned int length = text_.size();
+    if (!bidi_.itemize(text_.data(), length, base_))
+        return false;
+
+    const FriBidiLevel *levels = bidi_.levels();
+    const hb_script_t *scripts = bidi_.scripts();
+    attrs_.resize(length);
+
+    unsigned int font = 0;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        font = fonts.find(text_[i], font);
+        attrs_[i] = {levels[i], scripts[i], font};
+    }
+    return true;
+}
+
+bool ParagraphLayout::itemBoundary(const std::vector<Attr> &attrs, unsigned int position)
+{
+    return position == 0 || position >= attrs.size() || attrs[position - 1] != attrs[position];
+}
+
+size_t ParagraphLayout::glyphAt(unsigned int position) const
+{
+    return std::lower_bound(infos_.begin(), infos_.end(), position,
+                            [](const hb_glyph_info_t &info, unsigned int p) { return info.cluster < p; }) -
+           infos_.begin();
+}
+
+bool ParagraphLayout::safeBoundary(const std::vector<Attr> &attrs, unsigned int position) const
+{
+    // item은 따로 shape했으므로 item 경계는 항상 자를 수 있다
+    if (itemBoundary(attrs, position))
+        return true;
+
+    // cluster 가운데면 안 되고, cluster 시작이면 HarfBuzz가 표시한 대로
+    size_t g = glyphAt(position);
+    if (g == infos_.size() || infos_[g].cluster != position)
+        return false;
+    return !unsafe_to_break(infos_[g]);
+}
+
+void ParagraphLayout::shapeRange(unsigned int start, unsigned int end, LayoutFonts &fonts,
+                                 std::vector<hb_glyph_info_t> &infos, std::vector<hb_glyph_position_t> &positions)
+{
+    if (!buffer_)
+        buffer_ = hb_buffer_create();
+
+    unsigned int i = start;
+    while (i < end)
+    {
+        unsigned int j = i + 1;
+        while (j < end && attrs_[j] == attrs_[i])
+            j++;
+
+        // 앞뒤 문맥은 paragraph 전체에서 HarfBuzz가 읽는다
+        const Attr &attr = attrs_[i];
+        hb_direction_t direction = FRIBIDI_LEVEL_IS_RTL(attr.level) ? HB_DIRECTION_RTL : HB_DIRECTION_LTR;
+        shapeCache_.shape(fonts.font(attr.font), buffer_, text_.data(), text_.size(), i, j - i,
+                          direction, attr.script, NULL, 0);
+
+        unsigned int count = shapeCache_.length();
+        size_t first = infos.size();
+        infos.insert(infos.end(), shapeCache_.infos(), shapeCache_.infos() + count);
+        positions.insert(positions.end(), shapeCache_.positions(), shapeCache_.positions() + count);
+
+        // RTL은 HarfBuzz가 visual order로 내주므로 논리 순서로 돌려놓는다
+        if (HB_DIRECTION_IS_BACKWARD(direction))
+        {
+            std::reverse(infos.begin() + first, infos.end());
+            std::reverse(positions.begin() + first, positions.end());
+        }
+
+        stats_.shapedCodepoints += j - i;
+        i = j;
+    }
+}
+
+void ParagraphLayout::computeAdvances()
+{
+    advances_.assign(text_.size(), 0);
+    for (size_t g = 0; g < infos_.size(); g++)
+        advances_[infos_[g].cluster] += positions_[g].x_advance;
+}
+
+unsigned int ParagraphLayout::wrapLine(unsigned int start, bool &hard) const
+{
+    unsigned int length = text_.size();
+    int width = 0;
+    unsigned int lastBreak = start; // start보다 크면 마지막으로 나눌 수 있던 곳
+
+    for (unsigned int i = start; i < length; i++)
+    {
+        width += advances_[i];
+
+        // 공백은 줄 끝에 매달 수 있으므로 넘쳐도 자르지 않는다. 한 단어가 줄보다 길면 넘치게 둔다
+        if (width_ > 0 && width > width_ && !is_space(text_[i]) && lastBreak > start)
+        {
+            hard = false;
+            return lastBreak;
+        }
+
+        if (breaks_[i + 1] == LINE_BREAK_MANDATORY)
+        {
+            hard = is_newline(text_[i]);
+            return i + 1;
+        }
+        if (breaks_[i + 1] == LINE_BREAK_ALLOWED)
+            lastBreak = i + 1;
+    }
+
+    hard = false;
+    return length;
+}
+
+void ParagraphLayout::buildLine(LayoutLine &line, bool last, LayoutFonts &fonts)
+{
+    stats_.linesBuilt++;
+    line.infos.clear();
+    line.positions.clear();
+    line.segments.clear();
+
+    // 줄바꿈 글자는 그리지 않는다
+    unsigned int end = line.end;
+    while (end > line.start && is_newline(text_[end - 1]))
+        end--;
+
+    // UAX#9 L1: 줄 끝 공백은 paragraph level로 되돌린다
+    unsigned int trailing = end;
+    while (trailing > line.start && is_space(text_[trailing - 1]))
+        trailing--;
+    FriBidiLevel baseLevel = FRIBIDI_IS_RTL(bidi_.baseDirection()) ? 1 : 0;
+
+    lineRuns_.clear();
+    for (unsigned int i = line.start; i < end;)
+    {
+        unsigned int j = i + 1;
+        while (j < end && attrs_[j] == attrs_[i] && (j < trailing) == (i < trailing))
+            j++;
+        lineRuns_.push_back({i, j, i < trailing ? attrs_[i].level : baseLevel, attrs_[i]});
+        i = j;
+    }
+    bidi_reorder_runs(lineRuns_.data(), lineRuns_.size());
+
+    for (const LineRun &run : lineRuns_)
+    {
+        size_t first = line.infos.size();
+        if (safeBoundary(attrs_, run.start) && safeBoundary(attrs_, run.end))
+        {
+            size_t g0 = glyphAt(run.start);
+            size_t g1 = glyphAt(run.end);
+            line.infos.insert(line.infos.end(), infos_.begin() + g0, infos_.begin() + g1);
+            line.positions.insert(line.positions.end(), positions_.begin() + g0, positions_.begin() + g1);
+        }
+        else
+        {
+            // 줄 경계에서 모양이 바뀌는 글자 (Arabic 연결, ligature 등)는 이 구간만 다시 shape한다
+            shapedInfos_.clear();
+            shapedPositions_.clear();
+            shapeRange(run.start, run.end, fonts, shapedInfos_, shapedPositions_);
+            line.infos.insert(line.infos.end(), shapedInfos_.begin(), shapedInfos_.end());
+            line.positions.insert(line.positions.end(), shapedPositions_.begin(), shapedPositions_.end());
+        }
+
+        // 논리 순서 glyph를 shape한 방향의 visual order로
+        hb_direction_t direction = FRIBIDI_LEVEL_IS_RTL(run.attr.level) ? HB_DIRECTION_RTL : HB_DIRECTION_LTR;
+        if (HB_DIRECTION_IS_BACKWARD(direction))
+        {
+            std::reverse(line.infos.begin() + first, line.infos.end());
+            std::reverse(line.positions.begin() + first, line.positions.end());
+        }
+
+        line.segments.push_back({run.attr.font, (unsigned int)first, (unsigned int)(line.infos.size() - first),
+                                 direction, run.attr.script});
+    }
+
+    line.advance = 0;
+    int hanging = 0;
+    unsigned int spaces = 0;
+    for (size_t g = 0; g < line.infos.size(); g++)
+    {
+        unsigned int cluster = line.infos[g].cluster;
+        line.advance += line.positions[g].x_advance;
+        if (cluster >= trailing)
+            hanging += line.positions[g].x_advance;
+        else if (is_space(text_[cluster]))
+            spaces++;
+    }
+    line.width = line.advance - hanging;
+
+    // justify: 단어 사이 공백에 남는 폭을 고르게 나눠준다
+    if (justify_ && width_ > 0 && !last && !line.hard && spaces && line.width < width_)
+    {
+        int extra = width_ - line.width;
+        unsigned int n = 0;
+        for (size_t g = 0; g < line.infos.size(); g++)
+        {
+            unsigned int cluster = line.infos[g].cluster;
+            if (cluster >= trailing || !is_space(text_[cluster]))
+                continue;
+            line.positions[g].x_advance += (int)((int64_t)extra * (n + 1) / spaces - (int64_t)extra * n / spaces);
+            n++;
+        }
+        line.advance += extra;
+        line.width = width_;
+    }
+}
+
+void ParagraphLayout::wrapAll(LayoutFonts &fonts)
+{
+    rewrap_ = false;
+    lines_.clear();
+
+    unsigned int length = text_.size();
+    unsigned int pos = 0;
+    do
+    {
+        bool hard;
+        unsigned int end = wrapLine(pos, hard);
+        lines_.push_back(LayoutLine{pos, end, 0, 0, hard, {}, {}, {}});
+        pos = end;
+    } while (pos < length);
+
+    for (size_t i = 0; i < lines_.size(); i++)
+        buildLine(lines_[i], i + 1 == lines_.size(), fonts);
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <hb.h>
+// for harfbuzz
+
+#include "bidi_itemizer.h"
+#include "line_breaker.h"
+#include "shape_cache.h"
+
+// 같은 font, 같은 방향으로 그리는 glyph 구간
+struct GlyphSegment
+{
+    unsigned int font; // FontFallback 번호, 0은 primary
+    unsigned int start;
+    unsigned int count;
+    hb_direction_t direction;
+    hb_script_t script;
+};
+
+// ParagraphLayout이 font를 고르고 찾는 방법. font 번호는 FontFallback 번호와 같다 (0은 primary)
+class LayoutFonts
+{
+public:
+    virtual ~LayoutFonts() {}
+
+    // codepoint를 그릴 font. previous는 앞 글자의 font (같은 font를 이어 쓰도록)
+    virtual unsigned int find(uint32_t codepoint, unsigned int previous) = 0;
+    virtual hb_font_t *font(unsigned int font) = 0;
+};
+
+// 줄 하나. glyph는 visual order, 왼쪽부터 놓는다
+struct LayoutLine
+{
+    unsigned int start; // 논리 순서 codepoint 구간 [start, end), 줄 끝 공백과 줄바꿈 글자 포함
+    unsigned int end;
+    int width;          // 26.6, 줄 끝 공백을 뺀 폭 (justify하면 줄 폭)
+    int advance;        // 26.6, 모든 glyph advance 합
+    bool hard;          // 줄바꿈 글자(mandatory break)로 끝났다
+
+    std::vector<hb_glyph_info_t> infos; // cluster는 paragraph 기준 codepoint index
+    std::vector<hb_glyph_position_t> positions;
+    std::vector<GlyphSegment> segments;
+};
+
+struct ParagraphLayoutStats
+{
+    uint64_t layouts = 0;          // setText()
+    uint64_t edits = 0;            // edit()
+    uint64_t shapedCodepoints = 0; // 다시 shape한 글자 수
+    uint64_t reusedCodepoints = 0; // edit()에서 glyph를 그대로 쓴 글자 수
+    uint64_t linesBuilt = 0;
+    uint64_t linesReused = 0;
+
+    ParagraphLayoutStats &operator+=(const ParagraphLayoutStats &o)
+    {
+        layouts += o.layouts;
+        edits += o.edits;
+        shapedCodepoints += o.shapedCodepoints;
+        reusedCodepoints += o.reusedCodepoints;
+        linesBuilt += o.linesBuilt;
+        linesReused += o.linesReused;
+        return *this;
+    }
+};
+
+// 한 paragraph를 폭에 맞춰 여러 줄로 나눈다.
+//
+// paragraph 전체를 (bidi level, script, font)가 같은 item 단위로 한번 shape해서 논리 순서 glyph로 갖고,
+// UAX#14 break 위치에서 greedy하게 줄을 나눈다. 줄 경계가 HB_GLYPH_FLAG_UNSAFE_TO_BREAK이면
+// 그 줄의 경계 부분만 다시 shape한다. 줄마다 UAX#9 L1 (줄 끝 공백은 paragraph level), L2로 재배치한다.
+//
+// edit()은 바뀐 구간을 unsafe-to-break가 아닌 경계까지 넓혀서 그 부분만 다시 shape하고,
+// 나머지 glyph는 cluster만 옮겨서 재사용한다. 줄 나누기는 바뀐 줄 바로 앞 줄부터 다시 하고,
+// 줄 끝이 예전 줄 끝과 다시 맞으면 멈춘다. 그 뒤 줄은 glyph까지 그대로 재사용한다.
+// 가로쓰기만 지원한다. thread-safe 하지 않다.
+class ParagraphLayout
+{
+public:
+    ParagraphLayout() = default;
+    ~ParagraphLayout();
+
+    ParagraphLayout(const ParagraphLayout &) = delete;
+    ParagraphLayout &operator=(const ParagraphLayout &) = delete;
+
+    // 줄 폭 (26.6). 0 이하면 줄바꿈 글자에서만 나눈다. 다음 setText()/edit()/relayout()부터 적용
+    void setWidth(int width)
+    {
+        rewrap_ |= width != width_;
+        width_ = width;
+    }
+    // 마지막 줄과 줄바꿈 글자로 끝난 줄을 빼고 공백을 늘려 줄 폭에 맞춘다
+    void setJustify(bool justify)
+    {
+        rewrap_ |= justify != justify_;
+        justify_ = justify;
+    }
+    void setBase(FriBidiParType base) { base_ = base; }
+
+    // 전체를 다시 만든다. fribidi가 실패하면 false이고 clear()한 상태가 된다
+    bool setText(const std::string &utf8, LayoutFonts &fonts);
+    bool setText(const uint32_t *text, unsigned int length, LayoutFonts &fonts);
+
+    // text[start, end)를 replacement로 바꾸고 영향 받은 부분만 다시 만든다.
+    // 실패하면 false이고 편집 전 상태로 남는다 (되돌릴 수 없으면 clear()한 상태)
+    bool edit(unsigned int start, unsigned int end, const std::string &utf8, LayoutFonts &fonts);
+    bool edit(unsigned int start, unsigned int end, const uint32_t *replacement, unsigned int length,
+              LayoutFonts &fonts);
+
+    // shape는 그대로 두고 줄만 다시 나눈다 (폭이 바뀌었을 때)
+    void relayout(LayoutFonts &fonts);
+
+    const std::vector<LayoutLine> &lines() const { return lines_; }
+    const uint32_t *text() const { return text_.data(); }
+    unsigned int length() const { return text_.size(); }
+    hb_direction_t direction() const { return FRIBIDI_IS_RTL(bidi_.baseDirection()) ? HB_DIRECTION_RTL : HB_DIRECTION_LTR; }
+    unsigned int glyphCount() const { return infos_.size(); }
+
+    // font가 닫힐 때 부른다 (shape cache와 glyph를 버린다)
+    void clear();
+
+    const ShapeCache &shapeCache() const { return shapeCache_; }
+    const ParagraphLayoutStats &stats() const { return stats_; }
+
+private:
+    struct Attr
+    {
+        FriBidiLevel level;
+        hb_script_t script;
+        unsigned int font;
+
+        bool operator==(const Attr &o) const { return level == o.level && script == o.script && font == o.font; }
+        bool operator!=(const Attr &o) const { return !(*this == o); }
+    };
+
+    // 줄 안의 한 run (재배치 단위)
+    struct LineRun
+    {
+        unsigned int start;
+        unsigned int end;
+        FriBidiLevel level;
+        Attr attr;
+    };
+
+    bool itemize(LayoutFonts &fonts);
+    static bool itemBoundary(const std::vector<Attr> &attrs, unsigned int position);
+    size_t glyphAt(unsigned int position) const; // cluster >= position인 첫 glyph (논리 순서)
+    // infos_를 position에서 잘라도 되는지. attrs는 infos_를 만들 때의 것
+    bool safeBoundary(const std::vector<Attr> &attrs, unsigned int position) const;
+
+    // text_[start, end)를 item별로 shape해서 논리 순서로 infos/positions 뒤에 붙인다
+    void shapeRange(unsigned int start, unsigned int end, LayoutFonts &fonts,
+                    std::vector<hb_glyph_info_t> &infos, std::vector<hb_glyph_position_t> &positions);
+    void computeAdvances();
+
+    // start부터 줄 하나의 끝을 찾는다
+    unsigned int wrapLine(unsigned int start, bool &hard) const;
+    void buildLine(LayoutLine &line, bool last, LayoutFonts &fonts);
+    void wrapAll(LayoutFonts &fonts);
+
+    std::vector<uint32_t> text_;
+    BidiItemizer bidi_;
+    std::vector<Attr> attrs_; // codepoint마다
+    std::vector<Attr> oldAttrs_;
+
+    // 논리 순서 glyph, cluster는 오름차순
+    std::vector<hb_glyph_info_t> infos_;
+    std::vector<hb_glyph_position_t> positions_;
+    std::vector<int> advances_; // codepoint마다 x advance (26.6), cluster의 첫 글자에 모은다
+
+    LineBreaker breaker_;
+    std::vector<uint8_t> breaks_;
+
+    std::vector<LayoutLine> lines_;
+
+    // scratch
+    std::vector<hb_glyph_info_t> shapedInfos_;
+    std::vector<hb_glyph_position_t> shapedPositions_;
+    std::vector<LineRun> lineRuns_;
+    std::vector<uint32_t> utf32_;
+    std::vector<uint32_t> removed_; // edit()이 실패하면 되돌릴 글자
+
+    ShapeCache shapeCache_;
+    hb_buffer_t *buffer_ = NULL;
+
+    int width_ = 0;
+    bool justify_ = false;
+    bool rewrap_ = false; // 폭이나 justify가 바뀌어서 예전 줄을 재사용할 수 없다
+    FriBidiParType base_ = FRIBIDI_PAR_ON;
+
+    ParagraphLayoutStats stats_;
+};
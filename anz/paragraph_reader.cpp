@@ -0,0 +1,82 @@
+#include "paragraph_reader.h"
+
+#include <cstring>
+
+ParagraphReader::ParagraphReader(std::istream &in, size_t chunkSize)
+    : in_(in), buffer_(chunkSize < 16 ? 16 : chunkSize)
+{
+}
+
+size_t ParagraphReader::fill(size_t need)
+{
+    if (end_ - begin_ >= need || eof_)
+        return end_ - begin_;
+
+    // 남은 byte를 앞으로 당기고 뒤를 채운다
+    memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+
+    while (end_ - begin_ < need && !eof_)
+    {
+        in_.read(buffer_.data() + end_, buffer_.size() - end_);
+        size_t got = in_.gcount();
+        end_ += got;
+        bytesRead_ += got;
+        if (got == 0)
+            eof_ = true;
+    }
+
+    return end_ - begin_;
+}
+
+bool ParagraphReader::next(std::string &paragraph)
+{
+    paragraph.clear();
+
+    bool any = false;
+    for (;;)
+    {
+        // 3 byte separator(U+2029)까지 한번에 볼 수 있도록 채운다
+        size_t avail = fill(3);
+        if (avail == 0)
+            return any;
+        any = true;
+
+        const unsigned char *p = (const unsigned char *)buffer_.data() + begin_;
+        const unsigned char *end = p + avail;
+
+        // separator 후보가 나올 때까지는 그대로 복사한다
+        const unsigned char *run = p;
+        while (p < end && *p != '\n' && *p != '\r' && (*p < 0x1c || *p > 0x1e) && *p != 0xc2 && *p != 0xe2)
+            p++;
+
+        paragraph.append((const char *)run, p - run);
+        begin_ += p - run;
+        if (p == end)
+            continue;
+
+        avail = fill(3);
+        p = (const unsigned char *)buffer_.data() + begin_;
+
+        size_t separator = 0;
+        if (p[0] == '\r')
+            separator = (avail >= 2 && p[1] == '\n') ? 2 : 1;
+        else if (p[0] == '\n' || (p[0] >= 0x1c && p[0] <= 0x1e))
+            separator = 1;
+        else if (p[0] == 0xc2 && avail >= 2 && p[1] == 0x85)
+            separator = 2;
+        else if (p[0] == 0xe2 && avail >= 3 && p[1] == 0x80 && p[2] == 0xa9)
+            separator = 3;
+
+        if (separator)
+        {
+            begin_ += separator;
+            return true;
+        }
+
+        // separator가 아닌 0xc2 / 0xe2로 시작하는 글자
+        paragraph.push_back((char)p[0]);
+        begin_++;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+// UTF-8 stream을 UAX#9 paragraph separator(type B)에서 잘라 paragraph 단위로 읽는다.
+//   LF, CR, CRLF, U+001C..U+001E, U+0085 (NEL), U+2029 (PS)
+// separator는 paragraph에 포함되지 않는다.
+// 읽기 buffer는 고정 크기이므로 메모리는 가장 긴 paragraph 크기에만 비례한다.
+
+class ParagraphReader
+{
+public:
+    explicit ParagraphReader(std::istream &in, size_t chunkSize = 64 * 1024);
+
+    // 다음 paragraph를 paragraph에 넣는다 (capacity는 재사용). 입력이 끝나면 false
+    bool next(std::string &paragraph);
+
+    uint64_t bytesRead() const { return bytesRead_; }
+
+private:
+    // 최소 need byte를 볼 수 있게 채운다. 입력 끝이면 남은 만큼만
+    size_t fill(size_t need);
+
+    std::istream &in_;
+    std::vector<char> buffer_;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    bool eof_ = false;
+    uint64_t bytesRead_ = 0;
+};
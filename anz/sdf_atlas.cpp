@@ -0,0 +1,359 @@
+#include "sdf_atlas.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "composite.h"
+
+const int ATLAS_WIDTH = 1024;
+const int GUTTER = 1;        // glyph 사이 빈 texel, bilinear로 읽을 때 옆 glyph가 섞이지 않도록
+const double EDT_INF = 1e20; // feature가 없는 곳
+
+namespace
+{
+    // Felzenszwalb & Huttenlocher, 1차원 squared distance transform. f를 받아 d에 쓴다
+    void edt_1d(const double *f, int n, double *d, int *v, double *z)
+    {
+        int k = 0;
+        v[0] = 0;
+        z[0] = -EDT_INF;
+        z[1] = EDT_INF;
+        for (int q = 1; q < n; q++)
+        {
+            double s = ((f[q] + (double)q * q) - (f[v[k]] + (double)v[k] * v[k])) / (2. * q - 2. * v[k]);
+            while (s <= z[k])
+            {
+                k--;
+                s = ((f[q] + (double)q * q) - (f[v[k]] + (double)v[k] * v[k])) / (2. * q - 2. * v[k]);
+            }
+            k++;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = EDT_INF;
+        }
+
+        k = 0;
+        for (int q = 0; q < n; q++)
+        {
+            while (z[k + 1] < q)
+                k++;
+            double dq = q - v[k];
+            d[q] = dq * dq + f[v[k]];
+        }
+    }
+
+    // grid (0 또는 EDT_INF)를 가장 가까운 0까지의 squared distance로 바꾼다
+    struct DistanceTransform
+    {
+        std::vector<double> f;
+        std::vector<double> d;
+        std::vector<double> z;
+        std::vector<int> v;
+
+        void run(std::vector<double> &grid, int width, int height)
+        {
+            int n = std::max(width, height);
+            f.resize(n);
+            d.resize(n);
+            z.resize(n + 1);
+            v.resize(n);
+
+            for (int x = 0; x < width; x++)
+            {
+                for (int y = 0; y < height; y++)
+                    f[y] = grid[(size_t)y * width + x];
+                edt_1d(f.data(), height, d.data(), v.data(), z.data());
+                for (int y = 0; y < height; y++)
+                    grid[(size_t)y * width + x] = d[y];
+            }
+            for (int y = 0; y < height; y++)
+            {
+                double *row = &grid[(size_t)y * width];
+                std::copy(row, row + width, f.begin());
+                edt_1d(f.data(), width, d.data(), v.data(), z.data());
+                std::copy(d.begin(), d.begin() + width, row);
+            }
+        }
+    };
+
+    // pack하기 전 glyph 하나의 SDF
+    struct PendingGlyph
+    {
+        uint32_t glyph;
+        int width;
+        int height;
+        size_t offset; // sdf 안에서
+    };
+}
+
+bool SdfAtlas::build(FT_Face face, int emSize, int spread)
+{
+    std::vector<uint32_t> glyphs(face->num_glyphs);
+    for (size_t i = 0; i < glyphs.size(); i++)
+        glyphs[i] = i;
+    return build(face, glyphs.data(), glyphs.size(), emSize, spread);
+}
+
+bool SdfAtlas::build(FT_Face face, const uint32_t *glyphs, size_t count, int emSize, int spread)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    pixels_.clear();
+    glyphs_.assign(face->num_glyphs, SdfGlyph());
+    width_ = 0;
+    height_ = 0;
+    count_ = 0;
+    emSize_ = emSize;
+    spread_ = spread;
+
+    if (emSize <= 0 || spread <= 0 || FT_Set_Pixel_Sizes(face, 0, emSize * OVERSAMPLE))
+        return false;
+
+    const int pad = spread * OVERSAMPLE; // 외곽선 밖으로 spread까지 담는다
+    std::vector<PendingGlyph> pending;
+    std::vector<uint8_t> sdf;
+    std::vector<double> outside; // inside 글자까지의 거리
+    std::vector<double> inside;  // outside 글자까지의 거리
+    DistanceTransform transform;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t gid = glyphs[i];
+        if (gid >= glyphs_.size())
+            continue;
+
+        // hinting은 크기마다 다르므로 outline 그대로 쓴다
+        if (FT_Load_Glyph(face, gid, FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP))
+            continue;
+
+        FT_GlyphSlot slot = face->glyph;
+        SdfGlyph &entry = glyphs_[gid];
+        entry.present = true;
+        entry.advance = slot->linearHoriAdvance / 65536.f / OVERSAMPLE;
+        count_++;
+
+        if (slot->format != FT_GLYPH_FORMAT_OUTLINE || FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL))
+            continue;
+
+        const FT_Bitmap &bitmap = slot->bitmap;
+        if (bitmap.rows == 0 || bitmap.width == 0)
+            continue;
+
+        // oversample 배수로 맞춰서 em 크기 texel 하나가 OVERSAMPLE × OVERSAMPLE pixel이 되게 한다
+        int width = ((int)bitmap.width + 2 * pad + OVERSAMPLE - 1) / OVERSAMPLE * OVERSAMPLE;
+        int height = ((int)bitmap.rows + 2 * pad + OVERSAMPLE - 1) / OVERSAMPLE * OVERSAMPLE;
+        size_t size = (size_t)width * height;
+        outside.assign(size, EDT_INF);
+        inside.assign(size, 0.);
+        for (unsigned int y = 0; y < bitmap.rows; y++)
+        {
+            const unsigned char *row = bitmap.buffer + (ptrdiff_t)y * bitmap.pitch;
+            for (unsigned int x = 0; x < bitmap.width; x++)
+            {
+                if (row[x] < 128)
+                    continue;
+                size_t p = (size_t)(y + pad) * width + x + pad;
+                outside[p] = 0.;
+                inside[p] = EDT_INF;
+            }
+        }
+        transform.run(outside, width, height);
+        transform.run(inside, width, height);
+
+        // pixel 중심의 signed distance를 texel마다 평균한다. 경계는 안팎 pixel 사이에 있다
+        int texelWidth = width / OVERSAMPLE;
+        int texelHeight = height / OVERSAMPLE;
+        PendingGlyph glyph = {gid, texelWidth, texelHeight, sdf.size()};
+        sdf.resize(sdf.size() + (size_t)texelWidth * texelHeight);
+        uint8_t *out = sdf.data() + glyph.offset;
+        for (int ty = 0; ty < texelHeight; ty++)
+        {
+            for (int tx = 0; tx < texelWidth; tx++)
+            {
+                double sum = 0;
+                for (int sy = 0; sy < OVERSAMPLE; sy++)
+                {
+                    for (int sx = 0; sx < OVERSAMPLE; sx++)
+                    {
+                        size_t p = (size_t)(ty * OVERSAMPLE + sy) * width + tx * OVERSAMPLE + sx;
+                        sum += outside[p] == 0. ? sqrt(inside[p]) - .5 : .5 - sqrt(outside[p]);
+                    }
+                }
+                double distance = sum / (OVERSAMPLE * OVERSAMPLE) / OVERSAMPLE; // em pixel
+                long value = lround(128. + distance / spread * 127.);
+                out[ty * texelWidth + tx] = (uint8_t)std::min(255L, std::max(0L, value));
+            }
+        }
+        pending.push_back(glyph);
+
+        entry.width = texelWidth;
+        entry.height = texelHeight;
+        entry.bearingX = (float)(slot->bitmap_left - pad) / OVERSAMPLE;
+        entry.bearingY = (float)(slot->bitmap_top + pad) / OVERSAMPLE;
+    }
+
+    // shelf packing, 높은 것부터 줄에 채운다
+    std::sort(pending.begin(), pending.end(), [](const PendingGlyph &a, const PendingGlyph &b) {
+        return a.height != b.height ? a.height > b.height : a.glyph < b.glyph;
+    });
+
+    width_ = ATLAS_WIDTH;
+    for (const PendingGlyph &glyph : pending)
+        width_ = std::max(width_, glyph.width + 2 * GUTTER);
+
+    int x = GUTTER;
+    int y = GUTTER;
+    int shelf = 0;
+    for (const PendingGlyph &glyph : pending)
+    {
+        if (x + glyph.width + GUTTER > width_)
+        {
+            x = GUTTER;
+            y += shelf + GUTTER;
+            shelf = 0;
+        }
+        if (x > UINT16_MAX || y > UINT16_MAX)
+            return false;
+
+        SdfGlyph &entry = glyphs_[glyph.glyph];
+        entry.x = x;
+        entry.y = y;
+        x += glyph.width + GUTTER;
+        shelf = std::max(shelf, glyph.height);
+    }
+    height_ = y + shelf + GUTTER;
+
+    pixels_.assign((size_t)width_ * height_, 0);
+    for (const PendingGlyph &glyph : pending)
+    {
+        const SdfGlyph &entry = glyphs_[glyph.glyph];
+        for (int row = 0; row < glyph.height; row++)
+            memcpy(&pixels_[(size_t)(entry.y + row) * width_ + entry.x], &sdf[glyph.offset + (size_t)row * glyph.width],
+                   glyph.width);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    buildSeconds_ = elapsed.count();
+    return true;
+}
+
+bool SdfAtlas::writeMetrics(const char *path, const std::string &fontFile, int faceIndex) const
+{
+    bool toStdout = strcmp(path, "-") == 0;
+    FILE *fp = toStdout ? stdout : fopen(path, "w");
+    if (!fp)
+        return false;
+
+    std::string file;
+    for (unsigned char c : fontFile)
+    {
+        if (c == '"' || c == '\\')
+            file.push_back('\\');
+        if (c < 0x20)
+            continue;
+        file.push_back(c);
+    }
+
+    bool ok = fprintf(fp, "{\"type\":\"atlas\",\"file\":\"%s\",\"face\":%d,\"em\":%d,\"spread\":%d,"
+                          "\"oversample\":%d,\"width\":%d,\"height\":%d,\"glyphs\":%zu}\n",
+                      file.c_str(), faceIndex, emSize_, spread_, OVERSAMPLE, width_, height_, count_) > 0;
+    for (size_t gid = 0; gid < glyphs_.size() && ok; gid++)
+    {
+        const SdfGlyph &glyph = glyphs_[gid];
+        if (!glyph.present)
+            continue;
+        ok = fprintf(fp, "{\"type\":\"glyph\",\"id\":%zu,\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,"
+                         "\"bearing_x\":%g,\"bearing_y\":%g,\"advance\":%g}\n",
+                     gid, glyph.x, glyph.y, glyph.width, glyph.height, glyph.bearingX, glyph.bearingY,
+                     glyph.advance) > 0;
+    }
+
+    if (toStdout)
+        ok = fflush(fp) == 0 && ok;
+    else
+        ok = fclose(fp) == 0 && ok;
+    return ok;
+}
+
+void SdfRenderer::drawGlyphs(cairo_surface_t *surface, const SdfAtlas &atlas, double fontSize, double originX,
+                             double originY, const hb_glyph_info_t *info, const hb_glyph_position_t *pos,
+                             unsigned int len, uint32_t color, int surfaceTop)
+{
+    cairo_surface_flush(surface);
+    uint8_t *data = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    int surfaceWidth = cairo_image_surface_get_width(surface);
+    int surfaceHeight = cairo_image_surface_get_height(surface);
+    cairo_format_t format = cairo_image_surface_get_format(surface);
+    if (!data || (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_A8))
+        return;
+
+    const double scale = fontSize / atlas.emSize();
+    const double distanceScale = atlas.spread() / 127. * scale; // texel 값 1이 몇 pixel인지
+    const uint8_t *texels = atlas.data();
+    const int atlasStride = atlas.width();
+
+    double x = originX;
+    double y = originY;
+    for (unsigned int i = 0; i < len; i++)
+    {
+        const SdfGlyph *glyph = atlas.glyph(info[i].codepoint);
+        if (glyph && glyph->width && glyph->height)
+        {
+            // glyph 영역의 왼쪽 위 (device pixel)
+            double left = x + pos[i].x_offset / 64. + glyph->bearingX * scale;
+            double top = y - pos[i].y_offset / 64. - glyph->bearingY * scale;
+            int maskX = (int)floor(left);
+            int maskY = (int)floor(top);
+            int maskWidth = (int)ceil(left + glyph->width * scale) - maskX;
+            int maskHeight = (int)ceil(top + glyph->height * scale) - maskY;
+            mask_.resize((size_t)maskWidth * maskHeight);
+
+            const int lastX = glyph->width - 1;
+            const int lastY = glyph->height - 1;
+            for (int my = 0; my < maskHeight; my++)
+            {
+                // pixel 중심의 texel 좌표, texel 중심은 +.5에 있다
+                double ty = (maskY + my + .5 - top) / scale - .5;
+                int y0 = (int)floor(ty);
+                double fy = ty - y0;
+                const uint8_t *row0 = texels + (size_t)(glyph->y + std::min(std::max(y0, 0), lastY)) * atlasStride + glyph->x;
+                const uint8_t *row1 = texels + (size_t)(glyph->y + std::min(std::max(y0 + 1, 0), lastY)) * atlasStride + glyph->x;
+                uint8_t *out = &mask_[(size_t)my * maskWidth];
+
+                for (int mx = 0; mx < maskWidth; mx++)
+                {
+                    double tx = (maskX + mx + .5 - left) / scale - .5;
+                    int x0 = (int)floor(tx);
+                    double fx = tx - x0;
+                    int c0 = std::min(std::max(x0, 0), lastX);
+                    int c1 = std::min(std::max(x0 + 1, 0), lastX);
+
+                    double top0 = row0[c0] + (row0[c1] - row0[c0]) * fx;
+                    double top1 = row1[c0] + (row1[c1] - row1[c0]) * fx;
+                    double value = top0 + (top1 - top0) * fy;
+
+                    // 외곽선까지의 거리 (device pixel)에서 pixel 하나 폭으로 antialiasing
+                    double coverage = (value - 128.) * distanceScale + .5;
+                    out[mx] = coverage <= 0. ? 0 : coverage >= 1. ? 255 : (uint8_t)lround(coverage * 255.);
+                }
+            }
+
+            // mask는 image 기준으로 만들고 놓을 때만 slice 기준으로 옮긴다 (band로 나눠도 같은 pixel)
+            if (format == CAIRO_FORMAT_A8)
+                composite_mask_a8(data, stride, surfaceWidth, surfaceHeight, mask_.data(), maskWidth, maskWidth,
+                                  maskHeight, maskX, maskY - surfaceTop);
+            else
+                composite_mask(data, stride, surfaceWidth, surfaceHeight, mask_.data(), maskWidth, maskWidth,
+                               maskHeight, maskX, maskY - surfaceTop, color);
+        }
+
+        x += pos[i].x_advance / 64.;
+        y -= pos[i].y_advance / 64.;
+    }
+
+    cairo_surface_mark_dirty(surface);
+}
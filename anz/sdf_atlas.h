@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+// for freetype
+
+#include <hb.h>
+// for harfbuzz
+
+#include <cairo.h>
+// for cairo
+
+// signed distance field glyph atlas.
+//
+// face 하나의 glyph를 hinting 없이 한 크기(em pixel)로 한번만 rasterize하고, 각 texel에 glyph 외곽선까지의
+// 거리를 담는다. 128이 외곽선, 클수록 안쪽이고 ±spread pixel (em 크기 기준)이 0 / 255다.
+// 거리는 OVERSAMPLE배로 rasterize한 coverage를 경계로 exact Euclidean distance transform으로 구한다.
+//
+// SdfRenderer는 shaping 결과를 어떤 크기로든 atlas를 bilinear로 읽어 그린다. 크기마다 FT_Load_Glyph /
+// rasterize하지 않는다. font size가 em 크기의 몇 배를 넘으면 모서리가 둥글어진다 (single-channel SDF).
+
+struct SdfGlyph
+{
+    bool present = false; // atlas를 만들 때 load한 glyph
+    uint16_t x = 0;       // atlas 안의 영역, 빈 glyph(공백 등)는 width/height가 0
+    uint16_t y = 0;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    float bearingX = 0;   // 원점에서 영역 왼쪽 위까지, em pixel (y는 위쪽이 양수)
+    float bearingY = 0;
+    float advance = 0;    // hinting 없는 가로 advance, em pixel
+};
+
+class SdfAtlas
+{
+public:
+    static const int OVERSAMPLE = 2;
+    static const int DEFAULT_EM_SIZE = 48;
+    static const int DEFAULT_SPREAD = 6;
+
+    // face의 모든 glyph로 atlas를 만든다. face의 size는 바뀐다 (이 face로 따로 그리지 않을 때만 쓴다)
+    bool build(FT_Face face, int emSize = DEFAULT_EM_SIZE, int spread = DEFAULT_SPREAD);
+    // glyphs만으로 만든다
+    bool build(FT_Face face, const uint32_t *glyphs, size_t count, int emSize = DEFAULT_EM_SIZE,
+               int spread = DEFAULT_SPREAD);
+
+    // 없으면 NULL
+    const SdfGlyph *glyph(uint32_t glyph) const
+    {
+        return glyph < glyphs_.size() && glyphs_[glyph].present ? &glyphs_[glyph] : NULL;
+    }
+
+    const uint8_t *data() const { return pixels_.data(); } // A8, stride는 width
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int emSize() const { return emSize_; }
+    int spread() const { return spread_; }
+    size_t glyphCount() const { return count_; }
+    double buildSeconds() const { return buildSeconds_; }
+
+    // glyph 표를 JSON Lines로 쓴다. 첫 줄은 atlas 정보, 그 다음 줄부터 glyph 하나씩. path가 "-"면 stdout
+    bool writeMetrics(const char *path, const std::string &fontFile, int faceIndex) const;
+
+private:
+    std::vector<uint8_t> pixels_;
+    std::vector<SdfGlyph> glyphs_; // glyph id로 찾는다
+    int width_ = 0;
+    int height_ = 0;
+    int emSize_ = 0;
+    int spread_ = 0;
+    size_t count_ = 0;
+    double buildSeconds_ = 0;
+};
+
+// SdfAtlas로 shaping 결과를 ARGB32 (또는 A8) surface에 그린다. glyph마다 coverage mask를 만들어 composite_mask()로 합성한다
+class SdfRenderer
+{
+public:
+    // (originX, originY)가 baseline 시작점, fontSize는 pixel. color는 premultiplied ARGB32 (A8 surface면 쓰지 않는다).
+    // surface가 image의 surfaceTop 줄부터 시작하는 slice(band)이면 좌표는 image 기준으로 넘긴다
+    void drawGlyphs(cairo_surface_t *surface, const SdfAtlas &atlas, double fontSize, double originX,
+                    double originY, const hb_glyph_info_t *info, const hb_glyph_position_t *pos,
+                    unsigned int len, uint32_t color, int surfaceTop = 0);
+
+private:
+    std::vector<uint8_t> mask_;
+};
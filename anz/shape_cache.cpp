@@ -0,0 +1,264 @@
+#include "shape_cache.h"
+
+#include <algorithm>
+
+namespace
+{
+    // HarfBuzz가 보는 앞뒤 문맥 길이 (HB_BUFFER_CONTEXT_LENGTH)
+    const unsigned int CONTEXT_LENGTH = 5;
+}
+
+void ShapeCache::shape(hb_font_t *font, hb_buffer_t *buffer,
+                       const uint32_t *text, unsigned int textLength, unsigned int start, unsigned int length,
+                       hb_direction_t direction, hb_script_t script,
+                       const hb_feature_t *features, unsigned int num_features)
+{
+    stats_.texts++;
+
+    text_ = text;
+    textLength_ = textLength;
+    runStart_ = start;
+    runEnd_ = start + length;
+
+    // direction/script는 itemizer가 정한 것을 쓰고, language만 추측한다.
+    // cache hit이어도 segment properties는 buffer에서 읽을 수 있다.
+    hb_buffer_clear_contents(buffer);
+    hb_buffer_add_utf32(buffer, text, textLength, start, length);
+    hb_buffer_set_direction(buffer, direction);
+    hb_buffer_set_script(buffer, script);
+    hb_buffer_guess_segment_properties(buffer);
+
+    bool useCache = capacity_ > 0;
+    if (useCache)
+    {
+        splitWords();
+        makePrefix(font, buffer, features, num_features);
+    }
+
+    if (useCache && lookupAll(HB_DIRECTION_IS_BACKWARD(direction)))
+        return;
+
+    hb_shape(font, buffer, features, num_features);
+    stats_.shapes++;
+
+    infos_ = hb_buffer_get_glyph_infos(buffer, &length_);
+    positions_ = hb_buffer_get_glyph_positions(buffer, NULL);
+
+    if (useCache)
+        insertWords(infos_, positions_, length_);
+}
+
+void ShapeCache::setCapacity(size_t capacity)
+{
+    capacity_ = capacity;
+    while (entries_.size() > capacity_)
+    {
+        map_.erase(entries_.back().key);
+        entries_.pop_back();
+        stats_.evictions++;
+    }
+}
+
+void ShapeCache::clear()
+{
+    map_.clear();
+    entries_.clear();
+    infos_ = nullptr;
+    positions_ = nullptr;
+    length_ = 0;
+}
+
+void ShapeCache::splitWords()
+{
+    // 공백 다음에 공백이 아닌 글자가 오는 곳에서 자른다. 뒤따르는 공백은 앞 단어에 붙는다.
+    words_.clear();
+    if (runStart_ == runEnd_)
+        return;
+
+    unsigned int start = runStart_;
+    for (unsigned int i = runStart_ + 1; i < runEnd_; i++)
+    {
+        if (text_[i - 1] == ' ' && text_[i] != ' ')
+        {
+            words_.push_back({start, i});
+            start = i;
+        }
+    }
+    words_.push_back({start, runEnd_});
+}
+
+void ShapeCache::makePrefix(hb_font_t *font, hb_buffer_t *buffer,
+                            const hb_feature_t *features, unsigned int num_features)
+{
+    prefix_.clear();
+    auto put = [this](const void *data, size_t size) {
+        prefix_.append((const char *)data, size);
+    };
+
+    put(&font, sizeof(font));
+
+    int scale[2];
+    hb_font_get_scale(font, &scale[0], &scale[1]);
+    put(scale, sizeof(scale));
+
+    unsigned int coordCount = 0;
+    const int *coords = hb_font_get_var_coords_normalized(font, &coordCount);
+    put(&coordCount, sizeof(coordCount));
+    if (coordCount)
+        put(coords, coordCount * sizeof(int));
+
+    hb_direction_t direction = hb_buffer_get_direction(buffer);
+    hb_script_t script = hb_buffer_get_script(buffer);
+    hb_language_t language = hb_buffer_get_language(buffer); // language는 interned pointer
+    put(&direction, sizeof(direction));
+    put(&script, sizeof(script));
+    put(&language, sizeof(language));
+
+    put(&num_features, sizeof(num_features));
+    if (num_features)
+        put(features, num_features * sizeof(hb_feature_t));
+}
+
+const std::string &ShapeCache::wordKey(const Word &word)
+{
+    auto put = [this](const uint32_t *data, unsigned int count) {
+        key_.append((const char *)&count, sizeof(count));
+        key_.append((const char *)data, count * sizeof(uint32_t));
+    };
+
+    key_.assign(prefix_);
+
+    // run 첫 단어는 앞 문맥, 마지막 단어는 뒤 문맥까지 같아야 같은 glyph가 나온다
+    unsigned int before = word.start == runStart_ ? std::min(runStart_, CONTEXT_LENGTH) : 0;
+    unsigned int after = word.end == runEnd_ ? std::min(textLength_ - runEnd_, CONTEXT_LENGTH) : 0;
+
+    put(text_ + word.start - before, before);
+    put(text_ + word.start, word.end - word.start);
+    put(text_ + word.end, after);
+    return key_;
+}
+
+bool ShapeCache::lookupAll(bool backward)
+{
+    bool all = true;
+    found_.clear();
+
+    // 하나가 없어도 끝까지 본다: hit rate가 실제 단어 분포를 반영하도록
+    for (const Word &word : words_)
+    {
+        stats_.lookups++;
+
+        auto it = map_.find(wordKey(word));
+        if (it == map_.end())
+        {
+            all = false;
+            continue;
+        }
+
+        stats_.hits++;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        found_.push_back(&*it->second);
+    }
+
+    if (!all)
+        return false;
+
+    scratchInfos_.clear();
+    scratchPositions_.clear();
+
+    // RTL buffer는 glyph가 뒤에 있는 단어부터 나온다
+    size_t count = words_.size();
+    for (size_t n = 0; n < count; n++)
+    {
+        size_t k = backward ? count - 1 - n : n;
+        const Entry *entry = found_[k];
+
+        for (hb_glyph_info_t info : entry->infos)
+        {
+            info.cluster += words_[k].start;
+            scratchInfos_.push_back(info);
+        }
+        scratchPositions_.insert(scratchPositions_.end(), entry->positions.begin(), entry->positions.end());
+    }
+
+    infos_ = scratchInfos_.data();
+    positions_ = scratchPositions_.data();
+    length_ = scratchInfos_.size();
+    return true;
+}
+
+void ShapeCache::insertWords(const hb_glyph_info_t *infos,
+                             const hb_glyph_position_t *positions, unsigned int length)
+{
+    size_t count = words_.size();
+    ranges_.clear();
+    ranges_.resize(count);
+
+    size_t prev = count;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        unsigned int cluster = infos[i].cluster;
+        auto it = std::upper_bound(words_.begin(), words_.end(), cluster, [](unsigned int c, const Word &w) {
+            return c < w.start;
+        });
+        size_t k = (it - words_.begin()) - 1;
+        WordRange &range = ranges_[k];
+
+        if (!range.seen)
+        {
+            range.seen = true;
+            range.begin = i;
+            range.end = i + 1;
+        }
+        else if (k == prev)
+        {
+            range.end = i + 1;
+        }
+        else
+        {
+            range.broken = true;
+        }
+
+        if (cluster == words_[k].start &&
+            (hb_glyph_info_get_glyph_flags(&infos[i]) & HB_GLYPH_FLAG_UNSAFE_TO_BREAK))
+            range.startUnsafe = true;
+
+        prev = k;
+    }
+
+    for (size_t k = 0; k < count; k++)
+    {
+        // 단어 앞 경계(자기 첫 cluster)와 뒤 경계(다음 단어 첫 cluster)가 모두 safe여야 잘라 쓸 수 있다.
+        // run 양 끝은 문맥 글자가 key에 들어가므로 보지 않는다
+        const WordRange &range = ranges_[k];
+        bool startUnsafe = k > 0 && range.startUnsafe;
+        bool endUnsafe = k + 1 < count && ranges_[k + 1].startUnsafe;
+        if (!range.seen || range.broken || startUnsafe || endUnsafe)
+        {
+            stats_.unsafe++;
+            continue;
+        }
+
+        const std::string &key = wordKey(words_[k]);
+        if (map_.count(key))
+            continue;
+
+        entries_.emplace_front();
+        Entry &entry = entries_.front();
+        entry.key = key;
+        entry.infos.assign(infos + range.begin, infos + range.end);
+        entry.positions.assign(positions + range.begin, positions + range.end);
+        for (hb_glyph_info_t &info : entry.infos)
+            info.cluster -= words_[k].start;
+
+        map_.emplace(entry.key, entries_.begin());
+        stats_.inserts++;
+
+        while (entries_.size() > capacity_)
+        {
+            map_.erase(entries_.back().key);
+            entries_.pop_back();
+            stats_.evictions++;
+        }
+    }
+}
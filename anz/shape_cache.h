@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <hb.h>
+// for harfbuzz
+
+// hb_shape() 앞에 두는 단어 단위 LRU cache.
+//
+// bidi run (UTF-32 text의 한 구간)을 공백 뒤에서 단어로 나누고, 모든 단어가 cache에 있으면
+// HarfBuzz를 부르지 않고 저장된 glyph를 이어 붙인다. 하나라도 없으면 run 전체를 한번 shape 한 뒤,
+// 앞뒤 경계가 HB_GLYPH_FLAG_UNSAFE_TO_BREAK가 아닌 단어만 잘라서 cache에 넣는다.
+// (unsafe-to-break가 아니면 따로 shape해서 이어 붙여도 결과가 같다는 것이 HarfBuzz의 보장이다)
+// 단어 사이 경계의 앞은 항상 공백이므로, 공백 너머로 kerning / contextual alternate가 걸리는 단어는
+// 어느 run에서든 경계가 unsafe로 나와 cache에 들어가지 않는다. 그런 단어가 있는 run은 매번 전체를 shape한다.
+//
+// key: (단어 UTF-32, hb_font, scale, variation 좌표, direction, script, language, features)
+// run 양 끝 단어는 run 밖 문맥(joining 등)에 따라 모양이 달라질 수 있으므로 문맥 글자도 key에 넣는다.
+// cache가 잡고 있는 hb_font_t가 destroy되면 clear()를 불러야 한다.
+
+struct ShapeCacheStats
+{
+    uint64_t lookups = 0;   // 단어 lookup 수
+    uint64_t hits = 0;      // 그 중 cache에 있던 것
+    uint64_t texts = 0;     // shape() 호출 수
+    uint64_t shapes = 0;    // 실제 hb_shape() 호출 수
+    uint64_t inserts = 0;
+    uint64_t evictions = 0;
+    uint64_t unsafe = 0;    // 앞이나 뒤 경계가 unsafe-to-break라서 넣지 못한 단어
+
+    double hitRate() const { return lookups ? (double)hits / lookups : 0.; }
+
+    ShapeCacheStats &operator+=(const ShapeCacheStats &o)
+    {
+        lookups += o.lookups;
+        hits += o.hits;
+        texts += o.texts;
+        shapes += o.shapes;
+        inserts += o.inserts;
+        evictions += o.evictions;
+        unsafe += o.unsafe;
+        return *this;
+    }
+};
+
+class ShapeCache
+{
+public:
+    explicit ShapeCache(size_t capacity = 4096) : capacity_(capacity) {}
+
+    // text[start, start + length)를 주어진 direction/script로 shape 한다. 나머지 text는 문맥으로만 쓴다.
+    // buffer에는 항상 run과 segment properties가 채워진다. cluster는 text 전체 기준 codepoint index.
+    // 결과(infos/positions)는 다음 shape() 또는 buffer 변경 전까지만 유효하다.
+    void shape(hb_font_t *font, hb_buffer_t *buffer,
+               const uint32_t *text, unsigned int textLength, unsigned int start, unsigned int length,
+               hb_direction_t direction, hb_script_t script,
+               const hb_feature_t *features, unsigned int num_features);
+
+    const hb_glyph_info_t *infos() const { return infos_; }
+    const hb_glyph_position_t *positions() const { return positions_; }
+    unsigned int length() const { return length_; }
+
+    // 0이면 cache를 쓰지 않고 매번 hb_shape()를 부른다
+    void setCapacity(size_t capacity);
+    size_t size() const { return entries_.size(); }
+    void clear();
+
+    const ShapeCacheStats &stats() const { return stats_; }
+
+private:
+    struct Word
+    {
+        unsigned int start; // text 안에서의 codepoint offset
+        unsigned int end;
+    };
+
+    // insertWords()에서 단어 하나가 차지하는 glyph 범위
+    struct WordRange
+    {
+        unsigned int begin = 0;
+        unsigned int end = 0;
+        bool seen = false;
+        bool broken = false;      // glyph가 연속되지 않음 (cluster가 monotone이 아닐 때)
+        bool startUnsafe = false; // 단어 시작 cluster가 unsafe-to-break
+    };
+
+    struct Entry
+    {
+        std::string key;
+        std::vector<hb_glyph_info_t> infos; // cluster는 단어 시작 기준
+        std::vector<hb_glyph_position_t> positions;
+    };
+
+    void splitWords();
+    void makePrefix(hb_font_t *font, hb_buffer_t *buffer,
+                    const hb_feature_t *features, unsigned int num_features);
+    const std::string &wordKey(const Word &word);
+    bool lookupAll(bool backward);
+    void insertWords(const hb_glyph_info_t *infos,
+                     const hb_glyph_position_t *positions, unsigned int length);
+
+    size_t capacity_;
+    std::list<Entry> entries_; // 앞쪽이 최근에 쓴 것
+    std::unordered_map<std::string, std::list<Entry>::iterator> map_;
+
+    // shape() 동안의 run
+    const uint32_t *text_ = nullptr;
+    unsigned int textLength_ = 0;
+    unsigned int runStart_ = 0;
+    unsigned int runEnd_ = 0;
+
+    std::string prefix_;
+    std::string key_;
+    std::vector<Word> words_;
+    std::vector<Entry *> found_;
+    std::vector<WordRange> ranges_; // miss마다 할당하지 않도록 insertWords()가 재사용한다
+
+    std::vector<hb_glyph_info_t> scratchInfos_;
+    std::vector<hb_glyph_position_t> scratchPositions_;
+
+    const hb_glyph_info_t *infos_ = nullptr;
+    const hb_glyph_position_t *positions_ = nullptr;
+    unsigned int length_ = 0;
+
+    ShapeCacheStats stats_;
+};
@@ -0,0 +1,150 @@
+#include "stage_bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+StageResult stage_result(const std::string &corpus, unsigned int length, int fontSize, const char *stage,
+                         const StageSample &sample, uint64_t glyphs, uint64_t bytes)
+{
+    StageResult result;
+    result.corpus = corpus;
+    result.length = length;
+    result.fontSize = fontSize;
+    result.stage = stage;
+    result.ops = sample.ops;
+    result.glyphs = glyphs;
+    result.nsPerOp = sample.ops ? sample.ns / sample.ops : 0;
+    if (alloc_count_enabled() && sample.ops)
+        result.allocsPerOp = (double)sample.allocs / sample.ops;
+    result.bytes = bytes;
+    return result;
+}
+
+bool load_bench_corpora(const std::string &dir, std::vector<BenchCorpus> &corpora)
+{
+    std::error_code error;
+    std::vector<std::filesystem::path> files;
+    // range-for의 operator++와 error_code 없는 is_regular_file()은 filesystem_error를 던진다
+    std::filesystem::directory_iterator it(dir, error), end;
+    for (; !error && it != end; it.increment(error))
+    {
+        std::error_code entryError; // stat하지 못하는 entry는 건너뛴다
+        if (it->is_regular_file(entryError) && it->path().extension() == ".txt")
+            files.push_back(it->path());
+    }
+    if (error)
+        return false;
+    std::sort(files.begin(), files.end());
+
+    for (const std::filesystem::path &file : files)
+    {
+        std::ifstream in(file, std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        // 한 줄로 그리므로 줄바꿈은 공백 하나로 합친다
+        std::string line;
+        for (char c : text)
+        {
+            if (c == '\n' || c == '\r')
+            {
+                if (!line.empty() && line.back() != ' ')
+                    line.push_back(' ');
+            }
+            else
+            {
+                line.push_back(c);
+            }
+        }
+        while (!line.empty() && line.back() == ' ')
+            line.pop_back();
+
+        if (!line.empty())
+            corpora.push_back({file.stem().string(), line});
+    }
+
+    return !corpora.empty();
+}
+
+std::string bench_sample(const std::string &text, unsigned int codepoints)
+{
+    std::string sample;
+    if (text.empty())
+        return sample;
+
+    unsigned int count = 0;
+    size_t i = 0;
+    while (count < codepoints)
+    {
+        if (i == text.size())
+        {
+            // 반복 사이에는 공백을 넣는다
+            sample.push_back(' ');
+            count++;
+            i = 0;
+            continue;
+        }
+
+        // UTF-8 한 글자 (continuation byte까지)
+        size_t end = i + 1;
+        while (end < text.size() && ((unsigned char)text[end] & 0xc0) == 0x80)
+            end++;
+        sample.append(text, i, end - i);
+        count++;
+        i = end;
+    }
+    return sample;
+}
+
+void print_stage_table(std::ostream &out, const std::vector<StageResult> &results)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "%-10s %6s %4s %-18s %12s %10s %10s %10s\n",
+             "corpus", "length", "size", "stage", "ns/op", "ns/glyph", "alloc/op", "alloc/gl");
+    out << line;
+
+    for (const StageResult &r : results)
+    {
+        char perGlyph[32] = "-";
+        char allocs[32] = "-";
+        char allocsPerGlyph[32] = "-";
+        if (r.glyphs)
+            snprintf(perGlyph, sizeof(perGlyph), "%.1f", r.nsPerGlyph());
+        if (r.allocsPerOp >= 0)
+            snprintf(allocs, sizeof(allocs), "%.1f", r.allocsPerOp);
+        if (r.allocsPerGlyph() >= 0)
+            snprintf(allocsPerGlyph, sizeof(allocsPerGlyph), "%.2f", r.allocsPerGlyph());
+
+        snprintf(line, sizeof(line), "%-10s %6u %4d %-18s %12.0f %10s %10s %10s\n",
+                 r.corpus.c_str(), r.length, r.fontSize, r.stage.c_str(), r.nsPerOp, perGlyph, allocs, allocsPerGlyph);
+        out << line;
+    }
+}
+
+bool write_stage_tsv(const char *path, const std::vector<StageResult> &results)
+{
+    bool toStdout = strcmp(path, "-") == 0;
+    FILE *fp = toStdout ? stdout : fopen(path, "w");
+    if (!fp)
+        return false;
+
+    // 열 순서는 바꾸지 않는다 (이전 결과와 diff / join 하기 위해서)
+    fprintf(fp, "corpus\tlength\tfont_size\tstage\tops\tglyphs\tns_per_op\tns_per_glyph\tallocs_per_op\tallocs_per_glyph\tbytes\n");
+    for (const StageResult &r : results)
+    {
+        fprintf(fp, "%s\t%u\t%d\t%s\t%llu\t%llu\t%.1f\t%.2f\t%.2f\t%.3f\t%llu\n",
+                r.corpus.c_str(), r.length, r.fontSize, r.stage.c_str(),
+                (unsigned long long)r.ops, (unsigned long long)r.glyphs,
+                r.nsPerOp, r.nsPerGlyph(), r.allocsPerOp, r.allocsPerGlyph(), (unsigned long long)r.bytes);
+    }
+
+    bool ok = !ferror(fp);
+    if (toStdout)
+        ok = fflush(fp) == 0 && ok;
+    else
+        ok = fclose(fp) == 0 && ok;
+    return ok;
+}
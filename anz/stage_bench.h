@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "alloc_count.h"
+
+// --bench mode에서 쓰는 측정 도구와 결과 출력.
+//
+// stage 하나를 한번 돌려 warm-up 한 뒤, 최소 시간이 지날 때까지 반복 횟수를 두배씩 늘려가며 잰다.
+// 결과는 사람이 읽는 표와, version 사이에 diff 할 수 있는 TSV(한 줄에 corpus × 길이 × size × stage)로 낸다.
+
+struct StageSample
+{
+    uint64_t ops = 0;
+    double ns = 0;       // ops번 전체 시간
+    uint64_t allocs = 0; // ops번 전체 할당 수
+};
+
+struct StageResult
+{
+    std::string corpus; // corpus와 무관한 stage는 "-"
+    unsigned int length = 0; // codepoint 수
+    int fontSize = 0;
+    std::string stage;
+    uint64_t ops = 0;
+    uint64_t glyphs = 0; // 한번 실행에 처리한 glyph 수, 0이면 per-glyph 값이 없다
+    double nsPerOp = 0;
+    double allocsPerOp = -1; // 할당 수를 세지 않는 build면 -1
+    uint64_t bytes = 0;      // 출력 크기 (encode stage)
+
+    double nsPerGlyph() const { return glyphs ? nsPerOp / glyphs : 0; }
+    double allocsPerGlyph() const { return glyphs && allocsPerOp >= 0 ? allocsPerOp / glyphs : -1; }
+};
+
+class StageTimer
+{
+public:
+    explicit StageTimer(double minSeconds = .1) : minNs_(minSeconds * 1e9) {}
+
+    template <class F>
+    StageSample measure(F &&fn)
+    {
+        fn(); // warm-up: cache, lazy open 등은 측정에 넣지 않는다
+
+        StageSample sample;
+        uint64_t batch = 1;
+        while (sample.ns < minNs_)
+        {
+            uint64_t allocs = alloc_count();
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < batch; i++)
+                fn();
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+            sample.allocs += alloc_count() - allocs;
+            sample.ns += elapsed.count();
+            sample.ops += batch;
+            batch *= 2;
+        }
+        return sample;
+    }
+
+private:
+    double minNs_;
+};
+
+StageResult stage_result(const std::string &corpus, unsigned int length, int fontSize, const char *stage,
+                         const StageSample &sample, uint64_t glyphs, uint64_t bytes = 0);
+
+struct BenchCorpus
+{
+    std::string name; // 파일 이름에서 .txt를 뺀 것
+    std::string text; // 줄바꿈은 공백으로 바꾼다 (한 줄로 그린다)
+};
+
+// dir 안의 *.txt를 이름 순으로 읽는다
+bool load_bench_corpora(const std::string &dir, std::vector<BenchCorpus> &corpora);
+
+// text를 필요한 만큼 반복해서 앞에서 codepoints개 글자만 남긴다 (UTF-8)
+std::string bench_sample(const std::string &text, unsigned int codepoints);
+
+void print_stage_table(std::ostream &out, const std::vector<StageResult> &results);
+
+// path가 "-"면 stdout
+bool write_stage_tsv(const char *path, const std::vector<StageResult> &results);
@@ -0,0 +1,207 @@
+#include "surface_pool.h"
+
+#include <new>
+
+const unsigned int MIN_CLASS = 16; // 64 KB
+
+SurfacePool::~SurfacePool()
+{
+    clear();
+    for (Buffer &buffer : used_)
+        unwrap(buffer);
+}
+
+unsigned int SurfacePool::sizeClass(size_t bytes)
+{
+    unsigned int c = MIN_CLASS;
+    while (((size_t)1 << c) < bytes)
+        c++;
+    return c;
+}
+
+void SurfacePool::unwrap(Buffer &buffer)
+{
+    if (buffer.cr)
+        cairo_destroy(buffer.cr);
+    buffer.cr = NULL;
+    if (buffer.surface)
+        cairo_surface_destroy(buffer.surface);
+    buffer.surface = NULL;
+    buffer.width = 0;
+    buffer.height = 0;
+}
+
+bool SurfacePool::take(size_t bytes, int width, int height, cairo_format_t format, Buffer &buffer)
+{
+    unsigned int c = sizeClass(bytes);
+    if (free_.size() <= c)
+        free_.resize(c + 1);
+
+    std::vector<Buffer> &list = free_[c];
+    if (!list.empty())
+    {
+        // 크기가 같은 surface가 있으면 그것을, 없으면 마지막 것을 쓴다
+        size_t pick = list.size() - 1;
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            if (list[i].width == width && list[i].height == height && list[i].format == format)
+            {
+                pick = i;
+                break;
+            }
+        }
+        buffer = std::move(list[pick]);
+        list[pick] = std::move(list.back());
+        list.pop_back();
+        pooledBytes_ -= buffer.capacity;
+    }
+    else
+    {
+        buffer.capacity = (size_t)1 << c;
+        buffer.data.reset(new (std::nothrow) unsigned char[buffer.capacity]);
+        if (!buffer.data)
+            return false;
+        stats_.allocated++;
+    }
+    return true;
+}
+
+cairo_surface_t *SurfacePool::acquire(int width, int height, cairo_format_t format)
+{
+    stats_.acquires++;
+
+    int stride = cairo_format_stride_for_width(format, width);
+    if (width <= 0 || height <= 0 || stride <= 0 || height > 32767)
+        return NULL;
+
+    Buffer buffer;
+    if (!take((size_t)stride * height, width, height, format, buffer))
+        return NULL;
+
+    if (buffer.surface && buffer.width == width && buffer.height == height && buffer.format == format)
+    {
+        stats_.reused++;
+    }
+    else
+    {
+        if (buffer.surface)
+            stats_.rewrapped++;
+        unwrap(buffer);
+        buffer.surface = cairo_image_surface_create_for_data(buffer.data.get(), format, width, height, stride);
+        if (cairo_surface_status(buffer.surface) != CAIRO_STATUS_SUCCESS)
+        {
+            unwrap(buffer);
+            return NULL;
+        }
+        buffer.width = width;
+        buffer.height = height;
+        buffer.format = format;
+    }
+
+    cairo_surface_t *surface = buffer.surface;
+    used_.push_back(std::move(buffer));
+    return surface;
+}
+
+unsigned char *SurfacePool::acquireBuffer(int width, int height, cairo_format_t format, int &stride)
+{
+    stats_.acquires++;
+
+    stride = cairo_format_stride_for_width(format, width);
+    if (width <= 0 || height <= 0 || stride <= 0)
+        return NULL;
+
+    // 예전 surface는 크기가 같으면 다음 acquire()를 위해 그대로 둔다 (pixel만 쓴다)
+    Buffer buffer;
+    if (!take((size_t)stride * height, width, height, format, buffer))
+        return NULL;
+
+    unsigned char *data = buffer.data.get();
+    used_.push_back(std::move(buffer));
+    return data;
+}
+
+cairo_t *SurfacePool::context(cairo_surface_t *surface)
+{
+    for (Buffer &buffer : used_)
+    {
+        if (buffer.surface != surface)
+            continue;
+
+        if (!buffer.cr)
+        {
+            buffer.cr = cairo_create(surface);
+            if (cairo_status(buffer.cr) != CAIRO_STATUS_SUCCESS)
+            {
+                cairo_destroy(buffer.cr);
+                buffer.cr = NULL;
+                return NULL;
+            }
+        }
+        else
+        {
+            cairo_identity_matrix(buffer.cr);
+            cairo_reset_clip(buffer.cr);
+            cairo_new_path(buffer.cr);
+            cairo_set_operator(buffer.cr, CAIRO_OPERATOR_OVER);
+        }
+        return buffer.cr;
+    }
+    return NULL;
+}
+
+void SurfacePool::giveBack(size_t used)
+{
+    Buffer buffer = std::move(used_[used]);
+    used_[used] = std::move(used_.back());
+    used_.pop_back();
+
+    // 다음 acquire()에서 쓰기 전에 cairo가 잡고 있는 것이 없도록 한다
+    if (buffer.surface)
+        cairo_surface_flush(buffer.surface);
+
+    if (pooledBytes_ + buffer.capacity > maxBytes_)
+    {
+        unwrap(buffer);
+        stats_.dropped++;
+        return;
+    }
+
+    pooledBytes_ += buffer.capacity;
+    free_[sizeClass(buffer.capacity)].push_back(std::move(buffer));
+}
+
+void SurfacePool::release(cairo_surface_t *surface)
+{
+    for (size_t i = 0; i < used_.size(); i++)
+    {
+        if (used_[i].surface == surface)
+        {
+            giveBack(i);
+            return;
+        }
+    }
+}
+
+void SurfacePool::release(const unsigned char *data)
+{
+    for (size_t i = 0; i < used_.size(); i++)
+    {
+        if (used_[i].data.get() == data)
+        {
+            giveBack(i);
+            return;
+        }
+    }
+}
+
+void SurfacePool::clear()
+{
+    for (std::vector<Buffer> &list : free_)
+    {
+        for (Buffer &buffer : list)
+            unwrap(buffer);
+        list.clear();
+    }
+    pooledBytes_ = 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <cairo.h>
+// for cairo
+
+// job마다 cairo_image_surface_create() 하지 않도록 pixel buffer를 재사용한다 (ARGB32, --mask면 A8 / A1).
+//
+// buffer는 크기 class(2의 거듭제곱 byte)별 free list에 모아둔다. acquire()는 같은 class의 buffer 위에
+// cairo_image_surface_create_for_data()로 surface를 만들고, 직전과 크기가 같으면 surface도 그대로 돌려준다.
+// 그래서 같은 크기가 반복되는 steady state에서는 heap 할당이 없다. surface마다 cairo_t도 하나 두고 같이 재사용한다.
+// cairo image 크기 제한(32767)을 넘는 image는 acquireBuffer()로 surface 없이 buffer만 받아서 band마다 감싸 그린다.
+// pixel은 지우지 않는다. 호출하는 쪽이 배경을 칠해야 한다.
+// thread-safe 하지 않다. RenderContext마다 하나씩 둔다.
+
+struct SurfacePoolStats
+{
+    uint64_t acquires = 0;
+    uint64_t reused = 0;      // surface까지 그대로 재사용
+    uint64_t rewrapped = 0;   // buffer만 재사용, surface는 새로 만듦
+    uint64_t allocated = 0;   // 새 buffer 할당
+    uint64_t dropped = 0;     // 한도를 넘어 반납하지 않고 버린 buffer
+
+    SurfacePoolStats &operator+=(const SurfacePoolStats &o)
+    {
+        acquires += o.acquires;
+        reused += o.reused;
+        rewrapped += o.rewrapped;
+        allocated += o.allocated;
+        dropped += o.dropped;
+        return *this;
+    }
+};
+
+class SurfacePool
+{
+public:
+    explicit SurfacePool(size_t maxBytes = 64 << 20) : maxBytes_(maxBytes) {}
+    ~SurfacePool();
+
+    SurfacePool(const SurfacePool &) = delete;
+    SurfacePool &operator=(const SurfacePool &) = delete;
+
+    // width x height surface. 만들 수 없으면 NULL
+    cairo_surface_t *acquire(int width, int height, cairo_format_t format = CAIRO_FORMAT_ARGB32);
+
+    // surface 없이 width x height pixel buffer만 받는다. 높이 제한이 없다. 만들 수 없으면 NULL
+    unsigned char *acquireBuffer(int width, int height, cairo_format_t format, int &stride);
+
+    // acquire()로 받은 surface에 그리는 cairo_t. surface와 함께 재사용되고 pool이 destroy한다.
+    // matrix, clip, path, operator는 초기화해서 준다. 그 밖의 상태는 cairo_save() / cairo_restore()로 되돌려야 한다
+    cairo_t *context(cairo_surface_t *surface);
+
+    // acquire()로 받은 surface를 돌려준다. cairo_surface_destroy()를 부르면 안 된다
+    void release(cairo_surface_t *surface);
+    // acquire() / acquireBuffer()로 받은 pixel buffer를 돌려준다 (surface는 cairo_image_surface_get_data())
+    void release(const unsigned char *data);
+
+    // 쉬고 있는 buffer를 모두 해제한다. 사용 중인 것은 release() 때 해제된다
+    void clear();
+
+    size_t pooledBytes() const { return pooledBytes_; }
+    const SurfacePoolStats &stats() const { return stats_; }
+
+private:
+    struct Buffer
+    {
+        std::unique_ptr<unsigned char[]> data;
+        size_t capacity = 0;
+        cairo_surface_t *surface = NULL; // data 위에 만든 마지막 surface
+        cairo_t *cr = NULL;              // surface에 그리는 것, context()가 처음 불릴 때 만든다
+        int width = 0;
+        int height = 0;
+        cairo_format_t format = CAIRO_FORMAT_ARGB32;
+    };
+
+    static unsigned int sizeClass(size_t bytes);
+    static void unwrap(Buffer &buffer);
+    // bytes 이상인 buffer를 free list에서 꺼내거나 새로 할당한다. 같은 크기의 surface가 있는 것을 먼저 고른다
+    bool take(size_t bytes, int width, int height, cairo_format_t format, Buffer &buffer);
+    void giveBack(size_t used);
+
+    size_t maxBytes_;
+    size_t pooledBytes_ = 0;          // free list에 있는 buffer 크기 합
+    std::vector<std::vector<Buffer>> free_; // sizeClass별
+    std::vector<Buffer> used_;        // acquire()로 나가 있는 것, 보통 한두개
+    SurfacePoolStats stats_;
+};
@@ -0,0 +1,222 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> trace_active{false};
+
+namespace
+{
+    // log-linear histogram: 16ns 아래는 1ns 단위, 그 위로는 2의 거듭제곱 구간마다 16칸
+    const int HISTOGRAM_SUB_BITS = 4;
+    const int HISTOGRAM_SUB = 1 << HISTOGRAM_SUB_BITS;
+    const int HISTOGRAM_BUCKETS = 64 * HISTOGRAM_SUB;
+
+    int histogram_bucket(uint64_t ns)
+    {
+        if (ns < (uint64_t)HISTOGRAM_SUB)
+            return ns;
+        int exponent = 63 - __builtin_clzll(ns);
+        int sub = (ns >> (exponent - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB - 1);
+        return (exponent - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB + sub;
+    }
+
+    // bucket 가운데 값
+    double histogram_value(int bucket)
+    {
+        if (bucket < HISTOGRAM_SUB)
+            return bucket;
+        int exponent = bucket / HISTOGRAM_SUB + HISTOGRAM_SUB_BITS - 1;
+        int sub = bucket % HISTOGRAM_SUB;
+        double low = (double)(HISTOGRAM_SUB + sub) * (double)(1ull << (exponent - HISTOGRAM_SUB_BITS));
+        return low + (double)(1ull << (exponent - HISTOGRAM_SUB_BITS)) * .5;
+    }
+
+    struct TraceRing
+    {
+        uint32_t tid = 0;
+        std::vector<TraceEvent> events; // 크기는 2의 거듭제곱
+        std::atomic<uint64_t> head{0};  // 지금까지 쓴 event 수, 쓰는 thread만 올린다
+
+        uint64_t histogram[TRACE_STAGE_COUNT][HISTOGRAM_BUCKETS] = {};
+        uint64_t maximum[TRACE_STAGE_COUNT] = {};
+    };
+
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<TraceRing>> rings; // thread가 끝나도 dump 할 때까지 남겨둔다
+    size_t ring_events = 1 << 16;
+    uint64_t trace_start = 0;
+
+    thread_local TraceRing *thread_ring = nullptr;
+    thread_local uint32_t thread_job = 0;
+
+    TraceRing *ring_of_thread()
+    {
+        if (!thread_ring)
+        {
+            std::unique_ptr<TraceRing> ring(new TraceRing);
+            ring->events.resize(ring_events);
+
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            ring->tid = rings.size() + 1;
+            thread_ring = ring.get();
+            rings.push_back(std::move(ring));
+        }
+        return thread_ring;
+    }
+
+    const char *STAGE_NAMES[TRACE_STAGE_COUNT] = {
+        "job", "fontconfig", "freetype", "fribidi", "harfbuzz", "cairo", "encode",
+    };
+}
+
+void trace_enable(size_t ringEvents)
+{
+    size_t size = 1;
+    while (size < ringEvents)
+        size *= 2;
+    ring_events = size;
+    trace_start = trace_now();
+    trace_active.store(true, std::memory_order_relaxed);
+}
+
+void trace_set_job(uint32_t job)
+{
+    thread_job = job;
+}
+
+uint64_t trace_now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void trace_record(TraceStage stage, uint64_t start, uint32_t count, uint32_t hits, uint32_t lookups)
+{
+    uint64_t duration = trace_now() - start;
+    TraceRing *ring = ring_of_thread();
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    TraceEvent &event = ring->events[head & (ring->events.size() - 1)];
+    event.start = start;
+    event.duration = duration;
+    event.job = thread_job;
+    event.stage = stage;
+    event.count = count;
+    event.hits = hits;
+    event.lookups = lookups;
+    ring->head.store(head + 1, std::memory_order_release);
+
+    ring->histogram[stage][histogram_bucket(duration)]++;
+    if (duration > ring->maximum[stage])
+        ring->maximum[stage] = duration;
+}
+
+const char *trace_stage_name(TraceStage stage)
+{
+    return stage < TRACE_STAGE_COUNT ? STAGE_NAMES[stage] : "?";
+}
+
+bool trace_write_chrome(const char *path)
+{
+    bool toStdout = strcmp(path, "-") == 0;
+    FILE *fp = toStdout ? stdout : fopen(path, "w");
+    if (!fp)
+        return false;
+
+    // complete event ("ph":"X"), 시간은 us 단위
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", fp);
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    bool first = true;
+    for (const std::unique_ptr<TraceRing> &ring : rings)
+    {
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                first ? "" : ",\n", ring->tid, ring->tid);
+        first = false;
+
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t size = ring->events.size();
+        uint64_t begin = head > size ? head - size : 0;
+        for (uint64_t i = begin; i < head; i++)
+        {
+            const TraceEvent &e = ring->events[i & (size - 1)];
+            fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"anz\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                        "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"job\":%u,\"count\":%u,\"hits\":%u,\"lookups\":%u}}",
+                    trace_stage_name((TraceStage)e.stage), ring->tid,
+                    (e.start - trace_start) / 1000., e.duration / 1000., e.job, e.count, e.hits, e.lookups);
+        }
+    }
+
+    fputs("\n]}\n", fp);
+
+    bool ok = !ferror(fp);
+    if (toStdout)
+        ok = fflush(fp) == 0 && ok;
+    else
+        ok = fclose(fp) == 0 && ok;
+    return ok;
+}
+
+void trace_print_summary(std::ostream &out)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    char line[160];
+    snprintf(line, sizeof(line), "%-12s %10s %12s %12s %12s %12s\n", "stage", "count", "p50 us", "p90 us", "p99 us", "max us");
+    out << line;
+
+    uint64_t dropped = 0;
+    for (const std::unique_ptr<TraceRing> &ring : rings)
+    {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        if (head > ring->events.size())
+            dropped += head - ring->events.size();
+    }
+
+    std::vector<uint64_t> merged(HISTOGRAM_BUCKETS);
+    for (int stage = 0; stage < TRACE_STAGE_COUNT; stage++)
+    {
+        std::fill(merged.begin(), merged.end(), 0);
+        uint64_t total = 0;
+        uint64_t maximum = 0;
+        for (const std::unique_ptr<TraceRing> &ring : rings)
+        {
+            for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+            {
+                merged[b] += ring->histogram[stage][b];
+                total += ring->histogram[stage][b];
+            }
+            maximum = std::max(maximum, ring->maximum[stage]);
+        }
+        if (!total)
+            continue;
+
+        // rank 이상이 되는 첫 bucket
+        auto percentile = [&](double p) {
+            uint64_t rank = (uint64_t)(p * (total - 1)) + 1;
+            uint64_t seen = 0;
+            for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+            {
+                seen += merged[b];
+                if (seen >= rank)
+                    return std::min(histogram_value(b), (double)maximum) / 1000.;
+            }
+            return maximum / 1000.;
+        };
+
+        snprintf(line, sizeof(line), "%-12s %10llu %12.1f %12.1f %12.1f %12.1f\n",
+                 trace_stage_name((TraceStage)stage), (unsigned long long)total,
+                 percentile(.5), percentile(.9), percentile(.99), maximum / 1000.);
+        out << line;
+    }
+
+    if (dropped)
+        out << "trace: " << dropped << " old events overwritten in ring buffers (histograms include them)\n";
+}
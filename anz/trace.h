@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// stage 단위 tracing.
+//
+// TraceSpan이 scope의 시작 / 끝 시각을 재서 thread별 ring buffer에 event 하나로 넣는다.
+// ring은 thread마다 따로라 쓸 때 lock이 없다 (처음 쓸 때 등록만 mutex). 가득 차면 오래된 event부터 덮어쓴다.
+// stage별 latency histogram은 ring과 별도로 모든 span을 누적한다 (상대 오차 1/16 이하).
+// trace_enable()을 부르지 않으면 TraceSpan은 bool 하나만 읽고 아무것도 하지 않는다.
+//
+// 결과는 Chrome trace JSON (chrome://tracing, Perfetto)이나 stage별 p50/p99 요약으로 낸다.
+// 둘 다 worker thread가 끝난 뒤에 불러야 한다.
+
+enum TraceStage
+{
+    TRACE_JOB, // job 하나 전체 (render, stream paragraph)
+    TRACE_FONTCONFIG,
+    TRACE_FREETYPE,
+    TRACE_FRIBIDI,
+    TRACE_HARFBUZZ,
+    TRACE_CAIRO,
+    TRACE_ENCODE,
+    TRACE_STAGE_COUNT
+};
+
+struct TraceEvent
+{
+    uint64_t start;    // steady clock ns
+    uint64_t duration; // ns
+    uint32_t job;
+    uint32_t stage;
+    uint32_t count;   // 처리한 glyph 수 (fribidi는 글자 수)
+    uint32_t hits;    // cache hit (harfbuzz: 단어, cairo: glyph cache)
+    uint32_t lookups; // cache lookup
+};
+
+extern std::atomic<bool> trace_active;
+
+inline bool trace_enabled()
+{
+    return trace_active.load(std::memory_order_relaxed);
+}
+
+// ringEvents: thread 하나가 들고 있을 최근 event 수
+void trace_enable(size_t ringEvents = 1 << 16);
+
+// 이 thread에서 이후에 끝나는 span들에 붙일 job 번호
+void trace_set_job(uint32_t job);
+
+uint64_t trace_now();
+void trace_record(TraceStage stage, uint64_t start, uint32_t count, uint32_t hits, uint32_t lookups);
+
+const char *trace_stage_name(TraceStage stage);
+
+// path가 "-"면 stdout
+bool trace_write_chrome(const char *path);
+void trace_print_summary(std::ostream &out);
+
+class TraceSpan
+{
+public:
+    explicit TraceSpan(TraceStage stage) : stage_(stage), start_(trace_enabled() ? trace_now() : 0) {}
+    ~TraceSpan()
+    {
+        if (start_)
+            trace_record(stage_, start_, count_, hits_, lookups_);
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    // 꺼져 있으면 false, counter를 모으는 비용도 아낄 수 있다
+    bool active() const { return start_ != 0; }
+
+    void setCount(uint32_t count) { count_ = count; }
+    void setCache(uint32_t hits, uint32_t lookups)
+    {
+        hits_ = hits;
+        lookups_ = lookups;
+    }
+
+private:
+    TraceStage stage_;
+    uint64_t start_; // 0이면 꺼져 있을 때 만들어진 span
+    uint32_t count_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t lookups_ = 0;
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// job index [0, count)를 worker thread들에 나눠서 실행한다.
+//
+// 처음에는 연속된 구간으로 나눠 각 worker의 deque에 넣는다. worker는 자기 deque 앞에서 꺼내고,
+// 비면 다른 worker deque의 뒤에서 훔쳐온다. 실행 중에 job이 추가되지 않으므로
+// 모든 deque가 비면 끝난다.
+//
+// worker 0은 run()을 부른 thread이고, 나머지 thread는 처음 run()에서 만들어 pool이 없어질 때까지 기다리게 둔다.
+// 그래서 frame마다 run()을 불러도 thread를 새로 만들지 않는다. run()은 한번에 한 thread만 부른다.
+
+struct WorkStealingStats
+{
+    uint64_t jobs = 0;   // 이 worker가 실행한 job 수
+    uint64_t stolen = 0; // 그 중 다른 worker에게서 훔친 것
+};
+
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(int threads)
+        : threads_(threads > 0 ? threads : 1), queues_(threads_), stats_(threads_)
+    {
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread &t : workers_)
+            t.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    int threads() const { return threads_; }
+    const std::vector<WorkStealingStats> &stats() const { return stats_; }
+
+    // fn(int worker, size_t job)을 모든 job에 대해 호출한다. 끝날 때까지 돌아오지 않는다.
+    template <class F>
+    void run(size_t count, F &&fn)
+    {
+        for (int w = 0; w < threads_; w++)
+        {
+            queues_[w].jobs.clear();
+            stats_[w] = WorkStealingStats();
+
+            size_t begin = count * w / threads_;
+            size_t end = count * (w + 1) / threads_;
+            for (size_t i = begin; i < end; i++)
+                queues_[w].jobs.push_back(i);
+        }
+
+        Call call = [](void *f, int worker, size_t job) { (*(std::remove_reference_t<F> *)f)(worker, job); };
+        void *context = (void *)&fn;
+        if (threads_ == 1)
+        {
+            drain(0, call, context);
+            return;
+        }
+
+        if (workers_.empty())
+        {
+            workers_.reserve(threads_ - 1);
+            for (int w = 1; w < threads_; w++)
+                workers_.emplace_back([this, w] { loop(w); });
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            call_ = call;
+            context_ = context;
+            active_ = threads_ - 1;
+            generation_++;
+        }
+        wake_.notify_all();
+
+        drain(0, call, context);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return active_ == 0; });
+    }
+
+private:
+    typedef void (*Call)(void *context, int worker, size_t job);
+
+    void drain(int worker, Call call, void *context)
+    {
+        size_t job;
+        bool stolen;
+        while (next(worker, job, stolen))
+        {
+            call(context, worker, job);
+            stats_[worker].jobs++;
+            if (stolen)
+                stats_[worker].stolen++;
+        }
+    }
+
+    // worker 1 .. threads_-1. run()마다 generation_이 바뀌면 한번 돈다
+    void loop(int worker)
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            Call call;
+            void *context;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_)
+                    return;
+                seen = generation_;
+                call = call_;
+                context = context_;
+            }
+
+            drain(worker, call, context);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--active_ == 0)
+                done_.notify_one();
+        }
+    }
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+
+    bool next(int worker, size_t &job, bool &stolen)
+    {
+        {
+            Queue &own = queues_[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs.empty())
+            {
+                job = own.jobs.front();
+                own.jobs.pop_front();
+                stolen = false;
+                return true;
+            }
+        }
+
+        // 옆 worker부터 차례로 훔친다
+        for (int n = 1; n < threads_; n++)
+        {
+            Queue &victim = queues_[(worker + n) % threads_];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty())
+            {
+                job = victim.jobs.back();
+                victim.jobs.pop_back();
+                stolen = true;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    int threads_;
+    std::vector<Queue> queues_;
+    std::vector<WorkStealingStats> stats_;
+
+    // 기다리는 worker thread들, mutex_가 아래를 지킨다
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    Call call_ = NULL;
+    void *context_ = NULL;
+    uint64_t generation_ = 0;
+    int active_ = 0; // 이번 run()을 아직 끝내지 않은 worker thread 수
+    bool stop_ = false;
+};
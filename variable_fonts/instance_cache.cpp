@@ -0,0 +1,255 @@
+#include "instance_cache.h"
+
+#include <algorithm>
+
+#include FT_MULTIPLE_MASTERS_H
+
+#include <cairo-ft.h>
+
+namespace
+{
+    // cairo는 font face를 자기 cache에 더 오래 잡고 있을 수 있으므로,
+    // instance의 FT_Face는 cairo가 font face를 놓을 때 닫는다 (InstanceCache가 닫힌 뒤일 수도 있다)
+    const cairo_user_data_key_t FT_FACE_KEY = {};
+
+    struct FaceOwner
+    {
+        FT_Face face;
+        VarFontData *data; // face가 읽는 memory와 library, reference 하나를 들고 있다
+    };
+
+    void done_face(FT_Face face, VarFontData *data)
+    {
+        {
+            std::lock_guard<std::mutex> lock(data->mutex);
+            FT_Done_Face(face);
+        }
+        data->release();
+    }
+
+    void done_face_owner(void *owner)
+    {
+        FaceOwner *o = (FaceOwner *)owner;
+        done_face(o->face, o->data);
+        delete o;
+    }
+}
+
+void VarFontData::release()
+{
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    FT_Done_FreeType(library);
+    hb_blob_destroy(blob);
+    delete this;
+}
+
+InstanceCache::InstanceCache(size_t capacity)
+    : capacity_(capacity > 0 ? capacity : 1)
+{
+}
+
+InstanceCache::~InstanceCache()
+{
+    close();
+}
+
+bool InstanceCache::open(const char *path, unsigned int faceIndex, unsigned int pixelSize)
+{
+    close();
+
+    hb_blob_t *blob = hb_blob_create_from_file_or_fail(path);
+    if (!blob)
+        return false;
+
+    data_ = new VarFontData;
+    data_->blob = blob;
+    if (FT_Init_FreeType(&data_->library))
+    {
+        data_->library = NULL;
+        close();
+        return false;
+    }
+
+    face_ = hb_face_create(blob, faceIndex);
+    hb_face_make_immutable(face_);
+    faceIndex_ = faceIndex;
+    pixelSize_ = pixelSize;
+
+    // FT_Set_Pixel_Sizes(pixelSize)와 같은 크기, position은 26.6
+    parent_ = hb_font_create(face_);
+    hb_font_set_scale(parent_, pixelSize * 64, pixelSize * 64);
+    hb_font_set_ppem(parent_, pixelSize, pixelSize);
+    hb_font_make_immutable(parent_);
+
+    unsigned int axisCount = hb_ot_var_get_axis_count(face_);
+    axes_.resize(axisCount);
+    hb_ot_var_get_axis_infos(face_, 0, &axisCount, axes_.data());
+
+    return true;
+}
+
+void InstanceCache::close()
+{
+    for (auto &it : instances_)
+        destroy(*it.second);
+    instances_.clear();
+
+    hb_font_destroy(parent_);
+    hb_face_destroy(face_);
+    parent_ = NULL;
+    face_ = NULL;
+
+    // cairo가 아직 잡고 있는 FT_Face가 있으면 마지막 face가 닫힐 때 해제된다
+    if (data_)
+        data_->release();
+    data_ = NULL;
+
+    axes_.clear();
+    glyphs_.clear();
+}
+
+void InstanceCache::setGlyphs(const hb_codepoint_t *glyphs, unsigned int count)
+{
+    glyphs_.assign(glyphs, glyphs + count);
+    std::sort(glyphs_.begin(), glyphs_.end());
+    glyphs_.erase(std::unique(glyphs_.begin(), glyphs_.end()), glyphs_.end());
+}
+
+bool InstanceCache::hasAxis(hb_tag_t tag) const
+{
+    for (const hb_ot_var_axis_info_t &axis : axes_)
+    {
+        if (axis.tag == tag)
+            return true;
+    }
+    return false;
+}
+
+VarInstance *InstanceCache::get(const hb_variation_t *variations, unsigned int count, unsigned int parts)
+{
+    // tag로 axis를 찾고 avar까지 적용한 정규화 좌표를 key로 쓴다.
+    // design 좌표가 달라도 clamp 후 같은 instance면 같은 key가 된다.
+    key_.assign(axes_.size(), 0);
+    if (!axes_.empty())
+        hb_ot_var_normalize_variations(face_, variations, count, key_.data(), key_.size());
+
+    VarInstance *instance;
+    auto it = instances_.find(key_);
+    if (it != instances_.end())
+    {
+        stats_.hits++;
+        instance = it->second.get();
+    }
+    else
+    {
+        stats_.misses++;
+        if (instances_.size() >= capacity_)
+            evict();
+
+        instance = new VarInstance;
+        instance->coords = key_;
+        instances_.emplace(key_, std::unique_ptr<VarInstance>(instance));
+    }
+
+    instance->lastUse = ++clock_;
+    if ((instance->parts & parts) != parts)
+        build(*instance, parts & ~instance->parts);
+    return instance;
+}
+
+void InstanceCache::build(VarInstance &instance, unsigned int parts)
+{
+    instance.parts |= parts;
+    const std::vector<int> &coords = instance.coords;
+
+    if (parts & INSTANCE_SHAPING)
+    {
+        // HarfBuzz: 좌표만 다른 sub-font, face와 scale은 parent를 공유한다
+        instance.hb_font = hb_font_create_sub_font(parent_);
+        if (!coords.empty())
+            hb_font_set_var_coords_normalized(instance.hb_font, coords.data(), coords.size());
+        hb_font_make_immutable(instance.hb_font);
+
+        // advance table (그릴 glyph만)
+        instance.advances.clear();
+        if (!glyphs_.empty())
+        {
+            instance.advances.assign(glyphs_.back() + 1, ADVANCE_UNKNOWN);
+            for (hb_codepoint_t glyph : glyphs_)
+                instance.advances[glyph] = hb_font_get_glyph_h_advance(instance.hb_font, glyph);
+        }
+        stats_.fonts++;
+    }
+
+    if (!(parts & INSTANCE_DRAWING))
+        return;
+
+    // FreeType: 같은 file memory 위에 instance 전용 face, 크기와 좌표는 여기서 한번만 정한다
+    unsigned int length = 0;
+    const char *data = hb_blob_get_data(data_->blob, &length);
+    FT_Error error;
+    {
+        std::lock_guard<std::mutex> lock(data_->mutex);
+        error = FT_New_Memory_Face(data_->library, (const FT_Byte *)data, length, faceIndex_, &instance.face);
+    }
+    if (error == 0)
+    {
+        data_->reference(); // face가 닫힐 때 놓는다
+        FT_Set_Pixel_Sizes(instance.face, 0, pixelSize_);
+
+        if (!coords.empty())
+        {
+            // F2DOT14 → 16.16
+            std::vector<FT_Fixed> blend(coords.size());
+            for (size_t i = 0; i < coords.size(); i++)
+                blend[i] = (FT_Fixed)coords[i] * 4;
+            FT_Set_Var_Blend_Coordinates(instance.face, blend.size(), blend.data());
+        }
+
+        instance.cairo_face = cairo_ft_font_face_create_for_ft_face(instance.face, 0);
+        FaceOwner *owner = new FaceOwner{instance.face, data_};
+        if (cairo_font_face_set_user_data(instance.cairo_face, &FT_FACE_KEY, owner, done_face_owner) !=
+            CAIRO_STATUS_SUCCESS)
+        {
+            delete owner;
+            cairo_font_face_destroy(instance.cairo_face);
+            instance.cairo_face = NULL;
+        }
+    }
+    else
+    {
+        instance.face = NULL;
+    }
+    stats_.faces++;
+}
+
+void InstanceCache::destroy(VarInstance &instance)
+{
+    // cairo_face가 있으면 FT_Face는 cairo가 닫는다
+    if (instance.cairo_face)
+        cairo_font_face_destroy(instance.cairo_face);
+    else if (instance.face)
+        done_face(instance.face, data_);
+    hb_font_destroy(instance.hb_font);
+
+    instance.parts = 0;
+    instance.cairo_face = NULL;
+    instance.hb_font = NULL;
+    instance.face = NULL;
+}
+
+void InstanceCache::evict()
+{
+    auto oldest = instances_.begin();
+    for (auto it = instances_.begin(); it != instances_.end(); ++it)
+    {
+        if (it->second->lastUse < oldest->second->lastUse)
+            oldest = it;
+    }
+
+    destroy(*oldest->second);
+    instances_.erase(oldest);
+    stats_.evictions++;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+// for freetype
+
+#include <hb.h>
+#include <hb-ot.h>
+// for harfbuzz
+
+#include <cairo.h>
+// for cairo
+
+// variable font의 instance (axis 좌표 조합) cache.
+//
+// key는 hb_ot_var_normalize_variations()로 정규화한 좌표 (F2DOT14, fvar axis 순서)이다.
+// axis는 이름("Weight")이 아니라 tag('wght')로 찾으므로 지역화된 이름에 영향받지 않는다.
+// instance 하나는 좌표가 고정된 hb_font_t sub-font와 advance table (shaping 부분),
+// 같은 좌표와 pixel size로 맞춘 FT_Face와 cairo font face (drawing 부분)를 가진다.
+// get()은 요청한 부분만 만들고, cache에 있는 instance에 없는 부분은 그때 더한다.
+// 같은 좌표를 다시 요청하면 lookup만 하고 FT_Set_Var_* / hb_font_set_variations를 다시 부르지 않는다.
+// advance table은 setGlyphs()로 정한 glyph만 담는다 (그릴 text의 glyph, 전체 glyph 표가 아니다).
+//
+// FT_Face는 cairo font face가 놓을 때 닫히는데, cairo는 font face를 자기 cache에 더 오래 잡고 있을 수 있다
+// (cache를 닫은 뒤, 다른 thread에서). 그래서 font file data와 FT_Library는 cache가 만들고 reference count로
+// 들고 있다가, cache와 모든 FT_Face가 놓은 뒤에 해제한다.
+
+enum InstanceParts
+{
+    INSTANCE_SHAPING = 1, // hb_font, advance table
+    INSTANCE_DRAWING = 2, // FT_Face, cairo font face
+    INSTANCE_ALL = INSTANCE_SHAPING | INSTANCE_DRAWING
+};
+
+const hb_position_t ADVANCE_UNKNOWN = INT32_MIN; // advance table에 없는 glyph
+
+struct VarInstance
+{
+    std::vector<int> coords; // 정규화 좌표
+    unsigned int parts = 0;  // 만든 InstanceParts
+    hb_font_t *hb_font = NULL;
+    FT_Face face = NULL;
+    cairo_font_face_t *cairo_face = NULL;
+    std::vector<hb_position_t> advances; // glyph id → x advance (26.6), setGlyphs()의 glyph만 있다
+    uint64_t lastUse = 0;
+
+    // table에 없는 glyph는 HarfBuzz에 바로 묻는다 (shaping 부분이 있어야 한다)
+    hb_position_t advance(hb_codepoint_t glyph) const
+    {
+        if (glyph < advances.size() && advances[glyph] != ADVANCE_UNKNOWN)
+            return advances[glyph];
+        return hb_font_get_glyph_h_advance(hb_font, glyph);
+    }
+};
+
+struct InstanceCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t fonts = 0; // 만든 shaping 부분 (hb_font + advance table)
+    uint64_t faces = 0; // 만든 drawing 부분 (FT_Face + cairo font face)
+};
+
+// instance FT_Face들이 읽는 font file과 그 face를 만든 FT_Library. 마지막 reference가 놓을 때 해제한다
+struct VarFontData
+{
+    hb_blob_t *blob = NULL;
+    FT_Library library = NULL;
+    std::mutex mutex; // FT_New_Memory_Face / FT_Done_Face는 library 하나에서 동시에 부를 수 없다
+    std::atomic<int> refs{1};
+
+    void reference() { refs.fetch_add(1, std::memory_order_relaxed); }
+    void release();
+};
+
+class InstanceCache
+{
+public:
+    explicit InstanceCache(size_t capacity = 64);
+    ~InstanceCache();
+    InstanceCache(const InstanceCache &) = delete;
+    InstanceCache &operator=(const InstanceCache &) = delete;
+
+    // font file은 hb_blob으로 한번만 읽고 (mmap), 모든 instance의 FT_Face와 hb_face가 공유한다
+    bool open(const char *path, unsigned int faceIndex, unsigned int pixelSize);
+    void close();
+
+    const std::vector<hb_ot_var_axis_info_t> &axes() const { return axes_; }
+    bool hasAxis(hb_tag_t tag) const;
+
+    // advance table에 넣을 glyph. 이미 만든 instance의 table은 바뀌지 않는다
+    void setGlyphs(const hb_codepoint_t *glyphs, unsigned int count);
+
+    // variations에 없는 axis는 기본값, 범위 밖의 값은 min/max로 자른다. parts는 InstanceParts.
+    // capacity를 넘으면 가장 오래 안 쓴 instance를 버리므로, 반환값은 다음 get() 전까지만 쓴다.
+    VarInstance *get(const hb_variation_t *variations, unsigned int count, unsigned int parts = INSTANCE_ALL);
+
+    size_t size() const { return instances_.size(); }
+    const InstanceCacheStats &stats() const { return stats_; }
+
+private:
+    void build(VarInstance &instance, unsigned int parts);
+    void destroy(VarInstance &instance);
+    void evict();
+
+    size_t capacity_;
+
+    VarFontData *data_ = NULL;
+    hb_face_t *face_ = NULL;
+    hb_font_t *parent_ = NULL; // scale만 정해둔 font, instance는 이것의 sub-font
+    unsigned int faceIndex_ = 0;
+    unsigned int pixelSize_ = 0;
+
+    std::vector<hb_ot_var_axis_info_t> axes_;
+    std::vector<hb_codepoint_t> glyphs_; // advance table에 넣을 glyph (setGlyphs)
+
+    std::map<std::vector<int>, std::unique_ptr<VarInstance>> instances_;
+    std::vector<int> key_;
+    uint64_t clock_ = 0;
+
+    InstanceCacheStats stats_;
+};
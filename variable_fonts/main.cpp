@@ -5,14 +5,17 @@
 #include <cmath>
 #include <vector>
 #include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include FT_MULTIPLE_MASTERS_H
 // for freetype
 
 #include <hb.h>
-#include <hb-ft.h>
 #include <hb-ot.h>
 // for harfbuzz
 
@@ -20,103 +23,102 @@
 #include <cairo-ft.h>
 // for cairo
 
+#include "instance_cache.h"
+
 const char* FONT_FILE = "./NotoSans-VariableFont_wdth,wght.ttf";
 const int FONT_SIZE = 72;
 const double MARGIN = FONT_SIZE * .5;
-const int MAX_STR_LEN = 10000;
 const int AXIS_CNT = 2;
+const int INSTANCE_CACHE_SIZE = 64; // 동시에 들고 있을 (weight, width) instance 수
 
-const char* WEIGHT_NAME = "Weight";
-const char* WIDTH_NAME = "Width";
+struct Instance
+{
+    int weight;
+    int width;
+};
 
-int weight = 0;
-int width = 0;
 std::string str = "Hello, World!";
 
 namespace
 { // global variables
-    FT_Library library;
-    FT_Face face;
+    InstanceCache *instances;
 
-    hb_font_t *hb_font;
     hb_buffer_t *hb_buffer;
 
     hb_glyph_info_t *info;
     hb_glyph_position_t *pos;
+}
 
-    cairo_surface_t *cairo_surface;
-    cairo_t *cr;
-    cairo_font_face_t *cairo_face;
+VarInstance *GetInstance(const Instance &instance)
+{
+    // axis는 tag로 찾는다. font에 없는 axis는 무시된다
+    hb_variation_t variations[AXIS_CNT];
+    variations[0].tag = HB_OT_TAG_VAR_AXIS_WEIGHT;
+    variations[0].value = instance.weight;
+    variations[1].tag = HB_OT_TAG_VAR_AXIS_WIDTH;
+    variations[1].value = instance.width;
+
+    return instances->get(variations, AXIS_CNT);
 }
 
-void ShapeText()
+void ShapeText(VarInstance *instance)
 {
-    hb_font = hb_ft_font_create(face, NULL);
-    hb_buffer = hb_buffer_create();
+    // buffer는 한번만 만들고 재사용한다
+    if (!hb_buffer)
+        hb_buffer = hb_buffer_create();
+    hb_buffer_clear_contents(hb_buffer);
 
     hb_buffer_add_utf8(hb_buffer, str.c_str(), -1, 0, -1);
     hb_buffer_guess_segment_properties(hb_buffer);
 
-    hb_variation_t variations[AXIS_CNT];
-    variations[0].tag = HB_OT_TAG_VAR_AXIS_WEIGHT;
-    variations[0].value = weight;
-    variations[1].tag = HB_OT_TAG_VAR_AXIS_WIDTH;
-    variations[1].value = width;
-    hb_font_set_variations(hb_font, variations, AXIS_CNT);
-
-    hb_shape(hb_font, hb_buffer, NULL, 0);
+    // instance의 sub-font는 좌표가 이미 고정되어 있다
+    hb_shape(instance->hb_font, hb_buffer, NULL, 0);
 
-    unsigned int len = hb_buffer_get_length(hb_buffer);
     info = hb_buffer_get_glyph_infos(hb_buffer, NULL);
     pos = hb_buffer_get_glyph_positions(hb_buffer, NULL);
 }
 
-void RenderText()
+void MeasureText(const hb_glyph_position_t *pos, unsigned int len, hb_direction_t direction, int fontSize,
+                 double &width, double &height)
 {
-    double width = 2 * MARGIN;
-    double height = 2 * MARGIN;
+    double margin = fontSize * .5;
+    width = 2 * margin;
+    height = 2 * margin;
 
-    unsigned int len = hb_buffer_get_length(hb_buffer);
     for (unsigned int i = 0; i < len; i++)
     {
         width += pos[i].x_advance / 64.;
         height -= pos[i].y_advance / 64.; // HarfBuzz는 y가 커지는 방향이 위쪽을 뜻한다. 세로쓰기를 하면 글자가 아래로 내려가므로, y_advance는 음수가 된다.
     }
 
-    if (HB_DIRECTION_IS_HORIZONTAL(hb_buffer_get_direction(hb_buffer)))
-        height += FONT_SIZE;
+    if (HB_DIRECTION_IS_HORIZONTAL(direction))
+        height += fontSize;
     else
-        width += FONT_SIZE;
-
-    // Cairo surface create
-    cairo_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
-                                               ceil(width),
-                                               ceil(height));
+        width += fontSize;
+}
 
-    // Cairo create
-    cr = cairo_create(cairo_surface);
-    cairo_set_source_rgba(cr, 1., 1., 1., 1.);
-    cairo_paint(cr);
-    cairo_set_source_rgba(cr, 0., 0., 0., 1.);
-    cairo_translate(cr, MARGIN, MARGIN); // 현재 변환 행렬 수정 (Margin, Margin)으로
+void DrawText(cairo_t *cr, VarInstance *instance, const hb_glyph_info_t *info, const hb_glyph_position_t *pos,
+              unsigned int len, hb_direction_t direction, int fontSize)
+{
+    // cr의 원점이 글자 영역 왼쪽 위 (margin 안쪽)에 있어야 한다
+    cairo_save(cr);
 
-    // Cairo Font Face 설정
-    cairo_face = cairo_ft_font_face_create_for_ft_face(face, 0);
-    cairo_set_font_face(cr, cairo_face);
-    cairo_set_font_size(cr, FONT_SIZE);
+    // Cairo Font Face 설정, instance마다 만들어둔 것을 쓴다
+    cairo_set_font_face(cr, instance->cairo_face);
+    cairo_set_font_size(cr, fontSize);
 
     // baseLine 설정
     // baseLine은 기준이 되는 아래 줄을 뜻한다. gpqy등의 문자들은 이 아래로 내려가기도 한다.
-    if (HB_DIRECTION_IS_HORIZONTAL(hb_buffer_get_direction(hb_buffer)))
+    if (HB_DIRECTION_IS_HORIZONTAL(direction))
     {
         cairo_font_extents_t font_extents;
         cairo_font_extents(cr, &font_extents);
-        double baseline = (FONT_SIZE - font_extents.height) * .5 + font_extents.ascent;
+        double baseline = (fontSize - font_extents.height) * .5 + font_extents.ascent;
         cairo_translate(cr, 0, baseline);
     }
     else
     {
-        cairo_translate(cr, FONT_SIZE * .5, 0);
+        cairo_translate(cr, fontSize * .5, 0);
     }
 
     cairo_glyph_t *cairo_glyphs = cairo_glyph_allocate(len);
@@ -134,20 +136,421 @@ void RenderText()
     cairo_show_glyphs(cr, cairo_glyphs, len);
     cairo_glyph_free(cairo_glyphs);
 
-    cairo_surface_write_to_png(cairo_surface, "out.png");
+    cairo_restore(cr);
 }
 
-void Destroy()
+void RenderText(VarInstance *instance, const char *outFile)
 {
-    cairo_font_face_destroy(cairo_face);
+    unsigned int len = hb_buffer_get_length(hb_buffer);
+    hb_direction_t direction = hb_buffer_get_direction(hb_buffer);
+
+    double width, height;
+    MeasureText(pos, len, direction, FONT_SIZE, width, height);
+
+    // Cairo surface create
+    cairo_surface_t *cairo_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                                                ceil(width),
+                                                                ceil(height));
+
+    // Cairo create
+    cairo_t *cr = cairo_create(cairo_surface);
+    cairo_set_source_rgba(cr, 1., 1., 1., 1.);
+    cairo_paint(cr);
+    cairo_set_source_rgba(cr, 0., 0., 0., 1.);
+    cairo_translate(cr, MARGIN, MARGIN); // 현재 변환 행렬 수정 (Margin, Margin)으로
+
+    DrawText(cr, instance, info, pos, len, direction, FONT_SIZE);
+
+    cairo_surface_write_to_png(cairo_surface, outFile);
+
     cairo_destroy(cr);
     cairo_surface_destroy(cairo_surface);
+}
+
+// --sweep: (weight, width) 격자의 모든 instance를 그려 sprite sheet나 frame 파일들로 낸다
+struct SweepAxis
+{
+    float min = 0;
+    float max = 0;
+    float step = 1;
+
+    int count() const { return step > 0 && max > min ? (int)floor((max - min) / step + 1e-4) + 1 : 1; }
+    float value(int i) const { return std::min(min + step * i, max); }
+};
+
+struct SweepOptions
+{
+    SweepAxis weight;
+    SweepAxis width;
+    int fontSize = FONT_SIZE;
+    int threads = 0;           // 0이면 core 수
+    int keyStep = 4;           // weight 방향으로 몇 칸마다 실제로 shape 할지, 1이면 전부 shape
+    const char *sheet = "sheet.png";
+    const char *frames = NULL; // printf 형식 (%d 하나), 있으면 sheet 대신 frame마다 파일로 쓴다
+};
+
+// frame 하나 (weight, width 조합 하나)의 shaping 결과
+struct SweepFrame
+{
+    bool interpolated = false;
+    hb_direction_t direction = HB_DIRECTION_LTR;
+    std::vector<hb_glyph_info_t> infos;
+    std::vector<hb_glyph_position_t> positions;
+    std::vector<hb_position_t> kerning; // keyframe만: x_advance - advance table 값 (GPOS가 더한 몫)
+};
+
+// worker thread 하나가 쓰는 것. InstanceCache (FT_Library와 FT_Face)는 thread 사이에 공유하지 않는다
+struct SweepWorker
+{
+    InstanceCache *instances = NULL;
+    hb_buffer_t *buffer = NULL;
+    uint64_t shaped = 0;
+    uint64_t interpolated = 0;
+};
+
+void ParallelFor(std::vector<SweepWorker> &workers, size_t count, const std::function<void(SweepWorker &, size_t)> &fn)
+{
+    // 연속된 index 묶음을 가져간다. 이웃한 칸이 같은 worker에 가서 cache된 instance를 다시 쓸 수 있고,
+    // job 크기가 고르지 않아도 worker마다 묶음이 여러개라서 부하가 고르게 나뉜다
+    size_t chunk = std::max<size_t>(1, count / (workers.size() * 4));
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (SweepWorker &worker : workers)
+    {
+        threads.emplace_back([&worker, &next, count, chunk, &fn] {
+            for (size_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk))
+            {
+                for (size_t i = begin; i < std::min(begin + chunk, count); i++)
+                    fn(worker, i);
+            }
+        });
+    }
+    for (std::thread &t : threads)
+        t.join();
+}
+
+VarInstance *GetSweepInstance(SweepWorker &worker, float weight, float width, unsigned int parts)
+{
+    hb_variation_t variations[AXIS_CNT];
+    variations[0].tag = HB_OT_TAG_VAR_AXIS_WEIGHT;
+    variations[0].value = weight;
+    variations[1].tag = HB_OT_TAG_VAR_AXIS_WIDTH;
+    variations[1].value = width;
+
+    return worker.instances->get(variations, AXIS_CNT, parts);
+}
+
+void ShapeFrame(SweepWorker &worker, VarInstance *instance, SweepFrame &frame)
+{
+    hb_buffer_clear_contents(worker.buffer);
+    hb_buffer_add_utf8(worker.buffer, str.c_str(), -1, 0, -1);
+    hb_buffer_guess_segment_properties(worker.buffer);
+    hb_shape(instance->hb_font, worker.buffer, NULL, 0);
+
+    unsigned int len = 0;
+    hb_glyph_info_t *infos = hb_buffer_get_glyph_infos(worker.buffer, &len);
+    hb_glyph_position_t *positions = hb_buffer_get_glyph_positions(worker.buffer, NULL);
+
+    frame.interpolated = false;
+    frame.direction = hb_buffer_get_direction(worker.buffer);
+    frame.infos.assign(infos, infos + len);
+    frame.positions.assign(positions, positions + len);
+
+    frame.kerning.resize(len);
+    for (unsigned int i = 0; i < len; i++)
+        frame.kerning[i] = positions[i].x_advance - instance->advance(infos[i].codepoint);
+
+    worker.shaped++;
+}
+
+bool CanInterpolate(const SweepFrame &a, const SweepFrame &b)
+{
+    // 양쪽 keyframe의 glyph 순서가 같아야 한다 (GSUB FeatureVariations 등으로 glyph가 바뀌면 다시 shape)
+    if (a.direction != b.direction || !HB_DIRECTION_IS_HORIZONTAL(a.direction) || a.infos.size() != b.infos.size())
+        return false;
+
+    for (size_t i = 0; i < a.infos.size(); i++)
+    {
+        if (a.infos[i].codepoint != b.infos[i].codepoint || a.infos[i].cluster != b.infos[i].cluster)
+            return false;
+    }
+    return true;
+}
+
+void InterpolateFrame(SweepWorker &worker, VarInstance *instance, const SweepFrame &a, const SweepFrame &b, double t,
+                      SweepFrame &frame)
+{
+    // glyph 순서는 keyframe 것을 그대로 쓰고 position만 만든다.
+    // advance는 이 instance의 advance table(hmtx + HVAR)에서 정확한 값을 쓰고,
+    // GPOS가 더한 몫(kerning, mark offset)만 정규화 좌표에 대해 직선 보간한다.
+    // variation delta는 region 안에서 정규화 좌표의 1차식이므로 keyframe 사이에 peak가 없으면 정확하다.
+    auto lerp = [t](hb_position_t x, hb_position_t y) {
+        return (hb_position_t)lround(x + (y - x) * t);
+    };
+
+    size_t len = a.infos.size();
+    frame.interpolated = true;
+    frame.direction = a.direction;
+    frame.infos = a.infos;
+    frame.positions.resize(len);
+    frame.kerning.clear();
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hb_glyph_position_t &p = frame.positions[i];
+        p = a.positions[i];
+        p.x_advance = instance->advance(a.infos[i].codepoint) + lerp(a.kerning[i], b.kerning[i]);
+        p.y_advance = lerp(a.positions[i].y_advance, b.positions[i].y_advance);
+        p.x_offset = lerp(a.positions[i].x_offset, b.positions[i].x_offset);
+        p.y_offset = lerp(a.positions[i].y_offset, b.positions[i].y_offset);
+    }
+
+    worker.interpolated++;
+}
+
+bool ParseAxis(const char *arg, SweepAxis &axis)
+{
+    // "min:max:step" 또는 값 하나
+    int n = sscanf(arg, "%f:%f:%f", &axis.min, &axis.max, &axis.step);
+    if (n == 1)
+    {
+        axis.max = axis.min;
+        axis.step = 1;
+        return true;
+    }
+    return n == 3 && axis.step > 0 && axis.max >= axis.min;
+}
+
+bool ValidFramePattern(const char *pattern)
+{
+    // %d 하나 (0, width 허용)만 있어야 한다
+    int numbers = 0;
+    for (const char *p = pattern; *p; p++)
+    {
+        if (*p != '%')
+            continue;
+        if (p[1] == '%')
+        {
+            p++;
+            continue;
+        }
+
+        p++;
+        while (*p >= '0' && *p <= '9')
+            p++;
+        if (*p != 'd')
+            return false;
+        numbers++;
+    }
+    return numbers == 1;
+}
+
+int RunSweep(const SweepOptions &options)
+{
+    int cols = options.weight.count();
+    int rows = options.width.count();
+    size_t count = (size_t)cols * rows;
+    int keyStep = std::max(options.keyStep, 1);
+
+    int threadCount = options.threads > 0 ? options.threads : (int)std::thread::hardware_concurrency();
+    threadCount = std::max(1, std::min<int>(threadCount, count));
+
+    std::vector<SweepWorker> workers(threadCount);
+    for (SweepWorker &worker : workers)
+    {
+        // 칸마다 shaping 부분은 shape / 보간할 때, drawing 부분은 그릴 때 한번씩만 만든다 (각 단계에서 한번만 쓴다).
+        // 그래서 cache는 작게 둔다
+        worker.instances = new InstanceCache(8);
+        if (!worker.instances->open(FONT_FILE, 0, options.fontSize))
+        {
+            printf("Font load error.\n");
+            return 1;
+        }
+        worker.buffer = hb_buffer_create();
+    }
+
+    // advance table은 text가 쓰는 glyph만 담는다. 기본 instance로 shape해서 모은다
+    // (다른 instance에서 다른 glyph가 나오면 advance()가 HarfBuzz에 바로 묻는다)
+    {
+        SweepFrame frame;
+        ShapeFrame(workers[0], workers[0].instances->get(NULL, 0, INSTANCE_SHAPING), frame);
+        workers[0].shaped = 0;
+
+        std::vector<hb_codepoint_t> glyphs;
+        for (const hb_glyph_info_t &info : frame.infos)
+            glyphs.push_back(info.codepoint);
+        for (SweepWorker &worker : workers)
+            worker.instances->setGlyphs(glyphs.data(), glyphs.size());
+    }
+
+    // weight 축의 정규화 좌표 (보간 비율 계산용), axis가 없으면 보간하지 않는다
+    int weightAxis = -1;
+    const std::vector<hb_ot_var_axis_info_t> &axes = workers[0].instances->axes();
+    for (size_t i = 0; i < axes.size(); i++)
+    {
+        if (axes[i].tag == HB_OT_TAG_VAR_AXIS_WEIGHT)
+            weightAxis = i;
+    }
+    if (weightAxis < 0)
+        keyStep = 1;
+
+    auto isKey = [cols, keyStep](int col) { return col % keyStep == 0 || col == cols - 1; };
+
+    std::vector<SweepFrame> frames(count);
+    std::vector<int> keyCoords(count, 0);
+    auto start = std::chrono::steady_clock::now();
+
+    // 1. keyframe shape
+    std::vector<size_t> keys;
+    std::vector<size_t> between;
+    for (size_t f = 0; f < count; f++)
+        (isKey(f % cols) ? keys : between).push_back(f);
+
+    ParallelFor(workers, keys.size(), [&](SweepWorker &worker, size_t i) {
+        size_t f = keys[i];
+        VarInstance *instance = GetSweepInstance(worker, options.weight.value(f % cols), options.width.value(f / cols),
+                                                 INSTANCE_SHAPING);
+        ShapeFrame(worker, instance, frames[f]);
+        if (weightAxis >= 0)
+            keyCoords[f] = instance->coords[weightAxis];
+    });
+
+    // 2. keyframe 사이: glyph 순서가 같으면 보간, 아니면 shape
+    ParallelFor(workers, between.size(), [&](SweepWorker &worker, size_t i) {
+        size_t f = between[i];
+        int col = f % cols;
+        size_t row = f / cols;
+        size_t a = row * cols + col / keyStep * keyStep;
+        size_t b = row * cols + std::min(col / keyStep * keyStep + keyStep, cols - 1);
+
+        VarInstance *instance = GetSweepInstance(worker, options.weight.value(col), options.width.value(row),
+                                                 INSTANCE_SHAPING);
+        if (!CanInterpolate(frames[a], frames[b]) || keyCoords[a] == keyCoords[b])
+        {
+            ShapeFrame(worker, instance, frames[f]);
+            return;
+        }
+
+        double t = (double)(instance->coords[weightAxis] - keyCoords[a]) / (keyCoords[b] - keyCoords[a]);
+        InterpolateFrame(worker, instance, frames[a], frames[b], t, frames[f]);
+    });
+
+    auto shaped = std::chrono::steady_clock::now();
+
+    // 모든 frame을 같은 크기의 칸에 그린다 (frame sequence도 크기가 같아야 넘겨보기 좋다)
+    double cellWidth = 0;
+    double cellHeight = 0;
+    for (const SweepFrame &frame : frames)
+    {
+        double width, height;
+        MeasureText(frame.positions.data(), frame.positions.size(), frame.direction, options.fontSize, width, height);
+        cellWidth = std::max(cellWidth, width);
+        cellHeight = std::max(cellHeight, height);
+    }
+    int cellW = ceil(cellWidth);
+    int cellH = ceil(cellHeight);
+
+    // 3. 그리기. sheet면 각 칸을 sheet memory 위의 surface로 만들어 thread마다 겹치지 않게 그린다
+    std::vector<unsigned char> sheet;
+    int sheetStride = 0;
+    if (!options.frames)
+    {
+        if ((int64_t)cellW * cols > 32767 || (int64_t)cellH * rows > 32767)
+        {
+            printf("Sprite sheet too large (%d x %d cells of %dx%d), use --frames or a smaller --size.\n",
+                   cols, rows, cellW, cellH);
+            count = 0;
+        }
+        else
+        {
+            sheetStride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, cellW * cols);
+            sheet.resize((size_t)sheetStride * cellH * rows);
+        }
+    }
+
+    std::atomic<int> failed(0);
+    ParallelFor(workers, count, [&](SweepWorker &worker, size_t f) {
+        const SweepFrame &frame = frames[f];
+        int col = f % cols;
+        int row = f / cols;
+        VarInstance *instance = GetSweepInstance(worker, options.weight.value(col), options.width.value(row),
+                                                 INSTANCE_DRAWING);
+
+        cairo_surface_t *surface;
+        if (options.frames)
+            surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, cellW, cellH);
+        else
+            surface = cairo_image_surface_create_for_data(sheet.data() + (size_t)row * cellH * sheetStride + col * cellW * 4,
+                                                          CAIRO_FORMAT_ARGB32, cellW, cellH, sheetStride);
+
+        cairo_t *cr = cairo_create(surface);
+        cairo_set_source_rgba(cr, 1., 1., 1., 1.);
+        cairo_paint(cr);
+        cairo_set_source_rgba(cr, 0., 0., 0., 1.);
+        cairo_translate(cr, options.fontSize * .5, options.fontSize * .5);
+        DrawText(cr, instance, frame.infos.data(), frame.positions.data(), frame.infos.size(),
+                 frame.direction, options.fontSize);
+        cairo_destroy(cr);
+
+        if (options.frames)
+        {
+            char outFile[4096];
+            snprintf(outFile, sizeof(outFile), options.frames, (int)f);
+            if (cairo_surface_write_to_png(surface, outFile) != CAIRO_STATUS_SUCCESS)
+                failed++;
+        }
+        else
+        {
+            cairo_surface_flush(surface);
+        }
+        cairo_surface_destroy(surface);
+    });
 
+    if (!options.frames && !sheet.empty())
+    {
+        cairo_surface_t *surface = cairo_image_surface_create_for_data(sheet.data(), CAIRO_FORMAT_ARGB32,
+                                                                       cellW * cols, cellH * rows, sheetStride);
+        if (cairo_surface_write_to_png(surface, options.sheet) != CAIRO_STATUS_SUCCESS)
+            failed++;
+        cairo_surface_destroy(surface);
+    }
+
+    auto done = std::chrono::steady_clock::now();
+
+    uint64_t shapedCount = 0;
+    uint64_t interpolatedCount = 0;
+    uint64_t fontCount = 0;
+    uint64_t faceCount = 0;
+    for (SweepWorker &worker : workers)
+    {
+        shapedCount += worker.shaped;
+        interpolatedCount += worker.interpolated;
+        fontCount += worker.instances->stats().fonts;
+        faceCount += worker.instances->stats().faces;
+
+        hb_buffer_destroy(worker.buffer);
+        delete worker.instances;
+    }
+
+    std::chrono::duration<double> shapeTime = shaped - start;
+    std::chrono::duration<double> totalTime = done - start;
+    printf("Sweep: %d x %d instances, %dx%d cells, %d threads\n", cols, rows, cellW, cellH, threadCount);
+    printf("Sweep: %llu shaped, %llu interpolated, shaping %.3f s, total %.3f s (%.1f frames/sec)\n",
+           (unsigned long long)shapedCount, (unsigned long long)interpolatedCount,
+           shapeTime.count(), totalTime.count(), totalTime.count() > 0 ? frames.size() / totalTime.count() : 0.);
+    printf("Sweep: built %llu hb instances, %llu FT faces for %zu frames\n", (unsigned long long)fontCount,
+           (unsigned long long)faceCount, frames.size());
+    if (count)
+        printf("Sweep: wrote %s\n", options.frames ? options.frames : options.sheet);
+
+    return (count == 0 || failed) ? 1 : 0;
+}
+
+void Destroy()
+{
     hb_buffer_destroy(hb_buffer);
-    hb_font_destroy(hb_font);
 
-    FT_Done_Face(face);
-    FT_Done_FreeType(library);
+    delete instances; // FT_Library는 cairo가 마지막 FT_Face를 놓을 때 해제된다
 }
 
 std::string tag_to_string(FT_ULong tag)
@@ -166,56 +569,92 @@ std::string tag_to_string(FT_ULong tag)
 
 int main(int argc, char* argv[])
 {
-    printf("How to use: ./variable_fonts [weight] [width] [text].\n");
+    printf("How to use: ./variable_fonts [weight] [width] [text] [weight width]...\n");
+    printf("            ./variable_fonts --sweep <weight min:max:step> <width min:max:step> [--text <text>] [--size <px>]\n");
+    printf("                             [--threads <n>] [--key-step <n>] [--sheet <file> | --frames <pattern>]\n");
 
-    if(argc > 1) weight = atoi(argv[1]);
-    if(argc > 2) width = atoi(argv[2]);
-    if(argc > 3) str = argv[3];
-
-    // freetype
-    if (FT_Init_FreeType(&library))
+    if(argc > 1 && strcmp(argv[1], "--sweep") == 0)
     {
-        printf("Freetype library init error.\n");
-        return 1;
+        SweepOptions options;
+        bool ok = argc > 3 && ParseAxis(argv[2], options.weight) && ParseAxis(argv[3], options.width);
+        for(int i = 4; ok && i < argc; i++)
+        {
+            if(strcmp(argv[i], "--text") == 0 && i + 1 < argc)
+                str = argv[++i];
+            else if(strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+                options.fontSize = atoi(argv[++i]);
+            else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+                options.threads = atoi(argv[++i]);
+            else if(strcmp(argv[i], "--key-step") == 0 && i + 1 < argc)
+                options.keyStep = atoi(argv[++i]);
+            else if(strcmp(argv[i], "--sheet") == 0 && i + 1 < argc)
+                options.sheet = argv[++i];
+            else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+                options.frames = argv[++i];
+            else
+                ok = false;
+        }
+
+        if(!ok || options.fontSize <= 0 || (options.frames && !ValidFramePattern(options.frames)))
+        {
+            printf("Invalid sweep arguments.\n");
+            return 1;
+        }
+
+        return RunSweep(options);
     }
 
-    if(FT_New_Face(library, FONT_FILE, 0, &face))
+    // 첫 (weight, width)는 out.png, 뒤에 더 주면 out_<weight>_<width>.png로 그린다
+    std::vector<Instance> list(1, Instance{0, 0});
+    if(argc > 1) list[0].weight = atoi(argv[1]);
+    if(argc > 2) list[0].width = atoi(argv[2]);
+    if(argc > 3) str = argv[3];
+    for(int i = 4; i + 1 < argc; i += 2)
+        list.push_back(Instance{atoi(argv[i]), atoi(argv[i + 1])});
+
+    // freetype, harfbuzz: FT_Library는 cache가 만든다
+    instances = new InstanceCache(INSTANCE_CACHE_SIZE);
+    if(!instances->open(FONT_FILE, 0, FONT_SIZE))
     {
         printf("Font load error.\n");
         return 1;
     }
 
-    FT_Set_Pixel_Sizes(face, 0, FONT_SIZE);
-
-    FT_MM_Var* mm_var;
-    if(FT_Get_MM_Var(face, &mm_var) == 0)
+    const std::vector<hb_ot_var_axis_info_t> &axes = instances->axes();
+    if(!axes.empty())
     {
         printf("Variable Font detected.\n");
-        FT_Fixed coordinates[mm_var->num_axis];
-
-        printf("Variable Count: %d\n", mm_var->num_axis);
-        for(int i=0;i<mm_var->num_axis;i++)
+        printf("Variable Count: %d\n", (int)axes.size());
+        for(const hb_ot_var_axis_info_t &axis : axes)
         {
             printf("----------");
-            printf("Variable: %s\n", mm_var->axis[i].name);
-            printf("tag: %s\n", tag_to_string(mm_var->axis[i].tag).c_str());
-
-            if(strcmp(mm_var->axis[i].name, WEIGHT_NAME) == 0)
-            {
-                printf("Weight detected.\n");
-                coordinates[i] = weight << 16;
-            }
-            else if(strcmp(mm_var->axis[i].name, WIDTH_NAME) == 0)
-            {
-                printf("WIDTH detected.\n");
-                coordinates[i] = width << 16;
-            }
+            printf("tag: %s (%g ~ %g, default %g)\n", tag_to_string(axis.tag).c_str(),
+                   axis.min_value, axis.max_value, axis.default_value);
         }
 
-        FT_Set_Var_Design_Coordinates(face, mm_var->num_axis, coordinates);
+        if(instances->hasAxis(HB_OT_TAG_VAR_AXIS_WEIGHT))
+            printf("Weight detected.\n");
+        if(instances->hasAxis(HB_OT_TAG_VAR_AXIS_WIDTH))
+            printf("WIDTH detected.\n");
     }
 
-    ShapeText();
-    RenderText();
+    for(size_t i = 0; i < list.size(); i++)
+    {
+        char outFile[64];
+        if(i == 0)
+            snprintf(outFile, sizeof(outFile), "out.png");
+        else
+            snprintf(outFile, sizeof(outFile), "out_%d_%d.png", list[i].weight, list[i].width);
+
+        VarInstance *instance = GetInstance(list[i]);
+        ShapeText(instance);
+        RenderText(instance, outFile);
+    }
+
+    const InstanceCacheStats &stats = instances->stats();
+    printf("Instance cache: %llu hits, %llu misses, %llu evictions, %d instances\n",
+           (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+           (unsigned long long)stats.evictions, (int)instances->size());
+
     Destroy();
-}
\ No newline at end of file
+}